@@ -11,27 +11,38 @@
 #include <vector>
 
 #include "base/files/file_path.h"
+#include "base/format_macros.h"
 #include "base/memory/weak_ptr.h"
+#include "base/message_loop/message_loop.h"
 #include "base/strings/stringprintf.h"
 #include "base/strings/string_util.h"
+#include "base/task_runner_util.h"
 #include "base/threading/thread_restrictions.h"
-#include "base/threading/worker_pool.h"
 #include "base/threading/sequenced_worker_pool.h"
 #include "content/public/browser/browser_thread.h"
 #include "content/public/browser/resource_request_info.h"
 #include "url/url_util.h"
+#include "net/base/mime_util.h"
 #include "net/base/net_errors.h"
+#include "net/filter/filter.h"
+#include "net/http/http_byte_range.h"
+#include "net/http/http_request_headers.h"
 #include "net/http/http_response_headers.h"
 #include "net/http/http_response_info.h"
+#include "net/http/http_util.h"
 #include "net/url_request/url_request_error_job.h"
 #include "net/url_request/url_request_file_job.h"
 #include "net/url_request/url_request_simple_job.h"
+#include "xwalk/application/browser/application_resource_cache.h"
 #include "xwalk/application/browser/application_service.h"
+#include "xwalk/application/common/application_archive.h"
 #include "xwalk/application/common/application_data.h"
 #include "xwalk/application/common/application_file_util.h"
 #include "xwalk/application/common/application_manifest_constants.h"
 #include "xwalk/application/common/application_resource.h"
+#include "xwalk/application/common/compressed_assets.h"
 #include "xwalk/application/common/constants.h"
+#include "xwalk/application/common/manifest.h"
 #include "xwalk/application/common/manifest_handlers/csp_handler.h"
 #include "xwalk/application/common/manifest_handlers/main_document_handler.h"
 
@@ -46,6 +57,18 @@ namespace application {
 
 namespace {
 
+// The resources of installed applications only change with a new version of
+// the application, that restarts it.
+const char kImmutableCacheControlHeader[] =
+    "Cache-Control: public, max-age=31536000, immutable";
+
+// The compressed copy of a resource is another representation of it, with
+// its own validator.
+std::string GetGzipETag(const std::string& etag) {
+  DCHECK(!etag.empty());
+  return etag.substr(0, etag.size() - 1) + "-gzip\"";
+}
+
 net::HttpResponseHeaders* BuildHttpHeaders(
     const std::string& content_security_policy,
     const std::string& mime_type, const std::string& method,
@@ -136,10 +159,12 @@ class GeneratedMainDocumentJob: public net::URLRequestSimpleJob {
   std::string content_security_policy_;
 };
 
-void ReadResourceFilePath(
-    const ApplicationResource& resource,
-    base::FilePath* file_path) {
-  *file_path = resource.GetFilePath();
+int ReadArchiveEntry(
+    const scoped_refptr<ApplicationArchiveReader>& reader,
+    const scoped_refptr<net::IOBuffer>& buffer,
+    int size) {
+  int result = reader->Read(buffer->data(), size);
+  return result < 0 ? net::ERR_FAILED : result;
 }
 
 class URLRequestApplicationJob : public net::URLRequestFileJob {
@@ -152,13 +177,22 @@ class URLRequestApplicationJob : public net::URLRequestFileJob {
       const base::FilePath& directory_path,
       const base::FilePath& relative_path,
       const std::string& content_security_policy,
-      bool is_authority_match)
+      bool is_authority_match,
+      const scoped_refptr<ApplicationResourceCache>& resource_cache)
       : net::URLRequestFileJob(
           request, network_delegate, base::FilePath(), file_task_runner),
+        file_task_runner_(file_task_runner),
         relative_path_(relative_path),
         content_security_policy_(content_security_policy),
         is_authority_match_(is_authority_match),
         resource_(application_id, directory_path, relative_path),
+        resource_cache_(resource_cache),
+        is_not_modified_(false),
+        is_gzip_encoded_(false),
+        range_status_(NO_RANGE),
+        contents_offset_(0),
+        contents_end_(0),
+        archive_remaining_(0),
         weak_factory_(this) {
   }
 
@@ -169,45 +203,330 @@ class URLRequestApplicationJob : public net::URLRequestFileJob {
     response_info_.headers = BuildHttpHeaders(
         content_security_policy_, mime_type, method, file_path_,
         relative_path_, is_authority_match_);
+    if (response_info_.headers->response_code() == 200)
+      AddResourceHeaders(response_info_.headers.get());
     *info = response_info_;
   }
 
+  virtual void SetExtraRequestHeaders(
+      const net::HttpRequestHeaders& headers) OVERRIDE {
+    // The Range header is handled once the resource and its validator are
+    // known, see ApplyRange(), so it isn't given to URLRequestFileJob.
+    headers.GetHeader(net::HttpRequestHeaders::kIfNoneMatch, &if_none_match_);
+    headers.GetHeader(net::HttpRequestHeaders::kAcceptEncoding,
+                      &accept_encoding_);
+    headers.GetHeader(net::HttpRequestHeaders::kRange, &range_);
+    headers.GetHeader(net::HttpRequestHeaders::kIfRange, &if_range_);
+  }
+
   virtual void Start() OVERRIDE {
-    base::FilePath* read_file_path = new base::FilePath;
+    scoped_refptr<ApplicationResourceCache::Resource> resource;
+    if (resource_cache_)
+      resource = resource_cache_->GetResource(relative_path_);
+    else
+      resource = new ApplicationResourceCache::Resource;
+
+    // The headers can't be completed before Start() returns.
+    if (resource) {
+      base::MessageLoop::current()->PostTask(
+          FROM_HERE,
+          base::Bind(&URLRequestApplicationJob::OnResourceResolved,
+                     weak_factory_.GetWeakPtr(), resource));
+      return;
+    }
 
-    bool posted = base::WorkerPool::PostTaskAndReply(
+    bool posted = base::PostTaskAndReplyWithResult(
+        file_task_runner_.get(),
         FROM_HERE,
-        base::Bind(&ReadResourceFilePath, resource_,
-                   base::Unretained(read_file_path)),
-        base::Bind(&URLRequestApplicationJob::OnFilePathRead,
-                   weak_factory_.GetWeakPtr(),
-                   base::Owned(read_file_path)),
-        true /* task is slow */);
+        base::Bind(&ApplicationResourceCache::Resolve, resource_cache_,
+                   resource_),
+        base::Bind(&URLRequestApplicationJob::DidResolveResource,
+                   weak_factory_.GetWeakPtr()));
     DCHECK(posted);
   }
 
+  virtual bool GetMimeType(std::string* mime_type) const OVERRIDE {
+    // The compressed copy has the type of the resource.
+    if (is_gzip_encoded_) {
+      return net::GetMimeTypeFromFile(resolved_resource_->file_path,
+                                      mime_type);
+    }
+    return URLRequestFileJob::GetMimeType(mime_type);
+  }
+
+  virtual net::Filter* SetupFilter() const OVERRIDE {
+    if (is_gzip_encoded_)
+      return net::Filter::GZipFactory();
+    return URLRequestFileJob::SetupFilter();
+  }
+
+  virtual void Kill() OVERRIDE {
+    weak_factory_.InvalidateWeakPtrs();
+    URLRequestFileJob::Kill();
+  }
+
+  virtual bool ReadRawData(net::IOBuffer* buf, int buf_size,
+                           int* bytes_read) OVERRIDE {
+    if (is_not_modified_ || range_status_ == RANGE_NOT_SATISFIABLE) {
+      *bytes_read = 0;
+      return true;
+    }
+
+    if (contents_) {
+      int count = std::min(buf_size,
+                           static_cast<int>(contents_end_ - contents_offset_));
+      memcpy(buf->data(), contents_->data().data() + contents_offset_, count);
+      contents_offset_ += count;
+      *bytes_read = count;
+      return true;
+    }
+
+    if (!archive_reader_)
+      return URLRequestFileJob::ReadRawData(buf, buf_size, bytes_read);
+
+    if (archive_remaining_ == 0) {
+      *bytes_read = 0;
+      return true;
+    }
+
+    int count = static_cast<int>(std::min(static_cast<int64>(buf_size),
+                                          archive_remaining_));
+    base::PostTaskAndReplyWithResult(
+        file_task_runner_.get(),
+        FROM_HERE,
+        base::Bind(&ReadArchiveEntry, archive_reader_,
+                   make_scoped_refptr(buf), count),
+        base::Bind(&URLRequestApplicationJob::DidReadArchiveEntry,
+                   weak_factory_.GetWeakPtr()));
+    SetStatus(net::URLRequestStatus(net::URLRequestStatus::IO_PENDING, 0));
+    return false;
+  }
+
  private:
   virtual ~URLRequestApplicationJob() {}
 
-  void OnFilePathRead(base::FilePath* read_file_path) {
-    file_path_ = *read_file_path;
-    if (file_path_.empty())
+  void DidResolveResource(
+      const scoped_refptr<ApplicationResourceCache::Resource>& resource) {
+    resource_cache_->AddResource(relative_path_, resource);
+    OnResourceResolved(resource);
+  }
+
+  void OnResourceResolved(
+      const scoped_refptr<ApplicationResourceCache::Resource>& resource) {
+    resolved_resource_ = resource;
+    if (!resource->exists()) {
       NotifyHeadersComplete();
-    else
+      return;
+    }
+
+    // The path of an archived resource doesn't exist, but tells the MIME
+    // type and that the resource was found.
+    file_path_ = resource->file_path;
+
+    bool is_get = request()->method() == "GET" && is_authority_match_;
+    if (is_get && !if_none_match_.empty() &&
+        (ApplicationResourceCache::MatchesETag(if_none_match_,
+                                               resource->etag) ||
+         (!resource->gzip_file_path.empty() &&
+          ApplicationResourceCache::MatchesETag(
+              if_none_match_, GetGzipETag(resource->etag))))) {
+      is_not_modified_ = true;
+      NotifyHeadersComplete();
+      return;
+    }
+
+    if (is_get && !range_.empty())
+      ApplyRange();
+    if (range_status_ == RANGE_NOT_SATISFIABLE) {
+      NotifyHeadersComplete();
+      return;
+    }
+
+    contents_ = resource_cache_->GetContents(relative_path_);
+    if (contents_) {
+      StartReadingContents();
+      return;
+    }
+
+    if (resource_cache_->ShouldCacheContents(*resource)) {
+      base::PostTaskAndReplyWithResult(
+          file_task_runner_.get(),
+          FROM_HERE,
+          base::Bind(&ApplicationResourceCache::ReadContents, resource_cache_,
+                     resource),
+          base::Bind(&URLRequestApplicationJob::DidReadContents,
+                     weak_factory_.GetWeakPtr()));
+      return;
+    }
+
+    StartReading();
+  }
+
+  void DidReadContents(
+      const scoped_refptr<base::RefCountedString>& contents) {
+    if (!contents) {
+      StartReading();
+      return;
+    }
+
+    resource_cache_->AddContents(relative_path_, contents);
+    contents_ = contents;
+    StartReadingContents();
+  }
+
+  // Serves a single range of the resource if asked to and if it didn't
+  // change since the client got its other parts. Ranges that can't be
+  // parsed are ignored, like If-Range dates, as there is no Last-Modified.
+  // Several ranges aren't supported.
+  void ApplyRange() {
+    std::vector<net::HttpByteRange> ranges;
+    if (!net::HttpUtil::ParseRangeHeader(range_, &ranges))
+      return;
+    if (!if_range_.empty() &&
+        (resolved_resource_->etag.empty() ||
+         if_range_ != resolved_resource_->etag))
+      return;
+
+    if (ranges.size() != 1 ||
+        !ranges[0].ComputeBounds(resolved_resource_->size)) {
+      range_status_ = RANGE_NOT_SATISFIABLE;
+      return;
+    }
+    byte_range_ = ranges[0];
+    range_status_ = RANGE_SATISFIABLE;
+  }
+
+  int64 GetFirstBytePosition() const {
+    return range_status_ == RANGE_SATISFIABLE ?
+        byte_range_.first_byte_position() : 0;
+  }
+
+  int64 GetContentLength() const {
+    if (range_status_ != RANGE_SATISFIABLE)
+      return resolved_resource_->size;
+    return byte_range_.last_byte_position() -
+        byte_range_.first_byte_position() + 1;
+  }
+
+  void StartReadingContents() {
+    contents_offset_ = GetFirstBytePosition();
+    contents_end_ = contents_offset_ + GetContentLength();
+    set_expected_content_size(GetContentLength());
+    NotifyHeadersComplete();
+  }
+
+  void StartReading() {
+    if (!resolved_resource_->archive_entry) {
+      if (range_status_ == RANGE_SATISFIABLE) {
+        // URLRequestFileJob seeks in the file itself.
+        net::HttpRequestHeaders headers;
+        headers.SetHeader(net::HttpRequestHeaders::kRange, base::StringPrintf(
+            "bytes=%" PRId64 "-%" PRId64, byte_range_.first_byte_position(),
+            byte_range_.last_byte_position()));
+        URLRequestFileJob::SetExtraRequestHeaders(headers);
+      } else if (!resolved_resource_->gzip_file_path.empty() &&
+                 CompressedAssets::AcceptsGzip(accept_encoding_)) {
+        // Less is read from the disk, SetupFilter() inflates the data.
+        is_gzip_encoded_ = true;
+        file_path_ = resolved_resource_->gzip_file_path;
+      }
       URLRequestFileJob::Start();
+      return;
+    }
+
+    archive_reader_ = new ApplicationArchiveReader(
+        resource_cache_->archive(), resolved_resource_->archive_entry);
+    archive_reader_->Seek(GetFirstBytePosition());
+    archive_remaining_ = GetContentLength();
+    set_expected_content_size(archive_remaining_);
+    NotifyHeadersComplete();
+  }
+
+  // Adds the headers describing a resource that was found.
+  void AddResourceHeaders(net::HttpResponseHeaders* headers) const {
+    if (!resolved_resource_)
+      return;
+
+    if (is_not_modified_) {
+      headers->ReplaceStatusLine("HTTP/1.1 304 Not Modified");
+    } else if (range_status_ == RANGE_SATISFIABLE) {
+      headers->ReplaceStatusLine("HTTP/1.1 206 Partial Content");
+      headers->AddHeader(base::StringPrintf(
+          "Content-Range: bytes %" PRId64 "-%" PRId64 "/%" PRId64,
+          byte_range_.first_byte_position(), byte_range_.last_byte_position(),
+          resolved_resource_->size));
+    } else if (range_status_ == RANGE_NOT_SATISFIABLE) {
+      headers->ReplaceStatusLine(
+          "HTTP/1.1 416 Requested Range Not Satisfiable");
+      headers->AddHeader(base::StringPrintf(
+          "Content-Range: bytes */%" PRId64, resolved_resource_->size));
+    }
+    headers->AddHeader("Accept-Ranges: bytes");
+
+    if (is_gzip_encoded_)
+      headers->AddHeader("Content-Encoding: gzip");
+    if (!resolved_resource_->gzip_file_path.empty())
+      headers->AddHeader("Vary: Accept-Encoding");
+
+    if (!resolved_resource_->etag.empty()) {
+      headers->AddHeader("ETag: " + (is_gzip_encoded_ ?
+          GetGzipETag(resolved_resource_->etag) : resolved_resource_->etag));
+      headers->AddHeader(kImmutableCacheControlHeader);
+    }
+  }
+
+  void DidReadArchiveEntry(int result) {
+    if (result > 0) {
+      archive_remaining_ -= result;
+      SetStatus(net::URLRequestStatus());
+    } else if (result == 0) {
+      NotifyDone(net::URLRequestStatus());
+    } else {
+      NotifyDone(net::URLRequestStatus(net::URLRequestStatus::FAILED,
+                                       result));
+    }
+    NotifyReadComplete(result);
   }
 
+  scoped_refptr<base::TaskRunner> file_task_runner_;
   net::HttpResponseInfo response_info_;
   base::FilePath relative_path_;
   std::string content_security_policy_;
   bool is_authority_match_;
   ApplicationResource resource_;
+  // NULL if the application isn't running.
+  scoped_refptr<ApplicationResourceCache> resource_cache_;
+  scoped_refptr<ApplicationResourceCache::Resource> resolved_resource_;
+  std::string if_none_match_;
+  bool is_not_modified_;
+  std::string accept_encoding_;
+  // Whether the compressed copy of the resource is served.
+  bool is_gzip_encoded_;
+
+  enum RangeStatus {
+    NO_RANGE,
+    RANGE_SATISFIABLE,
+    RANGE_NOT_SATISFIABLE,
+  };
+  std::string range_;
+  std::string if_range_;
+  RangeStatus range_status_;
+  net::HttpByteRange byte_range_;
+
+  // Where the body comes from when URLRequestFileJob doesn't read it.
+  scoped_refptr<base::RefCountedString> contents_;
+  size_t contents_offset_;
+  size_t contents_end_;
+  scoped_refptr<ApplicationArchiveReader> archive_reader_;
+  int64 archive_remaining_;
   base::WeakPtrFactory<URLRequestApplicationJob> weak_factory_;
 };
 
 // This class is a thread-safe cache of active application's data.
 // This class is used by ApplicationProtocolHandler as it lives on IO thread
 // and hence cannot access ApplicationService directly.
+//
+// It also keeps the ApplicationResourceCache of each application.
 class ApplicationDataCache : public ApplicationService::Observer {
  public:
   scoped_refptr<ApplicationData> GetApplicationData(
@@ -221,19 +540,38 @@ class ApplicationDataCache : public ApplicationService::Observer {
     return NULL;
   }
 
+  scoped_refptr<ApplicationResourceCache> GetResourceCache(
+      const std::string& application_id) const {
+    base::AutoLock lock(lock_);
+    ResourceCacheMap::const_iterator it =
+        resource_caches_.find(application_id);
+    if (it != resource_caches_.end())
+      return it->second;
+    return NULL;
+  }
+
   virtual void DidLaunchApplication(Application* app) OVERRIDE {
     base::AutoLock lock(lock_);
     cache_.insert(std::pair<std::string, scoped_refptr<ApplicationData> >(
         app->id(), app->data()));
+    // Only the installed applications can't change while they run.
+    resource_caches_[app->id()] = new ApplicationResourceCache(
+        app->data()->Path(),
+        app->data()->GetSourceType() == Manifest::INTERNAL);
   }
 
   virtual void WillDestroyApplication(Application* app) OVERRIDE {
     base::AutoLock lock(lock_);
     cache_.erase(app->id());
+    resource_caches_.erase(app->id());
   }
 
  private:
+  typedef std::map<std::string, scoped_refptr<ApplicationResourceCache> >
+      ResourceCacheMap;
+
   ApplicationData::ApplicationDataMap cache_;
+  ResourceCacheMap resource_caches_;
   mutable base::Lock lock_;
 };
 
@@ -306,7 +644,8 @@ ApplicationProtocolHandler::MaybeCreateJob(
       directory_path,
       relative_path,
       content_security_policy,
-      application);
+      application,
+      cache_.GetResourceCache(application_id));
 }
 
 }  // namespace
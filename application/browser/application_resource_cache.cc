@@ -0,0 +1,204 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/application/browser/application_resource_cache.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "base/file_util.h"
+#include "base/format_macros.h"
+#include "base/logging.h"
+#include "base/platform_file.h"
+#include "base/strings/string_split.h"
+#include "base/strings/string_util.h"
+#include "base/strings/stringprintf.h"
+#include "xwalk/application/common/application_resource.h"
+#include "xwalk/application/common/constants.h"
+
+namespace xwalk {
+namespace application {
+
+namespace {
+
+// The resolved resources kept, whether they exist or not.
+const size_t kMaxResources = 1024;
+// Bigger resources are always read from the disk.
+const int64 kMaxContentSize = 256 * 1024;
+// The budget of the cached contents, for each application.
+const size_t kMaxContentsSize = 4 * 1024 * 1024;
+
+}  // namespace
+
+ApplicationResourceCache::Resource::Resource()
+    : archive_entry(NULL),
+      size(0),
+      hits(0) {
+}
+
+ApplicationResourceCache::Resource::~Resource() {
+}
+
+ApplicationResourceCache::ApplicationResourceCache(
+    const base::FilePath& application_path, bool is_immutable)
+    : application_path_(application_path),
+      archive_(new ApplicationArchive(
+          application_path.Append(kApplicationArchiveFilename))),
+      is_immutable_(is_immutable),
+      compressed_assets_loaded_(false),
+      resources_(kMaxResources),
+      contents_(ContentsMap::NO_AUTO_EVICT),
+      contents_size_(0) {
+  // Created on the UI thread, but only used on the IO thread.
+  thread_checker_.DetachFromThread();
+}
+
+ApplicationResourceCache::~ApplicationResourceCache() {
+}
+
+scoped_refptr<ApplicationResourceCache::Resource>
+ApplicationResourceCache::Resolve(const ApplicationResource& resource) const {
+  scoped_refptr<Resource> result(new Resource);
+
+  if (archive_->Open()) {
+    std::string name = resource.relative_path().AsUTF8Unsafe();
+#if defined(FILE_PATH_USES_WIN_SEPARATORS)
+    // Entry names always use '/' as separator.
+    std::replace(name.begin(), name.end(), '\\', '/');
+#endif
+    const ApplicationArchive::Entry* entry = archive_->FindEntry(name);
+    if (!entry)
+      return result;
+
+    result->file_path =
+        resource.application_root().Append(resource.relative_path());
+    result->archive_entry = entry;
+    result->size = entry->uncompressed_size;
+    if (is_immutable_) {
+      result->etag = base::StringPrintf(
+          "\"%" PRIx64 "-%x\"", result->size, entry->crc);
+    }
+    return result;
+  }
+
+  result->file_path = resource.GetFilePath();
+  base::PlatformFileInfo file_info;
+  if (result->file_path.empty() ||
+      !file_util::GetFileInfo(result->file_path, &file_info) ||
+      file_info.is_directory)
+    return result;
+
+  result->size = file_info.size;
+  if (is_immutable_) {
+    result->etag = base::StringPrintf(
+        "\"%" PRIx64 "-%" PRIx64 "\"", result->size,
+        file_info.last_modified.ToInternalValue());
+    // The copies are only valid as long as the resources don't change.
+    const CompressedAssets* compressed_assets = GetCompressedAssets();
+    if (compressed_assets) {
+      result->gzip_file_path = compressed_assets->GetGzipFilePath(
+          resource.relative_path(), result->size, file_info.last_modified);
+    }
+  }
+  return result;
+}
+
+const CompressedAssets* ApplicationResourceCache::GetCompressedAssets() const {
+  base::AutoLock lock(compressed_assets_lock_);
+  if (!compressed_assets_loaded_) {
+    compressed_assets_ = CompressedAssets::Load(application_path_);
+    compressed_assets_loaded_ = true;
+  }
+  return compressed_assets_.get();
+}
+
+scoped_refptr<base::RefCountedString> ApplicationResourceCache::ReadContents(
+    const scoped_refptr<Resource>& resource) const {
+  std::string contents;
+  if (resource->archive_entry) {
+    if (!archive_->ReadEntry(*resource->archive_entry, &contents))
+      return NULL;
+  } else if (!base::ReadFileToString(resource->file_path, &contents) ||
+             static_cast<int64>(contents.size()) != resource->size) {
+    return NULL;
+  }
+  return base::RefCountedString::TakeString(&contents);
+}
+
+scoped_refptr<ApplicationResourceCache::Resource>
+ApplicationResourceCache::GetResource(const base::FilePath& relative_path) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  ResourceMap::iterator it = resources_.Get(relative_path.value());
+  if (it == resources_.end())
+    return NULL;
+  it->second->hits++;
+  return it->second;
+}
+
+void ApplicationResourceCache::AddResource(
+    const base::FilePath& relative_path,
+    const scoped_refptr<Resource>& resource) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  if (is_immutable_)
+    resources_.Put(relative_path.value(), resource);
+}
+
+scoped_refptr<base::RefCountedString> ApplicationResourceCache::GetContents(
+    const base::FilePath& relative_path) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  ContentsMap::iterator it = contents_.Get(relative_path.value());
+  if (it == contents_.end())
+    return NULL;
+  return it->second;
+}
+
+bool ApplicationResourceCache::ShouldCacheContents(
+    const Resource& resource) const {
+  // Only the resources requested again are cached, most are requested once
+  // when the application starts.
+  return is_immutable_ && resource.exists() && !resource.etag.empty() &&
+      resource.size > 0 && resource.size <= kMaxContentSize &&
+      resource.hits > 0;
+}
+
+void ApplicationResourceCache::AddContents(
+    const base::FilePath& relative_path,
+    const scoped_refptr<base::RefCountedString>& contents) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+  if (!is_immutable_ ||
+      contents_.Peek(relative_path.value()) != contents_.end())
+    return;
+
+  contents_.Put(relative_path.value(), contents);
+  contents_size_ += contents->size();
+  while (contents_size_ > kMaxContentsSize) {
+    ContentsMap::reverse_iterator oldest = contents_.rbegin();
+    contents_size_ -= oldest->second->size();
+    contents_.Erase(oldest);
+  }
+}
+
+// static
+bool ApplicationResourceCache::MatchesETag(const std::string& if_none_match,
+                                           const std::string& etag) {
+  if (etag.empty())
+    return false;
+
+  std::vector<std::string> tags;
+  base::SplitString(if_none_match, ',', &tags);
+  for (size_t i = 0; i < tags.size(); ++i) {
+    // If-None-Match uses the weak comparison.
+    std::string tag = tags[i];
+    if (tag == "*")
+      return true;
+    if (StartsWithASCII(tag, "W/", true))
+      tag.erase(0, 2);
+    if (tag == etag)
+      return true;
+  }
+  return false;
+}
+
+}  // namespace application
+}  // namespace xwalk
@@ -0,0 +1,142 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef XWALK_APPLICATION_BROWSER_APPLICATION_RESOURCE_CACHE_H_
+#define XWALK_APPLICATION_BROWSER_APPLICATION_RESOURCE_CACHE_H_
+
+#include <string>
+
+#include "base/containers/mru_cache.h"
+#include "base/files/file_path.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/ref_counted_memory.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/thread_checker.h"
+#include "xwalk/application/common/application_archive.h"
+#include "xwalk/application/common/compressed_assets.h"
+
+namespace xwalk {
+namespace application {
+
+class ApplicationResource;
+
+// Caches what the app:// protocol handler learns about the resources of an
+// application, so repeated requests don't go to the disk:
+//
+//   - where a resource was found, or that it doesn't exist, skipping the
+//     path resolution and symlink checks of ApplicationResource;
+//   - the strong validator (ETag) of the resource, so conditional requests
+//     are answered without IO;
+//   - the contents of small resources requested more than once, under a byte
+//     budget, least recently used first out.
+//
+// The resources of installed applications don't change, for the others
+// nothing is cached and every request resolves its resource again. The cache
+// also owns the archive the application may be installed as, and the
+// compressed copies of its resources.
+//
+// Resolve() and ReadContents() do IO and run on a worker thread, the other
+// methods are used on the IO thread.
+class ApplicationResourceCache
+    : public base::RefCountedThreadSafe<ApplicationResourceCache> {
+ public:
+  // A resolved resource. The fields don't change once the resource is
+  // resolved.
+  class Resource : public base::RefCountedThreadSafe<Resource> {
+   public:
+    Resource();
+
+    bool exists() const { return !file_path.empty(); }
+
+    // The file of the resource or, if it is in the archive, the file it
+    // would be extracted to, that tells its MIME type. Empty if the resource
+    // doesn't exist.
+    base::FilePath file_path;
+    // NULL unless the resource is in the archive.
+    const ApplicationArchive::Entry* archive_entry;
+    int64 size;
+    // Empty if the resource can change.
+    std::string etag;
+    // The gzip compressed copy of the resource, if any.
+    base::FilePath gzip_file_path;
+
+   private:
+    friend class base::RefCountedThreadSafe<Resource>;
+    friend class ApplicationResourceCache;
+
+    ~Resource();
+
+    // How many times the resource was got from the cache.
+    int hits;
+  };
+
+  // |is_immutable| tells that the resources of the application at
+  // |application_path| can't change, enabling the cache.
+  ApplicationResourceCache(const base::FilePath& application_path,
+                           bool is_immutable);
+
+  // Runs on a worker thread.
+  scoped_refptr<Resource> Resolve(const ApplicationResource& resource) const;
+
+  // Runs on a worker thread. Returns NULL if the resource can't be read.
+  scoped_refptr<base::RefCountedString> ReadContents(
+      const scoped_refptr<Resource>& resource) const;
+
+  // Returns NULL if |relative_path| wasn't resolved yet.
+  scoped_refptr<Resource> GetResource(const base::FilePath& relative_path);
+  void AddResource(const base::FilePath& relative_path,
+                   const scoped_refptr<Resource>& resource);
+
+  // Returns NULL if the contents of |relative_path| aren't cached.
+  scoped_refptr<base::RefCountedString> GetContents(
+      const base::FilePath& relative_path);
+  // Tells if the contents of |resource| are worth reading in memory with
+  // ReadContents() and passing to AddContents().
+  bool ShouldCacheContents(const Resource& resource) const;
+  void AddContents(const base::FilePath& relative_path,
+                   const scoped_refptr<base::RefCountedString>& contents);
+
+  ApplicationArchive* archive() const { return archive_.get(); }
+  size_t contents_size() const { return contents_size_; }
+
+  // Tells if the value of an If-None-Match header matches |etag|.
+  static bool MatchesETag(const std::string& if_none_match,
+                          const std::string& etag);
+
+ private:
+  friend class base::RefCountedThreadSafe<ApplicationResourceCache>;
+
+  typedef base::MRUCache<base::FilePath::StringType, scoped_refptr<Resource> >
+      ResourceMap;
+  typedef base::MRUCache<base::FilePath::StringType,
+                         scoped_refptr<base::RefCountedString> > ContentsMap;
+
+  ~ApplicationResourceCache();
+
+  // Loads the compressed assets the first time it is called. Returns NULL
+  // if there are none.
+  const CompressedAssets* GetCompressedAssets() const;
+
+  const base::FilePath application_path_;
+  scoped_refptr<ApplicationArchive> archive_;
+  const bool is_immutable_;
+
+  mutable base::Lock compressed_assets_lock_;
+  mutable bool compressed_assets_loaded_;
+  mutable scoped_ptr<CompressedAssets> compressed_assets_;
+
+  ResourceMap resources_;
+  ContentsMap contents_;
+  size_t contents_size_;
+
+  base::ThreadChecker thread_checker_;
+
+  DISALLOW_COPY_AND_ASSIGN(ApplicationResourceCache);
+};
+
+}  // namespace application
+}  // namespace xwalk
+
+#endif  // XWALK_APPLICATION_BROWSER_APPLICATION_RESOURCE_CACHE_H_
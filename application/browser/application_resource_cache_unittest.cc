@@ -0,0 +1,161 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/application/browser/application_resource_cache.h"
+
+#include <string>
+
+#include "base/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/strings/stringprintf.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "xwalk/application/common/application_resource.h"
+#include "xwalk/application/common/compressed_assets.h"
+
+namespace xwalk {
+namespace application {
+
+class ApplicationResourceCacheTest : public testing::Test {
+ public:
+  virtual void SetUp() OVERRIDE {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+  }
+
+  void CreateCache(bool is_immutable) {
+    cache_ = new ApplicationResourceCache(temp_dir_.path(), is_immutable);
+  }
+
+  base::FilePath WriteResource(const std::string& name, size_t size) {
+    std::string contents(size, 'x');
+    EXPECT_EQ(static_cast<int>(size), file_util::WriteFile(
+        temp_dir_.path().AppendASCII(name), contents.data(), size));
+    return base::FilePath::FromUTF8Unsafe(name);
+  }
+
+  scoped_refptr<ApplicationResourceCache::Resource> Resolve(
+      const base::FilePath& relative_path) {
+    return cache_->Resolve(
+        ApplicationResource("id", temp_dir_.path(), relative_path));
+  }
+
+ protected:
+  base::ScopedTempDir temp_dir_;
+  scoped_refptr<ApplicationResourceCache> cache_;
+};
+
+TEST_F(ApplicationResourceCacheTest, Resolve) {
+  CreateCache(true);
+  base::FilePath path = WriteResource("index.html", 100);
+
+  scoped_refptr<ApplicationResourceCache::Resource> resource = Resolve(path);
+  EXPECT_TRUE(resource->exists());
+  EXPECT_TRUE(resource->archive_entry == NULL);
+  EXPECT_EQ(100, resource->size);
+  ASSERT_FALSE(resource->etag.empty());
+  EXPECT_EQ('"', resource->etag[0]);
+
+  resource = Resolve(base::FilePath::FromUTF8Unsafe("missing.html"));
+  EXPECT_FALSE(resource->exists());
+
+  // The resources of other applications can change.
+  CreateCache(false);
+  resource = Resolve(path);
+  EXPECT_TRUE(resource->exists());
+  EXPECT_TRUE(resource->etag.empty());
+}
+
+TEST_F(ApplicationResourceCacheTest, ResolveCompressedCopy) {
+  std::string contents;
+  for (int i = 0; i < 1000; ++i)
+    contents += "body { color: black; }\n";
+  base::FilePath path = base::FilePath::FromUTF8Unsafe("style.css");
+  ASSERT_EQ(static_cast<int>(contents.size()), file_util::WriteFile(
+      temp_dir_.path().Append(path), contents.data(), contents.size()));
+  ASSERT_TRUE(CompressedAssets::Create(temp_dir_.path()));
+
+  CreateCache(true);
+  scoped_refptr<ApplicationResourceCache::Resource> resource = Resolve(path);
+  EXPECT_FALSE(resource->gzip_file_path.empty());
+
+  CreateCache(false);
+  resource = Resolve(path);
+  EXPECT_TRUE(resource->gzip_file_path.empty());
+}
+
+TEST_F(ApplicationResourceCacheTest, ResolvedResourcesAreCached) {
+  CreateCache(true);
+  base::FilePath path = WriteResource("main.js", 100);
+  EXPECT_TRUE(cache_->GetResource(path) == NULL);
+
+  scoped_refptr<ApplicationResourceCache::Resource> resource = Resolve(path);
+  cache_->AddResource(path, resource);
+  EXPECT_EQ(resource.get(), cache_->GetResource(path).get());
+
+  CreateCache(false);
+  cache_->AddResource(path, Resolve(path));
+  EXPECT_TRUE(cache_->GetResource(path) == NULL);
+}
+
+TEST_F(ApplicationResourceCacheTest, OnlyContentsRequestedAgainAreCached) {
+  CreateCache(true);
+  base::FilePath path = WriteResource("style.css", 1000);
+  base::FilePath big_path = WriteResource("movie.webm", 1024 * 1024);
+
+  scoped_refptr<ApplicationResourceCache::Resource> resource = Resolve(path);
+  cache_->AddResource(path, resource);
+  EXPECT_FALSE(cache_->ShouldCacheContents(*resource));
+  cache_->GetResource(path);
+  EXPECT_TRUE(cache_->ShouldCacheContents(*resource));
+
+  scoped_refptr<base::RefCountedString> contents =
+      cache_->ReadContents(resource);
+  ASSERT_TRUE(contents.get());
+  EXPECT_EQ(1000u, contents->size());
+  cache_->AddContents(path, contents);
+  EXPECT_EQ(contents.get(), cache_->GetContents(path).get());
+  EXPECT_EQ(1000u, cache_->contents_size());
+
+  resource = Resolve(big_path);
+  cache_->AddResource(big_path, resource);
+  cache_->GetResource(big_path);
+  EXPECT_FALSE(cache_->ShouldCacheContents(*resource));
+}
+
+TEST_F(ApplicationResourceCacheTest, LeastRecentlyUsedContentsAreEvicted) {
+  CreateCache(true);
+  const size_t kContentsSize = 200 * 1024;
+  const int kResourceCount = 40;
+  for (int i = 0; i < kResourceCount; ++i) {
+    base::FilePath path = base::FilePath::FromUTF8Unsafe(
+        base::StringPrintf("%d.png", i));
+    std::string contents(kContentsSize, 'x');
+    cache_->AddContents(path, base::RefCountedString::TakeString(&contents));
+    // The first resource is the most used one.
+    cache_->GetContents(base::FilePath::FromUTF8Unsafe("0.png"));
+  }
+
+  EXPECT_LE(cache_->contents_size(), 4u * 1024 * 1024);
+  EXPECT_GT(cache_->contents_size(), 4u * 1024 * 1024 - kContentsSize);
+  EXPECT_TRUE(cache_->GetContents(
+      base::FilePath::FromUTF8Unsafe("0.png")) != NULL);
+  EXPECT_TRUE(cache_->GetContents(
+      base::FilePath::FromUTF8Unsafe("1.png")) == NULL);
+  EXPECT_TRUE(cache_->GetContents(base::FilePath::FromUTF8Unsafe(
+      base::StringPrintf("%d.png", kResourceCount - 1))) != NULL);
+}
+
+TEST_F(ApplicationResourceCacheTest, MatchesETag) {
+  const std::string etag = "\"64-1234\"";
+  EXPECT_TRUE(ApplicationResourceCache::MatchesETag("\"64-1234\"", etag));
+  EXPECT_TRUE(ApplicationResourceCache::MatchesETag("W/\"64-1234\"", etag));
+  EXPECT_TRUE(ApplicationResourceCache::MatchesETag(
+      "\"1\", \"64-1234\"", etag));
+  EXPECT_TRUE(ApplicationResourceCache::MatchesETag("*", etag));
+  EXPECT_FALSE(ApplicationResourceCache::MatchesETag("\"64-1235\"", etag));
+  EXPECT_FALSE(ApplicationResourceCache::MatchesETag("64-1234", etag));
+  EXPECT_FALSE(ApplicationResourceCache::MatchesETag("*", ""));
+}
+
+}  // namespace application
+}  // namespace xwalk
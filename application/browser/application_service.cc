@@ -7,6 +7,7 @@
 #include <set>
 #include <string>
 
+#include "base/command_line.h"
 #include "base/files/file_enumerator.h"
 #include "base/file_util.h"
 #include "base/memory/scoped_ptr.h"
@@ -20,11 +21,16 @@
 #include "xwalk/application/browser/installer/package.h"
 #include "xwalk/application/common/application_file_util.h"
 #include "xwalk/application/common/application_manifest_constants.h"
+#include "xwalk/application/common/compressed_assets.h"
 #include "xwalk/application/common/event_names.h"
 #include "xwalk/application/common/id_util.h"
+#include "xwalk/application/common/manifest_handlers/permissions_handler.h"
+#include "xwalk/extensions/common/xwalk_extension_server.h"
+#include "xwalk/extensions/common/xwalk_extension_switches.h"
 #include "xwalk/runtime/browser/runtime_context.h"
 #include "xwalk/runtime/browser/runtime.h"
 #include "xwalk/runtime/browser/xwalk_runner.h"
+#include "xwalk/runtime/common/xwalk_switches.h"
 
 #if defined(OS_TIZEN_MOBILE)
 #include "xwalk/application/browser/installer/tizen/package_installer.h"
@@ -221,11 +227,26 @@ bool ApplicationService::Install(const base::FilePath& path, std::string* id) {
       !file_util::CreateDirectory(data_dir))
     return false;
 
+  const CommandLine& command_line = *CommandLine::ForCurrentProcess();
+  bool install_as_archive = false;
   base::FilePath unpacked_dir;
   scoped_ptr<Package> package;
   if (!base::DirectoryExists(path)) {
     package = Package::Create(path);
+    if (!package)
+      return false;
+    // The package is moved to |data_dir| once extracted.
+    package->set_extraction_parent_path(data_dir);
+#if defined(OS_TIZEN_MOBILE)
+    // The Tizen installer needs the icons and other files on disk.
     package->Extract(&unpacked_dir);
+#else
+    install_as_archive = command_line.HasSwitch(switches::kInstallAsArchive);
+    if (install_as_archive)
+      package->ExtractManifest(&unpacked_dir);
+    else
+      package->Extract(&unpacked_dir);
+#endif
   } else {
     unpacked_dir = path;
   }
@@ -261,6 +282,13 @@ bool ApplicationService::Install(const base::FilePath& path, std::string* id) {
 
   application_data->SetPath(app_dir);
 
+  // The resources of archives are compressed already.
+  if (!install_as_archive &&
+      command_line.HasSwitch(switches::kInstallCompressedAssets) &&
+      !CompressedAssets::Create(app_dir))
+    LOG(WARNING) << "No resource of " << application_data->ID()
+                 << " was compressed.";
+
   if (!application_storage_->AddApplication(application_data)) {
     LOG(ERROR) << "Application with id " << application_data->ID()
                << " couldn't be installed.";
@@ -452,6 +480,31 @@ void ApplicationService::OnApplicationTerminated(
   }
 }
 
+// Only the external extensions providing the APIs the application declared
+// in its manifest permissions are used by its render processes. Applications
+// without permissions, and render processes not running an application,
+// keep getting all of them.
+void ApplicationService::GetExternalExtensionsFilter(
+    int render_process_id,
+    extensions::XWalkExternalExtensionsFilter* filter) const {
+  Application* application = GetApplicationByRenderHostID(render_process_id);
+  if (!application)
+    return;
+
+  PermissionsInfo* info = static_cast<PermissionsInfo*>(
+      application->data()->GetManifestData(
+          application_manifest_keys::kPermissionsKey));
+  if (info) {
+    const std::vector<std::string>& permissions = info->GetAPIPermissions();
+    filter->permissions.insert(permissions.begin(), permissions.end());
+    // Libraries can also be skipped before being loaded, if they are named
+    // after the permissions.
+    if (CommandLine::ForCurrentProcess()->HasSwitch(
+            switches::kXWalkOnlyPermittedExternalExtensions))
+      filter->libraries = filter->permissions;
+  }
+}
+
 Application* ApplicationService::Launch(
     scoped_refptr<ApplicationData> application_data,
     const Application::LaunchParams& launch_params) {
@@ -18,6 +18,10 @@ namespace xwalk {
 
 class RuntimeContext;
 
+namespace extensions {
+struct XWalkExternalExtensionsFilter;
+}
+
 namespace application {
 
 class ApplicationStorage;
@@ -60,6 +64,12 @@ class ApplicationService : public Application::Observer {
   Application* GetApplicationByRenderHostID(int id) const;
   Application* GetApplicationByID(const std::string& app_id) const;
 
+  // Restricts the external extensions of a render process to the ones the
+  // application it runs asked for, if any.
+  void GetExternalExtensionsFilter(
+      int render_process_id,
+      extensions::XWalkExternalExtensionsFilter* filter) const;
+
   const ScopedVector<Application>& active_applications() const {
       return applications_; }
 
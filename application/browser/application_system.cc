@@ -175,5 +175,11 @@ void ApplicationSystem::CreateExtensions(
               event_manager_.get(), application_storage_.get(), application));
 }
 
+void ApplicationSystem::GetExternalExtensionsFilter(
+    content::RenderProcessHost* host,
+    extensions::XWalkExternalExtensionsFilter* filter) {
+  application_service_->GetExternalExtensionsFilter(host->GetID(), filter);
+}
+
 }  // namespace application
 }  // namespace xwalk
@@ -20,6 +20,9 @@ class RenderProcessHost;
 
 namespace xwalk {
 class RuntimeContext;
+namespace extensions {
+struct XWalkExternalExtensionsFilter;
+}
 }
 
 namespace xwalk {
@@ -84,6 +87,10 @@ class ApplicationSystem {
   void CreateExtensions(content::RenderProcessHost* host,
                         extensions::XWalkExtensionVector* extensions);
 
+  void GetExternalExtensionsFilter(
+      content::RenderProcessHost* host,
+      extensions::XWalkExternalExtensionsFilter* filter);
+
  protected:
   explicit ApplicationSystem(RuntimeContext* runtime_context);
 
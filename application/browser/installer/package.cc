@@ -4,11 +4,27 @@
 
 #include "xwalk/application/browser/installer/package.h"
 
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "base/atomicops.h"
+#include "base/bind.h"
+#include "base/callback.h"
 #include "base/file_util.h"
 #include "base/files/file_path.h"
 #include "base/logging.h"
+#include "base/memory/scoped_vector.h"
 #include "base/path_service.h"
+#include "base/strings/string_util.h"
+#include "base/synchronization/lock.h"
+#include "base/sys_info.h"
+#include "base/threading/simple_thread.h"
+#include "base/time/time.h"
 #include "third_party/zlib/google/zip.h"
+#include "xwalk/application/common/application_archive.h"
+#include "xwalk/application/common/constants.h"
 #include "xwalk/application/common/id_util.h"
 #include "xwalk/application/browser/installer/wgt_package.h"
 #include "xwalk/application/browser/installer/xpk_package.h"
@@ -16,6 +32,121 @@
 namespace xwalk {
 namespace application {
 
+namespace {
+
+// The threads inflating files, the signature is checked on one more.
+const int kMaxExtractionThreads = 8;
+const int kExtractionBufferSize = 256 * 1024;
+
+// Shared by the threads of an extraction, to stop them all as soon as a
+// step fails, and to bound what they write.
+class ExtractionState {
+ public:
+  explicit ExtractionState(int64 max_size)
+      : aborted_(0),
+        bytes_left_(max_size) {
+  }
+
+  // Any thread can abort, unlike with a base::CancellationFlag.
+  void Abort() { base::subtle::Release_Store(&aborted_, 1); }
+  bool IsAborted() const { return base::subtle::Acquire_Load(&aborted_) != 0; }
+
+  // Takes |size| bytes to write, aborting if it is more than the size of
+  // the files told by the central directory.
+  bool TakeBytes(int size) {
+    base::AutoLock lock(lock_);
+    if (bytes_left_ < size) {
+      Abort();
+      return false;
+    }
+    bytes_left_ -= size;
+    return true;
+  }
+
+ private:
+  base::subtle::Atomic32 aborted_;
+  base::Lock lock_;
+  int64 bytes_left_;
+
+  DISALLOW_COPY_AND_ASSIGN(ExtractionState);
+};
+
+// Runs a step of the extraction on a thread of the pool, keeping its result.
+// A failure aborts the other steps.
+class ExtractionTask : public base::DelegateSimpleThread::Delegate {
+ public:
+  ExtractionTask(const base::Callback<bool(void)>& callback,
+                 ExtractionState* state)
+      : callback_(callback),
+        state_(state),
+        succeeded_(false) {
+  }
+
+  virtual void Run() OVERRIDE {
+    if (state_->IsAborted())
+      return;
+    succeeded_ = callback_.Run();
+    if (!succeeded_)
+      state_->Abort();
+  }
+
+  bool succeeded() const { return succeeded_; }
+
+ private:
+  base::Callback<bool(void)> callback_;
+  ExtractionState* state_;
+  bool succeeded_;
+
+  DISALLOW_COPY_AND_ASSIGN(ExtractionTask);
+};
+
+bool CompareCompressedSizes(const ApplicationArchive::Entry* a,
+                            const ApplicationArchive::Entry* b) {
+  return a->compressed_size > b->compressed_size;
+}
+
+bool ExtractEntry(const scoped_refptr<ApplicationArchive>& archive,
+                  const ApplicationArchive::Entry* entry,
+                  const base::FilePath& target_path,
+                  ExtractionState* state) {
+  base::FilePath relative_path =
+      base::FilePath::FromUTF8Unsafe(entry->name.as_string());
+  if (relative_path.IsAbsolute() || relative_path.ReferencesParent()) {
+    LOG(ERROR) << "Invalid file name in the package: " << entry->name;
+    return false;
+  }
+
+  base::FilePath path = target_path.Append(relative_path);
+  if (!file_util::CreateDirectory(path.DirName()))
+    return false;
+  file_util::ScopedFILE file(file_util::OpenFile(path, "wb"));
+  if (!file)
+    return false;
+
+  scoped_refptr<ApplicationArchiveReader> reader(
+      new ApplicationArchiveReader(archive.get(), entry));
+  std::vector<char> buffer(kExtractionBufferSize);
+  int count;
+  while ((count = reader->Read(&buffer[0], buffer.size())) > 0) {
+    if (state->IsAborted() || !state->TakeBytes(count) ||
+        fwrite(&buffer[0], 1, count, file.get()) !=
+            static_cast<size_t>(count))
+      return false;
+  }
+  return count == 0;
+}
+
+// Writes the whole package from the mapping that was verified, rather than
+// copying a file that could have been replaced since.
+bool WritePackageData(const base::StringPiece& data,
+                      const base::FilePath& path) {
+  file_util::ScopedFILE file(file_util::OpenFile(path, "wb"));
+  return file &&
+      fwrite(data.data(), 1, data.size(), file.get()) == data.size();
+}
+
+}  // namespace
+
 Package::Package(const base::FilePath& source_path)
   : source_path_(source_path) {
 }
@@ -39,6 +170,10 @@ scoped_ptr<Package> Package::Create(const base::FilePath& source_path) {
   return scoped_ptr<Package>();
 }
 
+bool Package::VerifySignature(const base::StringPiece& data) const {
+  return true;
+}
+
 bool Package::Extract(base::FilePath* target_path) {
   if (!IsValid()) {
     LOG(ERROR) << "XPK/WGT file is not valid.";
@@ -51,8 +186,132 @@ bool Package::Extract(base::FilePath* target_path) {
     return false;
   }
 
-  if (!zip::Unzip(source_path_, temp_dir_.path())) {
+  base::TimeTicks start_time = base::TimeTicks::Now();
+  scoped_refptr<ApplicationArchive> archive(
+      new ApplicationArchive(source_path_));
+  if (!archive->Open()) {
+    LOG(ERROR) << "An error occurred during package extraction";
+    return false;
+  }
+
+  bool succeeded;
+  if (archive->has_unsupported_entries()) {
+    // Like ZIP64 archives, that only zip::Unzip() extracts.
+    succeeded = VerifySignature(archive->file_data()) &&
+        zip::Unzip(source_path_, temp_dir_.path());
+  } else {
+    // The signature is verified from the mapping while the files are
+    // inflated from it, so the package is read from the disk once. The
+    // biggest files are started first to balance the threads.
+    // The first failure, including the signature check, stops the
+    // inflation of a package that may be crafted.
+    std::vector<const ApplicationArchive::Entry*> entries;
+    std::set<std::string> folded_names;
+    int64 size = 0;
+    for (size_t i = 0; i < archive->entry_count(); ++i) {
+      // Entries differing only by case would be extracted to the same file
+      // on some file systems, by threads racing with each other.
+      const ApplicationArchive::Entry& entry = archive->entry(i);
+      if (!folded_names.insert(
+              StringToLowerASCII(entry.name.as_string())).second) {
+        LOG(ERROR) << "Duplicate file name in the package: " << entry.name;
+        if (!temp_dir_.Delete())
+          LOG(WARNING) << "Can't delete the extracted files.";
+        return false;
+      }
+      entries.push_back(&entry);
+      size += entry.uncompressed_size;
+    }
+    std::sort(entries.begin(), entries.end(), CompareCompressedSizes);
+    ExtractionState state(size);
+
+    ScopedVector<ExtractionTask> tasks;
+    tasks.push_back(new ExtractionTask(base::Bind(
+        &Package::VerifySignature, base::Unretained(this),
+        archive->file_data()), &state));
+    for (size_t i = 0; i < entries.size(); ++i) {
+      tasks.push_back(new ExtractionTask(base::Bind(
+          &ExtractEntry, archive, entries[i], temp_dir_.path(), &state),
+          &state));
+    }
+
+    int thread_count = std::min(base::SysInfo::NumberOfProcessors(),
+                                kMaxExtractionThreads) + 1;
+    thread_count = std::min(thread_count, static_cast<int>(tasks.size()));
+    base::DelegateSimpleThreadPool pool("PackageExtraction", thread_count);
+    for (size_t i = 0; i < tasks.size(); ++i)
+      pool.AddWork(tasks[i]);
+    pool.Start();
+    pool.JoinAll();
+
+    succeeded = true;
+    for (size_t i = 0; i < tasks.size(); ++i)
+      succeeded = succeeded && tasks[i]->succeeded();
+  }
+
+  if (!succeeded) {
     LOG(ERROR) << "An error occurred during package extraction";
+    // Nothing of a package that isn't verified is kept.
+    if (!temp_dir_.Delete())
+      LOG(WARNING) << "Can't delete the extracted files.";
+    return false;
+  }
+
+  LOG(INFO) << "Extracted " << archive->entry_count() << " files, reading "
+            << archive->file_data().size() << " bytes of package in "
+            << (base::TimeTicks::Now() - start_time).InMilliseconds()
+            << " ms.";
+  *target_path = temp_dir_.path();
+  return true;
+}
+
+bool Package::ExtractManifest(base::FilePath* target_path) {
+  if (!IsValid()) {
+    LOG(ERROR) << "XPK/WGT file is not valid.";
+    return false;
+  }
+
+  if (!CreateTempDirectory()) {
+    LOG(ERROR) << "Can't create a temporary"
+                  "directory for extracting the package content.";
+    return false;
+  }
+
+  scoped_refptr<ApplicationArchive> archive(
+      new ApplicationArchive(source_path_));
+  if (!archive->Open()) {
+    LOG(ERROR) << "An error occurred while reading the package";
+    return false;
+  }
+  if (!VerifySignature(archive->file_data())) {
+    LOG(ERROR) << "The signature of the package is not valid.";
+    return false;
+  }
+
+  const base::FilePath::CharType* manifest_names[] = {
+    kManifestXpkFilename,
+    kManifestWgtFilename,
+  };
+  for (size_t i = 0; i < arraysize(manifest_names); ++i) {
+    base::FilePath manifest_name(manifest_names[i]);
+    const ApplicationArchive::Entry* entry =
+        archive->FindEntry(manifest_name.AsUTF8Unsafe());
+    if (!entry)
+      continue;
+
+    std::string manifest;
+    if (!archive->ReadEntry(*entry, &manifest) ||
+        file_util::WriteFile(temp_dir_.path().Append(manifest_name),
+                             manifest.data(), manifest.size()) !=
+            static_cast<int>(manifest.size())) {
+      LOG(ERROR) << "An error occurred during manifest extraction";
+      return false;
+    }
+  }
+
+  if (!WritePackageData(archive->file_data(),
+                        temp_dir_.path().Append(kApplicationArchiveFilename))) {
+    LOG(ERROR) << "An error occurred while writing the package";
     return false;
   }
 
@@ -64,8 +323,9 @@ bool Package::Extract(base::FilePath* target_path) {
 // As the package information might already exists under data_path,
 // it's safer to extract the XPK/WGT file into a temporary directory first.
 bool Package::CreateTempDirectory() {
-  base::FilePath tmp;
-  PathService::Get(base::DIR_TEMP, &tmp);
+  base::FilePath tmp = extraction_parent_path_;
+  if (tmp.empty())
+    PathService::Get(base::DIR_TEMP, &tmp);
   if (tmp.empty())
     return false;
   if (!temp_dir_.CreateUniqueTempDirUnderPath(tmp))
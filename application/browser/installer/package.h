@@ -12,6 +12,7 @@
 #include "base/files/scoped_temp_dir.h"
 #include "base/memory/scoped_handle.h"
 #include "base/memory/scoped_ptr.h"
+#include "base/strings/string_piece.h"
 
 namespace xwalk {
 namespace application {
@@ -29,15 +30,30 @@ class Package {
   static scoped_ptr<Package> Create(const base::FilePath& path);
   // The function will unzip the XPK/WGT file and return the target path where
   // to decompress by the parameter |target_path|.
+  // The package is mapped and read once: its signature is verified while its
+  // files are inflated in parallel, and nothing is left in |target_path| if
+  // the verification fails.
   bool Extract(base::FilePath* target_path);
+  // Like Extract(), but only the manifest is extracted. The package is copied
+  // next to it as kApplicationArchiveFilename, to serve the resources from.
+  bool ExtractManifest(base::FilePath* target_path);
+  // The directory to extract in, the temporary directory by default. Being on
+  // the filesystem the package is installed to, moving it there is a rename.
+  void set_extraction_parent_path(const base::FilePath& path) {
+    extraction_parent_path_ = path;
+  }
  protected:
   explicit Package(const base::FilePath& source_path);
+  // Verifies the signature of the package, mapped in memory as |data|, if it
+  // has one. It runs on a worker thread while the package is extracted.
+  virtual bool VerifySignature(const base::StringPiece& data) const;
   scoped_ptr<ScopedStdioHandle> file_;
   bool is_valid_;
   std::string id_;
   // Unzipping of the zipped file happens in a temporary directory
   bool CreateTempDirectory();
   base::FilePath source_path_;
+  base::FilePath extraction_parent_path_;
   // Temporary directory for unpacking.
   base::ScopedTempDir temp_dir_;
 };
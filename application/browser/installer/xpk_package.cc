@@ -4,6 +4,8 @@
 
 #include "xwalk/application/browser/installer/xpk_package.h"
 
+#include <algorithm>
+
 #include "base/file_util.h"
 #include "crypto/signature_verifier.h"
 #include "xwalk/application/common/id_util.h"
@@ -16,13 +18,17 @@ const uint8 kSignatureAlgorithm[15] = {
   0xf7, 0x0d, 0x01, 0x01, 0x05, 0x05, 0x00
 };
 
+// The data is passed to the verifier in chunks, as it takes int sizes.
+const size_t kSignatureChunkSize = 1024 * 1024;
+
 const char XPKPackage::kXPKPackageHeaderMagic[] = "CrWk";
 
 XPKPackage::~XPKPackage() {
 }
 
 XPKPackage::XPKPackage(const base::FilePath& path)
-  : Package(path) {
+  : Package(path),
+    zip_addr_(0) {
   if (!base::PathExists(path))
     return;
   scoped_ptr<ScopedStdioHandle> file(
@@ -56,9 +62,6 @@ XPKPackage::XPKPackage(const base::FilePath& path)
         if (len < header_.signature_size)
           is_valid_ = false;
 
-        if (!VerifySignature())
-          is_valid_ = false;
-
         std::string public_key =
             std::string(reinterpret_cast<char*>(&key_.front()), key_.size());
         id_ = GenerateId(public_key);
@@ -66,10 +69,10 @@ XPKPackage::XPKPackage(const base::FilePath& path)
   return;
 }
 
-bool XPKPackage::VerifySignature() {
-// Set the file read position to the beginning of compressed resource file,
-// which is behind the magic header, public key and signature key.
-  fseek(file_->get(), zip_addr_, SEEK_SET);
+bool XPKPackage::VerifySignature(const base::StringPiece& data) const {
+  if (data.size() < static_cast<size_t>(zip_addr_))
+    return false;
+
   crypto::SignatureVerifier verifier;
   if (!verifier.VerifyInit(kSignatureAlgorithm,
                            sizeof(kSignatureAlgorithm),
@@ -78,14 +81,15 @@ bool XPKPackage::VerifySignature() {
                            &key_.front(),
                            key_.size()))
     return false;
-  unsigned char buf[1 << 12];
-  size_t len = 0;
-  while ((len = fread(buf, 1, sizeof(buf), file_->get())) > 0)
-    verifier.VerifyUpdate(buf, len);
-  if (!verifier.VerifyFinal())
-    return false;
-
-  return true;
+  // The signature covers the compressed resource file, which is behind the
+  // magic header, public key and signature key.
+  for (size_t offset = zip_addr_; offset < data.size();
+       offset += kSignatureChunkSize) {
+    size_t size = std::min(kSignatureChunkSize, data.size() - offset);
+    verifier.VerifyUpdate(reinterpret_cast<const uint8*>(data.data() + offset),
+                          size);
+  }
+  return verifier.VerifyFinal();
 }
 
 }  // namespace application
@@ -31,9 +31,12 @@ class XPKPackage : public Package {
   virtual ~XPKPackage();
   explicit XPKPackage(const base::FilePath& path);
 
+ protected:
+  // Verifies the signature of the zip file that follows the header, the
+  // public key and the signature in |data|.
+  virtual bool VerifySignature(const base::StringPiece& data) const OVERRIDE;
+
  private:
-  // verify the signature in the xpk package
-  virtual bool VerifySignature();
 
   Header header_;
   std::vector<uint8> signature_;
@@ -7,11 +7,14 @@
 #include <string>
 #include "base/values.h"
 #include "base/bind.h"
+#include "base/json/json_writer.h"
 #include "dbus/bus.h"
 #include "dbus/message.h"
 #include "dbus/exported_object.h"
 #include "xwalk/application/browser/application.h"
 #include "xwalk/application/browser/linux/running_applications_manager.h"
+#include "xwalk/extensions/browser/xwalk_extension_service.h"
+#include "xwalk/runtime/browser/xwalk_runner.h"
 
 
 namespace {
@@ -25,6 +28,11 @@ namespace {
 //     Will terminate the running application. This object will be unregistered
 //     from D-Bus.
 //
+//   GetExtensionStats() -> string
+//     Returns a JSON dictionary with the messaging counters of the in process
+//     extensions used by the application, keyed by extension name. See
+//     XWalkExtensionMessagingStats.
+//
 // Properties:
 //
 //   readonly string AppID
@@ -65,6 +73,13 @@ RunningApplicationObject::RunningApplicationObject(
                  base::Unretained(this)),
       base::Bind(&RunningApplicationObject::OnExported,
                  base::Unretained(this)));
+
+  dbus_object()->ExportMethod(
+      kRunningApplicationDBusInterface, "GetExtensionStats",
+      base::Bind(&RunningApplicationObject::OnGetExtensionStats,
+                 base::Unretained(this)),
+      base::Bind(&RunningApplicationObject::OnExported,
+                 base::Unretained(this)));
 }
 
 RunningApplicationObject::~RunningApplicationObject() {
@@ -112,6 +127,28 @@ void RunningApplicationObject::OnTerminate(
   response_sender.Run(response.Pass());
 }
 
+void RunningApplicationObject::OnGetExtensionStats(
+    dbus::MethodCall* method_call,
+    dbus::ExportedObject::ResponseSender response_sender) {
+  extensions::XWalkExtensionService* extension_service =
+      XWalkRunner::GetInstance()->extension_service();
+  scoped_ptr<base::DictionaryValue> stats(new base::DictionaryValue);
+  if (extension_service) {
+    stats = extension_service->GetMessagingStats(
+        application_->GetRenderProcessHostID());
+  }
+
+  std::string json;
+  base::JSONWriter::WriteWithOptions(
+      stats.get(), base::JSONWriter::OPTIONS_PRETTY_PRINT, &json);
+
+  scoped_ptr<dbus::Response> response =
+      dbus::Response::FromMethodCall(method_call);
+  dbus::MessageWriter writer(response.get());
+  writer.AppendString(json);
+  response_sender.Run(response.Pass());
+}
+
 void RunningApplicationObject::OnNameOwnerChanged(
     const std::string& service_owner) {
   if (service_owner.empty()) {
@@ -37,6 +37,10 @@ class RunningApplicationObject : public dbus::ManagedObject {
   void OnTerminate(dbus::MethodCall* method_call,
                    dbus::ExportedObject::ResponseSender response_sender);
 
+  void OnGetExtensionStats(
+      dbus::MethodCall* method_call,
+      dbus::ExportedObject::ResponseSender response_sender);
+
   void OnNameOwnerChanged(const std::string& service_owner);
 
   void OnLauncherDisappeared();
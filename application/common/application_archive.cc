@@ -0,0 +1,336 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/application/common/application_archive.h"
+
+#include <string.h>
+#include <algorithm>
+
+#include "base/logging.h"
+
+namespace xwalk {
+namespace application {
+
+namespace {
+
+const uint32 kEndOfCentralDirectorySignature = 0x06054b50;
+const uint32 kCentralDirectoryHeaderSignature = 0x02014b50;
+const uint32 kLocalFileHeaderSignature = 0x04034b50;
+
+const size_t kEndOfCentralDirectorySize = 22;
+const size_t kCentralDirectoryHeaderSize = 46;
+const size_t kLocalFileHeaderSize = 30;
+const size_t kMaxCommentSize = 0xffff;
+
+const uint16 kMethodStored = 0;
+const uint16 kMethodDeflated = 8;
+const uint16 kFlagEncrypted = 1;
+
+uint16 ReadUInt16(const char* data) {
+  const uint8* bytes = reinterpret_cast<const uint8*>(data);
+  return bytes[0] | (bytes[1] << 8);
+}
+
+uint32 ReadUInt32(const char* data) {
+  const uint8* bytes = reinterpret_cast<const uint8*>(data);
+  return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) |
+      (static_cast<uint32>(bytes[3]) << 24);
+}
+
+bool CompareEntryNames(const ApplicationArchive::Entry& a,
+                       const ApplicationArchive::Entry& b) {
+  return a.name < b.name;
+}
+
+}  // namespace
+
+ApplicationArchive::ApplicationArchive(const base::FilePath& path)
+    : path_(path),
+      state_(NOT_OPENED),
+      archive_offset_(0),
+      has_unsupported_entries_(false) {
+}
+
+ApplicationArchive::~ApplicationArchive() {
+}
+
+bool ApplicationArchive::Open() {
+  base::AutoLock lock(lock_);
+  if (state_ == NOT_OPENED)
+    state_ = MapAndIndex() ? OPENED : FAILED;
+  return state_ == OPENED;
+}
+
+bool ApplicationArchive::MapAndIndex() {
+  if (!file_.Initialize(path_))
+    return false;
+
+  const char* data = reinterpret_cast<const char*>(file_.data());
+  size_t length = file_.length();
+  if (length < kEndOfCentralDirectorySize)
+    return false;
+
+  // The end of central directory record is followed by a comment of up to
+  // 64 KiB, it is searched backwards.
+  size_t eocd = length - kEndOfCentralDirectorySize;
+  size_t eocd_min = eocd > kMaxCommentSize ? eocd - kMaxCommentSize : 0;
+  while (ReadUInt32(data + eocd) != kEndOfCentralDirectorySignature) {
+    if (eocd == eocd_min) {
+      LOG(WARNING) << "No central directory in " << path_.value();
+      return false;
+    }
+    eocd--;
+  }
+
+  size_t entry_count = ReadUInt16(data + eocd + 10);
+  size_t directory_size = ReadUInt32(data + eocd + 12);
+  size_t directory_offset = ReadUInt32(data + eocd + 16);
+  // The checks subtract rather than add, sums could wrap around with a
+  // 32-bit size_t.
+  if (directory_offset > eocd || directory_size > eocd - directory_offset) {
+    LOG(WARNING) << "Invalid central directory in " << path_.value();
+    return false;
+  }
+
+  // The offsets in the archive are relative to its start, that is not the
+  // start of the file if something was prepended to it.
+  archive_offset_ = eocd - directory_size - directory_offset;
+
+  entries_.reserve(entry_count);
+  const char* header = data + archive_offset_ + directory_offset;
+  const char* directory_end = data + eocd;
+  for (size_t i = 0; i < entry_count; ++i) {
+    if (static_cast<size_t>(directory_end - header) <
+            kCentralDirectoryHeaderSize ||
+        ReadUInt32(header) != kCentralDirectoryHeaderSignature) {
+      LOG(WARNING) << "Invalid central directory in " << path_.value();
+      entries_.clear();
+      return false;
+    }
+
+    uint16 flags = ReadUInt16(header + 8);
+    size_t name_size = ReadUInt16(header + 28);
+    size_t extra_size = ReadUInt16(header + 30);
+    size_t comment_size = ReadUInt16(header + 32);
+    size_t header_size = kCentralDirectoryHeaderSize +
+        name_size + extra_size + comment_size;
+    if (static_cast<size_t>(directory_end - header) < header_size) {
+      LOG(WARNING) << "Invalid central directory in " << path_.value();
+      entries_.clear();
+      return false;
+    }
+    const char* next_header = header + header_size;
+
+    Entry entry;
+    entry.name.set(header + kCentralDirectoryHeaderSize, name_size);
+    entry.method = ReadUInt16(header + 10);
+    entry.crc = ReadUInt32(header + 16);
+    entry.compressed_size = ReadUInt32(header + 20);
+    entry.uncompressed_size = ReadUInt32(header + 24);
+    entry.local_header_offset = ReadUInt32(header + 42);
+    header = next_header;
+
+    // Directories have no contents to serve.
+    if (entry.name.empty() || entry.name[entry.name.size() - 1] == '/')
+      continue;
+
+    // Stored entries are read in place, their sizes must agree not to read
+    // past their data.
+    if (entry.method == kMethodStored &&
+        entry.compressed_size != entry.uncompressed_size) {
+      LOG(WARNING) << "Invalid entry " << entry.name << " in "
+                   << path_.value();
+      has_unsupported_entries_ = true;
+      continue;
+    }
+
+    if ((flags & kFlagEncrypted) ||
+        (entry.method != kMethodStored && entry.method != kMethodDeflated) ||
+        entry.compressed_size == 0xffffffff ||
+        entry.uncompressed_size == 0xffffffff) {
+      LOG(WARNING) << "Unsupported entry " << entry.name << " in "
+                   << path_.value();
+      has_unsupported_entries_ = true;
+      continue;
+    }
+
+    entries_.push_back(entry);
+  }
+
+  std::sort(entries_.begin(), entries_.end(), CompareEntryNames);
+  return true;
+}
+
+const ApplicationArchive::Entry* ApplicationArchive::FindEntry(
+    const base::StringPiece& name) const {
+  DCHECK_EQ(state_, OPENED);
+  Entry key;
+  key.name = name;
+  std::vector<Entry>::const_iterator it = std::lower_bound(
+      entries_.begin(), entries_.end(), key, CompareEntryNames);
+  if (it == entries_.end() || it->name != name)
+    return NULL;
+  return &*it;
+}
+
+base::StringPiece ApplicationArchive::file_data() const {
+  DCHECK_EQ(state_, OPENED);
+  return base::StringPiece(reinterpret_cast<const char*>(file_.data()),
+                           file_.length());
+}
+
+bool ApplicationArchive::ReadEntry(const Entry& entry, std::string* data) {
+  scoped_refptr<ApplicationArchiveReader> reader(
+      new ApplicationArchiveReader(this, &entry));
+  data->resize(entry.uncompressed_size);
+  size_t offset = 0;
+  while (offset < data->size()) {
+    int count = reader->Read(&(*data)[offset], data->size() - offset);
+    if (count <= 0)
+      return false;
+    offset += count;
+  }
+  return true;
+}
+
+const char* ApplicationArchive::GetEntryData(const Entry& entry) const {
+  const char* data = reinterpret_cast<const char*>(file_.data());
+  size_t length = file_.length();
+
+  if (entry.local_header_offset > length - archive_offset_)
+    return NULL;
+  size_t header_offset = archive_offset_ + entry.local_header_offset;
+  if (length - header_offset < kLocalFileHeaderSize)
+    return NULL;
+
+  const char* header = data + header_offset;
+  if (ReadUInt32(header) != kLocalFileHeaderSignature)
+    return NULL;
+
+  size_t names_size = ReadUInt16(header + 26) + ReadUInt16(header + 28);
+  if (length - header_offset - kLocalFileHeaderSize < names_size)
+    return NULL;
+  size_t data_offset = header_offset + kLocalFileHeaderSize + names_size;
+  if (entry.compressed_size > length - data_offset)
+    return NULL;
+
+  return data + data_offset;
+}
+
+ApplicationArchiveReader::ApplicationArchiveReader(
+    ApplicationArchive* archive,
+    const ApplicationArchive::Entry* entry)
+    : archive_(archive),
+      entry_(entry),
+      initialized_(false),
+      failed_(false),
+      data_(NULL),
+      offset_(0),
+      seek_offset_(0),
+      verify_crc_(true),
+      crc_(crc32(0, NULL, 0)) {
+  memset(&stream_, 0, sizeof(stream_));
+}
+
+ApplicationArchiveReader::~ApplicationArchiveReader() {
+  if (initialized_ && entry_->method == kMethodDeflated)
+    inflateEnd(&stream_);
+}
+
+bool ApplicationArchiveReader::Init() {
+  data_ = archive_->GetEntryData(*entry_);
+  if (!data_)
+    return false;
+
+  if (entry_->method == kMethodDeflated) {
+    // The entries are raw deflate streams, without zlib header.
+    if (inflateInit2(&stream_, -MAX_WBITS) != Z_OK)
+      return false;
+    stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data_));
+    stream_.avail_in = entry_->compressed_size;
+  }
+
+  initialized_ = true;
+  return true;
+}
+
+void ApplicationArchiveReader::Seek(int64 offset) {
+  DCHECK_GE(offset, offset_);
+  seek_offset_ = static_cast<uint32>(std::min(offset, size()));
+}
+
+int ApplicationArchiveReader::Read(char* buffer, int size) {
+  if (failed_)
+    return -1;
+
+  if (!initialized_ && !Init()) {
+    LOG(WARNING) << "Invalid entry " << entry_->name << " in "
+                 << archive_->path().value();
+    failed_ = true;
+    return -1;
+  }
+
+  if (offset_ < seek_offset_ && !Skip())
+    return -1;
+
+  return ReadData(buffer, size);
+}
+
+bool ApplicationArchiveReader::Skip() {
+  if (entry_->method == kMethodStored) {
+    offset_ = seek_offset_;
+    verify_crc_ = false;
+    return true;
+  }
+
+  char buffer[16 * 1024];
+  while (offset_ < seek_offset_) {
+    int count = std::min(static_cast<uint32>(sizeof(buffer)),
+                         seek_offset_ - offset_);
+    if (ReadData(buffer, count) <= 0)
+      return false;
+  }
+  return true;
+}
+
+int ApplicationArchiveReader::ReadData(char* buffer, int size) {
+  uint32 remaining = entry_->uncompressed_size - offset_;
+  uint32 count = std::min(static_cast<uint32>(size), remaining);
+  if (count == 0)
+    return 0;
+
+  if (entry_->method == kMethodStored) {
+    memcpy(buffer, data_ + offset_, count);
+  } else {
+    stream_.next_out = reinterpret_cast<Bytef*>(buffer);
+    stream_.avail_out = count;
+    int result = inflate(&stream_, Z_SYNC_FLUSH);
+    if (result != Z_OK && result != Z_STREAM_END) {
+      failed_ = true;
+      return -1;
+    }
+    count -= stream_.avail_out;
+    if (count == 0) {
+      // The compressed data ended before the expected size.
+      failed_ = true;
+      return -1;
+    }
+  }
+
+  crc_ = crc32(crc_, reinterpret_cast<const Bytef*>(buffer), count);
+  offset_ += count;
+
+  if (offset_ == entry_->uncompressed_size && verify_crc_ &&
+      crc_ != entry_->crc) {
+    LOG(WARNING) << "Corrupted entry " << entry_->name << " in "
+                 << archive_->path().value();
+    failed_ = true;
+    return -1;
+  }
+
+  return count;
+}
+
+}  // namespace application
+}  // namespace xwalk
@@ -0,0 +1,149 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef XWALK_APPLICATION_COMMON_APPLICATION_ARCHIVE_H_
+#define XWALK_APPLICATION_COMMON_APPLICATION_ARCHIVE_H_
+
+#include <string>
+#include <vector>
+
+#include "base/files/file_path.h"
+#include "base/files/memory_mapped_file.h"
+#include "base/memory/ref_counted.h"
+#include "base/strings/string_piece.h"
+#include "base/synchronization/lock.h"
+#include "third_party/zlib/zlib.h"
+
+namespace xwalk {
+namespace application {
+
+// The zip archive of an application installed without being extracted, see
+// kApplicationArchiveFilename. Data before the archive, like the header of
+// XPK packages, is skipped.
+//
+// The file is memory mapped and its central directory indexed once, the
+// index pointing to the names in the mapping, so finding an entry is a
+// binary search and stored entries are read in place. Only stored and
+// deflated entries are supported, not ZIP64 nor encryption.
+//
+// Open() and the readers do IO, but the archive can be shared by threads.
+class ApplicationArchive
+    : public base::RefCountedThreadSafe<ApplicationArchive> {
+ public:
+  struct Entry {
+    base::StringPiece name;
+    uint16 method;
+    uint32 crc;
+    uint32 compressed_size;
+    uint32 uncompressed_size;
+    uint32 local_header_offset;
+  };
+
+  explicit ApplicationArchive(const base::FilePath& path);
+
+  // Maps and indexes the archive the first time it is called, then returns
+  // the result of the first call. False if |path| is not a valid archive.
+  bool Open();
+
+  // Must be called after Open() returned true. Entries don't change until
+  // the archive is destroyed.
+  const Entry* FindEntry(const base::StringPiece& name) const;
+  size_t entry_count() const { return entries_.size(); }
+  const Entry& entry(size_t index) const { return entries_[index]; }
+  // Tells if entries were left out of the index because they aren't
+  // supported, so the archive can't be extracted from it.
+  bool has_unsupported_entries() const { return has_unsupported_entries_; }
+
+  // The whole mapped file, including the data before the archive.
+  base::StringPiece file_data() const;
+
+  // Reads a whole entry, for small ones like the manifest.
+  bool ReadEntry(const Entry& entry, std::string* data);
+
+  const base::FilePath& path() const { return path_; }
+
+ private:
+  friend class base::RefCountedThreadSafe<ApplicationArchive>;
+  friend class ApplicationArchiveReader;
+
+  enum State {
+    NOT_OPENED,
+    OPENED,
+    FAILED,
+  };
+
+  ~ApplicationArchive();
+
+  bool MapAndIndex();
+
+  // Returns NULL if the local header of |entry| is invalid.
+  const char* GetEntryData(const Entry& entry) const;
+
+  const base::FilePath path_;
+
+  base::Lock lock_;
+  State state_;
+
+  base::MemoryMappedFile file_;
+  // Offset of the archive in the file.
+  size_t archive_offset_;
+  // Sorted by name.
+  std::vector<Entry> entries_;
+  bool has_unsupported_entries_;
+
+  DISALLOW_COPY_AND_ASSIGN(ApplicationArchive);
+};
+
+// Reads an entry of an opened ApplicationArchive sequentially, inflating it if
+// needed, and checks its CRC at the end. It can be used from any thread that
+// allows IO, one at a time.
+//
+// Reading can start at any offset, see Seek(). That is immediate for stored
+// entries, but deflated ones have to be inflated up to the offset, so big
+// media files are better stored in packages.
+class ApplicationArchiveReader
+    : public base::RefCountedThreadSafe<ApplicationArchiveReader> {
+ public:
+  ApplicationArchiveReader(ApplicationArchive* archive,
+                           const ApplicationArchive::Entry* entry);
+
+  // Returns the number of bytes copied to |buffer|, 0 at the end of the entry
+  // or -1 if the entry is corrupted.
+  int Read(char* buffer, int size);
+
+  // Makes the next Read() start at |offset|, that must not be before the
+  // data already read. The IO is done by Read().
+  void Seek(int64 offset);
+
+  int64 size() const { return entry_->uncompressed_size; }
+
+ private:
+  friend class base::RefCountedThreadSafe<ApplicationArchiveReader>;
+
+  ~ApplicationArchiveReader();
+
+  bool Init();
+  int ReadData(char* buffer, int size);
+  bool Skip();
+
+  scoped_refptr<ApplicationArchive> archive_;
+  const ApplicationArchive::Entry* entry_;
+
+  bool initialized_;
+  bool failed_;
+  const char* data_;
+  uint32 offset_;
+  uint32 seek_offset_;
+  // The CRC can't be checked if a stored entry isn't read from its start.
+  bool verify_crc_;
+  uLong crc_;
+  z_stream stream_;
+
+  DISALLOW_COPY_AND_ASSIGN(ApplicationArchiveReader);
+};
+
+}  // namespace application
+}  // namespace xwalk
+
+#endif  // XWALK_APPLICATION_COMMON_APPLICATION_ARCHIVE_H_
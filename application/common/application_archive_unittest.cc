@@ -0,0 +1,449 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/application/common/application_archive.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/file_util.h"
+#include "base/files/file_enumerator.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/path_service.h"
+#include "base/platform_file.h"
+#include "base/rand_util.h"
+#include "base/strings/stringprintf.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "third_party/zlib/google/zip.h"
+
+namespace xwalk {
+namespace application {
+
+namespace {
+
+const int kBenchmarkFileCount = 200;
+const int kBenchmarkFileSize = 64 * 1024;
+const int kReadBufferSize = 32 * 1024;
+
+std::string ReadAll(ApplicationArchiveReader* reader) {
+  std::string data;
+  char buffer[kReadBufferSize];
+  int count;
+  while ((count = reader->Read(buffer, sizeof(buffer))) > 0)
+    data.append(buffer, count);
+  EXPECT_EQ(0, count);
+  return data;
+}
+
+char GetPatternByte(int64 offset) {
+  return static_cast<char>(offset % 251);
+}
+
+void AppendUInt16(std::string* data, uint16 value) {
+  data->push_back(static_cast<char>(value & 0xff));
+  data->push_back(static_cast<char>(value >> 8));
+}
+
+void AppendUInt32(std::string* data, uint32 value) {
+  AppendUInt16(data, static_cast<uint16>(value & 0xffff));
+  AppendUInt16(data, static_cast<uint16>(value >> 16));
+}
+
+// Writes an archive with a single stored entry of |size| bytes following
+// GetPatternByte(), as zip::Zip() always deflates.
+bool WriteStoredArchive(const base::FilePath& path, const std::string& name,
+                        uint32 size) {
+  FILE* file = file_util::OpenFile(path, "wb");
+  if (!file)
+    return false;
+
+  std::string header;
+  AppendUInt32(&header, 0x04034b50);
+  AppendUInt16(&header, 10);  // Version needed to extract.
+  AppendUInt16(&header, 0);  // Flags.
+  AppendUInt16(&header, 0);  // Stored.
+  AppendUInt32(&header, 0);  // Time and date.
+  size_t crc_offset = header.size();
+  AppendUInt32(&header, 0);  // CRC, written afterwards.
+  AppendUInt32(&header, size);
+  AppendUInt32(&header, size);
+  AppendUInt16(&header, static_cast<uint16>(name.size()));
+  AppendUInt16(&header, 0);  // Extra field size.
+  header += name;
+  bool success = fwrite(header.data(), 1, header.size(), file) ==
+      header.size();
+
+  uLong crc = crc32(0, NULL, 0);
+  std::string chunk;
+  for (uint32 offset = 0; success && offset < size; offset += chunk.size()) {
+    chunk.resize(std::min(size - offset, 1024u * 1024u));
+    for (size_t i = 0; i < chunk.size(); ++i)
+      chunk[i] = GetPatternByte(offset + i);
+    crc = crc32(crc, reinterpret_cast<const Bytef*>(chunk.data()),
+                chunk.size());
+    success = fwrite(chunk.data(), 1, chunk.size(), file) == chunk.size();
+  }
+
+  std::string directory;
+  AppendUInt32(&directory, 0x02014b50);
+  AppendUInt16(&directory, 10);  // Version made by.
+  directory += header.substr(4, 26);
+  AppendUInt16(&directory, 0);  // Comment size.
+  AppendUInt16(&directory, 0);  // Disk number.
+  AppendUInt16(&directory, 0);  // Internal attributes.
+  AppendUInt32(&directory, 0);  // External attributes.
+  AppendUInt32(&directory, 0);  // Offset of the local header.
+  directory += name;
+  std::string crc_field;
+  AppendUInt32(&crc_field, crc);
+  directory.replace(crc_offset + 2, 4, crc_field);
+
+  std::string end;
+  AppendUInt32(&end, 0x06054b50);
+  AppendUInt32(&end, 0);  // Disk numbers.
+  AppendUInt16(&end, 1);
+  AppendUInt16(&end, 1);
+  AppendUInt32(&end, directory.size());
+  AppendUInt32(&end, header.size() + size);
+  AppendUInt16(&end, 0);  // Comment size.
+  directory += end;
+
+  success = success &&
+      fwrite(directory.data(), 1, directory.size(), file) ==
+          directory.size() &&
+      fseek(file, crc_offset, SEEK_SET) == 0 &&
+      fwrite(crc_field.data(), 1, crc_field.size(), file) == crc_field.size();
+  return file_util::CloseFile(file) && success;
+}
+
+// Reads |size| bytes at |offset| with a new reader, like a range request.
+bool ReadRange(ApplicationArchive* archive,
+               const ApplicationArchive::Entry* entry,
+               int64 offset, int size, std::string* data) {
+  scoped_refptr<ApplicationArchiveReader> reader(
+      new ApplicationArchiveReader(archive, entry));
+  reader->Seek(offset);
+  data->resize(size);
+  int read = 0;
+  while (read < size) {
+    int count = reader->Read(&(*data)[read], size - read);
+    if (count <= 0)
+      return false;
+    read += count;
+  }
+  return true;
+}
+
+}  // namespace
+
+class ApplicationArchiveTest : public testing::Test {
+ public:
+  virtual void SetUp() OVERRIDE {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+  }
+
+  base::FilePath GetTestPackagePath(const std::string& name) {
+    base::FilePath path;
+    PathService::Get(base::DIR_SOURCE_ROOT, &path);
+    return path.AppendASCII("xwalk")
+        .AppendASCII("application")
+        .AppendASCII("test")
+        .AppendASCII("unpacker")
+        .AppendASCII(name);
+  }
+
+ protected:
+  base::ScopedTempDir temp_dir_;
+};
+
+TEST_F(ApplicationArchiveTest, ReadPackage) {
+  // The XPK header before the zip archive is skipped.
+  scoped_refptr<ApplicationArchive> archive(
+      new ApplicationArchive(GetTestPackagePath("good.xpk")));
+  ASSERT_TRUE(archive->Open());
+  EXPECT_EQ(2u, archive->entry_count());
+  EXPECT_TRUE(archive->FindEntry("missing.html") == NULL);
+
+  const ApplicationArchive::Entry* entry = archive->FindEntry("index.html");
+  ASSERT_TRUE(entry != NULL);
+  scoped_refptr<ApplicationArchiveReader> reader(
+      new ApplicationArchiveReader(archive, entry));
+  EXPECT_EQ(203, reader->size());
+  EXPECT_EQ(203u, ReadAll(reader).size());
+
+  entry = archive->FindEntry("manifest.json");
+  ASSERT_TRUE(entry != NULL);
+  std::string manifest;
+  EXPECT_TRUE(archive->ReadEntry(*entry, &manifest));
+  EXPECT_EQ(321u, manifest.size());
+  EXPECT_EQ(0u, manifest.find('{'));
+}
+
+TEST_F(ApplicationArchiveTest, InvalidArchive) {
+  scoped_refptr<ApplicationArchive> archive(
+      new ApplicationArchive(GetTestPackagePath("bad_zip.xpk")));
+  EXPECT_FALSE(archive->Open());
+  // The result of the first call is kept.
+  EXPECT_FALSE(archive->Open());
+
+  archive = new ApplicationArchive(temp_dir_.path().AppendASCII("missing"));
+  EXPECT_FALSE(archive->Open());
+}
+
+TEST_F(ApplicationArchiveTest, CorruptedEntry) {
+  base::FilePath source_dir = temp_dir_.path().AppendASCII("source");
+  ASSERT_TRUE(file_util::CreateDirectory(source_dir));
+  std::string contents;
+  for (int i = 0; i < 1000; ++i)
+    contents += static_cast<char>(i * 7919 % 251);
+  ASSERT_EQ(static_cast<int>(contents.size()), file_util::WriteFile(
+      source_dir.AppendASCII("a.txt"), contents.data(), contents.size()));
+  base::FilePath zip_path = temp_dir_.path().AppendASCII("a.zip");
+  ASSERT_TRUE(zip::Zip(source_dir, zip_path, false));
+
+  // Flip a byte in the middle of the compressed data, that starts after the
+  // local header, the name and the extra field of the entry.
+  std::string zip_data;
+  ASSERT_TRUE(base::ReadFileToString(zip_path, &zip_data));
+  ASSERT_EQ("PK\x03\x04", zip_data.substr(0, 4));
+  const uint8* header = reinterpret_cast<const uint8*>(zip_data.data());
+  size_t compressed_size = header[18] | header[19] << 8;
+  size_t data_offset = 30 + (header[26] | header[27] << 8) +
+      (header[28] | header[29] << 8);
+  zip_data[data_offset + compressed_size / 2] ^= 0xff;
+  ASSERT_EQ(static_cast<int>(zip_data.size()), file_util::WriteFile(
+      zip_path, zip_data.data(), zip_data.size()));
+
+  scoped_refptr<ApplicationArchive> archive(new ApplicationArchive(zip_path));
+  ASSERT_TRUE(archive->Open());
+  const ApplicationArchive::Entry* entry = archive->FindEntry("a.txt");
+  ASSERT_TRUE(entry != NULL);
+  std::string data;
+  EXPECT_FALSE(archive->ReadEntry(*entry, &data));
+}
+
+TEST_F(ApplicationArchiveTest, InconsistentStoredEntry) {
+  const std::string kName = "a.bin";
+  base::FilePath path = temp_dir_.path().AppendASCII("stored.zip");
+  ASSERT_TRUE(WriteStoredArchive(path, kName, 1000));
+
+  // A stored entry bigger than its data would be read past the mapping.
+  std::string zip_data;
+  ASSERT_TRUE(base::ReadFileToString(path, &zip_data));
+  size_t directory_offset = 30 + kName.size() + 1000;
+  ASSERT_EQ("PK\x01\x02", zip_data.substr(directory_offset, 4));
+  std::string size_field;
+  AppendUInt32(&size_field, 1000000);
+  zip_data.replace(directory_offset + 24, 4, size_field);
+  ASSERT_EQ(static_cast<int>(zip_data.size()), file_util::WriteFile(
+      path, zip_data.data(), zip_data.size()));
+
+  scoped_refptr<ApplicationArchive> archive(new ApplicationArchive(path));
+  ASSERT_TRUE(archive->Open());
+  EXPECT_TRUE(archive->FindEntry(kName) == NULL);
+  EXPECT_TRUE(archive->has_unsupported_entries());
+}
+
+TEST_F(ApplicationArchiveTest, OffsetsNearTheLimit) {
+  const std::string kName = "a.bin";
+  base::FilePath path = temp_dir_.path().AppendASCII("stored.zip");
+  ASSERT_TRUE(WriteStoredArchive(path, kName, 1000));
+  std::string zip_data;
+  ASSERT_TRUE(base::ReadFileToString(path, &zip_data));
+  size_t directory_offset = 30 + kName.size() + 1000;
+  size_t eocd = zip_data.size() - 22;
+  ASSERT_EQ("PK\x05\x06", zip_data.substr(eocd, 4));
+
+  // Offsets that would wrap around a 32-bit size_t once added to the sizes.
+  std::string offset_field;
+  AppendUInt32(&offset_field, 0xfffffff0);
+  std::string bad_directory = zip_data;
+  bad_directory.replace(eocd + 16, 4, offset_field);
+  ASSERT_EQ(static_cast<int>(bad_directory.size()), file_util::WriteFile(
+      path, bad_directory.data(), bad_directory.size()));
+  scoped_refptr<ApplicationArchive> archive(new ApplicationArchive(path));
+  EXPECT_FALSE(archive->Open());
+
+  std::string bad_entry = zip_data;
+  bad_entry.replace(directory_offset + 42, 4, offset_field);
+  ASSERT_EQ(static_cast<int>(bad_entry.size()), file_util::WriteFile(
+      path, bad_entry.data(), bad_entry.size()));
+  archive = new ApplicationArchive(path);
+  ASSERT_TRUE(archive->Open());
+  const ApplicationArchive::Entry* entry = archive->FindEntry(kName);
+  ASSERT_TRUE(entry);
+  std::string contents;
+  EXPECT_FALSE(archive->ReadEntry(*entry, &contents));
+}
+
+TEST_F(ApplicationArchiveTest, Seek) {
+  base::FilePath stored_path = temp_dir_.path().AppendASCII("stored.zip");
+  ASSERT_TRUE(WriteStoredArchive(stored_path, "video.webm", 100000));
+
+  base::FilePath source_dir = temp_dir_.path().AppendASCII("source");
+  ASSERT_TRUE(file_util::CreateDirectory(source_dir));
+  std::string contents;
+  for (int i = 0; i < 100000; ++i)
+    contents += GetPatternByte(i);
+  ASSERT_EQ(static_cast<int>(contents.size()), file_util::WriteFile(
+      source_dir.AppendASCII("video.webm"), contents.data(),
+      contents.size()));
+  base::FilePath deflated_path = temp_dir_.path().AppendASCII("deflated.zip");
+  ASSERT_TRUE(zip::Zip(source_dir, deflated_path, false));
+
+  base::FilePath paths[] = { stored_path, deflated_path };
+  for (size_t i = 0; i < arraysize(paths); ++i) {
+    scoped_refptr<ApplicationArchive> archive(
+        new ApplicationArchive(paths[i]));
+    ASSERT_TRUE(archive->Open());
+    const ApplicationArchive::Entry* entry = archive->FindEntry("video.webm");
+    ASSERT_TRUE(entry != NULL);
+
+    std::string data;
+    ASSERT_TRUE(ReadRange(archive, entry, 0, 100000, &data));
+    EXPECT_EQ(contents, data);
+    ASSERT_TRUE(ReadRange(archive, entry, 54321, 1000, &data));
+    EXPECT_EQ(contents.substr(54321, 1000), data);
+    // The CRC of the last bytes can't be checked for stored entries, but
+    // the end is reached.
+    ASSERT_TRUE(ReadRange(archive, entry, 99000, 1000, &data));
+    EXPECT_EQ(contents.substr(99000), data);
+
+    scoped_refptr<ApplicationArchiveReader> reader(
+        new ApplicationArchiveReader(archive, entry));
+    reader->Seek(200000);
+    char buffer[10];
+    EXPECT_EQ(0, reader->Read(buffer, sizeof(buffer)));
+  }
+}
+
+// Compares seeking at random in a big media file of an application with
+// reading the same ranges in a file, like a media element does with range
+// requests. Not run by default, as it writes a 500 MB file.
+TEST_F(ApplicationArchiveTest, DISABLED_RandomSeekBenchmark) {
+  const uint32 kMediaSize = 500 * 1024 * 1024;
+  const int kSeekCount = 500;
+  const int kRangeSize = 64 * 1024;
+
+  base::FilePath archive_path = temp_dir_.path().AppendASCII("media.zip");
+  ASSERT_TRUE(WriteStoredArchive(archive_path, "media.webm", kMediaSize));
+  // The same data, as if the archive was extracted.
+  base::FilePath file_path = temp_dir_.path().AppendASCII("media.webm");
+  {
+    scoped_refptr<ApplicationArchive> archive(
+        new ApplicationArchive(archive_path));
+    ASSERT_TRUE(archive->Open());
+    const ApplicationArchive::Entry* entry = archive->FindEntry("media.webm");
+    ASSERT_TRUE(entry != NULL);
+    FILE* file = file_util::OpenFile(file_path, "wb");
+    ASSERT_TRUE(file != NULL);
+    scoped_refptr<ApplicationArchiveReader> reader(
+        new ApplicationArchiveReader(archive, entry));
+    char buffer[kReadBufferSize];
+    int count;
+    while ((count = reader->Read(buffer, sizeof(buffer))) > 0)
+      ASSERT_EQ(static_cast<size_t>(count), fwrite(buffer, 1, count, file));
+    ASSERT_EQ(0, count);
+    ASSERT_TRUE(file_util::CloseFile(file));
+  }
+
+  std::vector<int64> offsets;
+  for (int i = 0; i < kSeekCount; ++i)
+    offsets.push_back(base::RandGenerator(kMediaSize - kRangeSize));
+
+  base::TimeTicks start_time = base::TimeTicks::Now();
+  bool created;
+  base::PlatformFileError error;
+  base::PlatformFile file = base::CreatePlatformFile(
+      file_path, base::PLATFORM_FILE_OPEN | base::PLATFORM_FILE_READ,
+      &created, &error);
+  ASSERT_NE(base::kInvalidPlatformFileValue, file);
+  std::string data(kRangeSize, 0);
+  for (int i = 0; i < kSeekCount; ++i) {
+    ASSERT_EQ(kRangeSize,
+              base::ReadPlatformFile(file, offsets[i], &data[0], kRangeSize));
+  }
+  base::ClosePlatformFile(file);
+  base::TimeDelta file_time = base::TimeTicks::Now() - start_time;
+
+  start_time = base::TimeTicks::Now();
+  scoped_refptr<ApplicationArchive> archive(
+      new ApplicationArchive(archive_path));
+  ASSERT_TRUE(archive->Open());
+  const ApplicationArchive::Entry* entry = archive->FindEntry("media.webm");
+  ASSERT_TRUE(entry != NULL);
+  for (int i = 0; i < kSeekCount; ++i) {
+    ASSERT_TRUE(ReadRange(archive, entry, offsets[i], kRangeSize, &data));
+    EXPECT_EQ(GetPatternByte(offsets[i]), data[0]);
+  }
+  base::TimeDelta archive_time = base::TimeTicks::Now() - start_time;
+
+  LOG(INFO) << kSeekCount << " random reads of " << kRangeSize
+            << " bytes in " << kMediaSize << " bytes: file "
+            << file_time.InMillisecondsF() << " ms, archive "
+            << archive_time.InMillisecondsF() << " ms.";
+}
+
+// Compares reading every resource of an application from its archive with
+// reading them after extraction, as done by the two installation modes.
+TEST_F(ApplicationArchiveTest, ReadBenchmark) {
+  base::FilePath source_dir = temp_dir_.path().AppendASCII("source");
+  ASSERT_TRUE(file_util::CreateDirectory(source_dir));
+  for (int i = 0; i < kBenchmarkFileCount; ++i) {
+    // Half of the content compresses, like scripts, half doesn't, like
+    // images.
+    std::string contents(kBenchmarkFileSize / 2, 'a' + i % 26);
+    for (int j = 0; j < kBenchmarkFileSize / 2; ++j)
+      contents += static_cast<char>((j * 7919 + i) % 251);
+    ASSERT_EQ(kBenchmarkFileSize, file_util::WriteFile(
+        source_dir.AppendASCII(base::StringPrintf("%d.dat", i)),
+        contents.data(), contents.size()));
+  }
+
+  base::FilePath zip_path = temp_dir_.path().AppendASCII("app.zip");
+  ASSERT_TRUE(zip::Zip(source_dir, zip_path, false));
+  base::FilePath extracted_dir = temp_dir_.path().AppendASCII("extracted");
+  base::TimeTicks start_time = base::TimeTicks::Now();
+  ASSERT_TRUE(zip::Unzip(zip_path, extracted_dir));
+  base::TimeDelta extract_time = base::TimeTicks::Now() - start_time;
+
+  start_time = base::TimeTicks::Now();
+  int64 file_bytes = 0;
+  base::FileEnumerator files(extracted_dir, false,
+                             base::FileEnumerator::FILES);
+  for (base::FilePath path = files.Next(); !path.empty();
+       path = files.Next()) {
+    std::string contents;
+    ASSERT_TRUE(base::ReadFileToString(path, &contents));
+    file_bytes += contents.size();
+  }
+  base::TimeDelta file_time = base::TimeTicks::Now() - start_time;
+
+  start_time = base::TimeTicks::Now();
+  int64 archive_bytes = 0;
+  scoped_refptr<ApplicationArchive> archive(new ApplicationArchive(zip_path));
+  ASSERT_TRUE(archive->Open());
+  for (int i = 0; i < kBenchmarkFileCount; ++i) {
+    const ApplicationArchive::Entry* entry =
+        archive->FindEntry(base::StringPrintf("%d.dat", i));
+    ASSERT_TRUE(entry != NULL);
+    scoped_refptr<ApplicationArchiveReader> reader(
+        new ApplicationArchiveReader(archive, entry));
+    archive_bytes += ReadAll(reader).size();
+  }
+  base::TimeDelta archive_time = base::TimeTicks::Now() - start_time;
+
+  EXPECT_EQ(kBenchmarkFileCount * kBenchmarkFileSize, file_bytes);
+  EXPECT_EQ(file_bytes, archive_bytes);
+  LOG(INFO) << "Extraction: " << extract_time.InMillisecondsF() << " ms, "
+            << "reading extracted files: " << file_time.InMillisecondsF()
+            << " ms, reading the archive: "
+            << archive_time.InMillisecondsF() << " ms.";
+}
+
+}  // namespace application
+}  // namespace xwalk
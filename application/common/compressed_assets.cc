@@ -0,0 +1,228 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/application/common/compressed_assets.h"
+
+#include <string.h>
+#include <vector>
+
+#include "base/file_util.h"
+#include "base/files/file_enumerator.h"
+#include "base/json/json_file_value_serializer.h"
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_split.h"
+#include "base/strings/string_util.h"
+#include "third_party/zlib/zlib.h"
+#include "xwalk/application/common/constants.h"
+
+namespace xwalk {
+namespace application {
+
+namespace {
+
+const int kManifestVersion = 2;
+const char kVersionKey[] = "version";
+const char kAssetsKey[] = "assets";
+const char kSizeKey[] = "size";
+// A string, a double can't hold the internal value of a base::Time.
+const char kModifiedKey[] = "modified";
+
+const base::FilePath::CharType kManifestFilename[] =
+    FILE_PATH_LITERAL("manifest.json");
+const base::FilePath::CharType kGzipExtension[] = FILE_PATH_LITERAL(".gz");
+
+// Smaller resources are read in one go anyway.
+const int64 kMinAssetSize = 1024;
+// Resources are compressed in memory.
+const int64 kMaxAssetSize = 32 * 1024 * 1024;
+
+// Text and other formats that aren't compressed already.
+const base::FilePath::CharType* kCompressibleExtensions[] = {
+  FILE_PATH_LITERAL(".css"),
+  FILE_PATH_LITERAL(".htm"),
+  FILE_PATH_LITERAL(".html"),
+  FILE_PATH_LITERAL(".js"),
+  FILE_PATH_LITERAL(".json"),
+  FILE_PATH_LITERAL(".map"),
+  FILE_PATH_LITERAL(".otf"),
+  FILE_PATH_LITERAL(".svg"),
+  FILE_PATH_LITERAL(".ttf"),
+  FILE_PATH_LITERAL(".txt"),
+  FILE_PATH_LITERAL(".wasm"),
+  FILE_PATH_LITERAL(".xml"),
+};
+
+bool IsCompressible(const base::FilePath& path) {
+  for (size_t i = 0; i < arraysize(kCompressibleExtensions); ++i) {
+    if (path.MatchesExtension(kCompressibleExtensions[i]))
+      return true;
+  }
+  return false;
+}
+
+bool GzipCompress(const std::string& input, std::string* output) {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  // MAX_WBITS + 16 writes a gzip header and trailer around the data.
+  if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, MAX_WBITS + 16,
+                   8, Z_DEFAULT_STRATEGY) != Z_OK)
+    return false;
+
+  output->resize(deflateBound(&stream, input.size()));
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+  stream.avail_in = input.size();
+  stream.next_out = reinterpret_cast<Bytef*>(&(*output)[0]);
+  stream.avail_out = output->size();
+  int result = deflate(&stream, Z_FINISH);
+  output->resize(stream.total_out);
+  deflateEnd(&stream);
+  return result == Z_STREAM_END;
+}
+
+base::FilePath GetGzipFilePathFor(const base::FilePath& application_path,
+                                  const base::FilePath& relative_path) {
+  return application_path.Append(kCompressedAssetsDirectory)
+      .Append(relative_path).AddExtension(kGzipExtension);
+}
+
+}  // namespace
+
+CompressedAssets::CompressedAssets(const base::FilePath& application_path,
+                                   scoped_ptr<base::DictionaryValue> assets)
+    : application_path_(application_path),
+      assets_(assets.Pass()) {
+}
+
+CompressedAssets::~CompressedAssets() {
+}
+
+// static
+bool CompressedAssets::Create(const base::FilePath& application_path) {
+  base::FilePath assets_path =
+      application_path.Append(kCompressedAssetsDirectory);
+  scoped_ptr<base::DictionaryValue> assets(new base::DictionaryValue);
+
+  base::FileEnumerator files(application_path, true,
+                             base::FileEnumerator::FILES);
+  for (base::FilePath path = files.Next(); !path.empty();
+       path = files.Next()) {
+    int64 size = files.GetInfo().GetSize();
+    if (size < kMinAssetSize || size > kMaxAssetSize ||
+        !IsCompressible(path) || assets_path.IsParent(path))
+      continue;
+
+    std::string contents;
+    std::string compressed;
+    if (!base::ReadFileToString(path, &contents) ||
+        !GzipCompress(contents, &compressed)) {
+      LOG(WARNING) << "Can't compress " << path.value();
+      continue;
+    }
+    // Inflating isn't worth it if it doesn't save an eighth of the reads.
+    if (compressed.size() > contents.size() - contents.size() / 8)
+      continue;
+
+    base::FilePath relative_path;
+    application_path.AppendRelativePath(path, &relative_path);
+    base::FilePath gzip_path =
+        GetGzipFilePathFor(application_path, relative_path);
+    if (!file_util::CreateDirectory(gzip_path.DirName()) ||
+        file_util::WriteFile(gzip_path, compressed.data(),
+                             compressed.size()) !=
+            static_cast<int>(compressed.size())) {
+      LOG(WARNING) << "Can't write " << gzip_path.value();
+      continue;
+    }
+
+    base::DictionaryValue* asset = new base::DictionaryValue;
+    asset->SetDouble(kSizeKey, size);
+    asset->SetString(kModifiedKey, base::Int64ToString(
+        files.GetInfo().GetLastModifiedTime().ToInternalValue()));
+    // The paths have dots.
+    assets->SetWithoutPathExpansion(relative_path.AsUTF8Unsafe(), asset);
+  }
+
+  if (assets->empty())
+    return false;
+
+  base::DictionaryValue manifest;
+  manifest.SetInteger(kVersionKey, kManifestVersion);
+  manifest.Set(kAssetsKey, assets.release());
+  JSONFileValueSerializer serializer(assets_path.Append(kManifestFilename));
+  return serializer.Serialize(manifest);
+}
+
+// static
+scoped_ptr<CompressedAssets> CompressedAssets::Load(
+    const base::FilePath& application_path) {
+  JSONFileValueSerializer serializer(application_path
+      .Append(kCompressedAssetsDirectory).Append(kManifestFilename));
+  scoped_ptr<base::Value> value(serializer.Deserialize(NULL, NULL));
+  base::DictionaryValue* manifest;
+  int version;
+  base::DictionaryValue* assets;
+  if (!value || !value->GetAsDictionary(&manifest) ||
+      !manifest->GetInteger(kVersionKey, &version) ||
+      version != kManifestVersion ||
+      !manifest->GetDictionary(kAssetsKey, &assets))
+    return scoped_ptr<CompressedAssets>();
+
+  return make_scoped_ptr(new CompressedAssets(
+      application_path, make_scoped_ptr(assets->DeepCopy())));
+}
+
+base::FilePath CompressedAssets::GetGzipFilePath(
+    const base::FilePath& relative_path,
+    int64 size,
+    const base::Time& last_modified) const {
+  const base::DictionaryValue* asset;
+  double asset_size;
+  std::string asset_modified;
+  int64 asset_modified_value;
+  if (!assets_->GetDictionaryWithoutPathExpansion(
+          relative_path.AsUTF8Unsafe(), &asset) ||
+      !asset->GetDouble(kSizeKey, &asset_size) ||
+      static_cast<int64>(asset_size) != size ||
+      !asset->GetString(kModifiedKey, &asset_modified) ||
+      !base::StringToInt64(asset_modified, &asset_modified_value) ||
+      asset_modified_value != last_modified.ToInternalValue())
+    return base::FilePath();
+
+  return GetGzipFilePathFor(application_path_, relative_path);
+}
+
+// static
+bool CompressedAssets::AcceptsGzip(const std::string& accept_encoding) {
+  if (accept_encoding.empty())
+    return true;
+
+  bool accepts_any = false;
+  std::vector<std::string> codings;
+  base::SplitString(accept_encoding, ',', &codings);
+  for (size_t i = 0; i < codings.size(); ++i) {
+    std::vector<std::string> params;
+    base::SplitString(codings[i], ';', &params);
+    if (params.empty())
+      continue;
+
+    bool is_refused = false;
+    for (size_t j = 1; j < params.size(); ++j) {
+      double quality;
+      if (StartsWithASCII(params[j], "q=", false) &&
+          base::StringToDouble(params[j].substr(2), &quality))
+        is_refused = quality <= 0;
+    }
+
+    std::string coding = StringToLowerASCII(params[0]);
+    if (coding == "gzip" || coding == "x-gzip")
+      return !is_refused;
+    if (coding == "*")
+      accepts_any = !is_refused;
+  }
+  return accepts_any;
+}
+
+}  // namespace application
+}  // namespace xwalk
@@ -0,0 +1,68 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef XWALK_APPLICATION_COMMON_COMPRESSED_ASSETS_H_
+#define XWALK_APPLICATION_COMMON_COMPRESSED_ASSETS_H_
+
+#include <string>
+
+#include "base/files/file_path.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/time/time.h"
+#include "base/values.h"
+
+namespace xwalk {
+namespace application {
+
+// The gzip compressed copies of the resources of an installed application,
+// made at installation so that less is read from the disk when serving
+// them, at the price of inflating them.
+//
+// The copies are in the kCompressedAssetsDirectory of the application, with
+// a manifest telling the size and last modification time, in internal
+// base::Time units, of each resource when it was compressed:
+//
+//   { "version": 2,
+//     "assets": { "js/game.js": { "size": 123456,
+//                                 "modified": "13026834154000000" } } }
+//
+// Only the resources that compress well are copied, see Create().
+class CompressedAssets {
+ public:
+  ~CompressedAssets();
+
+  // Compresses the resources of the application at |application_path|.
+  // Returns false if no copy could be written.
+  static bool Create(const base::FilePath& application_path);
+
+  // Returns NULL if the application at |application_path| has no compressed
+  // resources.
+  static scoped_ptr<CompressedAssets> Load(
+      const base::FilePath& application_path);
+
+  // Returns the path of the gzip copy of the resource at |relative_path|,
+  // that had |size| bytes and was last modified at |last_modified| when it
+  // was compressed, or an empty path if there is no copy.
+  base::FilePath GetGzipFilePath(const base::FilePath& relative_path,
+                                 int64 size,
+                                 const base::Time& last_modified) const;
+
+  // Tells if the value of an Accept-Encoding header allows gzip. No value
+  // allows it, as the app:// protocol handler inflates the data itself.
+  static bool AcceptsGzip(const std::string& accept_encoding);
+
+ private:
+  CompressedAssets(const base::FilePath& application_path,
+                   scoped_ptr<base::DictionaryValue> assets);
+
+  const base::FilePath application_path_;
+  scoped_ptr<base::DictionaryValue> assets_;
+
+  DISALLOW_COPY_AND_ASSIGN(CompressedAssets);
+};
+
+}  // namespace application
+}  // namespace xwalk
+
+#endif  // XWALK_APPLICATION_COMMON_COMPRESSED_ASSETS_H_
@@ -0,0 +1,134 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/application/common/compressed_assets.h"
+
+#include <string.h>
+#include <string>
+
+#include "base/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "third_party/zlib/zlib.h"
+
+namespace xwalk {
+namespace application {
+
+namespace {
+
+std::string GetCompressibleContents() {
+  std::string contents;
+  for (int i = 0; i < 500; ++i)
+    contents += "function f() { return 42; }\n";
+  return contents;
+}
+
+bool GzipUncompress(const std::string& input, std::string* output) {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  if (inflateInit2(&stream, MAX_WBITS + 16) != Z_OK)
+    return false;
+
+  char buffer[4096];
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+  stream.avail_in = input.size();
+  int result;
+  do {
+    stream.next_out = reinterpret_cast<Bytef*>(buffer);
+    stream.avail_out = sizeof(buffer);
+    result = inflate(&stream, Z_NO_FLUSH);
+    output->append(buffer, sizeof(buffer) - stream.avail_out);
+  } while (result == Z_OK);
+  inflateEnd(&stream);
+  return result == Z_STREAM_END;
+}
+
+}  // namespace
+
+class CompressedAssetsTest : public testing::Test {
+ public:
+  virtual void SetUp() OVERRIDE {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+  }
+
+  base::FilePath WriteResource(const std::string& name,
+                               const std::string& contents) {
+    base::FilePath path = temp_dir_.path().AppendASCII(name);
+    EXPECT_TRUE(file_util::CreateDirectory(path.DirName()));
+    EXPECT_EQ(static_cast<int>(contents.size()),
+              file_util::WriteFile(path, contents.data(), contents.size()));
+    return base::FilePath::FromUTF8Unsafe(name);
+  }
+
+ protected:
+  base::ScopedTempDir temp_dir_;
+};
+
+TEST_F(CompressedAssetsTest, CompressResources) {
+  std::string contents = GetCompressibleContents();
+  base::FilePath script_path = WriteResource("js/game.js", contents);
+  base::FilePath small_path = WriteResource("small.js", "var a;");
+  // Compressible, but most images aren't.
+  base::FilePath image_path = WriteResource("image.bmp", contents);
+  std::string random_contents;
+  uint32 random = 1;
+  for (int i = 0; i < 10000; ++i) {
+    random = random * 1103515245 + 12345;
+    random_contents += static_cast<char>(random >> 16);
+  }
+  base::FilePath data_path = WriteResource("data.json", random_contents);
+
+  ASSERT_TRUE(CompressedAssets::Create(temp_dir_.path()));
+  scoped_ptr<CompressedAssets> assets =
+      CompressedAssets::Load(temp_dir_.path());
+  ASSERT_TRUE(assets);
+
+  base::PlatformFileInfo file_info;
+  ASSERT_TRUE(file_util::GetFileInfo(temp_dir_.path().Append(script_path),
+                                     &file_info));
+  base::Time modified = file_info.last_modified;
+  base::FilePath gzip_path =
+      assets->GetGzipFilePath(script_path, contents.size(), modified);
+  ASSERT_FALSE(gzip_path.empty());
+  std::string compressed;
+  ASSERT_TRUE(base::ReadFileToString(gzip_path, &compressed));
+  EXPECT_LT(compressed.size(), contents.size() / 8);
+  std::string uncompressed;
+  ASSERT_TRUE(GzipUncompress(compressed, &uncompressed));
+  EXPECT_EQ(contents, uncompressed);
+
+  // The copy isn't used if the resource changed, even keeping its size.
+  EXPECT_TRUE(assets->GetGzipFilePath(
+      script_path, contents.size() + 1, modified).empty());
+  EXPECT_TRUE(assets->GetGzipFilePath(
+      script_path, contents.size(),
+      modified + base::TimeDelta::FromSeconds(1)).empty());
+
+  EXPECT_TRUE(assets->GetGzipFilePath(small_path, 6, modified).empty());
+  EXPECT_TRUE(assets->GetGzipFilePath(
+      image_path, contents.size(), modified).empty());
+  EXPECT_TRUE(assets->GetGzipFilePath(
+      data_path, random_contents.size(), modified).empty());
+}
+
+TEST_F(CompressedAssetsTest, NoCompressedResources) {
+  WriteResource("index.html", "<html></html>");
+  EXPECT_FALSE(CompressedAssets::Create(temp_dir_.path()));
+  EXPECT_FALSE(CompressedAssets::Load(temp_dir_.path()));
+}
+
+TEST_F(CompressedAssetsTest, AcceptsGzip) {
+  EXPECT_TRUE(CompressedAssets::AcceptsGzip(""));
+  EXPECT_TRUE(CompressedAssets::AcceptsGzip("gzip"));
+  EXPECT_TRUE(CompressedAssets::AcceptsGzip("deflate, GZIP;q=0.5"));
+  EXPECT_TRUE(CompressedAssets::AcceptsGzip("*"));
+  EXPECT_TRUE(CompressedAssets::AcceptsGzip("x-gzip"));
+  EXPECT_FALSE(CompressedAssets::AcceptsGzip("identity"));
+  EXPECT_FALSE(CompressedAssets::AcceptsGzip("gzip;q=0"));
+  EXPECT_FALSE(CompressedAssets::AcceptsGzip("*, gzip;q=0.0"));
+  EXPECT_FALSE(CompressedAssets::AcceptsGzip("*;q=0"));
+}
+
+}  // namespace application
+}  // namespace xwalk
@@ -17,6 +17,10 @@ const base::FilePath::CharType kMessagesFilename[] =
     FILE_PATH_LITERAL("messages.json");
 const char kGeneratedMainDocumentFilename[] =
     "_generated_main_document.html";
+const base::FilePath::CharType kApplicationArchiveFilename[] =
+    FILE_PATH_LITERAL("resources.zip");
+const base::FilePath::CharType kCompressedAssetsDirectory[] =
+    FILE_PATH_LITERAL("_compressed_assets");
 
 }  // namespace application
 }  // namespace xwalk
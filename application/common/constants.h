@@ -25,6 +25,14 @@ extern const base::FilePath::CharType kMessagesFilename[];
 // The filename to use for main document generated from app.main.scripts.
 extern const char kGeneratedMainDocumentFilename[];
 
+// The name of the package kept in the directory of an application installed
+// without extracting its resources, see ApplicationArchive.
+extern const base::FilePath::CharType kApplicationArchiveFilename[];
+
+// The directory of the compressed copies of the resources of an application,
+// see CompressedAssets.
+extern const base::FilePath::CharType kCompressedAssetsDirectory[];
+
 }  // namespace application
 }  // namespace xwalk
 
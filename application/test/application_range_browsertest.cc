@@ -0,0 +1,167 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "content/public/browser/web_contents.h"
+#include "content/public/test/browser_test_utils.h"
+#include "content/public/test/test_utils.h"
+#include "third_party/zlib/google/zip.h"
+#include "xwalk/application/browser/application.h"
+#include "xwalk/application/browser/application_service.h"
+#include "xwalk/application/browser/application_storage.h"
+#include "xwalk/application/browser/application_system.h"
+#include "xwalk/application/common/constants.h"
+#include "xwalk/application/test/application_browsertest.h"
+#include "xwalk/runtime/browser/runtime.h"
+#include "xwalk/runtime/browser/xwalk_runner.h"
+
+using xwalk::application::Application;
+using xwalk::application::ApplicationSystem;
+
+namespace {
+
+// The contents of data.txt in the "range" application.
+const char kResourceContents[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+}  // namespace
+
+// Requests a resource of an installed application, that has an ETag, with
+// the Range, If-Range and If-None-Match headers.
+class ApplicationRangeBrowserTest : public ApplicationBrowserTest {
+ protected:
+  ApplicationRangeBrowserTest() : web_contents_(NULL) {}
+
+  ApplicationSystem* system() {
+    return xwalk::XWalkRunner::GetInstance()->app_system();
+  }
+
+  std::string InstallApplication() {
+    std::string id;
+    EXPECT_TRUE(system()->application_service()->Install(
+        test_data_dir_.Append(FILE_PATH_LITERAL("range")), &id));
+    return id;
+  }
+
+  // Moves the resources of the installed application into its archive, only
+  // the manifest is left on the disk.
+  void ArchiveApplication(const std::string& id) {
+    base::FilePath app_path =
+        system()->application_storage()->GetApplicationData(id)->Path();
+    base::ScopedTempDir temp_dir;
+    ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+    base::FilePath archive_path = temp_dir.path().AppendASCII("range.zip");
+    ASSERT_TRUE(zip::Zip(app_path, archive_path, false));
+    ASSERT_TRUE(base::DeleteFile(app_path.AppendASCII("main.html"), false));
+    ASSERT_TRUE(base::DeleteFile(app_path.AppendASCII("data.txt"), false));
+    ASSERT_TRUE(base::Move(archive_path, app_path.Append(
+        xwalk::application::kApplicationArchiveFilename)));
+  }
+
+  void LaunchApplication(const std::string& id) {
+    int runtime_count = GetRuntimeCount();
+    Application* app = system()->application_service()->Launch(id);
+    ASSERT_TRUE(app);
+    WaitForRuntimes(runtime_count + 1);
+    ASSERT_FALSE(app->runtimes().empty());
+    web_contents_ = (*app->runtimes().begin())->web_contents();
+    content::WaitForLoadStop(web_contents_);
+  }
+
+  // Requests data.txt with |headers|, a JavaScript object that can use the
+  // ETag kept by KeepETag(), and returns the status of the response.
+  int Request(const std::string& headers) {
+    int status = -1;
+    EXPECT_TRUE(content::ExecuteScriptAndExtractInt(
+        web_contents_,
+        "var headers = " + headers + ";"
+        "window.xhr = new XMLHttpRequest();"
+        "xhr.open('GET', 'data.txt', false);"
+        "for (var name in headers)"
+        "  xhr.setRequestHeader(name, headers[name]);"
+        "xhr.send();"
+        "window.domAutomationController.send(xhr.status);",
+        &status));
+    return status;
+  }
+
+  // Keeps the ETag of the last response in |etag|.
+  void KeepETag() {
+    EXPECT_TRUE(content::ExecuteScript(
+        web_contents_, "window.etag = xhr.getResponseHeader('ETag');"));
+  }
+
+  std::string GetResponseHeader(const std::string& name) {
+    std::string value;
+    EXPECT_TRUE(content::ExecuteScriptAndExtractString(
+        web_contents_,
+        "window.domAutomationController.send("
+        "    xhr.getResponseHeader('" + name + "') || '');",
+        &value));
+    return value;
+  }
+
+  std::string GetResponseBody() {
+    std::string body;
+    EXPECT_TRUE(content::ExecuteScriptAndExtractString(
+        web_contents_,
+        "window.domAutomationController.send(xhr.responseText);",
+        &body));
+    return body;
+  }
+
+  void TestRanges() {
+    ASSERT_EQ(200, Request("{}"));
+    EXPECT_EQ(kResourceContents, GetResponseBody());
+    EXPECT_EQ("bytes", GetResponseHeader("Accept-Ranges"));
+    ASSERT_FALSE(GetResponseHeader("ETag").empty());
+    KeepETag();
+
+    EXPECT_EQ(206, Request("{'Range': 'bytes=2-5'}"));
+    EXPECT_EQ("bytes 2-5/36", GetResponseHeader("Content-Range"));
+    EXPECT_EQ("2345", GetResponseBody());
+
+    EXPECT_EQ(206, Request("{'Range': 'bytes=-3'}"));
+    EXPECT_EQ("bytes 33-35/36", GetResponseHeader("Content-Range"));
+    EXPECT_EQ("xyz", GetResponseBody());
+
+    // The resource didn't change, so only the range is sent.
+    EXPECT_EQ(206, Request("{'Range': 'bytes=10-', 'If-Range': etag}"));
+    EXPECT_EQ("bytes 10-35/36", GetResponseHeader("Content-Range"));
+    EXPECT_EQ("abcdefghijklmnopqrstuvwxyz", GetResponseBody());
+
+    // The client has parts of another version, it gets the whole resource.
+    EXPECT_EQ(200, Request("{'Range': 'bytes=10-', 'If-Range': '\"0-0\"'}"));
+    EXPECT_EQ("", GetResponseHeader("Content-Range"));
+    EXPECT_EQ(kResourceContents, GetResponseBody());
+
+    EXPECT_EQ(416, Request("{'Range': 'bytes=36-'}"));
+    EXPECT_EQ("bytes */36", GetResponseHeader("Content-Range"));
+    EXPECT_EQ("", GetResponseBody());
+
+    EXPECT_EQ(304, Request("{'If-None-Match': etag}"));
+    EXPECT_EQ(304, Request("{'Range': 'bytes=2-5', 'If-None-Match': etag}"));
+    EXPECT_EQ(200, Request("{'If-None-Match': '\"0-0\"'}"));
+    EXPECT_EQ(kResourceContents, GetResponseBody());
+  }
+
+  content::WebContents* web_contents_;
+};
+
+IN_PROC_BROWSER_TEST_F(ApplicationRangeBrowserTest, FileResource) {
+  content::RunAllPendingInMessageLoop();
+  std::string id = InstallApplication();
+  ASSERT_FALSE(id.empty());
+  LaunchApplication(id);
+  TestRanges();
+}
+
+IN_PROC_BROWSER_TEST_F(ApplicationRangeBrowserTest, ArchiveResource) {
+  content::RunAllPendingInMessageLoop();
+  std::string id = InstallApplication();
+  ASSERT_FALSE(id.empty());
+  ArchiveApplication(id);
+  LaunchApplication(id);
+  TestRanges();
+}
@@ -0,0 +1,216 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/extensions/browser/xwalk_extension_code_cache_store.h"
+
+#include <algorithm>
+#include <vector>
+#include "base/bind.h"
+#include "base/file_util.h"
+#include "base/files/file_enumerator.h"
+#include "base/native_library.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_util.h"
+#include "base/strings/utf_string_conversions.h"
+#include "content/public/browser/browser_thread.h"
+#include "ipc/ipc_message_macros.h"
+#include "v8/include/v8.h"
+#include "xwalk/extensions/common/xwalk_extension_messages.h"
+
+using content::BrowserThread;
+
+namespace xwalk {
+namespace extensions {
+
+namespace {
+
+const base::FilePath::CharType kStampFileName[] = FILE_PATH_LITERAL("Stamp");
+
+// The data comes from render processes, so be conservative about what we
+// write to disk.
+const size_t kMaxKeyLength = 128;
+const size_t kMaxEntrySize = 1024 * 1024;
+const size_t kMaxEntries = 256;
+
+bool IsValidKey(const std::string& key) {
+  if (key.empty() || key.size() > kMaxKeyLength || key[0] == '.')
+    return false;
+  for (size_t i = 0; i < key.size(); ++i) {
+    const char c = key[i];
+    if (!IsAsciiAlpha(c) && !IsAsciiDigit(c) && c != '.' && c != '-'
+        && c != '_')
+      return false;
+  }
+  return base::FilePath::FromUTF8Unsafe(key) != base::FilePath(kStampFileName);
+}
+
+base::FilePath::StringType GetNativeLibraryPattern() {
+  const base::string16 library_pattern = base::GetNativeLibraryName(
+      UTF8ToUTF16("*"));
+#if defined(OS_WIN)
+  return library_pattern;
+#else
+  return UTF16ToUTF8(library_pattern);
+#endif
+}
+
+class CodeCacheMessageFilter : public IPC::ChannelProxy::MessageFilter {
+ public:
+  explicit CodeCacheMessageFilter(XWalkExtensionCodeCacheStore* store)
+      : store_(store) {}
+
+  // IPC::ChannelProxy::MessageFilter implementation.
+  virtual bool OnMessageReceived(const IPC::Message& message) OVERRIDE {
+    bool handled = true;
+    IPC_BEGIN_MESSAGE_MAP(CodeCacheMessageFilter, message)
+      IPC_MESSAGE_HANDLER(XWalkExtensionHostMsg_StoreCodeCache,
+                          OnStoreCodeCache)
+      IPC_MESSAGE_UNHANDLED(handled = false)
+    IPC_END_MESSAGE_MAP()
+    return handled;
+  }
+
+ private:
+  virtual ~CodeCacheMessageFilter() {}
+
+  void OnStoreCodeCache(const std::string& key, const std::string& data) {
+    BrowserThread::PostTask(
+        BrowserThread::UI, FROM_HERE,
+        base::Bind(&XWalkExtensionCodeCacheStore::Store, store_, key, data));
+  }
+
+  scoped_refptr<XWalkExtensionCodeCacheStore> store_;
+};
+
+}  // namespace
+
+XWalkExtensionCodeCacheStore::XWalkExtensionCodeCacheStore(
+    const base::FilePath& cache_path,
+    const base::FilePath& external_extensions_path)
+    : cache_path_(cache_path),
+      external_extensions_path_(external_extensions_path),
+      loaded_(false) {
+}
+
+XWalkExtensionCodeCacheStore::~XWalkExtensionCodeCacheStore() {
+}
+
+void XWalkExtensionCodeCacheStore::Load(const base::Closure& callback) {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::UI));
+  BrowserThread::PostTaskAndReply(
+      BrowserThread::FILE, FROM_HERE,
+      base::Bind(&XWalkExtensionCodeCacheStore::LoadOnFileThread, this),
+      base::Bind(&XWalkExtensionCodeCacheStore::OnLoaded, this, callback));
+}
+
+void XWalkExtensionCodeCacheStore::Store(const std::string& key,
+                                         const std::string& data) {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::UI));
+  if (!IsValidKey(key) || data.size() > kMaxEntrySize) {
+    LOG(WARNING) << "Ignoring invalid extension code cache entry.";
+    return;
+  }
+
+  if (entries_.size() >= kMaxEntries && entries_.find(key) == entries_.end())
+    return;
+
+  entries_[key] = data;
+  BrowserThread::PostTask(
+      BrowserThread::FILE, FROM_HERE,
+      base::Bind(&XWalkExtensionCodeCacheStore::WriteOnFileThread, this,
+                 key, data));
+}
+
+IPC::ChannelProxy::MessageFilter*
+XWalkExtensionCodeCacheStore::CreateMessageFilter() {
+  return new CodeCacheMessageFilter(this);
+}
+
+// Preparse data is only valid for the V8 version that produced it. External
+// extensions are also part of the stamp, so replacing a library invalidates
+// the cache even if the JS code it provides is kept.
+std::string XWalkExtensionCodeCacheStore::ComputeStamp() const {
+  std::string stamp = std::string("v8 ") + v8::V8::GetVersion() + "\n";
+  if (external_extensions_path_.empty())
+    return stamp;
+
+  std::vector<std::string> libraries;
+  base::FileEnumerator enumerator(external_extensions_path_, false,
+                                  base::FileEnumerator::FILES,
+                                  GetNativeLibraryPattern());
+  for (base::FilePath path = enumerator.Next(); !path.empty();
+       path = enumerator.Next()) {
+    base::FileEnumerator::FileInfo info = enumerator.GetInfo();
+    libraries.push_back(
+        path.BaseName().AsUTF8Unsafe() + " " +
+        base::Int64ToString(info.GetSize()) + " " +
+        base::Int64ToString(info.GetLastModifiedTime().ToInternalValue()));
+  }
+
+  std::sort(libraries.begin(), libraries.end());
+  for (size_t i = 0; i < libraries.size(); ++i)
+    stamp += libraries[i] + "\n";
+  return stamp;
+}
+
+void XWalkExtensionCodeCacheStore::LoadOnFileThread() {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::FILE));
+  loaded_entries_.reset(new EntryMap);
+
+  const std::string stamp = ComputeStamp();
+  const base::FilePath stamp_path = cache_path_.Append(kStampFileName);
+
+  std::string stored_stamp;
+  if (!base::ReadFileToString(stamp_path, &stored_stamp)
+      || stored_stamp != stamp) {
+    VLOG(1) << "Discarding extension code cache at "
+            << cache_path_.AsUTF8Unsafe();
+    base::DeleteFile(cache_path_, true);
+    if (!file_util::CreateDirectory(cache_path_)) {
+      LOG(WARNING) << "Couldn't create extension code cache directory "
+                   << cache_path_.AsUTF8Unsafe();
+      return;
+    }
+    file_util::WriteFile(stamp_path, stamp.data(), stamp.size());
+    return;
+  }
+
+  base::FileEnumerator enumerator(cache_path_, false,
+                                  base::FileEnumerator::FILES);
+  for (base::FilePath path = enumerator.Next(); !path.empty();
+       path = enumerator.Next()) {
+    // Files that Store() wouldn't have written are left aside.
+    const std::string key = path.BaseName().AsUTF8Unsafe();
+    if (!IsValidKey(key) ||
+        enumerator.GetInfo().GetSize() > static_cast<int64>(kMaxEntrySize) ||
+        loaded_entries_->size() >= kMaxEntries)
+      continue;
+    std::string data;
+    if (base::ReadFileToString(path, &data))
+      (*loaded_entries_)[key] = data;
+  }
+}
+
+void XWalkExtensionCodeCacheStore::OnLoaded(const base::Closure& callback) {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::UI));
+  // Entries stored while loading are newer than the ones from disk.
+  entries_.insert(loaded_entries_->begin(), loaded_entries_->end());
+  loaded_entries_.reset();
+  loaded_ = true;
+
+  VLOG(1) << "Loaded " << entries_.size() << " extension code cache entries.";
+  callback.Run();
+}
+
+void XWalkExtensionCodeCacheStore::WriteOnFileThread(const std::string& key,
+                                                     const std::string& data) {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::FILE));
+  const base::FilePath path = cache_path_.AppendASCII(key);
+  if (file_util::WriteFile(path, data.data(), data.size())
+      != static_cast<int>(data.size()))
+    LOG(WARNING) << "Couldn't write extension code cache entry " << key;
+}
+
+}  // namespace extensions
+}  // namespace xwalk
@@ -0,0 +1,71 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef XWALK_EXTENSIONS_BROWSER_XWALK_EXTENSION_CODE_CACHE_STORE_H_
+#define XWALK_EXTENSIONS_BROWSER_XWALK_EXTENSION_CODE_CACHE_STORE_H_
+
+#include <map>
+#include <string>
+#include "base/callback.h"
+#include "base/files/file_path.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "ipc/ipc_channel_proxy.h"
+
+namespace xwalk {
+namespace extensions {
+
+// Persists on disk the V8 preparse data produced by render processes for the
+// extensions JS code (see XWalkExtensionCodeCache), so new render processes
+// and later runs don't need to produce it again.
+//
+// The cache is discarded when the V8 version or any of the external
+// extensions libraries change. Disk access happens in the FILE thread, the
+// rest of this class should be used from the UI thread.
+class XWalkExtensionCodeCacheStore
+    : public base::RefCountedThreadSafe<XWalkExtensionCodeCacheStore> {
+ public:
+  typedef std::map<std::string, std::string> EntryMap;
+
+  XWalkExtensionCodeCacheStore(const base::FilePath& cache_path,
+                               const base::FilePath& external_extensions_path);
+
+  // Reads the entries from disk, |callback| is called once they are
+  // available in entries().
+  void Load(const base::Closure& callback);
+  bool is_loaded() const { return loaded_; }
+
+  const EntryMap& entries() const { return entries_; }
+
+  void Store(const std::string& key, const std::string& data);
+
+  // Creates a filter to be added to a render process channel, that will
+  // receive the data produced by that render process.
+  IPC::ChannelProxy::MessageFilter* CreateMessageFilter();
+
+ private:
+  friend class base::RefCountedThreadSafe<XWalkExtensionCodeCacheStore>;
+  ~XWalkExtensionCodeCacheStore();
+
+  std::string ComputeStamp() const;
+  void LoadOnFileThread();
+  void OnLoaded(const base::Closure& callback);
+  void WriteOnFileThread(const std::string& key, const std::string& data);
+
+  base::FilePath cache_path_;
+  base::FilePath external_extensions_path_;
+
+  bool loaded_;
+  EntryMap entries_;
+
+  // Filled in the FILE thread and merged into entries_ by OnLoaded().
+  scoped_ptr<EntryMap> loaded_entries_;
+
+  DISALLOW_COPY_AND_ASSIGN(XWalkExtensionCodeCacheStore);
+};
+
+}  // namespace extensions
+}  // namespace xwalk
+
+#endif  // XWALK_EXTENSIONS_BROWSER_XWALK_EXTENSION_CODE_CACHE_STORE_H_
@@ -0,0 +1,161 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/extensions/browser/xwalk_extension_code_cache_store.h"
+
+#include <string>
+#include "base/bind.h"
+#include "base/bind_helpers.h"
+#include "base/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/native_library.h"
+#include "base/run_loop.h"
+#include "base/strings/utf_string_conversions.h"
+#include "content/public/test/test_browser_thread_bundle.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+using xwalk::extensions::XWalkExtensionCodeCacheStore;
+
+namespace {
+
+const char kTestKey[] = "echo.js-1234";
+const char kTestData[] = "preparse data";
+
+class XWalkExtensionCodeCacheStoreTest : public testing::Test {
+ public:
+  virtual void SetUp() OVERRIDE {
+    ASSERT_TRUE(cache_dir_.CreateUniqueTempDir());
+    ASSERT_TRUE(extensions_dir_.CreateUniqueTempDir());
+  }
+
+  // Creates a store for the cache and waits for it to load the entries.
+  scoped_refptr<XWalkExtensionCodeCacheStore> LoadStore() {
+    scoped_refptr<XWalkExtensionCodeCacheStore> store(
+        new XWalkExtensionCodeCacheStore(cache_dir_.path(),
+                                         extensions_dir_.path()));
+    store->Load(base::Bind(&base::DoNothing));
+    base::RunLoop().RunUntilIdle();
+    EXPECT_TRUE(store->is_loaded());
+    return store;
+  }
+
+  // Stores |data| under |key| and waits for it to be written.
+  void Store(XWalkExtensionCodeCacheStore* store, const std::string& key,
+             const std::string& data) {
+    store->Store(key, data);
+    base::RunLoop().RunUntilIdle();
+  }
+
+  void WriteCacheFile(const std::string& name, const std::string& data) {
+    ASSERT_EQ(static_cast<int>(data.size()), file_util::WriteFile(
+        cache_dir_.path().AppendASCII(name), data.data(), data.size()));
+  }
+
+  void AddExternalExtension(const std::string& name) {
+    base::FilePath path = extensions_dir_.path().Append(
+        base::GetNativeLibraryName(ASCIIToUTF16(name)));
+    ASSERT_EQ(1, file_util::WriteFile(path, "x", 1));
+  }
+
+ protected:
+  content::TestBrowserThreadBundle thread_bundle_;
+  base::ScopedTempDir cache_dir_;
+  base::ScopedTempDir extensions_dir_;
+};
+
+}  // namespace
+
+TEST_F(XWalkExtensionCodeCacheStoreTest, EntriesArePersisted) {
+  scoped_refptr<XWalkExtensionCodeCacheStore> store = LoadStore();
+  EXPECT_TRUE(store->entries().empty());
+  Store(store.get(), kTestKey, kTestData);
+  ASSERT_EQ(1u, store->entries().count(kTestKey));
+
+  store = LoadStore();
+  ASSERT_EQ(1u, store->entries().size());
+  EXPECT_EQ(kTestData, store->entries().find(kTestKey)->second);
+}
+
+TEST_F(XWalkExtensionCodeCacheStoreTest, InvalidKeysAreIgnored) {
+  scoped_refptr<XWalkExtensionCodeCacheStore> store = LoadStore();
+
+  // The keys become file names in the cache directory.
+  Store(store.get(), "", kTestData);
+  Store(store.get(), ".hidden", kTestData);
+  Store(store.get(), "..", kTestData);
+  Store(store.get(), "../escaped", kTestData);
+  Store(store.get(), "sub/dir", kTestData);
+  Store(store.get(), "sub\\dir", kTestData);
+  Store(store.get(), "space in key", kTestData);
+  Store(store.get(), "Stamp", kTestData);
+  Store(store.get(), std::string(129, 'a'), kTestData);
+  EXPECT_TRUE(store->entries().empty());
+  EXPECT_FALSE(base::PathExists(
+      cache_dir_.path().DirName().AppendASCII("escaped")));
+
+  Store(store.get(), std::string(128, 'a'), kTestData);
+  Store(store.get(), "a-Z_0.9", kTestData);
+  EXPECT_EQ(2u, store->entries().size());
+
+  // So is data bigger than V8 would produce for an extension.
+  Store(store.get(), kTestKey, std::string(1024 * 1024 + 1, 'x'));
+  EXPECT_EQ(0u, store->entries().count(kTestKey));
+}
+
+TEST_F(XWalkExtensionCodeCacheStoreTest, ChangedExtensionsInvalidateCache) {
+  AddExternalExtension("echo");
+  scoped_refptr<XWalkExtensionCodeCacheStore> store = LoadStore();
+  Store(store.get(), kTestKey, kTestData);
+
+  store = LoadStore();
+  EXPECT_EQ(1u, store->entries().size());
+
+  // Only the libraries are part of the stamp.
+  ASSERT_EQ(1, file_util::WriteFile(
+      extensions_dir_.path().AppendASCII("README"), "x", 1));
+  store = LoadStore();
+  EXPECT_EQ(1u, store->entries().count(kTestKey));
+
+  AddExternalExtension("another");
+  store = LoadStore();
+  EXPECT_TRUE(store->entries().empty());
+  EXPECT_FALSE(base::PathExists(cache_dir_.path().AppendASCII(kTestKey)));
+
+  // The new stamp is kept.
+  Store(store.get(), kTestKey, kTestData);
+  store = LoadStore();
+  EXPECT_EQ(1u, store->entries().size());
+}
+
+TEST_F(XWalkExtensionCodeCacheStoreTest, CorruptedStampDiscardsCache) {
+  scoped_refptr<XWalkExtensionCodeCacheStore> store = LoadStore();
+  Store(store.get(), kTestKey, kTestData);
+
+  WriteCacheFile("Stamp", "garbage");
+  store = LoadStore();
+  EXPECT_TRUE(store->entries().empty());
+
+  ASSERT_TRUE(base::DeleteFile(cache_dir_.path().AppendASCII("Stamp"),
+                               false));
+  WriteCacheFile(kTestKey, kTestData);
+  store = LoadStore();
+  EXPECT_TRUE(store->entries().empty());
+}
+
+TEST_F(XWalkExtensionCodeCacheStoreTest, CorruptedFilesAreIgnored) {
+  scoped_refptr<XWalkExtensionCodeCacheStore> store = LoadStore();
+  Store(store.get(), kTestKey, kTestData);
+
+  WriteCacheFile("not a key", kTestData);
+  WriteCacheFile(".hidden", kTestData);
+  WriteCacheFile("too-big", std::string(1024 * 1024 + 1, 'x'));
+  WriteCacheFile("empty", "");
+  ASSERT_TRUE(file_util::CreateDirectory(
+      cache_dir_.path().AppendASCII("directory")));
+
+  store = LoadStore();
+  EXPECT_EQ(2u, store->entries().size());
+  EXPECT_EQ(kTestData, store->entries().find(kTestKey)->second);
+  EXPECT_EQ("", store->entries().find("empty")->second);
+}
@@ -6,10 +6,7 @@
 #define XWALK_EXTENSIONS_BROWSER_XWALK_EXTENSION_DATA_H_
 
 #include "base/memory/scoped_ptr.h"
-
-namespace base {
-class Thread;
-}
+#include "base/memory/weak_ptr.h"
 
 namespace content {
 class RenderProcessHost;
@@ -35,12 +32,12 @@ class XWalkExtensionData {
     return in_process_ui_thread_server_.get();
   }
 
-  ExtensionServerMessageFilter* in_process_message_filter() {
-    return in_process_message_filter_;
+  XWalkExtensionServer* in_process_extension_thread_server() {
+    return in_process_extension_thread_server_.get();
   }
 
-  scoped_ptr<XWalkExtensionProcessHost> extension_process_host() {
-    return extension_process_host_.Pass();
+  ExtensionServerMessageFilter* in_process_message_filter() {
+    return in_process_message_filter_;
   }
 
   content::RenderProcessHost* render_process_host() {
@@ -63,14 +60,21 @@ class XWalkExtensionData {
     in_process_message_filter_ = filter;
   }
 
-  void set_extension_process_host(scoped_ptr<XWalkExtensionProcessHost> host) {
-    extension_process_host_.reset(host.release());
+  // The extension process host lives in the IO thread, see
+  // XWalkExtensionProcessHost::GetWeakPtr(). It is deleted together with this
+  // object, unless it is a shared one, in which case only its id is set.
+  void set_extension_process_host(
+      base::WeakPtr<XWalkExtensionProcessHost> host, int host_id) {
+    extension_process_host_ = host;
+    extension_process_host_id_ = host_id;
   }
 
-  void set_extension_thread(base::Thread* thread) {
-    extension_thread_ = thread;
+  void set_shared_extension_process_host_id(int host_id) {
+    extension_process_host_id_ = host_id;
   }
 
+  int extension_process_host_id() const { return extension_process_host_id_; }
+
   void set_render_process_host(content::RenderProcessHost* rph) {
     render_process_host_ = rph;
   }
@@ -84,9 +88,8 @@ class XWalkExtensionData {
   ExtensionServerMessageFilter* in_process_message_filter_;
 
   // This object lives on the IO-thread.
-  scoped_ptr<XWalkExtensionProcessHost> extension_process_host_;
-
-  base::Thread* extension_thread_;
+  base::WeakPtr<XWalkExtensionProcessHost> extension_process_host_;
+  int extension_process_host_id_;
 
   content::RenderProcessHost* render_process_host_;
 };
@@ -5,7 +5,9 @@
 #include "xwalk/extensions/browser/xwalk_extension_function_handler.h"
 
 #include "base/location.h"
+#include "base/logging.h"
 #include "xwalk/extensions/common/xwalk_external_instance.h"
+#include "xwalk/extensions/common/xwalk_serialized_value.h"
 
 namespace xwalk {
 namespace extensions {
@@ -23,9 +25,17 @@ XWalkExtensionFunctionInfo::~XWalkExtensionFunctionInfo() {}
 XWalkExtensionFunctionHandler::XWalkExtensionFunctionHandler(
     XWalkExtensionInstance* instance)
   : instance_(instance),
-    weak_factory_(this) {}
+    weak_factory_(this) {
+  if (instance_) {
+    DCHECK(!instance_->function_handler_);
+    instance_->function_handler_ = this;
+  }
+}
 
-XWalkExtensionFunctionHandler::~XWalkExtensionFunctionHandler() {}
+XWalkExtensionFunctionHandler::~XWalkExtensionFunctionHandler() {
+  if (instance_ && instance_->function_handler_ == this)
+    instance_->function_handler_ = NULL;
+}
 
 void XWalkExtensionFunctionHandler::HandleMessage(scoped_ptr<base::Value> msg) {
   base::ListValue* args;
@@ -72,6 +82,49 @@ void XWalkExtensionFunctionHandler::HandleMessage(scoped_ptr<base::Value> msg) {
   }
 }
 
+void XWalkExtensionFunctionHandler::HandleSerializedMessage(
+    const XWalkSerializedValue& msg) {
+  if (!msg.IsType(base::Value::TYPE_LIST) || msg.size() < 2) {
+    LOG(WARNING) << "Invalid number of arguments.";
+    return;
+  }
+
+  XWalkSerializedValue::Iterator it(msg);
+  std::string function_name;
+  if (!it.Next() || !it.value().GetAsString(&function_name)) {
+    LOG(WARNING) << "The function name is not a string.";
+    return;
+  }
+
+  std::string callback_id;
+  if (!it.Next() || !it.value().GetAsString(&callback_id)) {
+    LOG(WARNING) << "The callback id is not a string.";
+    return;
+  }
+
+  if (handlers_.find(function_name) == handlers_.end()) {
+    DLOG(WARNING) << "Function not registered: " << function_name;
+    return;
+  }
+
+  // Params::Create() generated from the IDL takes a base::ListValue, so the
+  // arguments are still converted, but the rest of the message isn't.
+  scoped_ptr<base::ListValue> arguments(new base::ListValue);
+  while (it.Next())
+    arguments->Append(it.value().ToValue().release());
+
+  scoped_ptr<XWalkExtensionFunctionInfo> info(
+      new XWalkExtensionFunctionInfo(
+          function_name,
+          arguments.Pass(),
+          base::Bind(&XWalkExtensionFunctionHandler::DispatchResult,
+                     weak_factory_.GetWeakPtr(),
+                     base::MessageLoopProxy::current(),
+                     callback_id)));
+
+  HandleFunction(info.Pass());
+}
+
 bool XWalkExtensionFunctionHandler::HandleFunction(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
   FunctionHandlerMap::iterator iter = handlers_.find(info->name());
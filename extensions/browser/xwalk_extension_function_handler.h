@@ -16,6 +16,7 @@ namespace xwalk {
 namespace extensions {
 
 class XWalkExtensionInstance;
+class XWalkSerializedValue;
 
 // This struct is passed to the function handler, usually assigned to the
 // signature of a method in JavaScript. The struct can be safely passed around.
@@ -63,7 +64,8 @@ class XWalkExtensionFunctionInfo {
 // Helper for handling JavaScript method calls in the native side. Allows you to
 // register a handler for a function with a given signature. This class takes an
 // XWalkExtensionInstance in the constructor and should never outlive this
-// instance.
+// instance. The serialized messages of the instance are handled by it, see
+// XWalkExtensionInstance::HandleSerializedMessage().
 class XWalkExtensionFunctionHandler {
  public:
   typedef base::Callback<void(
@@ -76,6 +78,11 @@ class XWalkExtensionFunctionHandler {
   // data structure and invokes HandleFunction().
   void HandleMessage(scoped_ptr<base::Value> msg);
 
+  // Same as HandleMessage() for messages read from the IPC message. The
+  // function name and callback id are read in place, and base::Values are
+  // only created for the arguments of registered functions.
+  void HandleSerializedMessage(const XWalkSerializedValue& msg);
+
   // Executes the handler associated to the |name| tag of the |info| argument
   // passed as parameter.
   bool HandleFunction(scoped_ptr<XWalkExtensionFunctionInfo> info);
@@ -4,10 +4,15 @@
 
 #include "xwalk/extensions/browser/xwalk_extension_function_handler.h"
 
+#include "base/pickle.h"
 #include "testing/gtest/include/gtest/gtest.h"
+#include "xwalk/extensions/common/xwalk_extension.h"
+#include "xwalk/extensions/common/xwalk_serialized_value.h"
 
 using xwalk::extensions::XWalkExtensionFunctionHandler;
 using xwalk::extensions::XWalkExtensionFunctionInfo;
+using xwalk::extensions::XWalkExtensionInstance;
+using xwalk::extensions::XWalkSerializedValue;
 
 namespace {
 
@@ -39,6 +44,26 @@ void ResetCounter(int* counter, scoped_ptr<XWalkExtensionFunctionInfo> info) {
   *counter = 0;
 }
 
+// Counts the messages that don't go through a function handler.
+class TestInstance : public XWalkExtensionInstance {
+ public:
+  TestInstance() : handle_message_count_(0) {}
+
+  virtual void HandleMessage(scoped_ptr<base::Value> msg) OVERRIDE {
+    handle_message_count_++;
+  }
+
+  int handle_message_count() const { return handle_message_count_; }
+
+ private:
+  int handle_message_count_;
+};
+
+void ReadSerializedValue(const Pickle& pickle, XWalkSerializedValue* value) {
+  PickleIterator iter(pickle);
+  ASSERT_TRUE(XWalkSerializedValue::Read(&iter, value));
+}
+
 }  // namespace
 
 TEST(XWalkExtensionFunctionHandlerTest, PostResult) {
@@ -123,3 +148,75 @@ TEST(XWalkExtensionFunctionHandlerTest, PostingResultAfterDeletingTheHandler) {
   info->PostResult(make_scoped_ptr(new base::ListValue));
   delete info;
 }
+
+TEST(XWalkExtensionFunctionHandlerTest, HandleSerializedMessage) {
+  XWalkExtensionFunctionHandler handler(NULL);
+
+  XWalkExtensionFunctionInfo* info = NULL;
+  handler.Register("storeFunctionInfo", base::Bind(&StoreFunctionInfo, &info));
+
+  base::ListValue arguments;
+  arguments.AppendInteger(1);
+  base::DictionaryValue* dictionary = new base::DictionaryValue;
+  dictionary->SetString("data", kTestString);
+  arguments.Append(dictionary);
+
+  base::ListValue msg;
+  msg.AppendString("storeFunctionInfo");  // Function name.
+  msg.AppendString("id");  // Callback ID.
+  msg.AppendInteger(1);
+  msg.Append(dictionary->DeepCopy());
+
+  Pickle pickle;
+  XWalkSerializedValue::Write(msg, &pickle);
+  PickleIterator iter(pickle);
+  XWalkSerializedValue value;
+  ASSERT_TRUE(XWalkSerializedValue::Read(&iter, &value));
+
+  handler.HandleSerializedMessage(value);
+  ASSERT_TRUE(info);
+  EXPECT_EQ("storeFunctionInfo", info->name());
+  EXPECT_TRUE(arguments.Equals(info->arguments()));
+  delete info;
+
+  // Messages for functions that are not registered are dropped.
+  info = NULL;
+  msg.Set(0, new base::StringValue("foobar"));
+  Pickle unknown_pickle;
+  XWalkSerializedValue::Write(msg, &unknown_pickle);
+  PickleIterator unknown_iter(unknown_pickle);
+  ASSERT_TRUE(XWalkSerializedValue::Read(&unknown_iter, &value));
+  handler.HandleSerializedMessage(value);
+  EXPECT_FALSE(info);
+}
+
+TEST(XWalkExtensionFunctionHandlerTest, InstanceForwardsSerializedMessages) {
+  TestInstance instance;
+  scoped_ptr<XWalkExtensionFunctionHandler> handler(
+      new XWalkExtensionFunctionHandler(&instance));
+
+  XWalkExtensionFunctionInfo* info = NULL;
+  handler->Register("storeFunctionInfo",
+                    base::Bind(&StoreFunctionInfo, &info));
+
+  base::ListValue msg;
+  msg.AppendString("storeFunctionInfo");  // Function name.
+  msg.AppendString("id");  // Callback ID.
+  Pickle pickle;
+  XWalkSerializedValue::Write(msg, &pickle);
+  XWalkSerializedValue value;
+  ReadSerializedValue(pickle, &value);
+
+  instance.HandleSerializedMessage(value);
+  ASSERT_TRUE(info);
+  EXPECT_EQ("storeFunctionInfo", info->name());
+  EXPECT_EQ(0, instance.handle_message_count());
+  delete info;
+
+  // Without the handler, the message is converted for HandleMessage().
+  info = NULL;
+  handler.reset();
+  instance.HandleSerializedMessage(value);
+  EXPECT_FALSE(info);
+  EXPECT_EQ(1, instance.handle_message_count());
+}
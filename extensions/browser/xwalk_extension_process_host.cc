@@ -4,14 +4,22 @@
 
 #include "xwalk/extensions/browser/xwalk_extension_process_host.h"
 
+#include <algorithm>
 #include <string>
+#include <vector>
 
+#include "base/atomic_sequence_num.h"
 #include "base/command_line.h"
+#include "base/debug/trace_event.h"
 #include "base/logging.h"
 #include "base/files/file_path.h"
+#include "base/metrics/histogram.h"
+#include "base/process/process_metrics.h"
+#include "base/stl_util.h"
 #include "content/public/browser/browser_child_process_host.h"
 #include "content/public/browser/browser_thread.h"
 #include "content/public/browser/render_process_host.h"
+#include "content/public/browser/child_process_data.h"
 #include "content/public/common/child_process_host.h"
 #include "content/public/common/process_type.h"
 #include "content/public/common/content_switches.h"
@@ -28,30 +36,61 @@ using content::BrowserThread;
 namespace xwalk {
 namespace extensions {
 
+namespace {
+
+base::StaticAtomicSequenceNumber g_next_extension_process_host_id;
+
+void DeleteExtensionProcessHost(base::WeakPtr<XWalkExtensionProcessHost> eph) {
+  delete eph.get();
+}
+
+}  // namespace
+
 // This filter is used by ExtensionProcessHost to intercept when Render Process
 // ask for the Extension Channel handle (that is created by extension process).
 class XWalkExtensionProcessHost::RenderProcessMessageFilter
     : public IPC::ChannelProxy::MessageFilter {
  public:
-  explicit RenderProcessMessageFilter(XWalkExtensionProcessHost* eph)
-      : eph_(eph) {}
+  RenderProcessMessageFilter(base::WeakPtr<XWalkExtensionProcessHost> eph,
+                             content::RenderProcessHost* render_process_host)
+      : eph_(eph),
+        render_process_host_(render_process_host),
+        render_process_id_(render_process_host->GetID()),
+        is_valid_(true),
+        sender_(NULL) {}
 
   // This exists to fulfill the requirement for delayed reply handling, since it
   // needs to send a message back if the parameters couldn't be correctly read
   // from the original message received. See DispatchDealyReplyWithSendParams().
   bool Send(IPC::Message* message) {
-    if (eph_)
-      return eph_->render_process_host_->Send(message);
+    if (is_valid_)
+      return render_process_host_->Send(message);
     delete message;
     return false;
   }
 
   void Invalidate() {
-    eph_ = NULL;
+    is_valid_ = false;
   }
 
  private:
   // IPC::ChannelProxy::MessageFilter implementation.
+  virtual void OnFilterAdded(IPC::Channel* channel) OVERRIDE {
+    sender_ = channel;
+  }
+
+  virtual void OnFilterRemoved() OVERRIDE {
+    sender_ = NULL;
+  }
+
+  virtual void OnChannelClosing() OVERRIDE {
+    sender_ = NULL;
+  }
+
+  virtual void OnChannelError() OVERRIDE {
+    sender_ = NULL;
+  }
+
   virtual bool OnMessageReceived(const IPC::Message& message) OVERRIDE {
     bool handled = true;
     IPC_BEGIN_MESSAGE_MAP(RenderProcessMessageFilter, message)
@@ -65,13 +104,31 @@ class XWalkExtensionProcessHost::RenderProcessMessageFilter
 
   void OnGetExtensionProcessChannel(IPC::Message* reply) {
     scoped_ptr<IPC::Message> scoped_reply(reply);
-    if (eph_)
-      eph_->OnGetExtensionProcessChannel(scoped_reply.Pass());
+    if (is_valid_ && eph_ &&
+        eph_->HasRenderProcess(render_process_id_)) {
+      eph_->OnGetExtensionProcessChannel(render_process_id_,
+                                         scoped_reply.Pass());
+      return;
+    }
+
+    // The render process is blocked until it gets a reply, it goes on
+    // without the external extensions when the handle is empty.
+    XWalkExtensionProcessHostMsg_GetExtensionProcessChannel::WriteReplyParams(
+        scoped_reply.get(), IPC::ChannelHandle());
+    if (sender_)
+      sender_->Send(scoped_reply.release());
   }
 
   virtual ~RenderProcessMessageFilter() {}
 
-  XWalkExtensionProcessHost* eph_;
+  base::WeakPtr<XWalkExtensionProcessHost> eph_;
+  content::RenderProcessHost* render_process_host_;
+  int render_process_id_;
+  bool is_valid_;
+
+  // The channel of the render process, that is still used to reply after
+  // the filter is invalidated.
+  IPC::Sender* sender_;
 };
 
 #if defined(OS_WIN)
@@ -90,17 +147,26 @@ class ExtensionSandboxedProcessLauncherDelegate
 };
 #endif
 
+XWalkExtensionProcessHost::RenderProcessData::RenderProcessData()
+    : render_process_host(NULL),
+      channel_handle(""),
+      is_channel_ready(false),
+      is_channel_sent(false) {}
+
+XWalkExtensionProcessHost::RenderProcessData::~RenderProcessData() {}
+
 XWalkExtensionProcessHost::XWalkExtensionProcessHost(
-    content::RenderProcessHost* render_process_host,
     const base::FilePath& external_extensions_path,
+    const XWalkExternalExtensionsFilter& filter,
+    bool is_shared,
     XWalkExtensionProcessHost::Delegate* delegate)
-    : ep_rp_channel_handle_(""),
-      render_process_host_(render_process_host),
-      render_process_message_filter_(new RenderProcessMessageFilter(this)),
-      external_extensions_path_(external_extensions_path),
-      is_extension_process_channel_ready_(false),
-      delegate_(delegate) {
-  render_process_host_->GetChannel()->AddFilter(render_process_message_filter_);
+    : external_extensions_path_(external_extensions_path),
+      filter_(filter),
+      id_(g_next_extension_process_host_id.GetNext() + 1),
+      is_shared_(is_shared),
+      is_ready_(false),
+      delegate_(delegate),
+      weak_factory_(this) {
   BrowserThread::PostTask(BrowserThread::IO, FROM_HERE,
       base::Bind(&XWalkExtensionProcessHost::StartProcess,
       base::Unretained(this)));
@@ -108,14 +174,56 @@ XWalkExtensionProcessHost::XWalkExtensionProcessHost(
 
 XWalkExtensionProcessHost::~XWalkExtensionProcessHost() {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
-  render_process_message_filter_->Invalidate();
+  RenderProcessMap::iterator it = render_processes_.begin();
+  for (; it != render_processes_.end(); ++it)
+    it->second->filter->Invalidate();
+  STLDeleteValues(&render_processes_);
   StopProcess();
 }
 
+base::WeakPtr<XWalkExtensionProcessHost>
+XWalkExtensionProcessHost::GetWeakPtr() {
+  return weak_factory_.GetWeakPtr();
+}
+
+// static
+void XWalkExtensionProcessHost::DeleteSoon(
+    base::WeakPtr<XWalkExtensionProcessHost> eph) {
+  BrowserThread::PostTask(BrowserThread::IO, FROM_HERE,
+      base::Bind(&DeleteExtensionProcessHost, eph));
+}
+
+// static
+void XWalkExtensionProcessHost::AddRenderProcess(
+    base::WeakPtr<XWalkExtensionProcessHost> eph,
+    content::RenderProcessHost* render_process_host) {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::UI));
+  scoped_refptr<RenderProcessMessageFilter> filter(
+      new RenderProcessMessageFilter(eph, render_process_host));
+
+  // The filter is added to the channel in the IO thread, so this task runs
+  // before it can receive any message.
+  BrowserThread::PostTask(BrowserThread::IO, FROM_HERE,
+      base::Bind(&XWalkExtensionProcessHost::OnRenderProcessAdded, eph,
+                 render_process_host, filter));
+  render_process_host->GetChannel()->AddFilter(filter);
+}
+
+// static
+void XWalkExtensionProcessHost::RemoveRenderProcess(
+    base::WeakPtr<XWalkExtensionProcessHost> eph, int render_process_id) {
+  BrowserThread::PostTask(BrowserThread::IO, FROM_HERE,
+      base::Bind(&XWalkExtensionProcessHost::OnRenderProcessRemoved, eph,
+                 render_process_id));
+}
+
 void XWalkExtensionProcessHost::StartProcess() {
   CHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
   CHECK(!process_);
 
+  start_time_ = base::TimeTicks::Now();
+  TRACE_EVENT_ASYNC_BEGIN1("xwalk", "XWalkExtensionProcessHost::Startup", id_,
+                           "shared", is_shared_);
   process_.reset(content::BrowserChildProcessHost::Create(
       content::PROCESS_TYPE_CONTENT_END, this));
 
@@ -128,6 +236,13 @@ void XWalkExtensionProcessHost::StartProcess() {
   cmd_line->AppendSwitchASCII(switches::kProcessType,
                               switches::kXWalkExtensionProcess);
   cmd_line->AppendSwitchASCII(switches::kProcessChannelID, channel_id);
+
+  static const char* const kForwardSwitches[] = {
+    switches::kXWalkRecordExtensionMessages,
+  };
+  cmd_line->CopySwitchesFrom(*CommandLine::ForCurrentProcess(),
+                             kForwardSwitches, arraysize(kForwardSwitches));
+
   process_->Launch(
 #if defined(OS_WIN)
       new ExtensionSandboxedProcessLauncherDelegate(),
@@ -137,7 +252,11 @@ void XWalkExtensionProcessHost::StartProcess() {
     cmd_line.release());
 
   process_->GetHost()->Send(new XWalkExtensionProcessMsg_RegisterExtensions(
-      external_extensions_path_));
+      external_extensions_path_,
+      std::vector<std::string>(filter_.libraries.begin(),
+                               filter_.libraries.end()),
+      std::vector<std::string>(filter_.permissions.begin(),
+                               filter_.permissions.end())));
 }
 
 void XWalkExtensionProcessHost::StopProcess() {
@@ -145,15 +264,83 @@ void XWalkExtensionProcessHost::StopProcess() {
   process_.reset();
 }
 
+void XWalkExtensionProcessHost::OnRenderProcessAdded(
+    content::RenderProcessHost* render_process_host,
+    scoped_refptr<RenderProcessMessageFilter> filter) {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
+  const int render_process_id = render_process_host->GetID();
+  DCHECK(is_shared_ || render_processes_.empty());
+  if (ContainsKey(render_processes_, render_process_id)) {
+    filter->Invalidate();
+    return;
+  }
+
+  RenderProcessData* data = new RenderProcessData;
+  data->render_process_host = render_process_host;
+  data->filter = filter;
+  data->added_time = base::TimeTicks::Now();
+  render_processes_[render_process_id] = data;
+
+  // Sent before any navigation reaches the render process, so extensions are
+  // available to the first script context if the extension process is warm.
+  if (extensions_)
+    SendExtensionsToRenderProcess(data);
+
+  TRACE_EVENT_ASYNC_BEGIN2("xwalk", "XWalkExtensionProcessHost::Channel",
+                           render_process_id, "extension_process", id_,
+                           "warm", is_ready_);
+
+  process_->GetHost()->Send(
+      new XWalkExtensionProcessMsg_CreateRenderProcessChannel(
+          render_process_id));
+}
+
+void XWalkExtensionProcessHost::OnRenderProcessRemoved(
+    int render_process_id) {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
+  RenderProcessMap::iterator it = render_processes_.find(render_process_id);
+  if (it == render_processes_.end())
+    return;
+
+  it->second->filter->Invalidate();
+  delete it->second;
+  render_processes_.erase(it);
+
+  process_->GetHost()->Send(
+      new XWalkExtensionProcessMsg_CloseRenderProcessChannel(
+          render_process_id));
+}
+
+bool XWalkExtensionProcessHost::HasRenderProcess(
+    int render_process_id) const {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
+  return ContainsKey(render_processes_, render_process_id);
+}
+
 void XWalkExtensionProcessHost::OnGetExtensionProcessChannel(
-    scoped_ptr<IPC::Message> reply) {
-  pending_reply_for_render_process_ = reply.Pass();
-  ReplyChannelHandleToRenderProcess();
+    int render_process_id, scoped_ptr<IPC::Message> reply) {
+  RenderProcessMap::iterator it = render_processes_.find(render_process_id);
+  DCHECK(it != render_processes_.end());
+
+  RenderProcessData* data = it->second;
+  if (data->is_channel_sent) {
+    // The render process will get the channel from the message already sent,
+    // which is dispatched while it waits for this reply.
+    XWalkExtensionProcessHostMsg_GetExtensionProcessChannel::WriteReplyParams(
+        reply.get(), IPC::ChannelHandle());
+    data->filter->Send(reply.release());
+    return;
+  }
+
+  data->pending_reply = reply.Pass();
+  ReplyChannelHandleToRenderProcess(data);
 }
 
 bool XWalkExtensionProcessHost::OnMessageReceived(const IPC::Message& message) {
   bool handled = true;
   IPC_BEGIN_MESSAGE_MAP(XWalkExtensionProcessHost, message)
+    IPC_MESSAGE_HANDLER(XWalkExtensionProcessHostMsg_ExtensionsRegistered,
+                        OnExtensionsRegistered)
     IPC_MESSAGE_HANDLER(
         XWalkExtensionProcessHostMsg_RenderProcessChannelCreated,
         OnRenderChannelCreated)
@@ -172,39 +359,128 @@ void XWalkExtensionProcessHost::OnChannelError() {
   // most likely have a pointer to us that needs to be invalidated.
 
   VLOG(1) << "\n\nExtensionProcess crashed";
+
+  std::vector<int> render_process_ids;
+  RenderProcessMap::iterator it = render_processes_.begin();
+  for (; it != render_processes_.end(); ++it)
+    render_process_ids.push_back(it->first);
+
   if (delegate_)
-    delegate_->OnExtensionProcessDied(this, render_process_host_->GetID());
+    delegate_->OnExtensionProcessDied(this, render_process_ids);
 }
 
 void XWalkExtensionProcessHost::OnProcessLaunched() {
-  VLOG(1) << "\n\nExtensionProcess was started!";
+  VLOG(1) << "\n\nExtensionProcess was started in "
+          << (base::TimeTicks::Now() - start_time_).InMillisecondsF() << "ms!";
+}
+
+void XWalkExtensionProcessHost::OnExtensionsRegistered(
+    const std::vector<XWalkExtensionServerMsg_ExtensionRegisterParams>&
+        extensions) {
+  is_ready_ = true;
+  extensions_.reset(
+      new std::vector<XWalkExtensionServerMsg_ExtensionRegisterParams>(
+          extensions));
+
+  RenderProcessMap::iterator it = render_processes_.begin();
+  for (; it != render_processes_.end(); ++it)
+    SendExtensionsToRenderProcess(it->second);
+
+  TRACE_EVENT_ASYNC_END0("xwalk", "XWalkExtensionProcessHost::Startup", id_);
+  VLOG(1) << "Extension process ready in "
+          << (base::TimeTicks::Now() - start_time_).InMillisecondsF()
+          << "ms.";
 }
 
 void XWalkExtensionProcessHost::OnRenderChannelCreated(
-    const IPC::ChannelHandle& handle) {
-  is_extension_process_channel_ready_ = true;
-  ep_rp_channel_handle_ = handle;
-  ReplyChannelHandleToRenderProcess();
-}
-
-void XWalkExtensionProcessHost::ReplyChannelHandleToRenderProcess() {
-  // Replying the channel handle to RP depends on two events:
-  // - EP already notified EPH that new channel was created (for RP<->EP).
-  // - RP already asked for the channel handle.
-  //
-  // The order for this events is not determined, so we call this function from
-  // both, and the second execution will send the reply.
-  if (!is_extension_process_channel_ready_
-      || !pending_reply_for_render_process_)
+    int render_process_id, const IPC::ChannelHandle& handle) {
+  RenderProcessMap::iterator it = render_processes_.find(render_process_id);
+  if (it == render_processes_.end())
     return;
 
-  XWalkExtensionProcessHostMsg_GetExtensionProcessChannel::WriteReplyParams(
-      pending_reply_for_render_process_.get(), ep_rp_channel_handle_);
+  RenderProcessData* data = it->second;
+  data->is_channel_ready = true;
+  data->channel_handle = handle;
+  ReplyChannelHandleToRenderProcess(data);
 
-  render_process_host_->Send(pending_reply_for_render_process_.release());
+  LogProcessMetrics();
 }
 
+void XWalkExtensionProcessHost::SendExtensionsToRenderProcess(
+    RenderProcessData* data) {
+  DCHECK(extensions_);
+  // Like the channel, the extensions are needed by RP if it is blocked
+  // waiting for the channel before creating a script context.
+  IPC::Message* message = new XWalkExtensionMsg_ExternalExtensions(
+      *extensions_);
+  message->set_unblock(true);
+  data->filter->Send(message);
+}
+
+void XWalkExtensionProcessHost::ReplyChannelHandleToRenderProcess(
+    RenderProcessData* data) {
+  // The channel handle is sent once EP notifies EPH that the new channel was
+  // created (for RP<->EP). If RP is blocked asking for it, it goes in the
+  // reply, otherwise in its own message.
+  if (!data->is_channel_ready || data->is_channel_sent)
+    return;
+
+  if (data->pending_reply) {
+    XWalkExtensionProcessHostMsg_GetExtensionProcessChannel::WriteReplyParams(
+        data->pending_reply.get(), data->channel_handle);
+    data->filter->Send(data->pending_reply.release());
+  } else {
+    // RP may ask for the channel while this message is in flight, so it has
+    // to be dispatched even if RP is blocked in that synchronous request.
+    IPC::Message* message =
+        new XWalkExtensionMsg_ExtensionProcessChannelCreated(
+            data->channel_handle);
+    message->set_unblock(true);
+    data->filter->Send(message);
+  }
+  data->is_channel_sent = true;
+
+  const int render_process_id = data->render_process_host->GetID();
+  TRACE_EVENT_ASYNC_END0("xwalk", "XWalkExtensionProcessHost::Channel",
+                         render_process_id);
+  VLOG(1) << "Render process " << render_process_id
+          << " got its extension process channel in "
+          << (base::TimeTicks::Now() - data->added_time).InMillisecondsF()
+          << "ms.";
+}
+
+// Memory used by the extension process and the number of render processes
+// served, to compare a shared extension process with one extension process
+// per render process. The histograms are recorded each time a render process
+// gets its channel.
+void XWalkExtensionProcessHost::LogProcessMetrics() {
+  size_t working_set_size = 0;
+#if !defined(OS_MACOSX)
+  scoped_ptr<base::ProcessMetrics> metrics(
+      base::ProcessMetrics::CreateProcessMetrics(process_->GetData().handle));
+  working_set_size = metrics->GetWorkingSetSize();
+#endif
+
+  const size_t render_processes = std::max(render_processes_.size(),
+                                           static_cast<size_t>(1));
+  const int per_render_process_kb =
+      static_cast<int>(working_set_size / 1024 / render_processes);
+  if (is_shared_) {
+    UMA_HISTOGRAM_MEMORY_KB(
+        "XWalk.Extensions.SharedProcessMemoryPerRenderProcess",
+        per_render_process_kb);
+    UMA_HISTOGRAM_COUNTS_100("XWalk.Extensions.SharedProcessRenderProcesses",
+                             render_processes_.size());
+  } else {
+    UMA_HISTOGRAM_MEMORY_KB("XWalk.Extensions.ProcessMemoryPerRenderProcess",
+                            per_render_process_kb);
+  }
+
+  VLOG(1) << (is_shared_ ? "Shared extension process" : "Extension process")
+          << " serving " << render_processes_.size()
+          << " render process(es) uses " << working_set_size / 1024
+          << "KB (" << per_render_process_kb << "KB per render process).";
+}
 
 }  // namespace extensions
 }  // namespace xwalk
-
@@ -5,12 +5,19 @@
 #ifndef XWALK_EXTENSIONS_BROWSER_XWALK_EXTENSION_PROCESS_HOST_H_
 #define XWALK_EXTENSIONS_BROWSER_XWALK_EXTENSION_PROCESS_HOST_H_
 
+#include <map>
+#include <vector>
 #include "base/files/file_path.h"
 #include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
+#include "base/memory/weak_ptr.h"
+#include "base/time/time.h"
 #include "content/public/browser/browser_child_process_host_delegate.h"
 #include "ipc/ipc_channel_handle.h"
 #include "ipc/ipc_channel_proxy.h"
+#include "xwalk/extensions/common/xwalk_extension_server.h"
+
+struct XWalkExtensionServerMsg_ExtensionRegisterParams;
 
 namespace content {
 class BrowserChildProcessHost;
@@ -23,32 +30,91 @@ namespace extensions {
 // This class represents the browser side of the browser <-> extension process
 // communication channel. It has to run some operations in IO thread for
 // creating the extra process.
+//
+// An extension process can serve a single render process, or be shared by
+// several of them. In both cases each render process gets its own channel to
+// the extension process.
+//
+// Render processes don't block waiting for the extension process: the list of
+// extensions and the channel are sent to them as soon as they are available.
+// A render process only asks synchronously for the channel when JS code needs
+// an extension before the channel arrived.
 class XWalkExtensionProcessHost
     : public content::BrowserChildProcessHostDelegate {
  public:
   class Delegate {
    public:
+    // Called in the IO thread, just before |eph| is deleted, with the ids of
+    // the render processes it was serving.
     virtual void OnExtensionProcessDied(XWalkExtensionProcessHost* eph,
-      int render_process_id) {}
+      const std::vector<int>& render_process_ids) {}
 
    protected:
     ~Delegate() {}
   };
 
-  XWalkExtensionProcessHost(content::RenderProcessHost* render_process_host,
-                            const base::FilePath& external_extensions_path,
+  // The process is launched and the extensions loaded right away, so a host
+  // can be created before it is needed and kept warm.
+  XWalkExtensionProcessHost(const base::FilePath& external_extensions_path,
+                            const XWalkExternalExtensionsFilter& filter,
+                            bool is_shared,
                             XWalkExtensionProcessHost::Delegate* delegate);
   virtual ~XWalkExtensionProcessHost();
 
+  // The extension process may die and delete its host in the IO thread at
+  // any time, so the UI thread refers to it with a weak pointer and id().
+  // Should be called in the UI thread right after construction.
+  base::WeakPtr<XWalkExtensionProcessHost> GetWeakPtr();
+
+  // Deletes the host in the IO thread, if still alive.
+  static void DeleteSoon(base::WeakPtr<XWalkExtensionProcessHost> eph);
+
+  // Attach and detach a render process from the extension process. Called in
+  // the UI thread, the work is done in the IO thread if |eph| is still alive.
+  static void AddRenderProcess(base::WeakPtr<XWalkExtensionProcessHost> eph,
+                               content::RenderProcessHost* render_process_host);
+  static void RemoveRenderProcess(base::WeakPtr<XWalkExtensionProcessHost> eph,
+                                  int render_process_id);
+
+  // Unique id for this host, can be used from any thread.
+  int id() const { return id_; }
+  bool is_shared() const { return is_shared_; }
+
  private:
   class RenderProcessMessageFilter;
 
+  // Channel between a render process and the extension process.
+  struct RenderProcessData {
+    RenderProcessData();
+    ~RenderProcessData();
+
+    content::RenderProcessHost* render_process_host;
+    scoped_refptr<RenderProcessMessageFilter> filter;
+    IPC::ChannelHandle channel_handle;
+    bool is_channel_ready;
+    // The channel handle can be sent only once, either as a reply to a
+    // pending synchronous request or in its own message.
+    bool is_channel_sent;
+    scoped_ptr<IPC::Message> pending_reply;
+    base::TimeTicks added_time;
+  };
+
   void StartProcess();
   void StopProcess();
 
+  void OnRenderProcessAdded(content::RenderProcessHost* render_process_host,
+                            scoped_refptr<RenderProcessMessageFilter> filter);
+  void OnRenderProcessRemoved(int render_process_id);
+
+  // Tells if |render_process_id| is served, its filter replies itself to the
+  // requests of a render process that isn't.
+  bool HasRenderProcess(int render_process_id) const;
+
   // Handler for message from Render Process host, it is a synchronous message,
-  // that will be replied only when the extension process channel is created.
-  void OnGetExtensionProcessChannel(scoped_ptr<IPC::Message> reply);
+  // that will be replied only when the extension process channel is created,
+  // or right away if it was already sent.
+  void OnGetExtensionProcessChannel(int render_process_id,
+                                    scoped_ptr<IPC::Message> reply);
 
   // content::BrowserChildProcessHostDelegate implementation.
   virtual bool OnMessageReceived(const IPC::Message& message) OVERRIDE;
@@ -56,28 +122,46 @@ class XWalkExtensionProcessHost
   virtual void OnProcessLaunched() OVERRIDE;
 
   // Message Handlers.
-  void OnRenderChannelCreated(const IPC::ChannelHandle& channel_id);
+  void OnExtensionsRegistered(
+      const std::vector<XWalkExtensionServerMsg_ExtensionRegisterParams>&
+          extensions);
+  void OnRenderChannelCreated(int render_process_id,
+                              const IPC::ChannelHandle& channel_id);
+
+  void SendExtensionsToRenderProcess(RenderProcessData* data);
+  void ReplyChannelHandleToRenderProcess(RenderProcessData* data);
 
-  void ReplyChannelHandleToRenderProcess();
+  void LogProcessMetrics();
 
   scoped_ptr<content::BrowserChildProcessHost> process_;
-  IPC::ChannelHandle ep_rp_channel_handle_;
-  content::RenderProcessHost* render_process_host_;
-  scoped_ptr<IPC::Message> pending_reply_for_render_process_;
 
-  // We use this filter to know when RP asked for the extension process channel.
-  // We keep the reference to invalidate the filter once we don't need it
-  // anymore.
+  // We use a filter per render process to know when it asked for the
+  // extension process channel.
   //
   // TODO(cmarcelo): Avoid having an extra filter, see if we can embed this
   // handling in the existing filter we have in ExtensionData struct.
-  scoped_refptr<RenderProcessMessageFilter> render_process_message_filter_;
+  typedef std::map<int, RenderProcessData*> RenderProcessMap;
+  RenderProcessMap render_processes_;
 
   base::FilePath external_extensions_path_;
+  XWalkExternalExtensionsFilter filter_;
 
-  bool is_extension_process_channel_ready_;
+  int id_;
+  bool is_shared_;
+
+  // Used to compare launch time and memory usage between a shared extension
+  // process and one extension process per render process, and the time
+  // saved by having the process ready before a render process needs it.
+  base::TimeTicks start_time_;
+  bool is_ready_;
+
+  // Extensions loaded by the extension process, available once it is ready.
+  scoped_ptr<std::vector<XWalkExtensionServerMsg_ExtensionRegisterParams> >
+      extensions_;
 
   XWalkExtensionProcessHost::Delegate* delegate_;
+
+  base::WeakPtrFactory<XWalkExtensionProcessHost> weak_factory_;
 };
 
 }  // namespace extensions
@@ -8,16 +8,19 @@
 #include <vector>
 #include "base/callback.h"
 #include "base/command_line.h"
-#include "base/pickle.h"
 #include "base/scoped_native_library.h"
+#include "base/stl_util.h"
 #include "base/synchronization/lock.h"
+#include "content/public/browser/browser_context.h"
 #include "content/public/browser/browser_thread.h"
 #include "content/public/browser/notification_types.h"
 #include "content/public/browser/notification_service.h"
 #include "content/public/browser/render_process_host.h"
 #include "ipc/ipc_message_macros.h"
+#include "xwalk/extensions/browser/xwalk_extension_code_cache_store.h"
 #include "xwalk/extensions/browser/xwalk_extension_data.h"
 #include "xwalk/extensions/browser/xwalk_extension_process_host.h"
+#include "xwalk/extensions/browser/xwalk_extension_thread_pool.h"
 #include "xwalk/extensions/common/xwalk_extension.h"
 #include "xwalk/extensions/common/xwalk_extension_messages.h"
 #include "xwalk/extensions/common/xwalk_extension_server.h"
@@ -38,23 +41,30 @@ XWalkExtensionService::CreateExtensionsCallback
 
 base::FilePath g_external_extensions_path_for_testing_;
 
+// After crashing this many times, the shared extension process is not used
+// anymore and each render process gets its own extension process, so a
+// crashing extension takes down only the render process using it.
+const int kMaxSharedExtensionProcessCrashes = 3;
+
 }  // namespace
 
 // This object intercepts messages destined to a XWalkExtensionServer and
 // dispatch them to its task runner. A message loop proxy of a thread is a
 // task runner. Like other filters, this filter will run in the IO-thread.
 //
-// In the case of in process extensions, we will pass the task runner of the
-// extension thread.
+// In the case of in process extensions, each instance of the extension
+// thread server gets a task runner from the thread pool when it is created,
+// and all its messages are dispatched there. Messages for instances that
+// don't exist, or not anymore, are dropped.
 class ExtensionServerMessageFilter : public IPC::ChannelProxy::MessageFilter,
                                      public IPC::Sender {
  public:
   ExtensionServerMessageFilter(
-      scoped_refptr<base::SequencedTaskRunner> task_runner,
+      XWalkExtensionThreadPool* thread_pool,
       XWalkExtensionServer* extension_thread_server,
       XWalkExtensionServer* ui_thread_server)
       : sender_(NULL),
-        task_runner_(task_runner),
+        thread_pool_(thread_pool),
         extension_thread_server_(extension_thread_server),
         ui_thread_server_(ui_thread_server) {}
 
@@ -62,7 +72,7 @@ class ExtensionServerMessageFilter : public IPC::ChannelProxy::MessageFilter,
   void Invalidate() {
     base::AutoLock l(lock_);
     sender_ = NULL;
-    task_runner_ = NULL;
+    thread_pool_ = NULL;
     extension_thread_server_ = NULL;
     ui_thread_server_ = NULL;
   }
@@ -80,60 +90,50 @@ class ExtensionServerMessageFilter : public IPC::ChannelProxy::MessageFilter,
  private:
   virtual ~ExtensionServerMessageFilter() {}
 
-  int64_t GetInstanceIDFromMessage(const IPC::Message& message) {
-    PickleIterator iter;
-
-    if (message.is_sync())
-      iter = IPC::SyncMessage::GetDataIterator(&message);
-    else
-      iter = PickleIterator(message);
-
-    int64_t instance_id;
-    if (!iter.ReadInt64(&instance_id))
-      return -1;
-
-    return instance_id;
-  }
-
   void RouteMessageToServer(const IPC::Message& message) {
-    int64_t id = GetInstanceIDFromMessage(message);
+    int64_t id = -1;
+    XWalkExtensionServer::ReadInstanceID(message, &id);
     DCHECK_NE(id, -1);
 
-    XWalkExtensionServer* server;
-    base::TaskRunner* task_runner;
-    scoped_refptr<base::TaskRunner> task_runner_ref;
-
-    if (ContainsKey(extension_thread_instances_ids_, id)) {
-      server = extension_thread_server_;
-      task_runner = task_runner_;
-    } else {
+    XWalkExtensionServer* server = extension_thread_server_;
+    scoped_refptr<base::TaskRunner> task_runner =
+        extension_thread_server_->GetTaskRunnerForInstance(id);
+
+    if (!task_runner) {
+      if (!ContainsKey(ui_thread_instances_, id)) {
+        DLOG(WARNING) << "Dropping message for unknown extension instance "
+                      << id;
+        return;
+      }
+      if (message.type() == XWalkExtensionServerMsg_DestroyInstance::ID)
+        ui_thread_instances_.erase(id);
       server = ui_thread_server_;
-      task_runner_ref =
+      task_runner =
           BrowserThread::GetMessageLoopProxyForThread(BrowserThread::UI);
-      task_runner = task_runner_ref.get();
     }
 
+    server->OnMessageQueued(message);
     base::Closure closure = base::Bind(
-        base::IgnoreResult(&XWalkExtensionServer::OnMessageReceived),
-        base::Unretained(server), message);
+        &XWalkExtensionServer::OnQueuedMessageReceived,
+        base::Unretained(server), message, base::TimeTicks::Now());
 
     task_runner->PostTask(FROM_HERE, closure);
   }
 
   void OnCreateInstance(int64_t instance_id, std::string name) {
     XWalkExtensionServer* server;
-    base::TaskRunner* task_runner;
-    scoped_refptr<base::TaskRunner> task_runner_ref;
+    scoped_refptr<base::SequencedTaskRunner> task_runner;
 
     if (extension_thread_server_->ContainsExtension(name)) {
-      extension_thread_instances_ids_.insert(instance_id);
       server = extension_thread_server_;
-      task_runner = task_runner_;
+      task_runner = thread_pool_->GetTaskRunnerForInstance(
+          server->GetThreadAffinity(name));
+      server->SetTaskRunnerForInstance(instance_id, task_runner);
     } else {
       server = ui_thread_server_;
-      task_runner_ref =
+      task_runner =
           BrowserThread::GetMessageLoopProxyForThread(BrowserThread::UI);
-      task_runner = task_runner_ref.get();
+      ui_thread_instances_.insert(instance_id);
     }
 
     base::Closure closure = base::Bind(
@@ -194,22 +194,28 @@ class ExtensionServerMessageFilter : public IPC::ChannelProxy::MessageFilter,
   base::Lock lock_;
 
   IPC::Sender* sender_;
-  scoped_refptr<base::SequencedTaskRunner> task_runner_;
+  XWalkExtensionThreadPool* thread_pool_;
   XWalkExtensionServer* extension_thread_server_;
   XWalkExtensionServer* ui_thread_server_;
-  std::set<int64_t> extension_thread_instances_ids_;
+
+  // The extension thread server keeps the task runners of its instances, the
+  // instances of the UI thread server are known from here.
+  std::set<int64_t> ui_thread_instances_;
 };
 
 XWalkExtensionService::XWalkExtensionService()
-    : extension_thread_("XWalkExtensionThread") {
+    : thread_pool_(new XWalkExtensionThreadPool(
+          XWalkExtensionThreadPool::GetDefaultSize())),
+      shared_extension_process_host_id_(0),
+      shared_extension_process_crashes_(0),
+      warm_extension_process_host_id_(0),
+      warm_extension_process_enabled_(!CommandLine::ForCurrentProcess()->
+          HasSwitch(switches::kXWalkDisableWarmExtensionProcess)),
+      weak_factory_(this) {
   if (!g_external_extensions_path_for_testing_.empty())
     external_extensions_path_ = g_external_extensions_path_for_testing_;
   registrar_.Add(this, content::NOTIFICATION_RENDERER_PROCESS_TERMINATED,
                  content::NotificationService::AllBrowserContextsAndSources());
-
-  // IO main loop is needed by extensions watching file descriptors events.
-  base::Thread::Options options(base::MessageLoop::TYPE_IO, 0);
-  extension_thread_.StartWithOptions(options);
 }
 
 XWalkExtensionService::~XWalkExtensionService() {
@@ -217,15 +223,22 @@ XWalkExtensionService::~XWalkExtensionService() {
   // extension thread.
   if (!extension_data_map_.empty())
     VLOG(1) << "The ExtensionData map is not empty!";
+
+  if (shared_extension_process_host_id_)
+    XWalkExtensionProcessHost::DeleteSoon(shared_extension_process_host_);
+  if (warm_extension_process_host_id_)
+    XWalkExtensionProcessHost::DeleteSoon(warm_extension_process_host_);
 }
 
 void XWalkExtensionService::RegisterExternalExtensionsForPath(
     const base::FilePath& path) {
   external_extensions_path_ = path;
+  RestartWarmExtensionProcess();
 }
 
 void XWalkExtensionService::OnRenderProcessHostCreated(
     content::RenderProcessHost* host,
+    const XWalkExternalExtensionsFilter& filter,
     XWalkExtensionVector* ui_thread_extensions,
     XWalkExtensionVector* extension_thread_extensions) {
   CHECK(host);
@@ -238,14 +251,48 @@ void XWalkExtensionService::OnRenderProcessHostCreated(
 
   CommandLine* cmd_line = CommandLine::ForCurrentProcess();
   if (!cmd_line->HasSwitch(switches::kXWalkDisableExtensionProcess))
-    CreateExtensionProcessHost(host, data);
+    CreateExtensionProcessHost(host, data, filter);
   else if (!external_extensions_path_.empty()) {
     RegisterExternalExtensionsInDirectory(
         data->in_process_ui_thread_server(),
-        external_extensions_path_);
+        external_extensions_path_,
+        filter);
   }
 
   extension_data_map_[host->GetID()] = data;
+
+  SetupCodeCache(host);
+}
+
+void XWalkExtensionService::SetupCodeCache(content::RenderProcessHost* host) {
+  if (!code_cache_store_) {
+    code_cache_store_ = new XWalkExtensionCodeCacheStore(
+        host->GetBrowserContext()->GetPath().Append(
+            FILE_PATH_LITERAL("ExtensionCodeCache")),
+        external_extensions_path_);
+    code_cache_store_->Load(
+        base::Bind(&XWalkExtensionService::OnCodeCacheLoaded,
+                   weak_factory_.GetWeakPtr()));
+  }
+
+  host->GetChannel()->AddFilter(code_cache_store_->CreateMessageFilter());
+
+  // Otherwise the data is sent once it is loaded.
+  if (code_cache_store_->is_loaded())
+    SendCodeCache(host);
+}
+
+void XWalkExtensionService::OnCodeCacheLoaded() {
+  RenderProcessToExtensionDataMap::iterator it = extension_data_map_.begin();
+  for (; it != extension_data_map_.end(); ++it)
+    SendCodeCache(it->second->render_process_host());
+}
+
+void XWalkExtensionService::SendCodeCache(content::RenderProcessHost* host) {
+  if (code_cache_store_->entries().empty())
+    return;
+  host->Send(new XWalkExtensionMsg_CodeCacheData(
+      code_cache_store_->entries()));
 }
 
 // static
@@ -306,6 +353,11 @@ void XWalkExtensionService::OnRenderProcessHostClosed(
   // This will cause the filter to be deleted in the IO-thread.
   host->GetChannel()->RemoveFilter(message_filter);
 
+  if (shared_extension_process_host_id_) {
+    XWalkExtensionProcessHost::RemoveRenderProcess(
+        shared_extension_process_host_, host->GetID());
+  }
+
   extension_data_map_.erase(it);
   delete data;
 }
@@ -340,6 +392,8 @@ void XWalkExtensionService::CreateInProcessExtensionServers(
   IPC::ChannelProxy* channel = host->GetChannel();
 
   extension_thread_server->Initialize(channel);
+  extension_thread_server->set_task_runner(
+      thread_pool_->GetDefaultTaskRunner());
   ui_thread_server->Initialize(channel);
 
   RegisterExtensionsIntoServer(extension_thread_extensions,
@@ -359,7 +413,7 @@ void XWalkExtensionService::CreateInProcessExtensionServers(
   }
 
   ExtensionServerMessageFilter* message_filter =
-      new ExtensionServerMessageFilter(extension_thread_.message_loop_proxy(),
+      new ExtensionServerMessageFilter(thread_pool_.get(),
                                        extension_thread_server.get(),
                                        ui_thread_server.get());
 
@@ -370,44 +424,167 @@ void XWalkExtensionService::CreateInProcessExtensionServers(
 
   data->set_in_process_extension_thread_server(extension_thread_server.Pass());
   data->set_in_process_ui_thread_server(ui_thread_server.Pass());
+}
 
-  data->set_extension_thread(&extension_thread_);
+bool XWalkExtensionService::UseSharedExtensionProcess() const {
+  return CommandLine::ForCurrentProcess()->HasSwitch(
+      switches::kXWalkSharedExtensionProcess)
+      && shared_extension_process_crashes_ < kMaxSharedExtensionProcessCrashes;
 }
 
 void XWalkExtensionService::CreateExtensionProcessHost(
-    content::RenderProcessHost* host, XWalkExtensionData* data) {
-  data->set_extension_process_host(make_scoped_ptr(
-      new XWalkExtensionProcessHost(host, external_extensions_path_, this)));
+    content::RenderProcessHost* host, XWalkExtensionData* data,
+    const XWalkExternalExtensionsFilter& filter) {
+  if (UseSharedExtensionProcess()) {
+    StartSharedExtensionProcess(filter);
+    // The render processes of applications asking for other extensions get
+    // their own extension process.
+    if (filter.Equals(shared_extension_process_filter_)) {
+      XWalkExtensionProcessHost::AddRenderProcess(
+          shared_extension_process_host_, host);
+      data->set_shared_extension_process_host_id(
+          shared_extension_process_host_id_);
+      return;
+    }
+  }
+
+  // Use the warm extension process if there is one with the same filter, it
+  // was launched and loaded the extensions in advance.
+  if (warm_extension_process_host_id_ &&
+      filter.Equals(warm_extension_process_filter_)) {
+    XWalkExtensionProcessHost::AddRenderProcess(
+        warm_extension_process_host_, host);
+    data->set_extension_process_host(warm_extension_process_host_,
+                                     warm_extension_process_host_id_);
+    warm_extension_process_host_.reset();
+    warm_extension_process_host_id_ = 0;
+  } else {
+    XWalkExtensionProcessHost* eph = new XWalkExtensionProcessHost(
+        external_extensions_path_, filter, false, this);
+    XWalkExtensionProcessHost::AddRenderProcess(eph->GetWeakPtr(), host);
+    data->set_extension_process_host(eph->GetWeakPtr(), eph->id());
+  }
+
+  // Start another one for the next render process once this one is set up.
+  BrowserThread::PostTask(BrowserThread::UI, FROM_HERE,
+      base::Bind(&XWalkExtensionService::StartWarmExtensionProcess,
+                 weak_factory_.GetWeakPtr(), filter));
+}
+
+void XWalkExtensionService::StartSharedExtensionProcess(
+    const XWalkExternalExtensionsFilter& filter) {
+  if (shared_extension_process_host_id_)
+    return;
+
+  // Owned by itself, deleted in the IO thread when the process dies or when
+  // this service is destroyed.
+  XWalkExtensionProcessHost* eph = new XWalkExtensionProcessHost(
+      external_extensions_path_, filter, true, this);
+  shared_extension_process_host_ = eph->GetWeakPtr();
+  shared_extension_process_host_id_ = eph->id();
+  shared_extension_process_filter_ = filter;
+}
+
+// Keeps an extension process launched with the extensions loaded, so the next
+// render process doesn't need to wait for it.
+void XWalkExtensionService::StartWarmExtensionProcess(
+    const XWalkExternalExtensionsFilter& filter) {
+  if (!warm_extension_process_enabled_ ||
+      CommandLine::ForCurrentProcess()->HasSwitch(
+          switches::kXWalkDisableExtensionProcess))
+    return;
+
+  // The shared extension process is reused, so starting it is enough.
+  if (UseSharedExtensionProcess() && (!shared_extension_process_host_id_ ||
+      filter.Equals(shared_extension_process_filter_))) {
+    StartSharedExtensionProcess(filter);
+    return;
+  }
+
+  if (warm_extension_process_host_id_) {
+    if (filter.Equals(warm_extension_process_filter_))
+      return;
+    XWalkExtensionProcessHost::DeleteSoon(warm_extension_process_host_);
+    warm_extension_process_host_id_ = 0;
+  }
+
+  XWalkExtensionProcessHost* eph = new XWalkExtensionProcessHost(
+      external_extensions_path_, filter, false, this);
+  warm_extension_process_host_ = eph->GetWeakPtr();
+  warm_extension_process_host_id_ = eph->id();
+  warm_extension_process_filter_ = filter;
+}
+
+// A warm extension process, or a shared one not serving any render process
+// yet, loaded the extensions with the previous settings.
+void XWalkExtensionService::RestartWarmExtensionProcess() {
+  if (warm_extension_process_host_id_) {
+    XWalkExtensionProcessHost::DeleteSoon(warm_extension_process_host_);
+    warm_extension_process_host_id_ = 0;
+  }
+  if (shared_extension_process_host_id_ && extension_data_map_.empty()) {
+    XWalkExtensionProcessHost::DeleteSoon(shared_extension_process_host_);
+    shared_extension_process_host_id_ = 0;
+  }
+  StartWarmExtensionProcess(warm_extension_process_filter_);
 }
 
 void XWalkExtensionService::OnExtensionProcessDied(
-    XWalkExtensionProcessHost* eph, int render_process_id) {
+    XWalkExtensionProcessHost* eph,
+    const std::vector<int>& render_process_ids) {
   // When this is called it means that XWalkExtensionProcessHost is about
-  // to be deleted. We should invalidate our reference to it so we avoid a
-  // segfault when trying to delete it within
-  // XWalkExtensionService::OnRenderProcessHostClosed();
-
-  RenderProcessToExtensionDataMap::iterator it =
-      extension_data_map_.find(render_process_id);
+  // to be deleted, the weak pointers to it are invalidated.
+  BrowserThread::PostTask(BrowserThread::UI, FROM_HERE,
+      base::Bind(&XWalkExtensionService::OnExtensionProcessHostDied,
+                 base::Unretained(this), eph->id(), render_process_ids));
+}
 
-  if (it == extension_data_map_.end())
+// The render processes can't reconnect to a new extension process, so all
+// of them are shut down. Render processes created later get a new shared
+// extension process, unless it crashed too many times already.
+void XWalkExtensionService::OnExtensionProcessHostDied(
+    int eph_id, const std::vector<int>& render_process_ids) {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::UI));
+
+  if (eph_id == warm_extension_process_host_id_) {
+    // Don't keep launching a process that dies before being used.
+    LOG(WARNING) << "Warm extension process died, not keeping one anymore.";
+    warm_extension_process_host_.reset();
+    warm_extension_process_host_id_ = 0;
+    warm_extension_process_enabled_ = false;
     return;
+  }
 
-  XWalkExtensionData* data = it->second;
+  if (eph_id == shared_extension_process_host_id_) {
+    shared_extension_process_host_.reset();
+    shared_extension_process_host_id_ = 0;
+    shared_extension_process_crashes_++;
 
-  XWalkExtensionProcessHost* stored_eph =
-      data->extension_process_host().release();
-  CHECK_EQ(stored_eph, eph);
+    LOG(WARNING) << "Shared extension process died, shutting down "
+                 << render_process_ids.size() << " render process(es).";
+    if (!UseSharedExtensionProcess()) {
+      LOG(WARNING) << "Using one extension process per render process after "
+                   << shared_extension_process_crashes_ << " crashes.";
+    }
+  }
 
-  content::RenderProcessHost* rph = data->render_process_host();
-  if (rph) {
-    BrowserThread::PostTask(BrowserThread::UI, FROM_HERE, base::Bind(
-        base::IgnoreResult(&content::RenderProcessHost::FastShutdownIfPossible),
-        base::Unretained(rph)));
+  // A render process may not be in |render_process_ids| if the extension
+  // process died before the render process was added to it.
+  std::set<int> ids(render_process_ids.begin(), render_process_ids.end());
+  RenderProcessToExtensionDataMap::iterator it = extension_data_map_.begin();
+  for (; it != extension_data_map_.end(); ++it) {
+    if (it->second->extension_process_host_id() == eph_id)
+      ids.insert(it->first);
   }
 
-  extension_data_map_.erase(it);
-  delete data;
+  for (std::set<int>::iterator id = ids.begin(); id != ids.end(); ++id) {
+    it = extension_data_map_.find(*id);
+    if (it == extension_data_map_.end())
+      continue;
+    content::RenderProcessHost* rph = it->second->render_process_host();
+    if (rph)
+      rph->FastShutdownIfPossible();
+  }
 }
 
 void XWalkExtensionService::OnRenderProcessDied(
@@ -420,9 +597,35 @@ void XWalkExtensionService::OnRenderProcessDied(
 
   XWalkExtensionData* data = it->second;
 
+  if (shared_extension_process_host_id_) {
+    XWalkExtensionProcessHost::RemoveRenderProcess(
+        shared_extension_process_host_, host->GetID());
+  }
+
   extension_data_map_.erase(it);
   delete data;
 }
 
+scoped_ptr<base::DictionaryValue> XWalkExtensionService::GetMessagingStats(
+    int render_process_id) {
+  scoped_ptr<base::DictionaryValue> stats(new base::DictionaryValue);
+  RenderProcessToExtensionDataMap::iterator it =
+      extension_data_map_.find(render_process_id);
+  if (it == extension_data_map_.end())
+    return stats.Pass();
+
+  // Each extension is registered in only one of the servers.
+  XWalkExtensionData* data = it->second;
+  if (data->in_process_ui_thread_server()) {
+    stats->MergeDictionary(
+        data->in_process_ui_thread_server()->GetMessagingStats().get());
+  }
+  if (data->in_process_extension_thread_server()) {
+    stats->MergeDictionary(
+        data->in_process_extension_thread_server()->GetMessagingStats().get());
+  }
+  return stats.Pass();
+}
+
 }  // namespace extensions
 }  // namespace xwalk
@@ -12,11 +12,13 @@
 #include "base/callback_forward.h"
 #include "base/containers/scoped_ptr_hash_map.h"
 #include "base/files/file_path.h"
+#include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
-#include "base/threading/thread.h"
+#include "base/memory/weak_ptr.h"
 #include "content/public/browser/notification_observer.h"
 #include "content/public/browser/notification_registrar.h"
 #include "xwalk/extensions/browser/xwalk_extension_process_host.h"
+#include "xwalk/extensions/common/xwalk_extension_server.h"
 #include "xwalk/extensions/common/xwalk_extension_vector.h"
 
 namespace content {
@@ -28,7 +30,9 @@ namespace xwalk {
 namespace extensions {
 
 class XWalkExtension;
+class XWalkExtensionCodeCacheStore;
 class XWalkExtensionData;
+class XWalkExtensionThreadPool;
 
 // This is the entry point for Crosswalk extensions. Its responsible for keeping
 // track of the extensions, and enable them on WebContents once they are
@@ -48,8 +52,14 @@ class XWalkExtensionService : public content::NotificationObserver,
   // The vectors contain the extensions to be used for this render process,
   // ownership of these extensions is taken by the XWalkExtensionService. The
   // vectors will be empty after the call.
+  //
+  // |filter| restricts the external extensions of this render process, e.g.
+  // to the ones the application it runs asked for in its manifest
+  // permissions. Extension processes are only shared by, or launched in
+  // advance for, render processes with the same filter.
   void OnRenderProcessHostCreated(
       content::RenderProcessHost* host,
+      const XWalkExternalExtensionsFilter& filter,
       XWalkExtensionVector* ui_thread_extensions,
       XWalkExtensionVector* extension_thread_extensions);
 
@@ -58,6 +68,12 @@ class XWalkExtensionService : public content::NotificationObserver,
   // XWalkContentBrowserClient::RenderProcessHostGone().
   void OnRenderProcessDied(content::RenderProcessHost* host);
 
+  // Returns the messaging counters of the in process extensions used by the
+  // given render process, see XWalkExtensionServer::GetMessagingStats().
+  // External extensions count their messages in the extension process, and
+  // are not included.
+  scoped_ptr<base::DictionaryValue> GetMessagingStats(int render_process_id);
+
   typedef base::Callback<void(XWalkExtensionVector* extensions)>
       CreateExtensionsCallback;
 
@@ -71,7 +87,10 @@ class XWalkExtensionService : public content::NotificationObserver,
  private:
   // XWalkExtensionProcessHost::Delegate implementation.
   virtual void OnExtensionProcessDied(XWalkExtensionProcessHost* eph,
-      int render_process_id) OVERRIDE;
+      const std::vector<int>& render_process_ids) OVERRIDE;
+
+  void OnExtensionProcessHostDied(int eph_id,
+                                  const std::vector<int>& render_process_ids);
 
   // NotificationObserver implementation.
   virtual void Observe(int type, const content::NotificationSource& source,
@@ -85,12 +104,21 @@ class XWalkExtensionService : public content::NotificationObserver,
       XWalkExtensionVector* ui_thread_extensions,
       XWalkExtensionVector* extension_thread_extensions);
 
+  bool UseSharedExtensionProcess() const;
   void CreateExtensionProcessHost(content::RenderProcessHost* host,
-      XWalkExtensionData* data);
+      XWalkExtensionData* data, const XWalkExternalExtensionsFilter& filter);
+  void StartSharedExtensionProcess(
+      const XWalkExternalExtensionsFilter& filter);
+  void StartWarmExtensionProcess(const XWalkExternalExtensionsFilter& filter);
+  void RestartWarmExtensionProcess();
 
-  // The server that handles in process extensions will live in the
-  // extension_thread_.
-  base::Thread extension_thread_;
+  void SetupCodeCache(content::RenderProcessHost* host);
+  void OnCodeCacheLoaded();
+  void SendCodeCache(content::RenderProcessHost* host);
+
+  // The instances of in process extensions registered for the extension
+  // thread run in this pool.
+  scoped_ptr<XWalkExtensionThreadPool> thread_pool_;
 
   content::NotificationRegistrar registrar_;
 
@@ -99,6 +127,28 @@ class XWalkExtensionService : public content::NotificationObserver,
   typedef std::map<int, XWalkExtensionData*> RenderProcessToExtensionDataMap;
   RenderProcessToExtensionDataMap extension_data_map_;
 
+  // With --shared-extension-process, a single extension process serves all
+  // render processes. The hosts live in the IO thread, so the weak pointers
+  // can't be checked here, the ids are zero when there is no host. See
+  // XWalkExtensionProcessHost::GetWeakPtr().
+  base::WeakPtr<XWalkExtensionProcessHost> shared_extension_process_host_;
+  int shared_extension_process_host_id_;
+  int shared_extension_process_crashes_;
+  XWalkExternalExtensionsFilter shared_extension_process_filter_;
+
+  // Extension process launched in advance for the next render process.
+  base::WeakPtr<XWalkExtensionProcessHost> warm_extension_process_host_;
+  int warm_extension_process_host_id_;
+  bool warm_extension_process_enabled_;
+  // The filter of the last render process, the next one likely has the same.
+  XWalkExternalExtensionsFilter warm_extension_process_filter_;
+
+  // Created with the first render process, since it lives in the browser
+  // context path.
+  scoped_refptr<XWalkExtensionCodeCacheStore> code_cache_store_;
+
+  base::WeakPtrFactory<XWalkExtensionService> weak_factory_;
+
   DISALLOW_COPY_AND_ASSIGN(XWalkExtensionService);
 };
 
@@ -0,0 +1,210 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/extensions/browser/xwalk_extension_thread_pool.h"
+
+#include <algorithm>
+#include "base/basictypes.h"
+#include "base/command_line.h"
+#include "base/memory/scoped_vector.h"
+#include "base/message_loop/message_loop.h"
+#include "base/message_loop/message_loop_proxy.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/stringprintf.h"
+#include "base/synchronization/lock.h"
+#include "base/sys_info.h"
+#include "base/threading/sequenced_worker_pool.h"
+#include "base/threading/thread.h"
+#include "content/public/browser/browser_thread.h"
+#include "xwalk/extensions/common/xwalk_extension_switches.h"
+
+using content::BrowserThread;
+
+namespace xwalk {
+namespace extensions {
+
+namespace {
+
+const size_t kMinPoolSize = 2;
+const size_t kMaxPoolSize = 8;
+
+// IO main loop is needed by extensions watching file descriptors events.
+scoped_ptr<base::Thread> StartIOThread(const std::string& name) {
+  scoped_ptr<base::Thread> thread(new base::Thread(name));
+  thread->StartWithOptions(
+      base::Thread::Options(base::MessageLoop::TYPE_IO, 0));
+  return thread.Pass();
+}
+
+}  // namespace
+
+// The IO threads not used by any instance, shared with the task runners that
+// give their thread back when released, possibly after the pool is gone.
+class XWalkExtensionThreadPool::IOThreadList
+    : public base::RefCountedThreadSafe<IOThreadList> {
+ public:
+  IOThreadList(size_t max_idle_threads,
+               scoped_refptr<base::SequencedTaskRunner> reaper)
+      : max_idle_threads_(max_idle_threads),
+        reaper_(reaper),
+        next_thread_id_(0),
+        is_shut_down_(false) {}
+
+  scoped_ptr<base::Thread> Take() {
+    int thread_id;
+    {
+      base::AutoLock l(lock_);
+      if (!idle_threads_.empty()) {
+        base::Thread* thread = idle_threads_.back();
+        idle_threads_.weak_erase(idle_threads_.end() - 1);
+        return make_scoped_ptr(thread);
+      }
+      thread_id = next_thread_id_++;
+    }
+    return StartIOThread(
+        base::StringPrintf("XWalkExtensionThread%d", thread_id));
+  }
+
+  void Return(scoped_ptr<base::Thread> thread) {
+    bool is_shut_down;
+    {
+      base::AutoLock l(lock_);
+      if (!is_shut_down_ && idle_threads_.size() < max_idle_threads_) {
+        idle_threads_.push_back(thread.release());
+        return;
+      }
+      is_shut_down = is_shut_down_;
+    }
+
+    // A thread can't be stopped from itself, which is where the instance
+    // usually releases it, so it is stopped by the default thread.
+    if (!is_shut_down) {
+      reaper_->DeleteSoon(FROM_HERE, thread.release());
+    } else if (thread->message_loop() != base::MessageLoop::current()) {
+      thread.reset();
+    } else {
+      // Leaked on shutdown, like the threads of the worker pool.
+      ignore_result(thread.release());
+    }
+  }
+
+  // Stops the idle threads, the others are stopped when returned.
+  void ShutDown() {
+    ScopedVector<base::Thread> idle_threads;
+    {
+      base::AutoLock l(lock_);
+      is_shut_down_ = true;
+      idle_threads.swap(idle_threads_);
+    }
+  }
+
+ private:
+  friend class base::RefCountedThreadSafe<IOThreadList>;
+  ~IOThreadList() {}
+
+  const size_t max_idle_threads_;
+  scoped_refptr<base::SequencedTaskRunner> reaper_;
+
+  base::Lock lock_;
+  ScopedVector<base::Thread> idle_threads_;
+  int next_thread_id_;
+  bool is_shut_down_;
+
+  DISALLOW_COPY_AND_ASSIGN(IOThreadList);
+};
+
+// Runs the tasks of a single instance on an IO thread of its own.
+class XWalkExtensionThreadPool::IOThreadTaskRunner
+    : public base::SequencedTaskRunner {
+ public:
+  explicit IOThreadTaskRunner(scoped_refptr<IOThreadList> threads)
+      : threads_(threads),
+        thread_(threads->Take()),
+        message_loop_proxy_(thread_->message_loop_proxy()) {}
+
+  // base::SequencedTaskRunner implementation.
+  virtual bool PostDelayedTask(const tracked_objects::Location& from_here,
+                               const base::Closure& task,
+                               base::TimeDelta delay) OVERRIDE {
+    return message_loop_proxy_->PostDelayedTask(from_here, task, delay);
+  }
+
+  virtual bool PostNonNestableDelayedTask(
+      const tracked_objects::Location& from_here,
+      const base::Closure& task,
+      base::TimeDelta delay) OVERRIDE {
+    return message_loop_proxy_->PostNonNestableDelayedTask(from_here, task,
+                                                           delay);
+  }
+
+  virtual bool RunsTasksOnCurrentThread() const OVERRIDE {
+    return message_loop_proxy_->RunsTasksOnCurrentThread();
+  }
+
+ private:
+  virtual ~IOThreadTaskRunner() {
+    // The tasks already posted still run before the next instance's.
+    threads_->Return(thread_.Pass());
+  }
+
+  scoped_refptr<IOThreadList> threads_;
+  scoped_ptr<base::Thread> thread_;
+  scoped_refptr<base::MessageLoopProxy> message_loop_proxy_;
+
+  DISALLOW_COPY_AND_ASSIGN(IOThreadTaskRunner);
+};
+
+XWalkExtensionThreadPool::XWalkExtensionThreadPool(size_t size) {
+  size = std::max(size, static_cast<size_t>(1));
+
+  default_thread_ = StartIOThread("XWalkExtensionDefaultThread");
+  io_threads_ = new IOThreadList(size, default_thread_->message_loop_proxy());
+  worker_pool_ = new base::SequencedWorkerPool(size, "XWalkExtensionWorker");
+}
+
+XWalkExtensionThreadPool::~XWalkExtensionThreadPool() {
+  worker_pool_->Shutdown();
+  io_threads_->ShutDown();
+  // The default thread is stopped when deleted by the scoped_ptr.
+}
+
+scoped_refptr<base::SequencedTaskRunner>
+XWalkExtensionThreadPool::GetTaskRunnerForInstance(
+    XWalkExtension::ThreadAffinity affinity) {
+  switch (affinity) {
+    case XWalkExtension::THREAD_AFFINITY_UI:
+      return BrowserThread::GetMessageLoopProxyForThread(BrowserThread::UI);
+    case XWalkExtension::THREAD_AFFINITY_ANY:
+      return worker_pool_->GetSequencedTaskRunner(
+          worker_pool_->GetSequenceToken());
+    case XWalkExtension::THREAD_AFFINITY_IO:
+      break;
+  }
+
+  return new IOThreadTaskRunner(io_threads_);
+}
+
+scoped_refptr<base::SequencedTaskRunner>
+XWalkExtensionThreadPool::GetDefaultTaskRunner() {
+  return default_thread_->message_loop_proxy();
+}
+
+// static
+size_t XWalkExtensionThreadPool::GetDefaultSize() {
+  CommandLine* cmd_line = CommandLine::ForCurrentProcess();
+  if (cmd_line->HasSwitch(switches::kXWalkExtensionThreadPoolSize)) {
+    int size;
+    if (base::StringToInt(cmd_line->GetSwitchValueASCII(
+            switches::kXWalkExtensionThreadPoolSize), &size) && size > 0)
+      return size;
+    LOG(WARNING) << "Invalid value for --"
+                 << switches::kXWalkExtensionThreadPoolSize;
+  }
+
+  size_t size = base::SysInfo::NumberOfProcessors();
+  return std::min(std::max(size, kMinPoolSize), kMaxPoolSize);
+}
+
+}  // namespace extensions
+}  // namespace xwalk
@@ -0,0 +1,66 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef XWALK_EXTENSIONS_BROWSER_XWALK_EXTENSION_THREAD_POOL_H_
+#define XWALK_EXTENSIONS_BROWSER_XWALK_EXTENSION_THREAD_POOL_H_
+
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/sequenced_task_runner.h"
+#include "xwalk/extensions/common/xwalk_extension.h"
+
+namespace base {
+class SequencedWorkerPool;
+class Thread;
+}
+
+namespace xwalk {
+namespace extensions {
+
+// Threads where the instances of in-process extensions registered for the
+// extension thread run, instead of a single thread shared by every instance
+// of every render process. Each instance gets a sequence of its own, so a
+// blocking call only delays the instance making it:
+//
+//  - Instances that need an IO message loop get an IO thread to themselves
+//    while they exist. The thread of a destroyed instance is kept for the
+//    next one, up to the pool size.
+//  - The others get a sequence in a worker pool of the pool size, so a
+//    blocking call holds one of its threads until it returns.
+//
+// The size is given by --extension-thread-pool-size. Can be used from any
+// thread.
+class XWalkExtensionThreadPool {
+ public:
+  explicit XWalkExtensionThreadPool(size_t size);
+  ~XWalkExtensionThreadPool();
+
+  // Returns the task runner to be used by a new instance of an extension with
+  // the given thread affinity. An IO thread is given back to the pool when
+  // its task runner is released, i.e. when the instance is gone.
+  scoped_refptr<base::SequencedTaskRunner> GetTaskRunnerForInstance(
+      XWalkExtension::ThreadAffinity affinity);
+
+  // Task runner for work that is not tied to a specific instance, like
+  // deleting a server once all its instances are gone.
+  scoped_refptr<base::SequencedTaskRunner> GetDefaultTaskRunner();
+
+  // Pool size from the command line, or based on the number of processors.
+  static size_t GetDefaultSize();
+
+ private:
+  class IOThreadList;
+  class IOThreadTaskRunner;
+
+  scoped_ptr<base::Thread> default_thread_;
+  scoped_refptr<IOThreadList> io_threads_;
+  scoped_refptr<base::SequencedWorkerPool> worker_pool_;
+
+  DISALLOW_COPY_AND_ASSIGN(XWalkExtensionThreadPool);
+};
+
+}  // namespace extensions
+}  // namespace xwalk
+
+#endif  // XWALK_EXTENSIONS_BROWSER_XWALK_EXTENSION_THREAD_POOL_H_
@@ -5,11 +5,15 @@
 #include "xwalk/extensions/common/xwalk_extension.h"
 
 #include "base/logging.h"
+#include "xwalk/extensions/browser/xwalk_extension_function_handler.h"
+#include "xwalk/extensions/common/xwalk_serialized_value.h"
 
 namespace xwalk {
 namespace extensions {
 
-XWalkExtension::XWalkExtension() {}
+XWalkExtension::XWalkExtension()
+    : message_batching_enabled_(false),
+      thread_affinity_(THREAD_AFFINITY_IO) {}
 
 XWalkExtension::~XWalkExtension() {}
 
@@ -17,7 +21,8 @@ const base::ListValue& XWalkExtension::entry_points() const {
   return entry_points_;
 }
 
-XWalkExtensionInstance::XWalkExtensionInstance() {}
+XWalkExtensionInstance::XWalkExtensionInstance()
+    : function_handler_(NULL) {}
 
 XWalkExtensionInstance::~XWalkExtensionInstance() {}
 
@@ -31,6 +36,26 @@ void XWalkExtensionInstance::SetSendSyncReplyCallback(
   send_sync_reply_ = callback;
 }
 
+void XWalkExtensionInstance::SetPostBinaryMessageCallback(
+    const PostBinaryMessageCallback& callback) {
+  post_binary_message_ = callback;
+}
+
+void XWalkExtensionInstance::HandleSerializedMessage(
+    const XWalkSerializedValue& msg) {
+  if (function_handler_) {
+    function_handler_->HandleSerializedMessage(msg);
+    return;
+  }
+  HandleMessage(msg.ToValue());
+}
+
+void XWalkExtensionInstance::HandleBinaryMessage(const char* data,
+                                                 size_t size) {
+  LOG(WARNING) << "Ignoring binary message sent to extension which doesn't "
+               << "support it.";
+}
+
 void XWalkExtensionInstance::HandleSyncMessage(
     scoped_ptr<base::Value> msg) {
   LOG(FATAL) << "Sending sync message to extension which doesn't support it!";
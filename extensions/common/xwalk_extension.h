@@ -8,6 +8,7 @@
 #include <string>
 #include <vector>
 #include "base/callback.h"
+#include "base/time/time.h"
 #include "base/values.h"
 
 namespace xwalk {
@@ -24,7 +25,9 @@ namespace extensions {
 // XWalkExternalExtension for it's implementation and XW_Extension.h for the C
 // API.
 
+class XWalkExtensionFunctionHandler;
 class XWalkExtensionInstance;
+class XWalkSerializedValue;
 
 // XWalkExtension is a factory class to be implemented by each extension, and
 // used to create extension instance objects. It also holds information valid
@@ -32,6 +35,22 @@ class XWalkExtensionInstance;
 // XWalkExtensionInstance.
 class XWalkExtension {
  public:
+  // Where the instances of an in-process extension registered for the
+  // extension thread run. Each instance is bound to a single sequence, so it
+  // handles its messages in order, but different instances may run in
+  // parallel. Extensions registered for the UI thread or running in the
+  // Extension Process ignore this.
+  enum ThreadAffinity {
+    // Instances must run in the browser UI thread.
+    THREAD_AFFINITY_UI,
+    // Instances run in a thread with an IO message loop, needed to watch file
+    // descriptors or use network sockets. This is the default.
+    THREAD_AFFINITY_IO,
+    // Instances can run in any worker thread, which has no message loop but
+    // is allowed to block, e.g. for storage access.
+    THREAD_AFFINITY_ANY
+  };
+
   virtual ~XWalkExtension();
 
   virtual XWalkExtensionInstance* CreateInstance() = 0;
@@ -44,6 +63,19 @@ class XWalkExtension {
   // objects outside the namespace that is implicitly created using its name.
   virtual const base::ListValue& entry_points() const;
 
+  // Whether the messages exchanged by instances of this extension can be
+  // coalesced, so bursts of messages generated during the same message loop
+  // turn are sent in a single IPC message. Order of messages is preserved.
+  bool message_batching_enabled() const { return message_batching_enabled_; }
+
+  ThreadAffinity thread_affinity() const { return thread_affinity_; }
+
+  // How long the Render Process waits for the reply of a sync message before
+  // throwing an exception in the JS code. Zero means no limit, the default.
+  base::TimeDelta sync_message_timeout() const {
+    return sync_message_timeout_;
+  }
+
  protected:
   XWalkExtension();
   void set_name(const std::string& name) { name_ = name; }
@@ -53,6 +85,15 @@ class XWalkExtension {
   void set_entry_points(const std::vector<std::string>& entry_points) {
     entry_points_.AppendStrings(entry_points);
   }
+  void set_message_batching_enabled(bool enabled) {
+    message_batching_enabled_ = enabled;
+  }
+  void set_thread_affinity(ThreadAffinity affinity) {
+    thread_affinity_ = affinity;
+  }
+  void set_sync_message_timeout(base::TimeDelta timeout) {
+    sync_message_timeout_ = timeout;
+  }
 
  private:
   // Name of extension, used for dispatching messages.
@@ -67,6 +108,12 @@ class XWalkExtension {
   // extra conversions later on.
   base::ListValue entry_points_;
 
+  bool message_batching_enabled_;
+
+  ThreadAffinity thread_affinity_;
+
+  base::TimeDelta sync_message_timeout_;
+
   DISALLOW_COPY_AND_ASSIGN(XWalkExtension);
 };
 
@@ -84,11 +131,26 @@ class XWalkExtensionInstance {
   // process.
   virtual void HandleMessage(scoped_ptr<base::Value> msg) = 0;
 
+  // Messages posted from JavaScript usually arrive here, written directly in
+  // the IPC message (see XWalkSerializedValue), and are only valid during the
+  // call. By default they go to the XWalkExtensionFunctionHandler of the
+  // instance, if it has one, which reads the function name and arguments
+  // without building a base::Value. Otherwise HandleMessage() is called.
+  virtual void HandleSerializedMessage(const XWalkSerializedValue& msg);
+
   // Allow to handle synchronous messages sent from JavaScript code. Renderer
-  // will block until SendSyncReplyToJS() is called with the reply. The reply
-  // can be sent after HandleSyncMessage() function returns.
+  // will block until SendSyncReplyToJS() is called with the reply, or until
+  // the sync message timeout expires. The reply can be sent after
+  // HandleSyncMessage() function returns. Requests sent with
+  // extension.internal.sendRequest() arrive here too, without blocking the
+  // renderer. Either way, the next message only arrives after the reply.
   virtual void HandleSyncMessage(scoped_ptr<base::Value> msg);
 
+  // Allow to handle binary messages sent from JavaScript code, see
+  // XW_Extension_BinaryMessage.h. The |data| is owned by the extension system
+  // and is only valid during the call.
+  virtual void HandleBinaryMessage(const char* data, size_t size);
+
   // Callbacks used by extension instance to communicate back to JS. These are
   // set by the extension system. Callbacks will take the ownership of the
   // message.
@@ -96,8 +158,14 @@ class XWalkExtensionInstance {
   typedef base::Callback<void(scoped_ptr<base::Value> msg)>
       SendSyncReplyCallback;
 
+  // The binary message callback copies the contents before returning, so the
+  // caller keeps the ownership of |data|.
+  typedef base::Callback<void(const char* data, size_t size)>
+      PostBinaryMessageCallback;
+
   void SetPostMessageCallback(const PostMessageCallback& callback);
   void SetSendSyncReplyCallback(const SendSyncReplyCallback& callback);
+  void SetPostBinaryMessageCallback(const PostBinaryMessageCallback& callback);
 
   // Function to be used by extensions Instances to post messages back to
   // JavaScript in the renderer process. This function will take the ownership
@@ -106,6 +174,12 @@ class XWalkExtensionInstance {
     post_message_.Run(msg.Pass());
   }
 
+  // Same as PostMessageToJS() but for binary messages, the JavaScript side
+  // will receive an ArrayBuffer with a copy of |data|.
+  void PostBinaryMessageToJS(const char* data, size_t size) {
+    post_binary_message_.Run(data, size);
+  }
+
  protected:
   XWalkExtensionInstance();
 
@@ -115,8 +189,14 @@ class XWalkExtensionInstance {
   }
 
  private:
+  // Sets |function_handler_| while the handler exists.
+  friend class XWalkExtensionFunctionHandler;
+
   PostMessageCallback post_message_;
   SendSyncReplyCallback send_sync_reply_;
+  PostBinaryMessageCallback post_binary_message_;
+
+  XWalkExtensionFunctionHandler* function_handler_;
 
   DISALLOW_COPY_AND_ASSIGN(XWalkExtensionInstance);
 };
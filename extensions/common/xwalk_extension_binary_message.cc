@@ -0,0 +1,59 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/extensions/common/xwalk_extension_binary_message.h"
+
+#include <string.h>
+#include "base/logging.h"
+#include "base/process/process_handle.h"
+
+namespace xwalk {
+namespace extensions {
+
+namespace {
+
+// Below this size the cost of creating and mapping a shared memory segment
+// is higher than copying the payload into the IPC message.
+const size_t kSharedMemoryThreshold = 64 * 1024;
+
+}  // namespace
+
+bool ShouldUseSharedMemoryForBinaryMessage(size_t size) {
+#if defined(OS_POSIX)
+  return size >= kSharedMemoryThreshold;
+#else
+  return false;
+#endif
+}
+
+bool CopyBinaryMessageToSharedMemory(base::SharedMemory* shared_memory,
+                                     const char* data, size_t size,
+                                     base::SharedMemoryHandle* handle) {
+  DCHECK(shared_memory->memory());
+  memcpy(shared_memory->memory(), data, size);
+
+  // On POSIX the process handle is ignored and the descriptor is just
+  // duplicated, it will be closed by the channel after being sent.
+  return shared_memory->ShareToProcess(
+      base::GetCurrentProcessHandle(), handle);
+}
+
+scoped_ptr<base::SharedMemory> MapBinaryMessageSharedMemory(
+    const base::SharedMemoryHandle& handle, size_t size) {
+  if (!base::SharedMemory::IsHandleValid(handle))
+    return scoped_ptr<base::SharedMemory>();
+
+  scoped_ptr<base::SharedMemory> shared_memory(
+      new base::SharedMemory(handle, true /* read_only */));
+  if (!shared_memory->Map(size)) {
+    LOG(WARNING) << "Couldn't map shared memory for binary message of size "
+                 << size;
+    return scoped_ptr<base::SharedMemory>();
+  }
+
+  return shared_memory.Pass();
+}
+
+}  // namespace extensions
+}  // namespace xwalk
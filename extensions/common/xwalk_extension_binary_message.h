@@ -0,0 +1,41 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef XWALK_EXTENSIONS_COMMON_XWALK_EXTENSION_BINARY_MESSAGE_H_
+#define XWALK_EXTENSIONS_COMMON_XWALK_EXTENSION_BINARY_MESSAGE_H_
+
+#include <stddef.h>
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/shared_memory.h"
+
+namespace xwalk {
+namespace extensions {
+
+// Helpers shared by XWalkExtensionServer and XWalkExtensionClient to move
+// binary messages around. Payloads smaller than the threshold are written
+// inline in the IPC message. Bigger ones are copied once into a shared memory
+// segment and only its handle is sent, so the receiving side can hand the
+// mapped memory to the extension (or to V8) without pickling the contents.
+
+// Returns whether a payload of |size| bytes should use shared memory. Only
+// POSIX platforms use it, since there the descriptor is transferred by the
+// channel itself and doesn't need to be duplicated for a specific process.
+bool ShouldUseSharedMemoryForBinaryMessage(size_t size);
+
+// Copies |size| bytes from |data| into |shared_memory|, that must be mapped
+// and big enough, and fills |handle| with a descriptor that can be sent over
+// IPC. Returns false if the handle couldn't be created.
+bool CopyBinaryMessageToSharedMemory(base::SharedMemory* shared_memory,
+                                     const char* data, size_t size,
+                                     base::SharedMemoryHandle* handle);
+
+// Maps |size| bytes of the shared memory received with a binary message.
+// Returns an empty scoped_ptr if the memory couldn't be mapped.
+scoped_ptr<base::SharedMemory> MapBinaryMessageSharedMemory(
+    const base::SharedMemoryHandle& handle, size_t size);
+
+}  // namespace extensions
+}  // namespace xwalk
+
+#endif  // XWALK_EXTENSIONS_COMMON_XWALK_EXTENSION_BINARY_MESSAGE_H_
@@ -0,0 +1,67 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/extensions/common/xwalk_extension_message_batch.h"
+
+#include "base/logging.h"
+#include "base/values.h"
+
+namespace xwalk {
+namespace extensions {
+
+const size_t kMaxMessageBatchBytes = 64 * 1024;
+
+size_t EstimateMessageSize(const base::Value& value) {
+  // Every value is written with its type tag before the contents.
+  const size_t kTypeSize = sizeof(int);
+
+  switch (value.GetType()) {
+    case base::Value::TYPE_STRING: {
+      const base::StringValue* string_value =
+          static_cast<const base::StringValue*>(&value);
+      return kTypeSize + sizeof(int) + string_value->GetString().size();
+    }
+    case base::Value::TYPE_BINARY: {
+      const base::BinaryValue* binary_value =
+          static_cast<const base::BinaryValue*>(&value);
+      return kTypeSize + sizeof(int) + binary_value->GetSize();
+    }
+    case base::Value::TYPE_LIST: {
+      const base::ListValue* list_value =
+          static_cast<const base::ListValue*>(&value);
+      size_t size = kTypeSize + sizeof(int);
+      for (base::ListValue::const_iterator it = list_value->begin();
+           it != list_value->end(); ++it) {
+        size += EstimateMessageSize(**it);
+      }
+      return size;
+    }
+    case base::Value::TYPE_DICTIONARY: {
+      const base::DictionaryValue* dictionary_value =
+          static_cast<const base::DictionaryValue*>(&value);
+      size_t size = kTypeSize + sizeof(int);
+      for (base::DictionaryValue::Iterator it(*dictionary_value);
+           !it.IsAtEnd(); it.Advance()) {
+        size += sizeof(int) + it.key().size() + EstimateMessageSize(it.value());
+      }
+      return size;
+    }
+    default:
+      return kTypeSize + sizeof(double);
+  }
+}
+
+void LogBatchingStats(const std::string& direction,
+                      const XWalkExtensionBatchingStatsMap& stats) {
+  XWalkExtensionBatchingStatsMap::const_iterator it = stats.begin();
+  for (; it != stats.end(); ++it) {
+    VLOG(1) << "Extension '" << it->first << "' " << direction << ": "
+            << it->second.messages << " messages sent in "
+            << it->second.batches << " IPC messages (batching factor "
+            << it->second.batching_factor() << ").";
+  }
+}
+
+}  // namespace extensions
+}  // namespace xwalk
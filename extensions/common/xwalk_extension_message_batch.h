@@ -0,0 +1,55 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef XWALK_EXTENSIONS_COMMON_XWALK_EXTENSION_MESSAGE_BATCH_H_
+#define XWALK_EXTENSIONS_COMMON_XWALK_EXTENSION_MESSAGE_BATCH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <map>
+#include <string>
+
+namespace base {
+class Value;
+}
+
+namespace xwalk {
+namespace extensions {
+
+// Extensions that opt in for message batching have the messages posted by
+// each instance during one turn of the message loop coalesced in a single IPC
+// message, see XWalkExtensionServer and XWalkExtensionClient. A batch is sent
+// earlier if its contents get bigger than this budget.
+extern const size_t kMaxMessageBatchBytes;
+
+// Returns a rough estimate of how many bytes |value| will take once
+// serialized. Used to enforce the budget above without pickling twice.
+size_t EstimateMessageSize(const base::Value& value);
+
+// Counters used to check how effective batching is for an extension. The
+// batching factor is the average number of messages carried by each IPC
+// message sent.
+struct XWalkExtensionBatchingStats {
+  XWalkExtensionBatchingStats() : messages(0), batches(0) {}
+
+  double batching_factor() const {
+    return batches ? static_cast<double>(messages) / batches : 0.0;
+  }
+
+  uint64_t messages;
+  uint64_t batches;
+};
+
+typedef std::map<std::string, XWalkExtensionBatchingStats>
+    XWalkExtensionBatchingStatsMap;
+
+// Logs the counters in |stats|, |direction| is used to tell which side of
+// the channel they were collected.
+void LogBatchingStats(const std::string& direction,
+                      const XWalkExtensionBatchingStatsMap& stats);
+
+}  // namespace extensions
+}  // namespace xwalk
+
+#endif  // XWALK_EXTENSIONS_COMMON_XWALK_EXTENSION_MESSAGE_BATCH_H_
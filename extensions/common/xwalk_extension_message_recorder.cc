@@ -0,0 +1,248 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/extensions/common/xwalk_extension_message_recorder.h"
+
+#include "base/at_exit.h"
+#include "base/bind.h"
+#include "base/command_line.h"
+#include "base/file_util.h"
+#include "base/json/json_writer.h"
+#include "base/logging.h"
+#include "base/process/process_handle.h"
+#include "base/strings/stringprintf.h"
+#include "base/threading/thread_restrictions.h"
+#include "base/time/time.h"
+#include "base/values.h"
+#include "ipc/ipc_message.h"
+#include "xwalk/extensions/common/xwalk_extension_messages.h"
+#include "xwalk/extensions/common/xwalk_extension_switches.h"
+#include "xwalk/extensions/common/xwalk_serialized_value.h"
+
+namespace xwalk {
+namespace extensions {
+
+namespace {
+
+base::LazyInstance<XWalkExtensionMessageRecorder>::Leaky g_recorder =
+    LAZY_INSTANCE_INITIALIZER;
+
+// The buffered records are written after this delay, or as soon as there is
+// this much of them.
+const int kFlushDelaySeconds = 1;
+const size_t kFlushSize = 64 * 1024;
+
+// The messages are wrapped in a list, see OnPostMessageToNative().
+base::Value* TakeWrappedMessage(base::ListValue* wrapper) {
+  scoped_ptr<base::Value> value;
+  if (!wrapper->Remove(0, &value))
+    return base::Value::CreateNullValue();
+  return value.release();
+}
+
+}  // namespace
+
+// static
+XWalkExtensionMessageRecorder* XWalkExtensionMessageRecorder::GetInstance() {
+  XWalkExtensionMessageRecorder* recorder = g_recorder.Pointer();
+  return recorder->file_ ? recorder : NULL;
+}
+
+XWalkExtensionMessageRecorder::XWalkExtensionMessageRecorder()
+    : file_(NULL),
+      next_server_id_(0),
+      is_flush_scheduled_(false),
+      thread_("XWalkExtensionMessageRecorder") {
+  CommandLine* cmd_line = CommandLine::ForCurrentProcess();
+  if (!cmd_line->HasSwitch(switches::kXWalkRecordExtensionMessages))
+    return;
+
+  base::FilePath path =
+      cmd_line->GetSwitchValuePath(switches::kXWalkRecordExtensionMessages);
+  base::ThreadRestrictions::ScopedAllowIO allow_io;
+  file_ = file_util::OpenFile(path, "a");
+  if (!file_) {
+    LOG(WARNING) << "Can't open " << path.AsUTF8Unsafe()
+                 << " to record extension messages.";
+    return;
+  }
+  // Each batch must reach the file in a single write, so processes sharing
+  // it don't interleave their records.
+  setvbuf(file_, NULL, _IONBF, 0);
+
+  if (!thread_.Start()) {
+    LOG(WARNING) << "Can't start the thread recording extension messages.";
+    file_util::CloseFile(file_);
+    file_ = NULL;
+    return;
+  }
+  base::AtExitManager::RegisterCallback(&FlushAtExit, this);
+}
+
+XWalkExtensionMessageRecorder::~XWalkExtensionMessageRecorder() {
+  if (file_)
+    file_util::CloseFile(file_);
+}
+
+int XWalkExtensionMessageRecorder::RegisterServer() {
+  base::AutoLock l(lock_);
+  return next_server_id_++;
+}
+
+void XWalkExtensionMessageRecorder::InitRecord(
+    int server_id, int64_t instance_id, const std::string& extension_name,
+    const char* type, base::DictionaryValue* record) {
+  record->SetDouble("time", base::Time::Now().ToJsTime());
+  record->SetString("source", base::StringPrintf(
+      "%d.%d", static_cast<int>(base::GetCurrentProcId()), server_id));
+  record->SetString("extension", extension_name);
+  record->SetDouble("instance", static_cast<double>(instance_id));
+  record->SetString("type", type);
+}
+
+void XWalkExtensionMessageRecorder::RecordCreateInstance(
+    int server_id, int64_t instance_id, const std::string& extension_name) {
+  base::DictionaryValue record;
+  InitRecord(server_id, instance_id, extension_name, "create", &record);
+  Write(record);
+}
+
+void XWalkExtensionMessageRecorder::RecordDestroyInstance(
+    int server_id, int64_t instance_id, const std::string& extension_name) {
+  base::DictionaryValue record;
+  InitRecord(server_id, instance_id, extension_name, "destroy", &record);
+  Write(record);
+}
+
+void XWalkExtensionMessageRecorder::RecordMessage(
+    int server_id, int64_t instance_id, const std::string& extension_name,
+    const IPC::Message& message) {
+  base::DictionaryValue record;
+
+  switch (message.type()) {
+    case XWalkExtensionServerMsg_PostMessageToNative::ID: {
+      XWalkExtensionServerMsg_PostMessageToNative::Param param;
+      if (!XWalkExtensionServerMsg_PostMessageToNative::Read(&message, &param))
+        return;
+      InitRecord(server_id, instance_id, extension_name, "post", &record);
+      record.Set("message", TakeWrappedMessage(&param.b));
+      break;
+    }
+    case XWalkExtensionServerMsg_PostMessagesToNative::ID: {
+      // Recorded as separate messages, batching is up to the replayer.
+      XWalkExtensionServerMsg_PostMessagesToNative::Param param;
+      if (!XWalkExtensionServerMsg_PostMessagesToNative::Read(&message,
+                                                              &param))
+        return;
+      while (!param.b.empty()) {
+        base::DictionaryValue batched_record;
+        InitRecord(server_id, instance_id, extension_name, "post",
+                   &batched_record);
+        batched_record.Set("message", TakeWrappedMessage(&param.b));
+        Write(batched_record);
+      }
+      return;
+    }
+    case XWalkExtensionServerMsg_PostSerializedMessageToNative::ID: {
+      PickleIterator iter(message);
+      int64_t id;
+      XWalkSerializedValue value;
+      if (!iter.ReadInt64(&id) || !XWalkSerializedValue::Read(&iter, &value))
+        return;
+      scoped_ptr<base::Value> contents = value.ToValue();
+      if (!contents)
+        return;
+      InitRecord(server_id, instance_id, extension_name, "post", &record);
+      record.Set("message", contents.release());
+      break;
+    }
+    case XWalkExtensionServerMsg_PostBinaryMessageToNative::ID: {
+      XWalkExtensionServerMsg_PostBinaryMessageToNative::Param param;
+      if (!XWalkExtensionServerMsg_PostBinaryMessageToNative::Read(&message,
+                                                                   &param))
+        return;
+      InitRecord(server_id, instance_id, extension_name, "binary", &record);
+      record.SetInteger("size", param.b.size());
+      break;
+    }
+    case XWalkExtensionServerMsg_PostSharedBinaryMessageToNative::ID: {
+      // Reading the handle doesn't take it away from the server, that reads
+      // the message again.
+      XWalkExtensionServerMsg_PostSharedBinaryMessageToNative::Param param;
+      if (!XWalkExtensionServerMsg_PostSharedBinaryMessageToNative::Read(
+              &message, &param))
+        return;
+      InitRecord(server_id, instance_id, extension_name, "binary", &record);
+      record.SetInteger("size", param.c);
+      break;
+    }
+    case XWalkExtensionServerMsg_SendSyncMessageToNative::ID: {
+      XWalkExtensionServerMsg_SendSyncMessageToNative::SendParam param;
+      if (!XWalkExtensionServerMsg_SendSyncMessageToNative::ReadSendParam(
+              &message, &param))
+        return;
+      InitRecord(server_id, instance_id, extension_name, "sync", &record);
+      record.Set("message", TakeWrappedMessage(&param.b));
+      break;
+    }
+    case XWalkExtensionServerMsg_SendRequestToNative::ID: {
+      XWalkExtensionServerMsg_SendRequestToNative::Param param;
+      if (!XWalkExtensionServerMsg_SendRequestToNative::Read(&message, &param))
+        return;
+      InitRecord(server_id, instance_id, extension_name, "request", &record);
+      record.Set("message", TakeWrappedMessage(&param.c));
+      break;
+    }
+    default:
+      return;
+  }
+
+  Write(record);
+}
+
+void XWalkExtensionMessageRecorder::Write(
+    const base::DictionaryValue& record) {
+  std::string line;
+  base::JSONWriter::Write(&record, &line);
+  line += '\n';
+
+  base::AutoLock l(lock_);
+  const bool was_below_flush_size = pending_records_.size() < kFlushSize;
+  pending_records_ += line;
+  if (was_below_flush_size && pending_records_.size() >= kFlushSize) {
+    thread_.message_loop_proxy()->PostTask(
+        FROM_HERE, base::Bind(&XWalkExtensionMessageRecorder::Flush,
+                              base::Unretained(this)));
+  } else if (!is_flush_scheduled_) {
+    thread_.message_loop_proxy()->PostDelayedTask(
+        FROM_HERE, base::Bind(&XWalkExtensionMessageRecorder::Flush,
+                              base::Unretained(this)),
+        base::TimeDelta::FromSeconds(kFlushDelaySeconds));
+    is_flush_scheduled_ = true;
+  }
+}
+
+void XWalkExtensionMessageRecorder::Flush() {
+  base::AutoLock file_lock(file_lock_);
+  std::string records;
+  {
+    base::AutoLock l(lock_);
+    records.swap(pending_records_);
+    is_flush_scheduled_ = false;
+  }
+  if (records.empty())
+    return;
+
+  base::ThreadRestrictions::ScopedAllowIO allow_io;
+  if (fwrite(records.data(), 1, records.size(), file_) != records.size())
+    LOG(WARNING) << "Failed to record extension messages.";
+}
+
+// static
+void XWalkExtensionMessageRecorder::FlushAtExit(void* recorder) {
+  static_cast<XWalkExtensionMessageRecorder*>(recorder)->Flush();
+}
+
+}  // namespace extensions
+}  // namespace xwalk
@@ -0,0 +1,95 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef XWALK_EXTENSIONS_COMMON_XWALK_EXTENSION_MESSAGE_RECORDER_H_
+#define XWALK_EXTENSIONS_COMMON_XWALK_EXTENSION_MESSAGE_RECORDER_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include "base/lazy_instance.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/thread.h"
+
+namespace base {
+class DictionaryValue;
+}
+
+namespace IPC {
+class Message;
+}
+
+namespace xwalk {
+namespace extensions {
+
+// Appends the messages received by XWalkExtensionServers to the file given by
+// --record-extension-messages, so they can be replayed later without a
+// browser, see xesh --replay.
+//
+// Each line of the file is a JSON dictionary with:
+//   "time": milliseconds since the epoch;
+//   "source": identifies the server, instance ids are only unique in it;
+//   "extension", "instance";
+//   "type": one of "create", "destroy", "post", "binary", "sync", "request";
+//   "message": the contents, except for binary messages that only have their
+//   "size", since they are replayed with zeros.
+//
+// Every process with servers writes to the same file. The records are
+// buffered, so the threads of the servers don't wait for the disk, and
+// written in batches of whole lines, with a single write each, by a thread of
+// the recorder. What is left is written when the process exits normally.
+class XWalkExtensionMessageRecorder {
+ public:
+  // Returns NULL if messages are not being recorded.
+  static XWalkExtensionMessageRecorder* GetInstance();
+
+  // Returns the id to be passed by a new server to the functions below.
+  int RegisterServer();
+
+  void RecordCreateInstance(int server_id, int64_t instance_id,
+                            const std::string& extension_name);
+  void RecordDestroyInstance(int server_id, int64_t instance_id,
+                             const std::string& extension_name);
+
+  // Records the contents of |message|, one of the messages to native with
+  // the instance id first, see XWalkExtensionServer::ReadInstanceID().
+  void RecordMessage(int server_id, int64_t instance_id,
+                     const std::string& extension_name,
+                     const IPC::Message& message);
+
+ private:
+  friend struct base::DefaultLazyInstanceTraits<XWalkExtensionMessageRecorder>;
+
+  XWalkExtensionMessageRecorder();
+  ~XWalkExtensionMessageRecorder();
+
+  // Fills the fields common to every record.
+  void InitRecord(int server_id, int64_t instance_id,
+                  const std::string& extension_name, const char* type,
+                  base::DictionaryValue* record);
+  void Write(const base::DictionaryValue& record);
+
+  // Writes the buffered records, on |thread_| or at exit.
+  void Flush();
+  static void FlushAtExit(void* recorder);
+
+  base::Lock lock_;
+  FILE* file_;
+  int next_server_id_;
+
+  // Guarded by |lock_|.
+  std::string pending_records_;
+  bool is_flush_scheduled_;
+
+  // Keeps batches from different threads in order.
+  base::Lock file_lock_;
+  base::Thread thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(XWalkExtensionMessageRecorder);
+};
+
+}  // namespace extensions
+}  // namespace xwalk
+
+#endif  // XWALK_EXTENSIONS_COMMON_XWALK_EXTENSION_MESSAGE_RECORDER_H_
@@ -3,8 +3,10 @@
 // found in the LICENSE file.
 
 #include <stdint.h>
+#include <map>
 #include <string>
 #include <vector>
+#include "base/memory/shared_memory.h"
 #include "base/values.h"
 #include "ipc/ipc_channel_handle.h"
 #include "ipc/ipc_message_macros.h"
@@ -24,32 +26,81 @@ enum {
 
 #define IPC_MESSAGE_START XWalkExtensionMsgStart
 
-IPC_MESSAGE_CONTROL1(XWalkExtensionProcessMsg_RegisterExtensions,  // NOLINT(*)
-                     base::FilePath /* extensions path */)
+// Used by both message classes, so the Browser Process can forward the
+// extensions loaded by the Extension Process to the Render Processes.
+IPC_STRUCT_BEGIN(XWalkExtensionServerMsg_ExtensionRegisterParams)
+  IPC_STRUCT_MEMBER(std::string, name)
+  IPC_STRUCT_MEMBER(std::string, js_api)
+  IPC_STRUCT_MEMBER(std::vector<std::string>, entry_points)
+  IPC_STRUCT_MEMBER(bool, message_batching_enabled)
+  // Zero means the Render Process waits forever for sync replies.
+  IPC_STRUCT_MEMBER(int, sync_message_timeout_ms)
+IPC_STRUCT_END()
 
-// This implies that extensions are all loaded and Extension Process
-// is ready to be used.
-IPC_MESSAGE_CONTROL1(XWalkExtensionProcessHostMsg_RenderProcessChannelCreated, // NOLINT(*)
+// The lists restrict which extensions are registered, see
+// XWalkExternalExtensionsFilter.
+IPC_MESSAGE_CONTROL3(XWalkExtensionProcessMsg_RegisterExtensions,  // NOLINT(*)
+                     base::FilePath /* extensions path */,
+                     std::vector<std::string> /* allowed libraries */,
+                     std::vector<std::string> /* permissions */)
+
+// Asks the Extension Process for a new channel to serve a Render Process. The
+// same Extension Process may serve several Render Processes, each one using
+// its own channel.
+IPC_MESSAGE_CONTROL1(XWalkExtensionProcessMsg_CreateRenderProcessChannel,  // NOLINT(*)
+                     int /* render process id */)
+
+IPC_MESSAGE_CONTROL1(XWalkExtensionProcessMsg_CloseRenderProcessChannel,  // NOLINT(*)
+                     int /* render process id */)
+
+// Sent once the extensions are loaded, so the Extension Process is ready to
+// serve Render Processes.
+IPC_MESSAGE_CONTROL1(XWalkExtensionProcessHostMsg_ExtensionsRegistered,  // NOLINT(*)
+                     std::vector<XWalkExtensionServerMsg_ExtensionRegisterParams> /* extensions */) // NOLINT(*)
+
+// The channel for the given Render Process was created.
+IPC_MESSAGE_CONTROL2(XWalkExtensionProcessHostMsg_RenderProcessChannelCreated, // NOLINT(*)
+                     int /* render process id */,
                      IPC::ChannelHandle /* channel id */)
 
-// Message from Render Process to Browser Process. This message needs
-// to be synchronous because Render Process cannot load anything without having
-// collected the extensions loaded in Extension Process.
+// Message from Browser Process to Render Process with the extensions loaded
+// by the Extension Process. Sent as soon as they are known, usually before
+// the Render Process creates any script context, so it can install the
+// extension namespaces without waiting for the Extension Process channel.
+IPC_MESSAGE_CONTROL1(XWalkExtensionMsg_ExternalExtensions,  // NOLINT(*)
+                     std::vector<XWalkExtensionServerMsg_ExtensionRegisterParams> /* extensions */) // NOLINT(*)
+
+// Message from Browser Process to Render Process with the Extension Process
+// channel, sent once it is created. It unblocks the Render Process in case it
+// is waiting in XWalkExtensionProcessHostMsg_GetExtensionProcessChannel.
+IPC_MESSAGE_CONTROL1(XWalkExtensionMsg_ExtensionProcessChannelCreated,  // NOLINT(*)
+                     IPC::ChannelHandle /* channel id */)
+
+// Message from Render Process to Browser Process, only used when JS code
+// touches an extension before the channel arrived. It is replied once the
+// channel is created, with an empty handle if the channel was already sent
+// with XWalkExtensionMsg_ExtensionProcessChannelCreated.
 IPC_SYNC_MESSAGE_CONTROL0_1(XWalkExtensionProcessHostMsg_GetExtensionProcessChannel,  // NOLINT(*)
                             IPC::ChannelHandle /* channel id */)
 
+// Message from Browser Process to Render Process with the V8 preparse data
+// for extensions JS code persisted by previous runs. See
+// XWalkExtensionCodeCache.
+IPC_MESSAGE_CONTROL1(XWalkExtensionMsg_CodeCacheData,  // NOLINT(*)
+                     std::map<std::string, std::string> /* key to data */)
+
+// Message from Render Process to Browser Process when preparse data was
+// produced for a script not found in the cache, so it can be persisted.
+IPC_MESSAGE_CONTROL2(XWalkExtensionHostMsg_StoreCodeCache,  // NOLINT(*)
+                     std::string /* key */,
+                     std::string /* data */)
+
 
 // We use a separated message class for Client<->Server communication
 // to ease filtering.
 #undef IPC_MESSAGE_START
 #define IPC_MESSAGE_START XWalkExtensionClientServerMsgStart
 
-IPC_STRUCT_BEGIN(XWalkExtensionServerMsg_ExtensionRegisterParams)
-  IPC_STRUCT_MEMBER(std::string, name)
-  IPC_STRUCT_MEMBER(std::string, js_api)
-  IPC_STRUCT_MEMBER(std::vector<std::string>, entry_points)
-IPC_STRUCT_END()
-
 IPC_MESSAGE_CONTROL2(XWalkExtensionServerMsg_CreateInstance,  // NOLINT(*)
                      int64_t /* instance id */,
                      std::string /* extension name */)
@@ -58,15 +109,67 @@ IPC_MESSAGE_CONTROL2(XWalkExtensionServerMsg_PostMessageToNative,  // NOLINT(*)
                      int64_t /* instance id */,
                      base::ListValue /* contents */)
 
+// Same as XWalkExtensionServerMsg_PostMessageToNative, but the contents are
+// written by SerializeV8Value() right after the instance id instead of being
+// a base::Value, and are read with XWalkSerializedValue.
+IPC_MESSAGE_CONTROL1(XWalkExtensionServerMsg_PostSerializedMessageToNative,  // NOLINT(*)
+                     int64_t /* instance id */)
+
 IPC_MESSAGE_CONTROL2(XWalkExtensionClientMsg_PostMessageToJS,  // NOLINT(*)
                      int64_t /* instance id */,
                      base::ListValue /* contents */)
 
+// Batched versions of the messages above, used by extensions that enabled
+// message batching. Each element of the list is a message, to be delivered
+// in order.
+IPC_MESSAGE_CONTROL2(XWalkExtensionServerMsg_PostMessagesToNative,  // NOLINT(*)
+                     int64_t /* instance id */,
+                     base::ListValue /* messages */)
+
+IPC_MESSAGE_CONTROL2(XWalkExtensionClientMsg_PostMessagesToJS,  // NOLINT(*)
+                     int64_t /* instance id */,
+                     base::ListValue /* messages */)
+
+// Binary messages are kept out of base::Value. Small payloads are written
+// directly in the IPC message, bigger ones are placed in a shared memory
+// segment, see xwalk_extension_binary_message.h.
+IPC_MESSAGE_CONTROL2(XWalkExtensionServerMsg_PostBinaryMessageToNative,  // NOLINT(*)
+                     int64_t /* instance id */,
+                     std::string /* contents */)
+
+IPC_MESSAGE_CONTROL3(XWalkExtensionServerMsg_PostSharedBinaryMessageToNative,  // NOLINT(*)
+                     int64_t /* instance id */,
+                     base::SharedMemoryHandle /* contents */,
+                     uint32_t /* size */)
+
+IPC_MESSAGE_CONTROL2(XWalkExtensionClientMsg_PostBinaryMessageToJS,  // NOLINT(*)
+                     int64_t /* instance id */,
+                     std::string /* contents */)
+
+IPC_MESSAGE_CONTROL3(XWalkExtensionClientMsg_PostSharedBinaryMessageToJS,  // NOLINT(*)
+                     int64_t /* instance id */,
+                     base::SharedMemoryHandle /* contents */,
+                     uint32_t /* size */)
+
 IPC_SYNC_MESSAGE_CONTROL2_1(XWalkExtensionServerMsg_SendSyncMessageToNative,  // NOLINT(*)
                             int64_t /* instance id */,
                             base::ListValue /* input contents */,
                             base::ListValue /* output contents */)
 
+// Non-blocking version of XWalkExtensionServerMsg_SendSyncMessageToNative,
+// handled by the same instance handler. The reply comes back in
+// XWalkExtensionClientMsg_RequestReplyToJS with the same request id, and is
+// empty if the instance doesn't exist.
+IPC_MESSAGE_CONTROL3(XWalkExtensionServerMsg_SendRequestToNative,  // NOLINT(*)
+                     int64_t /* instance id */,
+                     int /* request id */,
+                     base::ListValue /* contents */)
+
+IPC_MESSAGE_CONTROL3(XWalkExtensionClientMsg_RequestReplyToJS,  // NOLINT(*)
+                     int64_t /* instance id */,
+                     int /* request id */,
+                     base::ListValue /* contents */)
+
 IPC_SYNC_MESSAGE_CONTROL0_1(XWalkExtensionServerMsg_GetExtensions,  // NOLINT(*)
                             std::vector<XWalkExtensionServerMsg_ExtensionRegisterParams> /* output contents */) // NOLINT(*)
 
@@ -0,0 +1,83 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/extensions/common/xwalk_extension_messaging_stats.h"
+
+#include <algorithm>
+#include "base/values.h"
+
+namespace xwalk {
+namespace extensions {
+
+namespace {
+
+// base::Value has no 64 bits integers, counters are stored as doubles.
+void SetCounter(base::DictionaryValue* dictionary, const char* key,
+                uint64_t value) {
+  dictionary->SetDouble(key, static_cast<double>(value));
+}
+
+void SetTimeStats(base::DictionaryValue* dictionary, const char* key,
+                  const XWalkExtensionTimeStats& stats) {
+  base::DictionaryValue* value = new base::DictionaryValue;
+  SetCounter(value, "count", stats.count);
+  value->SetDouble("total_ms", stats.total.InMillisecondsF());
+  value->SetDouble("max_ms", stats.max.InMillisecondsF());
+  dictionary->Set(key, value);
+}
+
+}  // namespace
+
+void XWalkExtensionTimeStats::Add(base::TimeDelta time) {
+  count++;
+  total += time;
+  max = std::max(max, time);
+}
+
+void XWalkExtensionTimeStats::Merge(const XWalkExtensionTimeStats& other) {
+  count += other.count;
+  total += other.total;
+  max = std::max(max, other.max);
+}
+
+XWalkExtensionMessagingStats::XWalkExtensionMessagingStats()
+    : messages_to_native(0),
+      bytes_to_native(0),
+      messages_to_js(0),
+      bytes_to_js(0),
+      queue_depth(0),
+      max_queue_depth(0) {
+}
+
+void XWalkExtensionMessagingStats::Merge(
+    const XWalkExtensionMessagingStats& other) {
+  messages_to_native += other.messages_to_native;
+  bytes_to_native += other.bytes_to_native;
+  messages_to_js += other.messages_to_js;
+  bytes_to_js += other.bytes_to_js;
+  sync_latency.Merge(other.sync_latency);
+  queue_time.Merge(other.queue_time);
+  queue_depth += other.queue_depth;
+  max_queue_depth = std::max(max_queue_depth, other.max_queue_depth);
+  handle_time.Merge(other.handle_time);
+  handle_cpu_time.Merge(other.handle_cpu_time);
+}
+
+scoped_ptr<base::DictionaryValue> XWalkExtensionMessagingStats::ToValue()
+    const {
+  scoped_ptr<base::DictionaryValue> value(new base::DictionaryValue);
+  SetCounter(value.get(), "messages_to_native", messages_to_native);
+  SetCounter(value.get(), "bytes_to_native", bytes_to_native);
+  SetCounter(value.get(), "messages_to_js", messages_to_js);
+  SetCounter(value.get(), "bytes_to_js", bytes_to_js);
+  SetTimeStats(value.get(), "sync_latency", sync_latency);
+  SetTimeStats(value.get(), "queue_time", queue_time);
+  SetCounter(value.get(), "max_queue_depth", max_queue_depth);
+  SetTimeStats(value.get(), "handle_time", handle_time);
+  SetTimeStats(value.get(), "handle_cpu_time", handle_cpu_time);
+  return value.Pass();
+}
+
+}  // namespace extensions
+}  // namespace xwalk
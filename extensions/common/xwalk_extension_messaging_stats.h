@@ -0,0 +1,70 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef XWALK_EXTENSIONS_COMMON_XWALK_EXTENSION_MESSAGING_STATS_H_
+#define XWALK_EXTENSIONS_COMMON_XWALK_EXTENSION_MESSAGING_STATS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "base/memory/scoped_ptr.h"
+#include "base/time/time.h"
+
+namespace base {
+class DictionaryValue;
+}
+
+namespace xwalk {
+namespace extensions {
+
+// Accumulates a duration, keeping the count and the longest one.
+struct XWalkExtensionTimeStats {
+  XWalkExtensionTimeStats() : count(0) {}
+
+  void Add(base::TimeDelta time);
+  void Merge(const XWalkExtensionTimeStats& other);
+
+  uint64_t count;
+  base::TimeDelta total;
+  base::TimeDelta max;
+};
+
+// Counters kept by XWalkExtensionServer for each instance and, adding up the
+// instances, for each extension. They are used to find which extensions are
+// responsible for the IPC load.
+struct XWalkExtensionMessagingStats {
+  XWalkExtensionMessagingStats();
+
+  void Merge(const XWalkExtensionMessagingStats& other);
+
+  // Returns the counters in a dictionary, times in milliseconds.
+  scoped_ptr<base::DictionaryValue> ToValue() const;
+
+  uint64_t messages_to_native;
+  uint64_t bytes_to_native;
+  uint64_t messages_to_js;
+  uint64_t bytes_to_js;
+
+  // From the arrival of a sync message (or request) until its reply. It
+  // includes the time waiting for the previous ones to be replied.
+  XWalkExtensionTimeStats sync_latency;
+
+  // Time messages wait in the task runner of the instance before being
+  // handled, and how many were waiting at most. Only measured for the
+  // instances running in the Browser Process, see
+  // ExtensionServerMessageFilter.
+  XWalkExtensionTimeStats queue_time;
+  size_t queue_depth;
+  size_t max_queue_depth;
+
+  // Time spent inside the HandleMessage() family of functions, and the CPU
+  // time the handling thread used meanwhile. The latter is only measured
+  // where base::TimeTicks::IsThreadNowSupported().
+  XWalkExtensionTimeStats handle_time;
+  XWalkExtensionTimeStats handle_cpu_time;
+};
+
+}  // namespace extensions
+}  // namespace xwalk
+
+#endif  // XWALK_EXTENSIONS_COMMON_XWALK_EXTENSION_MESSAGING_STATS_H_
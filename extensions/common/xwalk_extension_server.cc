@@ -4,30 +4,153 @@
 
 #include "xwalk/extensions/common/xwalk_extension_server.h"
 
+#include <algorithm>
+#include <set>
+#include <vector>
+#include "base/bind.h"
 #include "base/file_util.h"
 #include "base/files/file_enumerator.h"
 #include "base/files/file_path.h"
+#include "base/memory/scoped_vector.h"
 #include "base/strings/string16.h"
+#include "base/strings/string_util.h"
 #include "base/strings/utf_string_conversions.h"
 #include "base/stl_util.h"
+#include "base/sys_info.h"
+#include "base/debug/trace_event.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/threading/simple_thread.h"
+#include "base/time/time.h"
 #include "content/public/browser/render_process_host.h"
 #include "ipc/ipc_sender.h"
+#include "ipc/ipc_sync_message.h"
 #include "xwalk/extensions/common/xwalk_extension.h"
+#include "xwalk/extensions/common/xwalk_extension_binary_message.h"
+#include "xwalk/extensions/common/xwalk_extension_message_recorder.h"
 #include "xwalk/extensions/common/xwalk_extension_messages.h"
 #include "xwalk/extensions/common/xwalk_external_extension.h"
+#include "xwalk/extensions/common/xwalk_serialized_value.h"
 
 namespace xwalk {
 namespace extensions {
 
 XWalkExtensionServer::XWalkExtensionServer()
-    : sender_(NULL) {}
+    : sender_(NULL),
+      pending_bytes_(0),
+      flush_scheduled_(false),
+      recorder_(XWalkExtensionMessageRecorder::GetInstance()),
+      recorder_server_id_(recorder_ ? recorder_->RegisterServer() : 0),
+      weak_factory_(this) {}
 
 XWalkExtensionServer::~XWalkExtensionServer() {
   DeleteInstanceMap();
-  STLDeleteValues(&extensions_);
+  for (ExtensionMap::iterator it = extensions_.begin();
+       it != extensions_.end(); ++it) {
+    if (!ContainsKey(shared_extensions_, it->second))
+      delete it->second;
+  }
+
+  base::AutoLock l(pending_lock_);
+  STLDeleteValues(&pending_messages_);
+  LogBatchingStats("to JS", batching_stats_);
+}
+
+XWalkExtensionServer::PendingMessages::PendingMessages(
+    const std::string& extension_name)
+    : extension_name(extension_name) {}
+
+XWalkExtensionServer::PendingMessages::~PendingMessages() {}
+
+namespace {
+
+// Messages from the client to an instance, named for the trace.
+const char* GetMessageToNativeName(const IPC::Message& message) {
+  switch (message.type()) {
+    case XWalkExtensionServerMsg_PostMessageToNative::ID:
+      return "PostMessage";
+    case XWalkExtensionServerMsg_PostMessagesToNative::ID:
+      return "PostMessages";
+    case XWalkExtensionServerMsg_PostSerializedMessageToNative::ID:
+      return "PostSerializedMessage";
+    case XWalkExtensionServerMsg_PostBinaryMessageToNative::ID:
+    case XWalkExtensionServerMsg_PostSharedBinaryMessageToNative::ID:
+      return "PostBinaryMessage";
+    case XWalkExtensionServerMsg_SendSyncMessageToNative::ID:
+      return "SendSyncMessage";
+    case XWalkExtensionServerMsg_SendRequestToNative::ID:
+      return "SendRequest";
+    default:
+      return NULL;
+  }
+}
+
+bool IsMessageToJS(const IPC::Message& message) {
+  switch (message.type()) {
+    case XWalkExtensionClientMsg_PostMessageToJS::ID:
+    case XWalkExtensionClientMsg_PostMessagesToJS::ID:
+    case XWalkExtensionClientMsg_PostBinaryMessageToJS::ID:
+    case XWalkExtensionClientMsg_PostSharedBinaryMessageToJS::ID:
+    case XWalkExtensionClientMsg_RequestReplyToJS::ID:
+      return true;
+    default:
+      return false;
+  }
+}
+
+}  // namespace
+
+// static
+bool XWalkExtensionServer::ReadInstanceID(const IPC::Message& message,
+                                          int64_t* instance_id) {
+  PickleIterator iter;
+  if (message.is_sync())
+    iter = IPC::SyncMessage::GetDataIterator(&message);
+  else
+    iter = PickleIterator(message);
+  return iter.ReadInt64(instance_id);
 }
 
 bool XWalkExtensionServer::OnMessageReceived(const IPC::Message& message) {
+  return DispatchMessage(message, base::TimeTicks());
+}
+
+void XWalkExtensionServer::OnQueuedMessageReceived(
+    const IPC::Message& message, base::TimeTicks queued_time) {
+  DispatchMessage(message, queued_time);
+}
+
+bool XWalkExtensionServer::DispatchMessage(const IPC::Message& message,
+                                           base::TimeTicks queued_time) {
+  const char* name = GetMessageToNativeName(message);
+  int64_t instance_id;
+  std::string extension_name;
+  if (name && ReadInstanceID(message, &instance_id) &&
+      RecordMessageToNative(instance_id, message.payload_size(), queued_time,
+                            &extension_name)) {
+    // The time handling the message includes reading it.
+    TRACE_EVENT2("xwalk", "XWalkExtensionServer::HandleMessage",
+                 "extension", TRACE_STR_COPY(extension_name.c_str()),
+                 "type", name);
+    if (recorder_) {
+      recorder_->RecordMessage(recorder_server_id_, instance_id,
+                               extension_name, message);
+    }
+    const bool measure_cpu = base::TimeTicks::IsThreadNowSupported();
+    base::TimeTicks start = base::TimeTicks::Now();
+    base::TimeTicks cpu_start;
+    if (measure_cpu)
+      cpu_start = base::TimeTicks::ThreadNow();
+    bool handled = HandleMessage(message);
+    base::TimeDelta cpu_time;
+    if (measure_cpu)
+      cpu_time = base::TimeTicks::ThreadNow() - cpu_start;
+    RecordHandleTime(instance_id, base::TimeTicks::Now() - start, cpu_time);
+    return handled;
+  }
+  return HandleMessage(message);
+}
+
+bool XWalkExtensionServer::HandleMessage(const IPC::Message& message) {
   bool handled = true;
   IPC_BEGIN_MESSAGE_MAP(XWalkExtensionServer, message)
     IPC_MESSAGE_HANDLER(XWalkExtensionServerMsg_CreateInstance,
@@ -36,9 +159,21 @@ bool XWalkExtensionServer::OnMessageReceived(const IPC::Message& message) {
         OnDestroyInstance)
     IPC_MESSAGE_HANDLER(XWalkExtensionServerMsg_PostMessageToNative,
         OnPostMessageToNative)
+    IPC_MESSAGE_HANDLER(XWalkExtensionServerMsg_PostMessagesToNative,
+        OnPostMessagesToNative)
+    IPC_MESSAGE_HANDLER_GENERIC(
+        XWalkExtensionServerMsg_PostSerializedMessageToNative,
+        OnPostSerializedMessageToNative(message))
+    IPC_MESSAGE_HANDLER(XWalkExtensionServerMsg_PostBinaryMessageToNative,
+        OnPostBinaryMessageToNative)
+    IPC_MESSAGE_HANDLER(
+        XWalkExtensionServerMsg_PostSharedBinaryMessageToNative,
+        OnPostSharedBinaryMessageToNative)
     IPC_MESSAGE_HANDLER_DELAY_REPLY(
         XWalkExtensionServerMsg_SendSyncMessageToNative,
         OnSendSyncMessageToNative)
+    IPC_MESSAGE_HANDLER(XWalkExtensionServerMsg_SendRequestToNative,
+        OnSendRequestToNative)
     IPC_MESSAGE_HANDLER(XWalkExtensionServerMsg_GetExtensions,
         OnGetExtensions)
     IPC_MESSAGE_UNHANDLED(handled = false)
@@ -57,33 +192,164 @@ void XWalkExtensionServer::OnCreateInstance(int64_t instance_id,
     return;
   }
 
-  XWalkExtensionInstance* instance = it->second->CreateInstance();
-  instance->SetPostMessageCallback(
-      base::Bind(&XWalkExtensionServer::PostMessageToJSCallback,
-                 base::Unretained(this), instance_id));
+  if (!task_runner_)
+    task_runner_ = base::MessageLoopProxy::current();
+
+  XWalkExtension* extension = it->second;
+  XWalkExtensionInstance* instance = extension->CreateInstance();
+  if (extension->message_batching_enabled()) {
+    instance->SetPostMessageCallback(
+        base::Bind(&XWalkExtensionServer::PostBatchedMessageToJSCallback,
+                   base::Unretained(this), name, instance_id));
+  } else {
+    instance->SetPostMessageCallback(
+        base::Bind(&XWalkExtensionServer::PostMessageToJSCallback,
+                   base::Unretained(this), instance_id));
+  }
 
   instance->SetSendSyncReplyCallback(
       base::Bind(&XWalkExtensionServer::SendSyncReplyToJSCallback,
                  base::Unretained(this), instance_id));
 
+  instance->SetPostBinaryMessageCallback(
+      base::Bind(&XWalkExtensionServer::PostBinaryMessageToJSCallback,
+                 base::Unretained(this), instance_id));
+
   InstanceExecutionData data;
   data.instance = instance;
-  data.pending_reply = NULL;
+  data.dispatching_sync_message = false;
+  data.extension_name = name;
+
+  if (recorder_)
+    recorder_->RecordCreateInstance(recorder_server_id_, instance_id, name);
 
+  base::AutoLock l(instances_lock_);
   instances_[instance_id] = data;
 }
 
+XWalkExtensionInstance* XWalkExtensionServer::GetInstance(int64_t instance_id) {
+  base::AutoLock l(instances_lock_);
+  InstanceMap::const_iterator it = instances_.find(instance_id);
+  if (it == instances_.end())
+    return NULL;
+  return it->second.instance;
+}
+
+void XWalkExtensionServer::SetTaskRunnerForInstance(
+    int64_t instance_id,
+    scoped_refptr<base::SequencedTaskRunner> task_runner) {
+  base::AutoLock l(instances_lock_);
+  instance_task_runners_[instance_id] = task_runner;
+}
+
+scoped_refptr<base::SequencedTaskRunner>
+XWalkExtensionServer::GetTaskRunnerForInstance(int64_t instance_id) {
+  base::AutoLock l(instances_lock_);
+  InstanceTaskRunnerMap::const_iterator it =
+      instance_task_runners_.find(instance_id);
+  if (it == instance_task_runners_.end())
+    return NULL;
+  return it->second;
+}
+
+XWalkExtension::ThreadAffinity XWalkExtensionServer::GetThreadAffinity(
+    const std::string& extension_name) const {
+  ExtensionMap::const_iterator it = extensions_.find(extension_name);
+  if (it == extensions_.end())
+    return XWalkExtension::THREAD_AFFINITY_IO;
+  return it->second->thread_affinity();
+}
+
+namespace {
+
+// Deletes the server when the last reference goes away, i.e. after the
+// instances in every task runner were deleted.
+class ServerDeleter : public base::RefCountedThreadSafe<ServerDeleter> {
+ public:
+  ServerDeleter(XWalkExtensionServer* server,
+                scoped_refptr<base::SequencedTaskRunner> task_runner)
+      : server_(server),
+        task_runner_(task_runner) {}
+
+ private:
+  friend class base::RefCountedThreadSafe<ServerDeleter>;
+  ~ServerDeleter() {
+    if (task_runner_)
+      task_runner_->DeleteSoon(FROM_HERE, server_);
+    else
+      delete server_;
+  }
+
+  XWalkExtensionServer* server_;
+  scoped_refptr<base::SequencedTaskRunner> task_runner_;
+};
+
+void RunWithServerDeleter(const base::Closure& closure,
+                          scoped_refptr<ServerDeleter> deleter) {
+  closure.Run();
+}
+
+}  // namespace
+
+// static
+void XWalkExtensionServer::DeleteSoon(
+    scoped_ptr<XWalkExtensionServer> server) {
+  std::set<base::SequencedTaskRunner*> task_runners;
+  {
+    base::AutoLock l(server->instances_lock_);
+    InstanceTaskRunnerMap::const_iterator it =
+        server->instance_task_runners_.begin();
+    for (; it != server->instance_task_runners_.end(); ++it)
+      task_runners.insert(it->second.get());
+  }
+
+  XWalkExtensionServer* raw_server = server.get();
+  scoped_refptr<ServerDeleter> deleter(
+      new ServerDeleter(server.release(), raw_server->task_runner_));
+
+  std::set<base::SequencedTaskRunner*>::iterator it = task_runners.begin();
+  for (; it != task_runners.end(); ++it) {
+    base::Closure closure = base::Bind(
+        &XWalkExtensionServer::DeleteInstancesForTaskRunner,
+        base::Unretained(raw_server), make_scoped_refptr(*it));
+    (*it)->PostTask(FROM_HERE,
+                    base::Bind(&RunWithServerDeleter, closure, deleter));
+  }
+}
+
+void XWalkExtensionServer::DeleteInstancesForTaskRunner(
+    scoped_refptr<base::SequencedTaskRunner> task_runner) {
+  std::vector<XWalkExtensionInstance*> instances;
+  {
+    base::AutoLock l(instances_lock_);
+    InstanceTaskRunnerMap::iterator it = instance_task_runners_.begin();
+    while (it != instance_task_runners_.end()) {
+      if (it->second != task_runner) {
+        ++it;
+        continue;
+      }
+      InstanceMap::iterator instance_it = instances_.find(it->first);
+      if (instance_it != instances_.end()) {
+        instances.push_back(instance_it->second.instance);
+        DeletePendingSyncMessages(&instance_it->second);
+        RetireInstanceStatsLocked(instance_it->second);
+        instances_.erase(instance_it);
+      }
+      instance_task_runners_.erase(it++);
+    }
+  }
+  STLDeleteElements(&instances);
+}
+
 void XWalkExtensionServer::OnPostMessageToNative(int64_t instance_id,
     const base::ListValue& msg) {
-  InstanceMap::const_iterator it = instances_.find(instance_id);
-  if (it == instances_.end()) {
+  XWalkExtensionInstance* instance = GetInstance(instance_id);
+  if (!instance) {
     LOG(WARNING) << "Can't PostMessage to invalid Extension instance id: "
                  << instance_id;
     return;
   }
 
-  const InstanceExecutionData& data = it->second;
-
   // The const_cast is needed to remove the only Value contained by the
   // ListValue (which is solely used as wrapper, since Value doesn't
   // have param traits for serialization) and we pass the ownership to to
@@ -92,7 +358,81 @@ void XWalkExtensionServer::OnPostMessageToNative(int64_t instance_id,
   // can be costly depending on the size of Value.
   scoped_ptr<base::Value> value;
   const_cast<base::ListValue*>(&msg)->Remove(0, &value);
-  data.instance->HandleMessage(value.Pass());
+  instance->HandleMessage(value.Pass());
+}
+
+void XWalkExtensionServer::OnPostMessagesToNative(int64_t instance_id,
+    const base::ListValue& msgs) {
+  XWalkExtensionInstance* instance = GetInstance(instance_id);
+  if (!instance) {
+    LOG(WARNING) << "Can't PostMessage to invalid Extension instance id: "
+                 << instance_id;
+    return;
+  }
+
+  // Same as in OnPostMessageToNative(), we steal the values from the list to
+  // avoid copying them.
+  base::ListValue* mutable_msgs = const_cast<base::ListValue*>(&msgs);
+  while (!mutable_msgs->empty()) {
+    scoped_ptr<base::Value> value;
+    mutable_msgs->Remove(0, &value);
+    instance->HandleMessage(value.Pass());
+  }
+}
+
+void XWalkExtensionServer::OnPostSerializedMessageToNative(
+    const IPC::Message& message) {
+  PickleIterator iter(message);
+  int64_t instance_id;
+  XWalkSerializedValue value;
+  if (!iter.ReadInt64(&instance_id) ||
+      !XWalkSerializedValue::Read(&iter, &value)) {
+    LOG(WARNING) << "Invalid serialized message received.";
+    return;
+  }
+
+  XWalkExtensionInstance* instance = GetInstance(instance_id);
+  if (!instance) {
+    LOG(WARNING) << "Can't PostMessage to invalid Extension instance id: "
+                 << instance_id;
+    return;
+  }
+
+  // The value points to |message|, that outlives the call.
+  instance->HandleSerializedMessage(value);
+}
+
+void XWalkExtensionServer::OnPostBinaryMessageToNative(int64_t instance_id,
+    const std::string& msg) {
+  XWalkExtensionInstance* instance = GetInstance(instance_id);
+  if (!instance) {
+    LOG(WARNING) << "Can't PostBinaryMessage to invalid Extension instance id: "
+                 << instance_id;
+    return;
+  }
+
+  instance->HandleBinaryMessage(msg.data(), msg.size());
+}
+
+void XWalkExtensionServer::OnPostSharedBinaryMessageToNative(
+    int64_t instance_id, base::SharedMemoryHandle handle, uint32_t size) {
+  // Take ownership of the handle first, so it is closed even if the instance
+  // is gone.
+  scoped_ptr<base::SharedMemory> shared_memory =
+      MapBinaryMessageSharedMemory(handle, size);
+
+  XWalkExtensionInstance* instance = GetInstance(instance_id);
+  if (!instance) {
+    LOG(WARNING) << "Can't PostBinaryMessage to invalid Extension instance id: "
+                 << instance_id;
+    return;
+  }
+
+  if (!shared_memory)
+    return;
+
+  instance->HandleBinaryMessage(
+      static_cast<const char*>(shared_memory->memory()), size);
 }
 
 void XWalkExtensionServer::Initialize(IPC::Sender* sender) {
@@ -102,6 +442,10 @@ void XWalkExtensionServer::Initialize(IPC::Sender* sender) {
 }
 
 bool XWalkExtensionServer::Send(IPC::Message* msg) {
+  int64_t instance_id;
+  if (IsMessageToJS(*msg) && ReadInstanceID(*msg, &instance_id))
+    RecordMessageToJS(instance_id, msg->payload_size());
+
   base::AutoLock l(sender_lock_);
   if (!sender_)
     return false;
@@ -141,6 +485,16 @@ bool ValidateExtensionIdentifier(const std::string& name) {
 
 }  // namespace
 
+void XWalkExtensionServer::ShareExtensionsOf(
+    const XWalkExtensionServer& server) {
+  DCHECK(extensions_.empty());
+  extensions_ = server.extensions_;
+  extension_symbols_ = server.extension_symbols_;
+  for (ExtensionMap::iterator it = extensions_.begin();
+       it != extensions_.end(); ++it)
+    shared_extensions_.insert(it->second);
+}
+
 bool XWalkExtensionServer::RegisterExtension(
     scoped_ptr<XWalkExtension> extension) {
   if (!ValidateExtensionIdentifier(extension->name())) {
@@ -188,50 +542,299 @@ void XWalkExtensionServer::PostMessageToJSCallback(
   Send(new XWalkExtensionClientMsg_PostMessageToJS(instance_id, wrapped_msg));
 }
 
-void XWalkExtensionServer::SendSyncReplyToJSCallback(
-    int64_t instance_id, scoped_ptr<base::Value> reply) {
+void XWalkExtensionServer::PostBatchedMessageToJSCallback(
+    const std::string& extension_name, int64_t instance_id,
+    scoped_ptr<base::Value> msg) {
+  base::AutoLock l(pending_lock_);
+
+  PendingMessages*& pending = pending_messages_[instance_id];
+  if (!pending)
+    pending = new PendingMessages(extension_name);
+
+  pending_bytes_ += EstimateMessageSize(*msg);
+  pending->messages.Append(msg.release());
+  batching_stats_[extension_name].messages++;
+
+  if (pending_bytes_ >= kMaxMessageBatchBytes || !task_runner_) {
+    for (PendingMessagesMap::iterator it = pending_messages_.begin();
+         it != pending_messages_.end(); ++it) {
+      SendPendingMessagesLocked(it->first, it->second);
+    }
+    STLDeleteValues(&pending_messages_);
+    pending_bytes_ = 0;
+    return;
+  }
+
+  if (flush_scheduled_)
+    return;
+
+  flush_scheduled_ = true;
+  task_runner_->PostTask(FROM_HERE,
+      base::Bind(&XWalkExtensionServer::FlushPendingMessages,
+                 weak_factory_.GetWeakPtr()));
+}
+
+void XWalkExtensionServer::SendPendingMessagesLocked(
+    int64_t instance_id, PendingMessages* pending) {
+  pending_lock_.AssertAcquired();
+  if (pending->messages.empty())
+    return;
+
+  batching_stats_[pending->extension_name].batches++;
 
+  // A batch with a single message is sent as a regular message, so the
+  // receiving side doesn't need to unpack it.
+  if (pending->messages.GetSize() == 1) {
+    Send(new XWalkExtensionClientMsg_PostMessageToJS(instance_id,
+                                                     pending->messages));
+  } else {
+    Send(new XWalkExtensionClientMsg_PostMessagesToJS(instance_id,
+                                                      pending->messages));
+  }
+  pending->messages.Clear();
+}
+
+void XWalkExtensionServer::FlushPendingMessages() {
+  base::AutoLock l(pending_lock_);
+  flush_scheduled_ = false;
+  for (PendingMessagesMap::iterator it = pending_messages_.begin();
+       it != pending_messages_.end(); ++it) {
+    SendPendingMessagesLocked(it->first, it->second);
+  }
+  STLDeleteValues(&pending_messages_);
+  pending_bytes_ = 0;
+}
+
+void XWalkExtensionServer::FlushPendingMessagesForInstance(
+    int64_t instance_id) {
+  base::AutoLock l(pending_lock_);
+  PendingMessagesMap::iterator it = pending_messages_.find(instance_id);
+  if (it == pending_messages_.end())
+    return;
+
+  SendPendingMessagesLocked(it->first, it->second);
+  delete it->second;
+  pending_messages_.erase(it);
+}
+
+XWalkExtensionBatchingStatsMap XWalkExtensionServer::GetBatchingStats() {
+  base::AutoLock l(pending_lock_);
+  return batching_stats_;
+}
+
+void XWalkExtensionServer::OnMessageQueued(const IPC::Message& message) {
+  int64_t instance_id;
+  if (!GetMessageToNativeName(message) ||
+      !ReadInstanceID(message, &instance_id))
+    return;
+
+  base::AutoLock l(instances_lock_);
   InstanceMap::iterator it = instances_.find(instance_id);
-  if (it == instances_.end()) {
-    LOG(WARNING) << "Can't SendSyncMessage to invalid Extension instance id: "
-                 << instance_id;
+  if (it == instances_.end())
     return;
+
+  XWalkExtensionMessagingStats& stats = it->second.stats;
+  stats.queue_depth++;
+  stats.max_queue_depth = std::max(stats.max_queue_depth, stats.queue_depth);
+  TRACE_COUNTER_ID1("xwalk", "XWalkExtensionServer::QueuedMessages",
+                    instance_id, stats.queue_depth);
+}
+
+bool XWalkExtensionServer::RecordMessageToNative(
+    int64_t instance_id, size_t size, base::TimeTicks queued_time,
+    std::string* extension_name) {
+  base::AutoLock l(instances_lock_);
+  InstanceMap::iterator it = instances_.find(instance_id);
+  if (it == instances_.end())
+    return false;
+
+  XWalkExtensionMessagingStats& stats = it->second.stats;
+  stats.messages_to_native++;
+  stats.bytes_to_native += size;
+  if (!queued_time.is_null()) {
+    stats.queue_time.Add(base::TimeTicks::Now() - queued_time);
+    if (stats.queue_depth)
+      stats.queue_depth--;
+    TRACE_COUNTER_ID1("xwalk", "XWalkExtensionServer::QueuedMessages",
+                      instance_id, stats.queue_depth);
   }
+  *extension_name = it->second.extension_name;
+  return true;
+}
 
-  InstanceExecutionData& data = it->second;
-  if (!data.pending_reply) {
-    LOG(WARNING) << "There's no pending SyncMessage for instance id: "
-                 << instance_id;
+void XWalkExtensionServer::RecordHandleTime(int64_t instance_id,
+                                            base::TimeDelta time,
+                                            base::TimeDelta cpu_time) {
+  base::AutoLock l(instances_lock_);
+  InstanceMap::iterator it = instances_.find(instance_id);
+  if (it == instances_.end())
+    return;
+
+  it->second.stats.handle_time.Add(time);
+  if (base::TimeTicks::IsThreadNowSupported())
+    it->second.stats.handle_cpu_time.Add(cpu_time);
+}
+
+void XWalkExtensionServer::RecordMessageToJS(int64_t instance_id,
+                                             size_t size) {
+  base::AutoLock l(instances_lock_);
+  InstanceMap::iterator it = instances_.find(instance_id);
+  if (it == instances_.end())
+    return;
+
+  it->second.stats.messages_to_js++;
+  it->second.stats.bytes_to_js += size;
+}
+
+void XWalkExtensionServer::RetireInstanceStatsLocked(
+    const InstanceExecutionData& data) {
+  instances_lock_.AssertAcquired();
+  retired_stats_[data.extension_name].Merge(data.stats);
+}
+
+scoped_ptr<base::DictionaryValue> XWalkExtensionServer::GetMessagingStats() {
+  base::AutoLock l(instances_lock_);
+  MessagingStatsMap totals = retired_stats_;
+  std::map<std::string, base::DictionaryValue*> instances;
+  for (InstanceMap::const_iterator it = instances_.begin();
+       it != instances_.end(); ++it) {
+    const InstanceExecutionData& data = it->second;
+    totals[data.extension_name].Merge(data.stats);
+    base::DictionaryValue*& extension_instances =
+        instances[data.extension_name];
+    if (!extension_instances)
+      extension_instances = new base::DictionaryValue;
+    extension_instances->SetWithoutPathExpansion(
+        base::Int64ToString(it->first), data.stats.ToValue().release());
+  }
+
+  scoped_ptr<base::DictionaryValue> result(new base::DictionaryValue);
+  for (MessagingStatsMap::const_iterator it = totals.begin();
+       it != totals.end(); ++it) {
+    base::DictionaryValue* value = it->second.ToValue().release();
+    base::DictionaryValue* extension_instances = instances[it->first];
+    value->Set("instances", extension_instances ? extension_instances
+                                                 : new base::DictionaryValue);
+    result->SetWithoutPathExpansion(it->first, value);
+  }
+  return result.Pass();
+}
+
+void XWalkExtensionServer::PostBinaryMessageToJSCallback(
+    int64_t instance_id, const char* data, size_t size) {
+  // Keep the ordering with messages that are waiting to be batched.
+  FlushPendingMessagesForInstance(instance_id);
+
+  if (!ShouldUseSharedMemoryForBinaryMessage(size)) {
+    Send(new XWalkExtensionClientMsg_PostBinaryMessageToJS(
+        instance_id, std::string(data, size)));
     return;
   }
 
+  base::SharedMemory shared_memory;
+  base::SharedMemoryHandle handle;
+  if (!shared_memory.CreateAndMapAnonymous(size) ||
+      !CopyBinaryMessageToSharedMemory(&shared_memory, data, size, &handle)) {
+    LOG(WARNING) << "Couldn't create shared memory for binary message of size "
+                 << size << ", sending it inline.";
+    Send(new XWalkExtensionClientMsg_PostBinaryMessageToJS(
+        instance_id, std::string(data, size)));
+    return;
+  }
+
+  Send(new XWalkExtensionClientMsg_PostSharedBinaryMessageToJS(
+      instance_id, handle, size));
+}
+
+void XWalkExtensionServer::SendSyncReplyToJSCallback(
+    int64_t instance_id, scoped_ptr<base::Value> reply) {
+  IPC::Message* ipc_reply;
+  int request_id;
+  {
+    base::AutoLock l(instances_lock_);
+    InstanceMap::iterator it = instances_.find(instance_id);
+    if (it == instances_.end()) {
+      LOG(WARNING) << "Can't SendSyncMessage to invalid Extension instance id: "
+                   << instance_id;
+      return;
+    }
+
+    InstanceExecutionData& data = it->second;
+    if (data.pending_sync_messages.empty() ||
+        data.pending_sync_messages.front().msg) {
+      LOG(WARNING) << "There's no pending SyncMessage for instance id: "
+                   << instance_id;
+      return;
+    }
+
+    const PendingSyncMessage& pending = data.pending_sync_messages.front();
+    ipc_reply = pending.ipc_reply;
+    request_id = pending.request_id;
+    data.stats.sync_latency.Add(base::TimeTicks::Now() - pending.arrival_time);
+    data.pending_sync_messages.pop_front();
+    TRACE_COUNTER_ID1("xwalk", "XWalkExtensionServer::PendingSyncMessages",
+                      instance_id, data.pending_sync_messages.size());
+  }
+
+  FlushPendingMessagesForInstance(instance_id);
+
   base::ListValue wrapped_reply;
   wrapped_reply.Append(reply.release());
 
-  // TODO(cmarcelo): we need to inline WriteReplyParams here because it takes
-  // a copy of the parameter and ListValue is noncopyable. This may be
-  // improved in ipc_message_utils.h so we don't need to inline the code here.
-  XWalkExtensionServerMsg_SendSyncMessageToNative::ReplyParam
-      reply_param(wrapped_reply);
-  IPC::WriteParam(data.pending_reply, reply_param);
-  Send(data.pending_reply);
+  if (ipc_reply) {
+    // TODO(cmarcelo): we need to inline WriteReplyParams here because it
+    // takes a copy of the parameter and ListValue is noncopyable. This may be
+    // improved in ipc_message_utils.h so we don't need to inline the code
+    // here.
+    XWalkExtensionServerMsg_SendSyncMessageToNative::ReplyParam
+        reply_param(wrapped_reply);
+    IPC::WriteParam(ipc_reply, reply_param);
+    RecordMessageToJS(instance_id, ipc_reply->payload_size());
+    Send(ipc_reply);
+  } else {
+    Send(new XWalkExtensionClientMsg_RequestReplyToJS(
+        instance_id, request_id, wrapped_reply));
+  }
+
+  DispatchPendingSyncMessages(instance_id);
+}
+
+XWalkExtensionServer::PendingSyncMessage::PendingSyncMessage(
+    IPC::Message* ipc_reply, int request_id, base::Value* msg)
+    : ipc_reply(ipc_reply),
+      request_id(request_id),
+      msg(msg),
+      arrival_time(base::TimeTicks::Now()) {
+}
 
-  data.pending_reply = NULL;
+// static
+int XWalkExtensionServer::DeletePendingSyncMessages(
+    InstanceExecutionData* data) {
+  int pending_replies = 0;
+  std::deque<PendingSyncMessage>::iterator it =
+      data->pending_sync_messages.begin();
+  for (; it != data->pending_sync_messages.end(); ++it) {
+    if (it->ipc_reply)
+      pending_replies++;
+    delete it->ipc_reply;
+    delete it->msg;
+  }
+  data->pending_sync_messages.clear();
+  return pending_replies;
 }
 
 void XWalkExtensionServer::DeleteInstanceMap() {
+  base::AutoLock l(instances_lock_);
   InstanceMap::iterator it = instances_.begin();
   int pending_replies_left = 0;
 
   for (; it != instances_.end(); ++it) {
     delete it->second.instance;
-    if (it->second.pending_reply) {
-      pending_replies_left++;
-      delete it->second.pending_reply;
-    }
+    pending_replies_left += DeletePendingSyncMessages(&it->second);
   }
 
   instances_.clear();
+  instance_task_runners_.clear();
 
   if (pending_replies_left > 0) {
     LOG(WARNING) << pending_replies_left
@@ -263,22 +866,16 @@ bool XWalkExtensionServer::ValidateExtensionEntryPoints(
 
 void XWalkExtensionServer::OnSendSyncMessageToNative(int64_t instance_id,
     const base::ListValue& msg, IPC::Message* ipc_reply) {
-  InstanceMap::iterator it = instances_.find(instance_id);
-  if (it == instances_.end()) {
-    LOG(WARNING) << "Can't SendSyncMessage to invalid Extension instance id: "
-                 << instance_id;
-    return;
-  }
-
-  InstanceExecutionData& data = it->second;
-  if (data.pending_reply) {
-    LOG(WARNING) << "There's already a pending Sync Message for "
-                 << "Extension instance id: " << instance_id;
-    return;
-  }
+  QueueSyncMessage(instance_id, ipc_reply, 0, msg);
+}
 
-  data.pending_reply = ipc_reply;
+void XWalkExtensionServer::OnSendRequestToNative(int64_t instance_id,
+    int request_id, const base::ListValue& msg) {
+  QueueSyncMessage(instance_id, NULL, request_id, msg);
+}
 
+void XWalkExtensionServer::QueueSyncMessage(int64_t instance_id,
+    IPC::Message* ipc_reply, int request_id, const base::ListValue& msg) {
   // The const_cast is needed to remove the only Value contained by the
   // ListValue (which is solely used as wrapper, since Value doesn't
   // have param traits for serialization) and we pass the ownership to to
@@ -287,22 +884,102 @@ void XWalkExtensionServer::OnSendSyncMessageToNative(int64_t instance_id,
   // can be costly depending on the size of Value.
   scoped_ptr<base::Value> value;
   const_cast<base::ListValue*>(&msg)->Remove(0, &value);
-  XWalkExtensionInstance* instance = data.instance;
 
-  instance->HandleSyncMessage(value.Pass());
+  bool queued = false;
+  {
+    base::AutoLock l(instances_lock_);
+    InstanceMap::iterator it = instances_.find(instance_id);
+    if (it != instances_.end() && value) {
+      // If the Render Process gave up waiting for a previous reply, this one
+      // waits for the instance to answer it first.
+      it->second.pending_sync_messages.push_back(
+          PendingSyncMessage(ipc_reply, request_id, value.release()));
+      queued = true;
+      TRACE_COUNTER_ID1("xwalk", "XWalkExtensionServer::PendingSyncMessages",
+                        instance_id, it->second.pending_sync_messages.size());
+    }
+  }
+
+  // Answer right away instead of leaving the Render Process waiting.
+  if (!queued) {
+    LOG(WARNING) << "Can't SendSyncMessage to invalid Extension instance id: "
+                 << instance_id;
+    if (ipc_reply) {
+      ipc_reply->set_reply_error();
+      Send(ipc_reply);
+    } else {
+      Send(new XWalkExtensionClientMsg_RequestReplyToJS(
+          instance_id, request_id, base::ListValue()));
+    }
+    return;
+  }
+
+  DispatchPendingSyncMessages(instance_id);
+}
+
+void XWalkExtensionServer::DispatchPendingSyncMessages(int64_t instance_id) {
+  while (true) {
+    XWalkExtensionInstance* instance;
+    scoped_ptr<base::Value> msg;
+    {
+      base::AutoLock l(instances_lock_);
+      InstanceMap::iterator it = instances_.find(instance_id);
+      if (it == instances_.end())
+        return;
+
+      InstanceExecutionData& data = it->second;
+      if (data.dispatching_sync_message ||
+          data.pending_sync_messages.empty() ||
+          !data.pending_sync_messages.front().msg)
+        return;
+
+      msg.reset(data.pending_sync_messages.front().msg);
+      data.pending_sync_messages.front().msg = NULL;
+      data.dispatching_sync_message = true;
+      instance = data.instance;
+    }
+
+    instance->HandleSyncMessage(msg.Pass());
+
+    // If the reply was sent during the call, the loop takes care of the next
+    // message. Otherwise SendSyncReplyToJSCallback() does it later.
+    base::AutoLock l(instances_lock_);
+    InstanceMap::iterator it = instances_.find(instance_id);
+    if (it == instances_.end())
+      return;
+    it->second.dispatching_sync_message = false;
+  }
 }
 
 void XWalkExtensionServer::OnDestroyInstance(int64_t instance_id) {
-  InstanceMap::iterator it = instances_.find(instance_id);
-  if (it == instances_.end()) {
-    LOG(WARNING) << "Can't destroy inexistent instance:" << instance_id;
-    return;
+  XWalkExtensionInstance* instance;
+  std::string extension_name;
+  {
+    base::AutoLock l(instances_lock_);
+    InstanceMap::iterator it = instances_.find(instance_id);
+    if (it == instances_.end()) {
+      LOG(WARNING) << "Can't destroy inexistent instance:" << instance_id;
+      return;
+    }
+
+    instance = it->second.instance;
+    extension_name = it->second.extension_name;
+    DeletePendingSyncMessages(&it->second);
+    RetireInstanceStatsLocked(it->second);
+    instances_.erase(it);
+    instance_task_runners_.erase(instance_id);
   }
 
-  InstanceExecutionData& data = it->second;
+  delete instance;
 
-  delete data.instance;
-  instances_.erase(it);
+  if (recorder_) {
+    recorder_->RecordDestroyInstance(recorder_server_id_, instance_id,
+                                     extension_name);
+  }
+
+  // Messages posted by the instance before dying still go to JS, the client
+  // will discard them if it isn't interested anymore.
+  FlushPendingMessagesForInstance(instance_id);
 
   Send(new XWalkExtensionClientMsg_InstanceDestroyed(instance_id));
 }
@@ -316,6 +993,10 @@ void XWalkExtensionServer::OnGetExtensions(
 
     extension_parameters.name = extension->name();
     extension_parameters.js_api = extension->javascript_api();
+    extension_parameters.message_batching_enabled =
+        extension->message_batching_enabled();
+    extension_parameters.sync_message_timeout_ms =
+        extension->sync_message_timeout().InMilliseconds();
 
     const base::ListValue& entry_points = extension->entry_points();
     base::ListValue::const_iterator entry_it = entry_points.begin();
@@ -344,13 +1025,101 @@ base::FilePath::StringType GetNativeLibraryPattern() {
   return UTF16ToUTF8(library_pattern);
 #endif
 }
+
+// Loads a single external extension library, so several of them can be
+// loaded at the same time. They are initialized afterwards, one at a time.
+class ExternalExtensionLoader : public base::DelegateSimpleThread::Delegate {
+ public:
+  explicit ExternalExtensionLoader(const base::FilePath& path)
+      : path_(path) {}
+
+  virtual void Run() OVERRIDE {
+    const base::TimeTicks start_time = base::TimeTicks::Now();
+    extension_.reset(new XWalkExternalExtension(path_));
+    load_time_ = base::TimeTicks::Now() - start_time;
+  }
+
+  const base::FilePath& path() const { return path_; }
+  base::TimeDelta load_time() const { return load_time_; }
+  scoped_ptr<XWalkExternalExtension> PassExtension() {
+    return extension_.Pass();
+  }
+
+ private:
+  base::FilePath path_;
+  scoped_ptr<XWalkExternalExtension> extension_;
+  base::TimeDelta load_time_;
+
+  DISALLOW_COPY_AND_ASSIGN(ExternalExtensionLoader);
+};
+
+const size_t kMaxLoadingThreads = 8;
+
 }  // namespace
 
+XWalkExternalExtensionsFilter::XWalkExternalExtensionsFilter() {}
+
+XWalkExternalExtensionsFilter::~XWalkExternalExtensionsFilter() {}
+
+bool XWalkExternalExtensionsFilter::Equals(
+    const XWalkExternalExtensionsFilter& other) const {
+  return libraries == other.libraries && permissions == other.permissions;
+}
+
+std::string GetExternalExtensionLibraryName(const base::FilePath& path) {
+  std::string name = path.BaseName().RemoveExtension().AsUTF8Unsafe();
+#if defined(OS_POSIX)
+  if (StartsWithASCII(name, "lib", true))
+    name = name.substr(3);
+#endif
+  return name;
+}
+
 std::vector<std::string> RegisterExternalExtensionsInDirectory(
     XWalkExtensionServer* server, const base::FilePath& dir) {
+  return RegisterExternalExtensionsInDirectory(
+      server, dir, XWalkExternalExtensionsFilter());
+}
+
+namespace {
+
+bool IsNamespacePermitted(const std::string& name,
+                          const std::set<std::string>& permissions) {
+  std::string current = name;
+  while (!ContainsKey(permissions, current)) {
+    size_t pos = current.rfind('.');
+    if (pos == std::string::npos)
+      return false;
+    current.erase(pos);
+  }
+  return true;
+}
+
+}  // namespace
+
+bool IsExtensionPermitted(const XWalkExtension* extension,
+                          const std::set<std::string>& permissions) {
+  if (IsNamespacePermitted(extension->name(), permissions))
+    return true;
+
+  const base::ListValue& entry_points = extension->entry_points();
+  base::ListValue::const_iterator it = entry_points.begin();
+  for (; it != entry_points.end(); ++it) {
+    std::string entry_point;
+    if ((*it)->GetAsString(&entry_point) &&
+        IsNamespacePermitted(entry_point, permissions))
+      return true;
+  }
+  return false;
+}
+
+std::vector<std::string> RegisterExternalExtensionsInDirectory(
+    XWalkExtensionServer* server, const base::FilePath& dir,
+    const XWalkExternalExtensionsFilter& filter) {
   CHECK(server);
 
   std::vector<std::string> registered_extensions;
+  std::vector<std::string> skipped_extensions;
 
   if (!base::DirectoryExists(dir)) {
     LOG(WARNING) << "Couldn't load external extensions from non-existent"
@@ -358,19 +1127,83 @@ std::vector<std::string> RegisterExternalExtensionsInDirectory(
     return registered_extensions;
   }
 
+  std::vector<base::FilePath> paths;
   base::FileEnumerator libraries(
       dir, false, base::FileEnumerator::FILES, GetNativeLibraryPattern());
-
   for (base::FilePath extension_path = libraries.Next();
         !extension_path.empty(); extension_path = libraries.Next()) {
-    scoped_ptr<XWalkExternalExtension> extension(
-        new XWalkExternalExtension(extension_path));
-    if (extension->is_valid()) {
-      registered_extensions.push_back(extension->name());
-      server->RegisterExtension(extension.PassAs<XWalkExtension>());
+    const std::string library_name =
+        GetExternalExtensionLibraryName(extension_path);
+    if (!filter.libraries.empty() &&
+        !ContainsKey(filter.libraries, library_name)) {
+      VLOG(1) << "Skipping external extension "
+              << extension_path.BaseName().AsUTF8Unsafe();
+      continue;
     }
+    paths.push_back(extension_path);
+  }
+
+  // The enumeration order depends on the file system, but the extensions
+  // should always be registered in the same order.
+  std::sort(paths.begin(), paths.end());
+
+  ScopedVector<ExternalExtensionLoader> loaders;
+  for (size_t i = 0; i < paths.size(); ++i)
+    loaders.push_back(new ExternalExtensionLoader(paths[i]));
+
+  // Most of the time is spent reading and relocating the libraries, so they
+  // are loaded in parallel. XW_Initialize is called on this thread, in the
+  // registration order, as the libraries may not be thread safe.
+  const base::TimeTicks start_time = base::TimeTicks::Now();
+  const size_t threads = std::min(loaders.size(), std::min(
+      static_cast<size_t>(base::SysInfo::NumberOfProcessors()),
+      kMaxLoadingThreads));
+  if (threads > 1) {
+    base::DelegateSimpleThreadPool pool("XWalkExtensionLoader", threads);
+    for (size_t i = 0; i < loaders.size(); ++i)
+      pool.AddWork(loaders[i]);
+    pool.Start();
+    pool.JoinAll();
+  } else {
+    for (size_t i = 0; i < loaders.size(); ++i)
+      loaders[i]->Run();
   }
 
+  for (size_t i = 0; i < loaders.size(); ++i) {
+    scoped_ptr<XWalkExternalExtension> extension(loaders[i]->PassExtension());
+    const base::TimeTicks initialize_start_time = base::TimeTicks::Now();
+    const bool initialized = extension->Initialize();
+    const base::TimeDelta initialize_time =
+        base::TimeTicks::Now() - initialize_start_time;
+    VLOG(1) << "Loaded external extension "
+            << loaders[i]->path().BaseName().AsUTF8Unsafe() << " in "
+            << loaders[i]->load_time().InMillisecondsF() << "ms, initialized"
+            << " it in " << initialize_time.InMillisecondsF() << "ms.";
+    if (!initialized)
+      continue;
+
+    // The library is unloaded and never advertised to the render processes.
+    if (!filter.permissions.empty() &&
+        !IsExtensionPermitted(extension.get(), filter.permissions)) {
+      skipped_extensions.push_back(extension->name());
+      continue;
+    }
+
+    registered_extensions.push_back(extension->name());
+    server->RegisterExtension(extension.PassAs<XWalkExtension>());
+  }
+
+  if (!skipped_extensions.empty()) {
+    LOG(INFO) << "Skipped " << skipped_extensions.size()
+              << " external extension(s) not in the application permissions: "
+              << JoinString(skipped_extensions, ',');
+  }
+
+  VLOG(1) << "Loaded " << loaders.size() << " external extensions in "
+          << (base::TimeTicks::Now() - start_time).InMillisecondsF()
+          << "ms using " << std::max(threads, static_cast<size_t>(1))
+          << " thread(s).";
+
   return registered_extensions;
 }
 
@@ -6,15 +6,24 @@
 #define XWALK_EXTENSIONS_COMMON_XWALK_EXTENSION_SERVER_H_
 
 #include <stdint.h>
+#include <deque>
 #include <map>
 #include <set>
 #include <string>
 #include <vector>
 
+#include "base/memory/shared_memory.h"
+#include "base/memory/weak_ptr.h"
+#include "base/message_loop/message_loop_proxy.h"
+#include "base/sequenced_task_runner.h"
 #include "base/synchronization/lock.h"
+#include "base/time/time.h"
 #include "base/values.h"
 #include "ipc/ipc_channel_proxy.h"
 #include "ipc/ipc_listener.h"
+#include "xwalk/extensions/common/xwalk_extension.h"
+#include "xwalk/extensions/common/xwalk_extension_message_batch.h"
+#include "xwalk/extensions/common/xwalk_extension_messaging_stats.h"
 
 struct XWalkExtensionServerMsg_ExtensionRegisterParams;
 
@@ -33,8 +42,7 @@ class Sender;
 namespace xwalk {
 namespace extensions {
 
-class XWalkExtension;
-class XWalkExtensionInstance;
+class XWalkExtensionMessageRecorder;
 
 // Manages the instances for a set of extensions. It communicates with one
 // XWalkExtensionClient by means of IPC channel.
@@ -55,29 +63,156 @@ class XWalkExtensionServer : public IPC::Listener {
   bool RegisterExtension(scoped_ptr<XWalkExtension> extension);
   bool ContainsExtension(const std::string& extension_name) const;
 
+  // Makes the extensions registered in |server| available in this server
+  // too, without taking their ownership. Used by the Extension Process to
+  // load the extensions once and serve several Render Processes, each with
+  // its own server, so instance ids are not shared between Render Processes.
+  // |server| must outlive this server.
+  void ShareExtensionsOf(const XWalkExtensionServer& server);
+
   void Invalidate();
 
+  // Task runner where the server lives, used to flush batched messages and to
+  // delete the server in DeleteSoon(). By default it is the one where the
+  // first instance is created.
+  void set_task_runner(scoped_refptr<base::SequencedTaskRunner> task_runner) {
+    task_runner_ = task_runner;
+  }
+
+  // Instances are by default created in the thread handling the server
+  // messages. A message filter can instead bind each instance to a different
+  // task runner, registered here before the instance is created, and then
+  // dispatch the messages for that instance to it.
+  void SetTaskRunnerForInstance(
+      int64_t instance_id,
+      scoped_refptr<base::SequencedTaskRunner> task_runner);
+  scoped_refptr<base::SequencedTaskRunner> GetTaskRunnerForInstance(
+      int64_t instance_id);
+
+  XWalkExtension::ThreadAffinity GetThreadAffinity(
+      const std::string& extension_name) const;
+
+  // Deletes the instances in their own task runners, then the server in its
+  // task runner.
+  static void DeleteSoon(scoped_ptr<XWalkExtensionServer> server);
+
   // These Message Handlers can be accessed by a message filter when
   // running on the browser process.
   void OnCreateInstance(int64_t instance_id, std::string name);
+  void OnDestroyInstance(int64_t instance_id);
   void OnGetExtensions(
       std::vector<XWalkExtensionServerMsg_ExtensionRegisterParams>* reply);
 
+  // Returns the counters for messages sent to JS by extensions that enabled
+  // message batching, keyed by extension name.
+  XWalkExtensionBatchingStatsMap GetBatchingStats();
+
+  // A message filter dispatching the messages for an instance to its task
+  // runner tells when a message is queued, then passes it to
+  // OnQueuedMessageReceived() instead of OnMessageReceived(), so the time
+  // spent in the queue is accounted.
+  void OnMessageQueued(const IPC::Message& message);
+  void OnQueuedMessageReceived(const IPC::Message& message,
+                               base::TimeTicks queued_time);
+
+  // Returns the messaging counters, see XWalkExtensionMessagingStats, in a
+  // dictionary keyed by extension name. Each extension also has an
+  // "instances" dictionary with the counters of its live instances, keyed by
+  // instance id.
+  scoped_ptr<base::DictionaryValue> GetMessagingStats();
+
+  // Reads the instance id that starts the messages sent from the client.
+  static bool ReadInstanceID(const IPC::Message& message,
+                             int64_t* instance_id);
+
  private:
+  // A message for the sync message handler of an instance. It comes either
+  // from sendSyncMessage(), and then |ipc_reply| is the reply to be filled,
+  // or from sendRequest(), identified by |request_id|. The instance gets them
+  // one at a time, |msg| is released when it is dispatched.
+  struct PendingSyncMessage {
+    PendingSyncMessage(IPC::Message* ipc_reply, int request_id,
+                       base::Value* msg);
+    IPC::Message* ipc_reply;
+    int request_id;
+    base::Value* msg;
+    base::TimeTicks arrival_time;
+  };
+
   struct InstanceExecutionData {
     XWalkExtensionInstance* instance;
-    IPC::Message* pending_reply;
+    // The front is the one being handled by the instance, if its |msg| was
+    // already dispatched.
+    std::deque<PendingSyncMessage> pending_sync_messages;
+    // Set while the instance runs HandleSyncMessage(), so a reply sent from
+    // inside it doesn't dispatch the next message recursively.
+    bool dispatching_sync_message;
+    std::string extension_name;
+    XWalkExtensionMessagingStats stats;
   };
 
+  // Returns the number of replies that were still pending.
+  static int DeletePendingSyncMessages(InstanceExecutionData* data);
+
+  XWalkExtensionInstance* GetInstance(int64_t instance_id);
+
+  bool DispatchMessage(const IPC::Message& message,
+                       base::TimeTicks queued_time);
+  bool HandleMessage(const IPC::Message& message);
+
+  // Update the messaging stats of the instance. Return false if the instance
+  // doesn't exist.
+  bool RecordMessageToNative(int64_t instance_id, size_t size,
+                             base::TimeTicks queued_time,
+                             std::string* extension_name);
+  void RecordHandleTime(int64_t instance_id, base::TimeDelta time,
+                        base::TimeDelta cpu_time);
+  void RecordMessageToJS(int64_t instance_id, size_t size);
+
+  // Keeps the counters of an instance that is going away. Must be called
+  // with |instances_lock_| held.
+  void RetireInstanceStatsLocked(const InstanceExecutionData& data);
+
+  void DeleteInstancesForTaskRunner(
+      scoped_refptr<base::SequencedTaskRunner> task_runner);
+
   // Message Handlers
-  void OnDestroyInstance(int64_t instance_id);
   void OnPostMessageToNative(int64_t instance_id, const base::ListValue& msg);
+  void OnPostMessagesToNative(int64_t instance_id,
+                              const base::ListValue& msgs);
+  void OnPostSerializedMessageToNative(const IPC::Message& message);
+  void OnPostBinaryMessageToNative(int64_t instance_id,
+                                   const std::string& msg);
+  void OnPostSharedBinaryMessageToNative(int64_t instance_id,
+                                         base::SharedMemoryHandle handle,
+                                         uint32_t size);
   void OnSendSyncMessageToNative(int64_t instance_id,
       const base::ListValue& msg, IPC::Message* ipc_reply);
+  void OnSendRequestToNative(int64_t instance_id, int request_id,
+                             const base::ListValue& msg);
+
+  // Queues a message for the sync message handler of the instance and runs
+  // it if the instance isn't busy with a previous one.
+  void QueueSyncMessage(int64_t instance_id, IPC::Message* ipc_reply,
+                        int request_id, const base::ListValue& msg);
+  void DispatchPendingSyncMessages(int64_t instance_id);
 
   void PostMessageToJSCallback(int64_t instance_id,
                                scoped_ptr<base::Value> msg);
 
+  // Used instead of PostMessageToJSCallback() for extensions that enabled
+  // message batching. Messages are queued and sent when the current message
+  // loop turn of the server thread ends or the batch gets too big.
+  void PostBatchedMessageToJSCallback(const std::string& extension_name,
+                                      int64_t instance_id,
+                                      scoped_ptr<base::Value> msg);
+
+  void FlushPendingMessages();
+  void FlushPendingMessagesForInstance(int64_t instance_id);
+
+  void PostBinaryMessageToJSCallback(int64_t instance_id,
+                                     const char* data, size_t size);
+
   void SendSyncReplyToJSCallback(int64_t instance_id,
                                  scoped_ptr<base::Value> reply);
 
@@ -91,16 +226,95 @@ class XWalkExtensionServer : public IPC::Listener {
   typedef std::map<std::string, XWalkExtension*> ExtensionMap;
   ExtensionMap extensions_;
 
+  // Extensions in |extensions_| owned by another server.
+  std::set<XWalkExtension*> shared_extensions_;
+
+  // Instances may run in different threads, so the maps below are protected
+  // by |instances_lock_|. It is never held while calling into an instance.
+  base::Lock instances_lock_;
+
   typedef std::map<int64_t, InstanceExecutionData> InstanceMap;
   InstanceMap instances_;
 
+  // Counters of the instances already destroyed, keyed by extension name.
+  typedef std::map<std::string, XWalkExtensionMessagingStats>
+      MessagingStatsMap;
+  MessagingStatsMap retired_stats_;
+
+  typedef std::map<int64_t, scoped_refptr<base::SequencedTaskRunner> >
+      InstanceTaskRunnerMap;
+  InstanceTaskRunnerMap instance_task_runners_;
+
   // The exported symbols for extensions already registered.
   typedef std::set<std::string> ExtensionSymbolsSet;
   ExtensionSymbolsSet extension_symbols_;
+
+  // Messages waiting to be sent in a batch. Instances can post messages from
+  // any thread, so these are protected by |pending_lock_|, that is held while
+  // sending to keep the ordering between batches.
+  struct PendingMessages {
+    explicit PendingMessages(const std::string& extension_name);
+    ~PendingMessages();
+    std::string extension_name;
+    base::ListValue messages;
+  };
+
+  void SendPendingMessagesLocked(int64_t instance_id,
+                                 PendingMessages* pending);
+
+  base::Lock pending_lock_;
+  typedef std::map<int64_t, PendingMessages*> PendingMessagesMap;
+  PendingMessagesMap pending_messages_;
+  size_t pending_bytes_;
+  bool flush_scheduled_;
+  XWalkExtensionBatchingStatsMap batching_stats_;
+
+  // Task runner of the thread where this server handles messages, used to
+  // flush the pending messages at the end of the current turn.
+  scoped_refptr<base::SequencedTaskRunner> task_runner_;
+
+  // Not owned, NULL unless recording, see XWalkExtensionMessageRecorder.
+  XWalkExtensionMessageRecorder* recorder_;
+  int recorder_server_id_;
+
+  base::WeakPtrFactory<XWalkExtensionServer> weak_factory_;
+};
+
+// Restricts the external extensions registered, empty sets don't restrict.
+struct XWalkExternalExtensionsFilter {
+  XWalkExternalExtensionsFilter();
+  ~XWalkExternalExtensionsFilter();
+
+  bool Equals(const XWalkExternalExtensionsFilter& other) const;
+
+  // Libraries not in this set are not even loaded, see
+  // GetExternalExtensionLibraryName().
+  std::set<std::string> libraries;
+
+  // Usually the permissions declared by the application. Extensions that
+  // don't provide any of them are unloaded right after initialization, see
+  // IsExtensionPermitted().
+  std::set<std::string> permissions;
 };
 
+// Loads the external extensions libraries found in |dir| and registers them
+// in |server|, always in the order of their file names. The libraries are
+// loaded and initialized in parallel.
 std::vector<std::string> RegisterExternalExtensionsInDirectory(
     XWalkExtensionServer* server, const base::FilePath& dir);
+std::vector<std::string> RegisterExternalExtensionsInDirectory(
+    XWalkExtensionServer* server, const base::FilePath& dir,
+    const XWalkExternalExtensionsFilter& filter);
+
+// Whether the name or one of the entry points of |extension| is in
+// |permissions|, or is inside a namespace that is, e.g. "tizen" permits
+// "tizen.bluetooth".
+bool IsExtensionPermitted(const XWalkExtension* extension,
+                          const std::set<std::string>& permissions);
+
+// Name of the external extension library without the platform prefix and
+// suffix, e.g. "echo" for "libecho.so".
+std::string GetExternalExtensionLibraryName(const base::FilePath& path);
 
 bool ValidateExtensionNameForTesting(const std::string& extension_name);
 
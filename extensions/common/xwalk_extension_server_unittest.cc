@@ -4,10 +4,120 @@
 
 #include "xwalk/extensions/common/xwalk_extension_server.h"
 
+#include <set>
+#include <string>
+#include <vector>
+
 #include "base/basictypes.h"
+#include "base/files/file_path.h"
+#include "base/message_loop/message_loop.h"
+#include "base/run_loop.h"
+#include "base/stl_util.h"
+#include "ipc/ipc_sender.h"
 #include "testing/gtest/include/gtest/gtest.h"
+#include "xwalk/extensions/common/xwalk_extension.h"
+#include "xwalk/extensions/common/xwalk_extension_messages.h"
 
+using xwalk::extensions::GetExternalExtensionLibraryName;
+using xwalk::extensions::IsExtensionPermitted;
 using xwalk::extensions::ValidateExtensionNameForTesting;
+using xwalk::extensions::XWalkExtension;
+using xwalk::extensions::XWalkExtensionBatchingStatsMap;
+using xwalk::extensions::XWalkExtensionInstance;
+using xwalk::extensions::XWalkExtensionServer;
+
+namespace {
+
+class TestSender : public IPC::Sender {
+ public:
+  virtual ~TestSender() { STLDeleteElements(&messages_); }
+
+  virtual bool Send(IPC::Message* message) OVERRIDE {
+    messages_.push_back(message);
+    return true;
+  }
+
+  const std::vector<IPC::Message*>& messages() const { return messages_; }
+
+ private:
+  std::vector<IPC::Message*> messages_;
+};
+
+class BatchingInstance : public XWalkExtensionInstance {
+ public:
+  virtual void HandleMessage(scoped_ptr<base::Value> msg) OVERRIDE {}
+};
+
+BatchingInstance* g_last_instance = NULL;
+
+class BatchingExtension : public XWalkExtension {
+ public:
+  explicit BatchingExtension(bool batching) {
+    set_name("batching");
+    set_javascript_api("");
+    set_message_batching_enabled(batching);
+  }
+
+  virtual XWalkExtensionInstance* CreateInstance() OVERRIDE {
+    g_last_instance = new BatchingInstance;
+    return g_last_instance;
+  }
+};
+
+class NamedExtension : public XWalkExtension {
+ public:
+  NamedExtension(const std::string& name, const std::string& entry_point) {
+    set_name(name);
+    if (!entry_point.empty())
+      set_entry_points(std::vector<std::string>(1, entry_point));
+  }
+
+  virtual XWalkExtensionInstance* CreateInstance() OVERRIDE {
+    return new BatchingInstance;
+  }
+};
+
+// Keeps the sync messages so the test decides when to reply.
+class SyncInstance : public XWalkExtensionInstance {
+ public:
+  virtual void HandleMessage(scoped_ptr<base::Value> msg) OVERRIDE {}
+  virtual void HandleSyncMessage(scoped_ptr<base::Value> msg) OVERRIDE {
+    int value;
+    msg->GetAsInteger(&value);
+    received_.push_back(value);
+  }
+
+  const std::vector<int>& received() const { return received_; }
+
+ private:
+  std::vector<int> received_;
+};
+
+SyncInstance* g_last_sync_instance = NULL;
+
+class SyncExtension : public XWalkExtension {
+ public:
+  SyncExtension() {
+    set_name("sync");
+    set_javascript_api("");
+    set_sync_message_timeout(base::TimeDelta::FromMilliseconds(500));
+  }
+
+  virtual XWalkExtensionInstance* CreateInstance() OVERRIDE {
+    g_last_sync_instance = new SyncInstance;
+    return g_last_sync_instance;
+  }
+};
+
+void SendRequest(XWalkExtensionServer* server, int64_t instance_id,
+                 int request_id, int value) {
+  base::ListValue msg;
+  msg.AppendInteger(value);
+  server->OnMessageReceived(XWalkExtensionServerMsg_SendRequestToNative(
+      instance_id, request_id, msg));
+}
+
+}  // namespace
 
 TEST(XWalkExtensionServerTest, ValidateExtensionName) {
   const std::string valid_names[] = {
@@ -42,3 +152,216 @@ TEST(XWalkExtensionServerTest, ValidateExtensionName) {
         << "Extension name should be invalid: " << invalid_names[i];
   }
 }
+
+TEST(XWalkExtensionServerTest, BatchMessagesToJS) {
+  base::MessageLoop message_loop;
+  TestSender sender;
+  XWalkExtensionServer server;
+  server.Initialize(&sender);
+  server.RegisterExtension(
+      scoped_ptr<XWalkExtension>(new BatchingExtension(true)));
+  server.OnCreateInstance(1, "batching");
+  ASSERT_TRUE(g_last_instance);
+
+  const int kMessages = 10;
+  for (int i = 0; i < kMessages; ++i) {
+    g_last_instance->PostMessageToJS(
+        scoped_ptr<base::Value>(base::Value::CreateIntegerValue(i)));
+  }
+
+  // Nothing is sent until the current message loop turn finishes.
+  EXPECT_TRUE(sender.messages().empty());
+  base::RunLoop().RunUntilIdle();
+
+  ASSERT_EQ(1u, sender.messages().size());
+  const IPC::Message* message = sender.messages()[0];
+  ASSERT_EQ(static_cast<uint32>(XWalkExtensionClientMsg_PostMessagesToJS::ID),
+            message->type());
+
+  XWalkExtensionClientMsg_PostMessagesToJS::Param params;
+  ASSERT_TRUE(XWalkExtensionClientMsg_PostMessagesToJS::Read(message, &params));
+  EXPECT_EQ(1, params.a);
+  ASSERT_EQ(static_cast<size_t>(kMessages), params.b.GetSize());
+  for (int i = 0; i < kMessages; ++i) {
+    int value;
+    ASSERT_TRUE(params.b.GetInteger(i, &value));
+    EXPECT_EQ(i, value);
+  }
+
+  XWalkExtensionBatchingStatsMap stats = server.GetBatchingStats();
+  EXPECT_EQ(static_cast<uint64_t>(kMessages), stats["batching"].messages);
+  EXPECT_EQ(1u, stats["batching"].batches);
+
+  server.Invalidate();
+}
+
+TEST(XWalkExtensionServerTest, NoBatchingWhenDisabled) {
+  base::MessageLoop message_loop;
+  TestSender sender;
+  XWalkExtensionServer server;
+  server.Initialize(&sender);
+  server.RegisterExtension(
+      scoped_ptr<XWalkExtension>(new BatchingExtension(false)));
+  server.OnCreateInstance(1, "batching");
+  ASSERT_TRUE(g_last_instance);
+
+  const int kMessages = 3;
+  for (int i = 0; i < kMessages; ++i) {
+    g_last_instance->PostMessageToJS(
+        scoped_ptr<base::Value>(base::Value::CreateIntegerValue(i)));
+  }
+
+  EXPECT_EQ(static_cast<size_t>(kMessages), sender.messages().size());
+  EXPECT_TRUE(server.GetBatchingStats().empty());
+
+  server.Invalidate();
+}
+
+TEST(XWalkExtensionServerTest, RequestsAreHandledOneAtATime) {
+  base::MessageLoop message_loop;
+  TestSender sender;
+  XWalkExtensionServer server;
+  server.Initialize(&sender);
+  server.RegisterExtension(scoped_ptr<XWalkExtension>(new SyncExtension));
+  server.OnCreateInstance(1, "sync");
+  ASSERT_TRUE(g_last_sync_instance);
+
+  SendRequest(&server, 1, 10, 100);
+  SendRequest(&server, 1, 11, 101);
+
+  // The second request waits for the reply of the first.
+  ASSERT_EQ(1u, g_last_sync_instance->received().size());
+  EXPECT_EQ(100, g_last_sync_instance->received()[0]);
+  EXPECT_TRUE(sender.messages().empty());
+
+  g_last_sync_instance->SendSyncReplyToJS(
+      scoped_ptr<base::Value>(base::Value::CreateIntegerValue(200)));
+  ASSERT_EQ(2u, g_last_sync_instance->received().size());
+  EXPECT_EQ(101, g_last_sync_instance->received()[1]);
+
+  ASSERT_EQ(1u, sender.messages().size());
+  XWalkExtensionClientMsg_RequestReplyToJS::Param params;
+  ASSERT_TRUE(XWalkExtensionClientMsg_RequestReplyToJS::Read(
+      sender.messages()[0], &params));
+  EXPECT_EQ(1, params.a);
+  EXPECT_EQ(10, params.b);
+  int reply;
+  ASSERT_TRUE(params.c.GetInteger(0, &reply));
+  EXPECT_EQ(200, reply);
+
+  // The next reply goes to the second request, the extra one is dropped.
+  g_last_sync_instance->SendSyncReplyToJS(
+      scoped_ptr<base::Value>(base::Value::CreateIntegerValue(201)));
+  g_last_sync_instance->SendSyncReplyToJS(
+      scoped_ptr<base::Value>(base::Value::CreateIntegerValue(202)));
+  EXPECT_EQ(2u, sender.messages().size());
+
+  // Requests for instances that don't exist get an empty reply.
+  SendRequest(&server, 2, 12, 102);
+  ASSERT_EQ(3u, sender.messages().size());
+  ASSERT_TRUE(XWalkExtensionClientMsg_RequestReplyToJS::Read(
+      sender.messages()[2], &params));
+  EXPECT_EQ(12, params.b);
+  EXPECT_TRUE(params.c.empty());
+
+  std::vector<XWalkExtensionServerMsg_ExtensionRegisterParams> extensions;
+  server.OnGetExtensions(&extensions);
+  ASSERT_EQ(1u, extensions.size());
+  EXPECT_EQ(500, extensions[0].sync_message_timeout_ms);
+
+  server.Invalidate();
+}
+
+TEST(XWalkExtensionServerTest, MessagingStats) {
+  base::MessageLoop message_loop;
+  TestSender sender;
+  XWalkExtensionServer server;
+  server.Initialize(&sender);
+  server.RegisterExtension(
+      scoped_ptr<XWalkExtension>(new BatchingExtension(false)));
+  server.OnCreateInstance(1, "batching");
+  server.OnCreateInstance(2, "batching");
+  ASSERT_TRUE(g_last_instance);
+
+  base::ListValue msg;
+  msg.AppendString("ping");
+  XWalkExtensionServerMsg_PostMessageToNative message(1, msg);
+  server.OnMessageQueued(message);
+  server.OnQueuedMessageReceived(message, base::TimeTicks::Now());
+  server.OnMessageReceived(
+      XWalkExtensionServerMsg_PostMessageToNative(2, msg));
+  g_last_instance->PostMessageToJS(
+      scoped_ptr<base::Value>(base::Value::CreateStringValue("pong")));
+
+  scoped_ptr<base::DictionaryValue> stats = server.GetMessagingStats();
+  const base::DictionaryValue* extension_stats;
+  ASSERT_TRUE(stats->GetDictionaryWithoutPathExpansion("batching",
+                                                       &extension_stats));
+  double value;
+  EXPECT_TRUE(extension_stats->GetDouble("messages_to_native", &value));
+  EXPECT_EQ(2, value);
+  EXPECT_TRUE(extension_stats->GetDouble("bytes_to_native", &value));
+  EXPECT_EQ(static_cast<double>(2 * message.payload_size()), value);
+  EXPECT_TRUE(extension_stats->GetDouble("messages_to_js", &value));
+  EXPECT_EQ(1, value);
+  EXPECT_TRUE(extension_stats->GetDouble("queue_time.count", &value));
+  EXPECT_EQ(1, value);
+  EXPECT_TRUE(extension_stats->GetDouble("handle_time.count", &value));
+  EXPECT_EQ(2, value);
+  EXPECT_TRUE(extension_stats->GetDouble("handle_cpu_time.count", &value));
+  EXPECT_EQ(base::TimeTicks::IsThreadNowSupported() ? 2 : 0, value);
+
+  const base::DictionaryValue* instances;
+  ASSERT_TRUE(extension_stats->GetDictionary("instances", &instances));
+  EXPECT_EQ(2u, instances->size());
+  const base::DictionaryValue* instance_stats;
+  ASSERT_TRUE(instances->GetDictionaryWithoutPathExpansion("2",
+                                                           &instance_stats));
+  EXPECT_TRUE(instance_stats->GetDouble("messages_to_js", &value));
+  EXPECT_EQ(1, value);
+
+  // Destroyed instances still count for the extension.
+  server.OnDestroyInstance(2);
+  stats = server.GetMessagingStats();
+  ASSERT_TRUE(stats->GetDictionaryWithoutPathExpansion("batching",
+                                                       &extension_stats));
+  EXPECT_TRUE(extension_stats->GetDouble("messages_to_native", &value));
+  EXPECT_EQ(2, value);
+  ASSERT_TRUE(extension_stats->GetDictionary("instances", &instances));
+  EXPECT_EQ(1u, instances->size());
+
+  server.Invalidate();
+}
+
+TEST(XWalkExtensionServerTest, ExternalExtensionLibraryName) {
+#if defined(OS_WIN)
+  EXPECT_EQ("echo", GetExternalExtensionLibraryName(
+      base::FilePath(FILE_PATH_LITERAL("C:\\extensions\\echo.dll"))));
+#else
+  EXPECT_EQ("echo", GetExternalExtensionLibraryName(
+      base::FilePath(FILE_PATH_LITERAL("/usr/lib/extensions/libecho.so"))));
+  EXPECT_EQ("tizen_bluetooth", GetExternalExtensionLibraryName(
+      base::FilePath(FILE_PATH_LITERAL("libtizen_bluetooth.so"))));
+  EXPECT_EQ("echo", GetExternalExtensionLibraryName(
+      base::FilePath(FILE_PATH_LITERAL("echo.so"))));
+#endif
+}
+
+TEST(XWalkExtensionServerTest, ExtensionPermissions) {
+  std::set<std::string> permissions;
+  permissions.insert("tizen");
+  permissions.insert("echo");
+
+  NamedExtension echo("echo", "");
+  NamedExtension nested("tizen.bluetooth", "");
+  NamedExtension entry_point("other", "echo.sync");
+  NamedExtension prefix("echoes", "");
+  NamedExtension not_permitted("xwalk.tizen", "navigator.tizen");
+
+  EXPECT_TRUE(IsExtensionPermitted(&echo, permissions));
+  EXPECT_TRUE(IsExtensionPermitted(&nested, permissions));
+  EXPECT_TRUE(IsExtensionPermitted(&entry_point, permissions));
+  EXPECT_FALSE(IsExtensionPermitted(&prefix, permissions));
+  EXPECT_FALSE(IsExtensionPermitted(&not_permitted, permissions));
+  EXPECT_FALSE(IsExtensionPermitted(&echo, std::set<std::string>()));
+}
@@ -13,9 +13,36 @@ namespace switches {
 const char kXWalkDisableExtensionProcess[] =
     "disable-extension-process";
 
+// Don't keep an extension process launched in advance for the next render
+// process.
+const char kXWalkDisableWarmExtensionProcess[] =
+    "disable-warm-extension-process";
+
+// Create the extension instances and evaluate their JS API code as soon as
+// the script context is created, instead of waiting for the first access.
+const char kXWalkDisableLazyExtensionLoading[] =
+    "disable-lazy-extension-loading";
+
 // Used internally to launch an extension process.
 const char kXWalkExtensionProcess[] = "xwalk-extension-process";
 
+// Number of worker threads, and of idle IO threads kept, to run in-process
+// extensions instances. See XWalkExtensionThreadPool.
+const char kXWalkExtensionThreadPoolSize[] = "extension-thread-pool-size";
+
+// Use a single extension process for all render processes, instead of one
+// extension process per render process.
+const char kXWalkSharedExtensionProcess[] = "shared-extension-process";
+
+// Only load the external extensions libraries named in the permissions of the
+// application manifest, e.g. "echo" for libecho.so.
+const char kXWalkOnlyPermittedExternalExtensions[] =
+    "only-permitted-external-extensions";
+
+// Appends the messages received by extensions to the given file, to be
+// replayed by xesh. See XWalkExtensionMessageRecorder.
+const char kXWalkRecordExtensionMessages[] = "record-extension-messages";
+
 // Specifies where XWalk will look for external extensions.
 const char kXWalkExternalExtensionsPath[] = "external-extensions-path";
 
@@ -9,8 +9,14 @@
 namespace switches {
 
 extern const char kXWalkDisableExtensionProcess[];
+extern const char kXWalkDisableLazyExtensionLoading[];
+extern const char kXWalkDisableWarmExtensionProcess[];
 extern const char kXWalkExtensionProcess[];
+extern const char kXWalkExtensionThreadPoolSize[];
 extern const char kXWalkExternalExtensionsPath[];
+extern const char kXWalkOnlyPermittedExternalExtensions[];
+extern const char kXWalkRecordExtensionMessages[];
+extern const char kXWalkSharedExtensionProcess[];
 
 }  // namespace switches
 
@@ -21,15 +21,18 @@ XWalkExternalAdapter* XWalkExternalAdapter::GetInstance() {
 }
 
 XW_Extension XWalkExternalAdapter::GetNextXWExtension() {
+  base::AutoLock l(lock_);
   return next_xw_extension_++;
 }
 
 XW_Instance XWalkExternalAdapter::GetNextXWInstance() {
+  base::AutoLock l(lock_);
   return next_xw_instance_++;
 }
 
 void XWalkExternalAdapter::RegisterExtension(
     XWalkExternalExtension* extension) {
+  base::AutoLock l(lock_);
   XW_Extension xw_extension = extension->xw_extension_;
   CHECK(IsValidXWExtension(xw_extension));
   CHECK(!ContainsKey(extension_map_, xw_extension));
@@ -38,6 +41,7 @@ void XWalkExternalAdapter::RegisterExtension(
 
 void XWalkExternalAdapter::UnregisterExtension(
     XWalkExternalExtension* extension) {
+  base::AutoLock l(lock_);
   XW_Extension xw_extension = extension->xw_extension_;
   CHECK(IsValidXWExtension(xw_extension));
   CHECK(ContainsKey(extension_map_, xw_extension));
@@ -45,6 +49,7 @@ void XWalkExternalAdapter::UnregisterExtension(
 }
 
 void XWalkExternalAdapter::RegisterInstance(XWalkExternalInstance* context) {
+  base::AutoLock l(lock_);
   XW_Instance xw_instance = context->xw_instance_;
   CHECK(IsValidXWInstance(xw_instance));
   CHECK(!ContainsKey(instance_map_, xw_instance));
@@ -52,6 +57,7 @@ void XWalkExternalAdapter::RegisterInstance(XWalkExternalInstance* context) {
 }
 
 void XWalkExternalAdapter::UnregisterInstance(XWalkExternalInstance* context) {
+  base::AutoLock l(lock_);
   XW_Instance xw_instance = context->xw_instance_;
   CHECK(IsValidXWInstance(xw_instance));
   CHECK(ContainsKey(instance_map_, xw_instance));
@@ -79,6 +85,14 @@ const void* XWalkExternalAdapter::GetInterface(const char* name) {
     return &messagingInterface1;
   }
 
+  if (!strcmp(name, XW_BINARY_MESSAGING_INTERFACE_1)) {
+    static const XW_BinaryMessagingInterface_1 binaryMessagingInterface1 = {
+      BinaryMessagingRegister,
+      BinaryMessagingPostMessage
+    };
+    return &binaryMessagingInterface1;
+  }
+
   if (!strcmp(name, XW_INTERNAL_SYNC_MESSAGING_INTERFACE_1)) {
     static const XW_Internal_SyncMessagingInterface_1
         syncMessagingInterface1 = {
@@ -88,6 +102,16 @@ const void* XWalkExternalAdapter::GetInterface(const char* name) {
     return &syncMessagingInterface1;
   }
 
+  if (!strcmp(name, XW_INTERNAL_SYNC_MESSAGING_INTERFACE_2)) {
+    static const XW_Internal_SyncMessagingInterface_2
+        syncMessagingInterface2 = {
+      SyncMessagingRegister,
+      SyncMessagingSetSyncReply,
+      SyncMessagingSetSyncMessageTimeout
+    };
+    return &syncMessagingInterface2;
+  }
+
   if (!strcmp(name, XW_INTERNAL_ENTRY_POINTS_INTERFACE_1)) {
     static const XW_Internal_EntryPointsInterface_1 entryPointsInterface1 = {
       EntryPointsSetExtraJSEntryPoints
@@ -95,6 +119,14 @@ const void* XWalkExternalAdapter::GetInterface(const char* name) {
     return &entryPointsInterface1;
   }
 
+  if (!strcmp(name, XW_INTERNAL_MESSAGE_BATCHING_INTERFACE_1)) {
+    static const XW_Internal_MessageBatchingInterface_1
+        messageBatchingInterface1 = {
+      MessageBatchingEnableMessageBatching
+    };
+    return &messageBatchingInterface1;
+  }
+
   LOG(WARNING) << "Interface '" << name << "' is not supported.";
   return NULL;
 }
@@ -110,6 +142,7 @@ bool XWalkExternalAdapter::IsValidXWInstance(XW_Instance xw_instance) {
 XWalkExternalExtension* XWalkExternalAdapter::GetExtension(
     XW_Extension xw_extension) {
   XWalkExternalAdapter* adapter = XWalkExternalAdapter::GetInstance();
+  base::AutoLock l(adapter->lock_);
   ExtensionMap::iterator it = adapter->extension_map_.find(xw_extension);
   if (it == adapter->extension_map_.end())
     return NULL;
@@ -119,6 +152,7 @@ XWalkExternalExtension* XWalkExternalAdapter::GetExtension(
 XWalkExternalInstance* XWalkExternalAdapter::GetInstance(
     XW_Instance xw_instance) {
   XWalkExternalAdapter* adapter = XWalkExternalAdapter::GetInstance();
+  base::AutoLock l(adapter->lock_);
   InstanceMap::iterator it = adapter->instance_map_.find(xw_instance);
   if (it == adapter->instance_map_.end())
     return NULL;
@@ -7,9 +7,12 @@
 
 #include <map>
 #include "base/memory/singleton.h"
+#include "base/synchronization/lock.h"
 #include "xwalk/extensions/public/XW_Extension.h"
+#include "xwalk/extensions/public/XW_Extension_BinaryMessage.h"
 #include "xwalk/extensions/public/XW_Extension_SyncMessage.h"
 #include "xwalk/extensions/public/XW_Extension_EntryPoints.h"
+#include "xwalk/extensions/public/XW_Extension_MessageBatching.h"
 #include "xwalk/extensions/common/xwalk_external_extension.h"
 #include "xwalk/extensions/common/xwalk_external_instance.h"
 
@@ -17,6 +20,15 @@
 // GetInterface(). They dispatch the function to the appropriate
 // extension or instance.
 
+#define DEFINE_FUNCTION_0(TYPE, INTERFACE, NAME)                \
+  static void INTERFACE ## NAME(XW_ ## TYPE xw) {               \
+    XWalkExternal ## TYPE * ptr = Get ## TYPE(xw);              \
+    if (!ptr)                                                   \
+      LogInvalidCall(xw, #TYPE, #INTERFACE, #NAME);             \
+    else                                                        \
+      ptr->INTERFACE ## NAME();                                 \
+  }
+
 #define DEFINE_FUNCTION_1(TYPE, INTERFACE, NAME, ARG1)          \
   static void INTERFACE ## NAME(XW_ ## TYPE xw, ARG1 arg1) {    \
     XWalkExternal ## TYPE * ptr = Get ## TYPE(xw);              \
@@ -55,7 +67,8 @@ class XWalkExternalInstance;
 // Provides the "C Interfaces" defined in XW_Extension.h and maps the
 // functions from external extension to their implementations in
 // XWalkExternalExtension and XWalkExternalInstance. We have only one
-// adapter per process.
+// adapter per process, it can be used from any thread since extensions are
+// loaded in parallel and their instances may run in different threads.
 class XWalkExternalAdapter {
  public:
   static XWalkExternalAdapter* GetInstance();
@@ -109,10 +122,22 @@ class XWalkExternalAdapter {
   DEFINE_FUNCTION_1(Extension, Messaging, Register, XW_HandleMessageCallback);
   DEFINE_FUNCTION_1(Instance, Messaging, PostMessage, const char*);
 
-  // XW_Internal_SyncMessaging_1 from XW_Extension_SyncMessage.h.
+  // XW_BinaryMessagingInterface_1 from XW_Extension_BinaryMessage.h.
+  DEFINE_FUNCTION_1(Extension, BinaryMessaging, Register,
+                    XW_HandleBinaryMessageCallback);
+  DEFINE_FUNCTION_2(Instance, BinaryMessaging, PostMessage,
+                    const char*, size_t);
+
+  // XW_Internal_MessageBatchingInterface_1 from
+  // XW_Extension_MessageBatching.h.
+  DEFINE_FUNCTION_0(Extension, MessageBatching, EnableMessageBatching);
+
+  // XW_Internal_SyncMessaging_2 from XW_Extension_SyncMessage.h.
   DEFINE_FUNCTION_1(Extension, SyncMessaging, Register,
                     XW_HandleSyncMessageCallback);
   DEFINE_FUNCTION_1(Instance, SyncMessaging, SetSyncReply, const char*);
+  DEFINE_FUNCTION_1(Extension, SyncMessaging, SetSyncMessageTimeout,
+                    unsigned int);
 
   typedef std::map<XW_Extension, XWalkExternalExtension*> ExtensionMap;
   ExtensionMap extension_map_;
@@ -123,6 +148,9 @@ class XWalkExternalAdapter {
   XW_Extension next_xw_extension_;
   XW_Instance next_xw_instance_;
 
+  // Protects the maps and the counters above.
+  base::Lock lock_;
+
   DISALLOW_COPY_AND_ASSIGN(XWalkExternalAdapter);
 };
 
@@ -15,11 +15,14 @@ namespace xwalk {
 namespace extensions {
 
 XWalkExternalExtension::XWalkExternalExtension(const base::FilePath& path)
-    : xw_extension_(0),
+    : path_(path),
+      initialize_(NULL),
+      xw_extension_(0),
       created_instance_callback_(NULL),
       destroyed_instance_callback_(NULL),
       shutdown_callback_(NULL),
       handle_msg_callback_(NULL),
+      handle_binary_msg_callback_(NULL),
       handle_sync_msg_callback_(NULL),
       initialized_(false) {
   std::string error;
@@ -30,26 +33,36 @@ XWalkExternalExtension::XWalkExternalExtension(const base::FilePath& path)
     return;
   }
 
-  XW_Initialize_Func initialize = reinterpret_cast<XW_Initialize_Func>(
+  initialize_ = reinterpret_cast<XW_Initialize_Func>(
       library.GetFunctionPointer("XW_Initialize"));
-  if (!initialize) {
+  if (!initialize_) {
     LOG(WARNING) << "Error loading extension '" << path.AsUTF8Unsafe() << "': "
                  << "couldn't get XW_Initialize function.";
     return;
   }
 
+  library_.Reset(library.Release());
+}
+
+bool XWalkExternalExtension::Initialize() {
+  DCHECK(!initialized_);
+  if (!initialize_)
+    return false;
+
   XWalkExternalAdapter* external_adapter = XWalkExternalAdapter::GetInstance();
   xw_extension_ = external_adapter->GetNextXWExtension();
   external_adapter->RegisterExtension(this);
-  int ret = initialize(xw_extension_, XWalkExternalAdapter::GetInterface);
+  int ret = initialize_(xw_extension_, XWalkExternalAdapter::GetInterface);
   if (ret != XW_OK) {
-    LOG(WARNING) << "Error loading extension '" << path.AsUTF8Unsafe() << "': "
-                 << "XW_Initialize function returned error value.";
-    return;
+    LOG(WARNING) << "Error loading extension '" << path_.AsUTF8Unsafe()
+                 << "': XW_Initialize function returned error value.";
+    initialize_ = NULL;
+    library_.Reset(NULL);
+    return false;
   }
 
-  library_.Reset(library.Release());
   initialized_ = true;
+  return true;
 }
 
 XWalkExternalExtension::~XWalkExternalExtension() {
@@ -109,12 +122,29 @@ void XWalkExternalExtension::MessagingRegister(
   handle_msg_callback_ = callback;
 }
 
+void XWalkExternalExtension::BinaryMessagingRegister(
+    XW_HandleBinaryMessageCallback callback) {
+  RETURN_IF_INITIALIZED("Register from BinaryMessagingInterface");
+  handle_binary_msg_callback_ = callback;
+}
+
 void XWalkExternalExtension::SyncMessagingRegister(
     XW_HandleSyncMessageCallback callback) {
   RETURN_IF_INITIALIZED("Register from Internal_SyncMessagingInterface");
   handle_sync_msg_callback_ = callback;
 }
 
+void XWalkExternalExtension::SyncMessagingSetSyncMessageTimeout(
+    unsigned int timeout_ms) {
+  RETURN_IF_INITIALIZED("SetSyncMessageTimeout from SyncMessaging");
+  set_sync_message_timeout(base::TimeDelta::FromMilliseconds(timeout_ms));
+}
+
+void XWalkExternalExtension::MessageBatchingEnableMessageBatching() {
+  RETURN_IF_INITIALIZED("EnableMessageBatching from MessageBatching");
+  set_message_batching_enabled(true);
+}
+
 void XWalkExternalExtension::EntryPointsSetExtraJSEntryPoints(
     const char** entry_points) {
   RETURN_IF_INITIALIZED("SetExtraJSEntryPoints from EntryPoints");
@@ -6,15 +6,13 @@
 #define XWALK_EXTENSIONS_COMMON_XWALK_EXTERNAL_EXTENSION_H_
 
 #include <string>
+#include "base/files/file_path.h"
 #include "base/scoped_native_library.h"
 #include "xwalk/extensions/common/xwalk_extension.h"
 #include "xwalk/extensions/public/XW_Extension.h"
+#include "xwalk/extensions/public/XW_Extension_BinaryMessage.h"
 #include "xwalk/extensions/public/XW_Extension_SyncMessage.h"
 
-namespace base {
-class FilePath;
-};
-
 namespace xwalk {
 namespace extensions {
 
@@ -30,10 +28,16 @@ class XWalkExternalInstance;
 // library.
 class XWalkExternalExtension : public XWalkExtension {
  public:
+  // Loads the library at |path|, which is thread safe, so several libraries
+  // can be loaded at the same time.
   explicit XWalkExternalExtension(const base::FilePath& path);
 
   virtual ~XWalkExternalExtension();
 
+  // Calls XW_Initialize of the loaded library. The libraries don't expect to
+  // be initialized concurrently, so this is called on a single thread.
+  bool Initialize();
+
   bool is_valid();
 
  private:
@@ -52,19 +56,32 @@ class XWalkExternalExtension : public XWalkExtension {
   void CoreRegisterShutdownCallback(XW_ShutdownCallback callback);
   void EntryPointsSetExtraJSEntryPoints(const char** entry_points);
 
+  // XW_Internal_MessageBatchingInterface_1 (from
+  // XW_Extension_MessageBatching.h) implementation.
+  void MessageBatchingEnableMessageBatching();
+
   // XW_MessagingInterface_1 (from XW_Extension.h) implementation.
   void MessagingRegister(XW_HandleMessageCallback callback);
 
-  // XW_Internal_SyncMessagingInterface_1 (from XW_Extension.h) implementation.
+  // XW_BinaryMessagingInterface_1 (from XW_Extension_BinaryMessage.h)
+  // implementation.
+  void BinaryMessagingRegister(XW_HandleBinaryMessageCallback callback);
+
+  // XW_Internal_SyncMessagingInterface_2 (from XW_Extension_SyncMessage.h)
+  // implementation.
   void SyncMessagingRegister(XW_HandleSyncMessageCallback callback);
+  void SyncMessagingSetSyncMessageTimeout(unsigned int timeout_ms);
 
+  base::FilePath path_;
   base::ScopedNativeLibrary library_;
+  XW_Initialize_Func initialize_;
   XW_Extension xw_extension_;
 
   XW_CreatedInstanceCallback created_instance_callback_;
   XW_DestroyedInstanceCallback destroyed_instance_callback_;
   XW_ShutdownCallback shutdown_callback_;
   XW_HandleMessageCallback handle_msg_callback_;
+  XW_HandleBinaryMessageCallback handle_binary_msg_callback_;
   XW_HandleSyncMessageCallback handle_sync_msg_callback_;
 
   bool initialized_;
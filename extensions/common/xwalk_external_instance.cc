@@ -45,6 +45,21 @@ void XWalkExternalInstance::HandleMessage(scoped_ptr<base::Value> msg) {
   callback(xw_instance_, string_msg.c_str());
 }
 
+void XWalkExternalInstance::HandleBinaryMessage(const char* data,
+                                                size_t size) {
+  XW_HandleBinaryMessageCallback callback =
+      extension_->handle_binary_msg_callback_;
+  if (!callback) {
+    LOG(WARNING) << "Ignoring binary message sent for external extension '"
+                 << extension_->name() << "' which doesn't support it.";
+    return;
+  }
+
+  // The extension gets the buffer as received from the client, it is only
+  // valid during the callback so no copy is needed here.
+  callback(xw_instance_, data, size);
+}
+
 void XWalkExternalInstance::HandleSyncMessage(scoped_ptr<base::Value> msg) {
   XW_HandleSyncMessageCallback callback = extension_->handle_sync_msg_callback_;
   if (!callback) {
@@ -71,6 +86,11 @@ void XWalkExternalInstance::MessagingPostMessage(const char* msg) {
   PostMessageToJS(scoped_ptr<base::Value>(new base::StringValue(msg)));
 }
 
+void XWalkExternalInstance::BinaryMessagingPostMessage(const char* msg,
+                                                       size_t size) {
+  PostBinaryMessageToJS(msg, size);
+}
+
 void XWalkExternalInstance::SyncMessagingSetSyncReply(const char* reply) {
   SendSyncReplyToJS(scoped_ptr<base::Value>(new base::StringValue(reply)));
 }
@@ -8,6 +8,7 @@
 #include <string>
 #include "xwalk/extensions/common/xwalk_extension.h"
 #include "xwalk/extensions/public/XW_Extension.h"
+#include "xwalk/extensions/public/XW_Extension_BinaryMessage.h"
 #include "xwalk/extensions/public/XW_Extension_SyncMessage.h"
 
 namespace xwalk {
@@ -34,6 +35,7 @@ class XWalkExternalInstance : public XWalkExtensionInstance {
 
   // XWalkExtensionInstance implementation.
   virtual void HandleMessage(scoped_ptr<base::Value> msg) OVERRIDE;
+  virtual void HandleBinaryMessage(const char* data, size_t size) OVERRIDE;
   virtual void HandleSyncMessage(scoped_ptr<base::Value> msg) OVERRIDE;
 
   // XW_CoreInterface_1 (from XW_Extension.h) implementation.
@@ -43,6 +45,10 @@ class XWalkExternalInstance : public XWalkExtensionInstance {
   // XW_MessagingInterface_1 (from XW_Extension.h) implementation.
   void MessagingPostMessage(const char* msg);
 
+  // XW_BinaryMessagingInterface_1 (from XW_Extension_BinaryMessage.h)
+  // implementation.
+  void BinaryMessagingPostMessage(const char* msg, size_t size);
+
   // XW_Internal_SyncMessagingInterface_1 (from XW_Extension_SyncMessage.h)
   // implementation.
   void SyncMessagingSetSyncReply(const char* reply);
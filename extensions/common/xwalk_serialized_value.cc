@@ -0,0 +1,443 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/extensions/common/xwalk_serialized_value.h"
+
+#include <string.h>
+#include "base/logging.h"
+
+namespace xwalk {
+namespace extensions {
+
+namespace {
+
+// Same limit used by the IPC traits of base::Value.
+const int kMaxRecursionDepth = 100;
+
+// Ends the elements of a list (in place of a type) and the entries of a
+// dictionary (in place of a key length).
+const int kEndOfContainer = -1;
+
+// Same encoding as Pickle::WriteString(), without copying to a std::string.
+void WriteStringPiece(const base::StringPiece& s, Pickle* pickle) {
+  pickle->WriteInt(static_cast<int>(s.size()));
+  pickle->WriteBytes(s.data(), static_cast<int>(s.size()));
+}
+
+bool ReadStringPiece(PickleIterator* iter, base::StringPiece* out) {
+  int length;
+  const char* data;
+  if (!iter->ReadLength(&length) || !iter->ReadBytes(&data, length))
+    return false;
+  *out = base::StringPiece(data, length);
+  return true;
+}
+
+bool ReadDouble(PickleIterator* iter, double* out) {
+  const char* data;
+  if (!iter->ReadBytes(&data, sizeof(*out)))
+    return false;
+  memcpy(out, data, sizeof(*out));
+  return true;
+}
+
+// Reads the key of the next dictionary entry. Returns false at the end of
+// the dictionary, |*valid| tells whether the data was malformed.
+bool ReadDictionaryKey(PickleIterator* iter, base::StringPiece* key,
+                       bool* valid) {
+  int length;
+  const char* data;
+  *valid = false;
+  if (!iter->ReadInt(&length))
+    return false;
+  if (length == kEndOfContainer) {
+    *valid = true;
+    return false;
+  }
+  if (length < 0 || !iter->ReadBytes(&data, length))
+    return false;
+  *key = base::StringPiece(data, length);
+  *valid = true;
+  return true;
+}
+
+scoped_ptr<base::Value> CreateValue(int type, PickleIterator* iter);
+
+// Builds the next value of a list. Returns an empty scoped_ptr at the end.
+scoped_ptr<base::Value> CreateListElement(PickleIterator* iter) {
+  int type;
+  if (!iter->ReadInt(&type) || type == kEndOfContainer)
+    return scoped_ptr<base::Value>();
+  return CreateValue(type, iter);
+}
+
+// Builds a value in a single pass. The data was already validated by
+// XWalkSerializedValue::Read(), so no depth checks are done here.
+scoped_ptr<base::Value> CreateValue(int type, PickleIterator* iter) {
+  switch (type) {
+    case base::Value::TYPE_NULL:
+      return make_scoped_ptr(base::Value::CreateNullValue());
+    case base::Value::TYPE_BOOLEAN: {
+      bool b;
+      if (!iter->ReadBool(&b))
+        break;
+      return make_scoped_ptr<base::Value>(new base::FundamentalValue(b));
+    }
+    case base::Value::TYPE_INTEGER: {
+      int i;
+      if (!iter->ReadInt(&i))
+        break;
+      return make_scoped_ptr<base::Value>(new base::FundamentalValue(i));
+    }
+    case base::Value::TYPE_DOUBLE: {
+      double d;
+      if (!ReadDouble(iter, &d))
+        break;
+      return make_scoped_ptr<base::Value>(new base::FundamentalValue(d));
+    }
+    case base::Value::TYPE_STRING: {
+      base::StringPiece s;
+      if (!ReadStringPiece(iter, &s))
+        break;
+      return make_scoped_ptr<base::Value>(new base::StringValue(s.as_string()));
+    }
+    case base::Value::TYPE_LIST: {
+      scoped_ptr<base::ListValue> list(new base::ListValue);
+      for (;;) {
+        scoped_ptr<base::Value> element = CreateListElement(iter);
+        if (!element)
+          break;
+        list->Append(element.release());
+      }
+      return list.PassAs<base::Value>();
+    }
+    case base::Value::TYPE_DICTIONARY: {
+      scoped_ptr<base::DictionaryValue> dictionary(new base::DictionaryValue);
+      base::StringPiece key;
+      bool valid;
+      int entry_type;
+      while (ReadDictionaryKey(iter, &key, &valid) &&
+             iter->ReadInt(&entry_type)) {
+        scoped_ptr<base::Value> entry = CreateValue(entry_type, iter);
+        if (!entry)
+          break;
+        dictionary->SetWithoutPathExpansion(key.as_string(), entry.release());
+      }
+      return dictionary.PassAs<base::Value>();
+    }
+  }
+  return scoped_ptr<base::Value>();
+}
+
+}  // namespace
+
+XWalkSerializedValue::XWalkSerializedValue()
+    : type_(base::Value::TYPE_NULL),
+      size_(0) {}
+
+XWalkSerializedValue::~XWalkSerializedValue() {}
+
+// static
+bool XWalkSerializedValue::Read(PickleIterator* iter,
+                                XWalkSerializedValue* value) {
+  return ReadValue(iter, value, 0);
+}
+
+// static
+bool XWalkSerializedValue::ReadValue(PickleIterator* iter,
+                                     XWalkSerializedValue* value, int depth) {
+  if (depth > kMaxRecursionDepth)
+    return false;
+
+  int type;
+  if (!iter->ReadInt(&type))
+    return false;
+
+  value->iter_ = *iter;
+  value->size_ = 0;
+
+  switch (type) {
+    case base::Value::TYPE_NULL:
+      break;
+    case base::Value::TYPE_BOOLEAN: {
+      bool b;
+      if (!iter->ReadBool(&b))
+        return false;
+      break;
+    }
+    case base::Value::TYPE_INTEGER: {
+      int i;
+      if (!iter->ReadInt(&i))
+        return false;
+      break;
+    }
+    case base::Value::TYPE_DOUBLE: {
+      double d;
+      if (!ReadDouble(iter, &d))
+        return false;
+      break;
+    }
+    case base::Value::TYPE_STRING: {
+      base::StringPiece s;
+      if (!ReadStringPiece(iter, &s))
+        return false;
+      break;
+    }
+    case base::Value::TYPE_LIST: {
+      XWalkSerializedValue element;
+      for (;;) {
+        PickleIterator next = *iter;
+        int element_type;
+        if (!next.ReadInt(&element_type))
+          return false;
+        if (element_type == kEndOfContainer) {
+          *iter = next;
+          break;
+        }
+        if (!ReadValue(iter, &element, depth + 1))
+          return false;
+        value->size_++;
+      }
+      break;
+    }
+    case base::Value::TYPE_DICTIONARY: {
+      XWalkSerializedValue entry;
+      base::StringPiece key;
+      bool valid;
+      while (ReadDictionaryKey(iter, &key, &valid)) {
+        if (!ReadValue(iter, &entry, depth + 1))
+          return false;
+        value->size_++;
+      }
+      if (!valid)
+        return false;
+      break;
+    }
+    default:
+      return false;
+  }
+
+  value->type_ = static_cast<base::Value::Type>(type);
+  return true;
+}
+
+// static
+void XWalkSerializedValue::Write(const base::Value& value, Pickle* pickle) {
+  switch (value.GetType()) {
+    case base::Value::TYPE_BOOLEAN: {
+      bool b;
+      value.GetAsBoolean(&b);
+      WriteBoolean(b, pickle);
+      break;
+    }
+    case base::Value::TYPE_INTEGER: {
+      int i;
+      value.GetAsInteger(&i);
+      WriteInteger(i, pickle);
+      break;
+    }
+    case base::Value::TYPE_DOUBLE: {
+      double d;
+      value.GetAsDouble(&d);
+      WriteDouble(d, pickle);
+      break;
+    }
+    case base::Value::TYPE_STRING: {
+      std::string s;
+      value.GetAsString(&s);
+      WriteString(s, pickle);
+      break;
+    }
+    case base::Value::TYPE_LIST: {
+      const base::ListValue* list;
+      value.GetAsList(&list);
+      BeginList(pickle);
+      for (base::ListValue::const_iterator it = list->begin();
+           it != list->end(); ++it)
+        Write(**it, pickle);
+      EndContainer(pickle);
+      break;
+    }
+    case base::Value::TYPE_DICTIONARY: {
+      const base::DictionaryValue* dictionary;
+      value.GetAsDictionary(&dictionary);
+      BeginDictionary(pickle);
+      for (base::DictionaryValue::Iterator it(*dictionary); !it.IsAtEnd();
+           it.Advance()) {
+        WriteKey(it.key(), pickle);
+        Write(it.value(), pickle);
+      }
+      EndContainer(pickle);
+      break;
+    }
+    case base::Value::TYPE_BINARY:
+      NOTREACHED() << "Binary values should be sent as binary messages.";
+      // Fall through.
+    case base::Value::TYPE_NULL:
+      WriteNull(pickle);
+      break;
+  }
+}
+
+// static
+void XWalkSerializedValue::WriteNull(Pickle* pickle) {
+  pickle->WriteInt(base::Value::TYPE_NULL);
+}
+
+// static
+void XWalkSerializedValue::WriteBoolean(bool value, Pickle* pickle) {
+  pickle->WriteInt(base::Value::TYPE_BOOLEAN);
+  pickle->WriteBool(value);
+}
+
+// static
+void XWalkSerializedValue::WriteInteger(int value, Pickle* pickle) {
+  pickle->WriteInt(base::Value::TYPE_INTEGER);
+  pickle->WriteInt(value);
+}
+
+// static
+void XWalkSerializedValue::WriteDouble(double value, Pickle* pickle) {
+  pickle->WriteInt(base::Value::TYPE_DOUBLE);
+  pickle->WriteBytes(&value, sizeof(value));
+}
+
+// static
+void XWalkSerializedValue::WriteString(const base::StringPiece& value,
+                                       Pickle* pickle) {
+  pickle->WriteInt(base::Value::TYPE_STRING);
+  WriteStringPiece(value, pickle);
+}
+
+// static
+void XWalkSerializedValue::BeginList(Pickle* pickle) {
+  pickle->WriteInt(base::Value::TYPE_LIST);
+}
+
+// static
+void XWalkSerializedValue::BeginDictionary(Pickle* pickle) {
+  pickle->WriteInt(base::Value::TYPE_DICTIONARY);
+}
+
+// static
+void XWalkSerializedValue::WriteKey(const base::StringPiece& key,
+                                    Pickle* pickle) {
+  WriteStringPiece(key, pickle);
+}
+
+// static
+void XWalkSerializedValue::EndContainer(Pickle* pickle) {
+  pickle->WriteInt(kEndOfContainer);
+}
+
+bool XWalkSerializedValue::GetAsBoolean(bool* out) const {
+  if (type_ != base::Value::TYPE_BOOLEAN)
+    return false;
+  PickleIterator iter = iter_;
+  return iter.ReadBool(out);
+}
+
+bool XWalkSerializedValue::GetAsInteger(int* out) const {
+  if (type_ != base::Value::TYPE_INTEGER)
+    return false;
+  PickleIterator iter = iter_;
+  return iter.ReadInt(out);
+}
+
+bool XWalkSerializedValue::GetAsDouble(double* out) const {
+  PickleIterator iter = iter_;
+  if (type_ == base::Value::TYPE_INTEGER) {
+    int i;
+    if (!iter.ReadInt(&i))
+      return false;
+    *out = i;
+    return true;
+  }
+  if (type_ != base::Value::TYPE_DOUBLE)
+    return false;
+  return ReadDouble(&iter, out);
+}
+
+bool XWalkSerializedValue::GetAsString(std::string* out) const {
+  base::StringPiece s;
+  if (!GetAsString(&s))
+    return false;
+  s.CopyToString(out);
+  return true;
+}
+
+bool XWalkSerializedValue::GetAsString(base::StringPiece* out) const {
+  if (type_ != base::Value::TYPE_STRING)
+    return false;
+  PickleIterator iter = iter_;
+  return ReadStringPiece(&iter, out);
+}
+
+bool XWalkSerializedValue::Get(size_t index, XWalkSerializedValue* out) const {
+  if (type_ != base::Value::TYPE_LIST || index >= size_)
+    return false;
+  Iterator it(*this);
+  for (size_t i = 0; i <= index; ++i) {
+    if (!it.Next())
+      return false;
+  }
+  *out = it.value();
+  return true;
+}
+
+bool XWalkSerializedValue::Get(const base::StringPiece& key,
+                               XWalkSerializedValue* out) const {
+  if (type_ != base::Value::TYPE_DICTIONARY)
+    return false;
+  Iterator it(*this);
+  while (it.Next()) {
+    if (it.key() == key) {
+      *out = it.value();
+      return true;
+    }
+  }
+  return false;
+}
+
+scoped_ptr<base::Value> XWalkSerializedValue::ToValue() const {
+  PickleIterator iter = iter_;
+  return CreateValue(type_, &iter);
+}
+
+XWalkSerializedValue::Iterator::Iterator(
+    const XWalkSerializedValue& container)
+    : iter_(container.iter_),
+      is_dictionary_(container.type_ == base::Value::TYPE_DICTIONARY),
+      done_(container.type_ != base::Value::TYPE_LIST && !is_dictionary_) {}
+
+XWalkSerializedValue::Iterator::~Iterator() {}
+
+bool XWalkSerializedValue::Iterator::Next() {
+  if (done_)
+    return false;
+
+  if (is_dictionary_) {
+    bool valid;
+    if (!ReadDictionaryKey(&iter_, &key_, &valid)) {
+      done_ = true;
+      return false;
+    }
+  } else {
+    PickleIterator next = iter_;
+    int type;
+    if (!next.ReadInt(&type) || type == kEndOfContainer) {
+      done_ = true;
+      return false;
+    }
+  }
+
+  if (!Read(&iter_, &value_)) {
+    done_ = true;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace extensions
+}  // namespace xwalk
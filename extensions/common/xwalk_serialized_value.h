@@ -0,0 +1,120 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef XWALK_EXTENSIONS_COMMON_XWALK_SERIALIZED_VALUE_H_
+#define XWALK_EXTENSIONS_COMMON_XWALK_SERIALIZED_VALUE_H_
+
+#include <stddef.h>
+#include <string>
+#include "base/memory/scoped_ptr.h"
+#include "base/pickle.h"
+#include "base/strings/string_piece.h"
+#include "base/values.h"
+
+namespace xwalk {
+namespace extensions {
+
+// Read-only view of a message written directly into an IPC message by the
+// Render Process (see SerializeV8Value()), so posting a message from JS
+// doesn't need to build a base::Value tree on either side. The view points
+// to the memory of the IPC message and is only valid while it is alive.
+//
+// A value is written as its base::Value::Type followed by the contents:
+// booleans, integers, doubles and strings use the Pickle encoding, lists and
+// dictionaries are followed by their elements (dictionary entries are the key
+// followed by the value) and a terminator. Binary values are not supported.
+class XWalkSerializedValue {
+ public:
+  class Iterator;
+
+  XWalkSerializedValue();
+  ~XWalkSerializedValue();
+
+  // Reads a value from |iter| into |value| and moves |iter| past it. The
+  // whole value is validated, so the accessors below can be used without
+  // further checks. Returns false if the data is malformed.
+  static bool Read(PickleIterator* iter, XWalkSerializedValue* value);
+
+  // Writes |value| with the same encoding. Used where the message is already
+  // a base::Value, and to produce messages in tests.
+  static void Write(const base::Value& value, Pickle* pickle);
+
+  // Used to write values that are not base::Values, see SerializeV8Value().
+  // A container is written by calling its Begin function, writing the
+  // elements (for dictionaries, WriteKey() followed by the value) and calling
+  // EndContainer().
+  static void WriteNull(Pickle* pickle);
+  static void WriteBoolean(bool value, Pickle* pickle);
+  static void WriteInteger(int value, Pickle* pickle);
+  static void WriteDouble(double value, Pickle* pickle);
+  static void WriteString(const base::StringPiece& value, Pickle* pickle);
+  static void BeginList(Pickle* pickle);
+  static void BeginDictionary(Pickle* pickle);
+  static void WriteKey(const base::StringPiece& key, Pickle* pickle);
+  static void EndContainer(Pickle* pickle);
+
+  base::Value::Type type() const { return type_; }
+  bool IsType(base::Value::Type type) const { return type_ == type; }
+
+  // Same semantics as the base::Value accessors, integers can be read as
+  // doubles. The StringPiece version points to the message memory instead
+  // of copying the contents.
+  bool GetAsBoolean(bool* out) const;
+  bool GetAsInteger(int* out) const;
+  bool GetAsDouble(double* out) const;
+  bool GetAsString(std::string* out) const;
+  bool GetAsString(base::StringPiece* out) const;
+
+  // Number of elements of a list or entries of a dictionary, zero for other
+  // types.
+  size_t size() const { return size_; }
+
+  // Looks up an element of a list or an entry of a dictionary. These are
+  // linear, use Iterator to go through all of them.
+  bool Get(size_t index, XWalkSerializedValue* out) const;
+  bool Get(const base::StringPiece& key, XWalkSerializedValue* out) const;
+
+  // Builds the equivalent base::Value, for code that needs one.
+  scoped_ptr<base::Value> ToValue() const;
+
+ private:
+  static bool ReadValue(PickleIterator* iter, XWalkSerializedValue* value,
+                        int depth);
+
+  base::Value::Type type_;
+
+  // Positioned right after the type.
+  PickleIterator iter_;
+  size_t size_;
+};
+
+// Iterates over the elements of a list or the entries of a dictionary:
+//
+//   XWalkSerializedValue::Iterator it(dictionary);
+//   while (it.Next())
+//     DoSomething(it.key(), it.value());
+class XWalkSerializedValue::Iterator {
+ public:
+  explicit Iterator(const XWalkSerializedValue& container);
+  ~Iterator();
+
+  // Moves to the next element, returns false when there are no more.
+  bool Next();
+
+  // Only valid for dictionaries.
+  const base::StringPiece& key() const { return key_; }
+  const XWalkSerializedValue& value() const { return value_; }
+
+ private:
+  PickleIterator iter_;
+  bool is_dictionary_;
+  bool done_;
+  base::StringPiece key_;
+  XWalkSerializedValue value_;
+};
+
+}  // namespace extensions
+}  // namespace xwalk
+
+#endif  // XWALK_EXTENSIONS_COMMON_XWALK_SERIALIZED_VALUE_H_
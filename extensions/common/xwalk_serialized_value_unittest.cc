@@ -0,0 +1,153 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/extensions/common/xwalk_serialized_value.h"
+
+#include <string>
+#include "base/pickle.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/values.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+using xwalk::extensions::XWalkSerializedValue;
+
+namespace {
+
+scoped_ptr<base::DictionaryValue> CreatePerson(int i) {
+  scoped_ptr<base::DictionaryValue> person(new base::DictionaryValue);
+  person->SetString("name", "Person " + base::IntToString(i));
+  person->SetInteger("age", i % 100);
+  person->SetDouble("height", 1.5 + i / 1000.0);
+  person->SetBoolean("active", i % 2 == 0);
+  return person.Pass();
+}
+
+// Same shape as the messages sent through XWalkExtensionFunctionHandler:
+// function name, callback id and the arguments.
+scoped_ptr<base::ListValue> CreateFunctionMessage(int size) {
+  scoped_ptr<base::ListValue> persons(new base::ListValue);
+  for (int i = 0; i < size; ++i)
+    persons->Append(CreatePerson(i).release());
+
+  scoped_ptr<base::ListValue> msg(new base::ListValue);
+  msg->AppendString("addPersons");
+  msg->AppendString("42");
+  msg->Append(persons.release());
+  return msg.Pass();
+}
+
+}  // namespace
+
+TEST(XWalkSerializedValueTest, RoundTrip) {
+  base::DictionaryValue dictionary;
+  dictionary.SetWithoutPathExpansion("null", base::Value::CreateNullValue());
+  dictionary.SetWithoutPathExpansion("with.dot",
+                                     base::Value::CreateStringValue("x"));
+  dictionary.SetString("empty", "");
+  dictionary.SetInteger("int", -7);
+  dictionary.SetDouble("double", 3.25);
+  dictionary.SetBoolean("bool", true);
+  dictionary.Set("list", CreateFunctionMessage(3).release());
+  dictionary.Set("empty_list", new base::ListValue);
+  dictionary.Set("empty_dictionary", new base::DictionaryValue);
+
+  Pickle pickle;
+  XWalkSerializedValue::Write(dictionary, &pickle);
+
+  PickleIterator iter(pickle);
+  XWalkSerializedValue value;
+  ASSERT_TRUE(XWalkSerializedValue::Read(&iter, &value));
+  EXPECT_TRUE(value.IsType(base::Value::TYPE_DICTIONARY));
+  EXPECT_EQ(dictionary.size(), value.size());
+
+  scoped_ptr<base::Value> result = value.ToValue();
+  ASSERT_TRUE(result);
+  EXPECT_TRUE(dictionary.Equals(result.get()));
+}
+
+TEST(XWalkSerializedValueTest, Accessors) {
+  scoped_ptr<base::ListValue> msg = CreateFunctionMessage(5);
+  Pickle pickle;
+  XWalkSerializedValue::Write(*msg, &pickle);
+
+  PickleIterator iter(pickle);
+  XWalkSerializedValue value;
+  ASSERT_TRUE(XWalkSerializedValue::Read(&iter, &value));
+  ASSERT_EQ(3u, value.size());
+
+  XWalkSerializedValue element;
+  std::string s;
+  ASSERT_TRUE(value.Get(0, &element));
+  EXPECT_TRUE(element.GetAsString(&s));
+  EXPECT_EQ("addPersons", s);
+  EXPECT_FALSE(value.Get(3, &element));
+
+  XWalkSerializedValue persons;
+  ASSERT_TRUE(value.Get(2, &persons));
+  EXPECT_EQ(5u, persons.size());
+
+  int count = 0;
+  XWalkSerializedValue::Iterator it(persons);
+  while (it.Next()) {
+    XWalkSerializedValue field;
+    int age;
+    double height;
+    base::StringPiece name;
+    ASSERT_TRUE(it.value().Get("age", &field));
+    EXPECT_TRUE(field.GetAsInteger(&age));
+    EXPECT_EQ(count, age);
+    // Integers can be read as doubles, but not the other way around.
+    EXPECT_TRUE(field.GetAsDouble(&height));
+    ASSERT_TRUE(it.value().Get("height", &field));
+    EXPECT_FALSE(field.GetAsInteger(&age));
+    ASSERT_TRUE(it.value().Get("name", &field));
+    EXPECT_TRUE(field.GetAsString(&name));
+    EXPECT_EQ("Person " + base::IntToString(count), name.as_string());
+    EXPECT_FALSE(it.value().Get("missing", &field));
+    count++;
+  }
+  EXPECT_EQ(5, count);
+}
+
+TEST(XWalkSerializedValueTest, RejectsMalformedData) {
+  XWalkSerializedValue value;
+
+  // List without terminator.
+  Pickle truncated;
+  truncated.WriteInt(base::Value::TYPE_LIST);
+  truncated.WriteInt(base::Value::TYPE_INTEGER);
+  truncated.WriteInt(1);
+  PickleIterator truncated_iter(truncated);
+  EXPECT_FALSE(XWalkSerializedValue::Read(&truncated_iter, &value));
+
+  // Binary values and unknown types.
+  Pickle binary;
+  binary.WriteInt(base::Value::TYPE_BINARY);
+  PickleIterator binary_iter(binary);
+  EXPECT_FALSE(XWalkSerializedValue::Read(&binary_iter, &value));
+
+  Pickle unknown;
+  unknown.WriteInt(1234);
+  PickleIterator unknown_iter(unknown);
+  EXPECT_FALSE(XWalkSerializedValue::Read(&unknown_iter, &value));
+
+  // String longer than the data.
+  Pickle bad_string;
+  bad_string.WriteInt(base::Value::TYPE_STRING);
+  bad_string.WriteInt(100);
+  PickleIterator bad_string_iter(bad_string);
+  EXPECT_FALSE(XWalkSerializedValue::Read(&bad_string_iter, &value));
+
+  // Too deep.
+  scoped_ptr<base::Value> deep(new base::ListValue);
+  for (int i = 0; i < 200; ++i) {
+    base::ListValue* list = new base::ListValue;
+    list->Append(deep.release());
+    deep.reset(list);
+  }
+  Pickle deep_pickle;
+  XWalkSerializedValue::Write(*deep, &deep_pickle);
+  PickleIterator deep_iter(deep_pickle);
+  EXPECT_FALSE(XWalkSerializedValue::Read(&deep_iter, &value));
+}
@@ -5,6 +5,9 @@
 #ifndef XWALK_EXTENSIONS_EXTENSION_PROCESS_XWALK_EXTENSION_PROCESS_H_
 #define XWALK_EXTENSIONS_EXTENSION_PROCESS_XWALK_EXTENSION_PROCESS_H_
 
+#include <map>
+#include <string>
+#include <vector>
 #include "base/values.h"
 #include "base/synchronization/waitable_event.h"
 #include "base/threading/thread.h"
@@ -30,9 +33,13 @@ class XWalkExtensionRunner;
 // This class represents the Extension Process itself.
 // It not only represents the extension side of the browser <->
 // extension process communication channel, but also the extension side
-// of the extension <-> render process channel.
+// of the extension <-> render process channels.
 // It will be responsible for handling the native side (instances) of
-// External extensions through its XWalkExtensionServer.
+// External extensions through its XWalkExtensionServers.
+//
+// The extensions are loaded only once, but each render process served gets
+// its own channel and XWalkExtensionServer, so an Extension Process can be
+// shared by several render processes.
 class XWalkExtensionProcess : public IPC::Listener {
  public:
   XWalkExtensionProcess();
@@ -43,17 +50,31 @@ class XWalkExtensionProcess : public IPC::Listener {
   virtual bool OnMessageReceived(const IPC::Message& message) OVERRIDE;
 
   // Handlers for IPC messages from XWalkExtensionProcessHost.
-  void OnRegisterExtensions(const base::FilePath& extension_path);
+  void OnRegisterExtensions(const base::FilePath& extension_path,
+                            const std::vector<std::string>& allowed_libraries,
+                            const std::vector<std::string>& permissions);
+  void OnCreateRenderProcessChannel(int render_process_id);
+  void OnCloseRenderProcessChannel(int render_process_id);
 
   void CreateBrowserProcessChannel();
-  void CreateRenderProcessChannel();
+
+  struct RenderProcessChannel {
+    RenderProcessChannel();
+    ~RenderProcessChannel();
+    XWalkExtensionServer server;
+    scoped_ptr<IPC::SyncChannel> channel;
+  };
 
   base::WaitableEvent shutdown_event_;
   base::Thread io_thread_;
   scoped_ptr<IPC::SyncChannel> browser_process_channel_;
+
+  // Owns the loaded extensions, the servers in |render_process_channels_|
+  // only refer to them.
   XWalkExtensionServer extensions_server_;
-  scoped_ptr<IPC::SyncChannel> render_process_channel_;
-  IPC::ChannelHandle rp_channel_handle_;
+
+  typedef std::map<int, RenderProcessChannel*> RenderProcessChannelMap;
+  RenderProcessChannelMap render_process_channels_;
 
   DISALLOW_COPY_AND_ASSIGN(XWalkExtensionProcess);
 };
@@ -15,6 +15,8 @@
         '../../build/filename_rules.gypi',
       ],
       'sources': [
+        'browser/xwalk_extension_code_cache_store.cc',
+        'browser/xwalk_extension_code_cache_store.h',
         'browser/xwalk_extension_data.cc',
         'browser/xwalk_extension_data.h',
         'browser/xwalk_extension_function_handler.cc',
@@ -23,12 +25,22 @@
         'browser/xwalk_extension_process_host.h',
         'browser/xwalk_extension_service.cc',
         'browser/xwalk_extension_service.h',
+        'browser/xwalk_extension_thread_pool.cc',
+        'browser/xwalk_extension_thread_pool.h',
         'common/android/xwalk_extension_android.cc',
         'common/android/xwalk_extension_android.h',
         'common/xwalk_extension.cc',
         'common/xwalk_extension.h',
+        'common/xwalk_extension_binary_message.cc',
+        'common/xwalk_extension_binary_message.h',
+        'common/xwalk_extension_message_batch.cc',
+        'common/xwalk_extension_message_batch.h',
+        'common/xwalk_extension_message_recorder.cc',
+        'common/xwalk_extension_message_recorder.h',
         'common/xwalk_extension_messages.cc',
         'common/xwalk_extension_messages.h',
+        'common/xwalk_extension_messaging_stats.cc',
+        'common/xwalk_extension_messaging_stats.h',
         'common/xwalk_extension_server.cc',
         'common/xwalk_extension_server.h',
         'common/xwalk_extension_switches.cc',
@@ -40,14 +52,20 @@
         'common/xwalk_external_extension.h',
         'common/xwalk_external_instance.cc',
         'common/xwalk_external_instance.h',
+        'common/xwalk_serialized_value.cc',
+        'common/xwalk_serialized_value.h',
         'extension_process/xwalk_extension_process.cc',
         'extension_process/xwalk_extension_process.h',
         'extension_process/xwalk_extension_process_main.cc',
         'extension_process/xwalk_extension_process_main.h',
         'public/XW_Extension.h',
+        'public/XW_Extension_BinaryMessage.h',
+        'public/XW_Extension_MessageBatching.h',
         'public/XW_Extension_SyncMessage.h',
         'renderer/xwalk_extension_client.cc',
         'renderer/xwalk_extension_client.h',
+        'renderer/xwalk_extension_code_cache.cc',
+        'renderer/xwalk_extension_code_cache.h',
         'renderer/xwalk_extension_module.cc',
         'renderer/xwalk_extension_module.h',
         'renderer/xwalk_extension_renderer_controller.cc',
@@ -59,6 +77,8 @@
         'renderer/xwalk_module_system.h',
         'renderer/xwalk_v8_utils.cc',
         'renderer/xwalk_v8_utils.h',
+        'renderer/xwalk_v8_value_serializer.cc',
+        'renderer/xwalk_v8_value_serializer.h',
         'renderer/xwalk_v8tools_module.cc',
         'renderer/xwalk_v8tools_module.h',
       ],
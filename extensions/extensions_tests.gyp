@@ -6,12 +6,18 @@
       'dependencies': [
         '../../base/base.gyp:base',
         '../../base/base.gyp:run_all_unittests',
+        '../../content/content_shell_and_tests.gyp:test_support_content',
+        '../../ipc/ipc.gyp:ipc',
         '../../testing/gtest.gyp:gtest',
+        '../../v8/tools/gyp/v8.gyp:v8',
         'extensions.gyp:xwalk_extensions',
       ],
       'sources': [
+        'browser/xwalk_extension_code_cache_store_unittest.cc',
         'browser/xwalk_extension_function_handler_unittest.cc',
         'common/xwalk_extension_server_unittest.cc',
+        'common/xwalk_serialized_value_unittest.cc',
+        'renderer/xwalk_v8_value_serializer_unittest.cc',
       ],
     },
     {
@@ -60,5 +66,37 @@
         'test/xwalk_extensions_test_base.h',
       ],
     },
+    {
+      # Reports numbers instead of checking behavior, see
+      # test/xwalk_extensions_benchmark.cc, test/first_paint.cc and
+      # test/serialized_message_benchmark.cc.
+      'target_name': 'xwalk_extensions_benchmark',
+      'type': 'executable',
+      'dependencies': [
+        '../../base/base.gyp:base',
+        '../../content/content.gyp:content_browser',
+        '../../content/content_shell_and_tests.gyp:test_support_content',
+        '../../ipc/ipc.gyp:ipc',
+        '../../net/net.gyp:net',
+        '../../testing/gtest.gyp:gtest',
+        '../../v8/tools/gyp/v8.gyp:v8',
+        '../test/base/base.gyp:xwalk_test_base',
+        '../xwalk.gyp:xwalk_runtime',
+        'extensions.gyp:xwalk_extensions',
+        'extensions_resources.gyp:xwalk_extensions_resources',
+        'external_extension_sample.gyp:benchmark_extension',
+        'external_extension_sample.gyp:echo_extension',
+      ],
+      'defines': [
+        'HAS_OUT_OF_PROC_TEST_RUNNER',
+      ],
+      'sources': [
+        'test/first_paint.cc',
+        'test/serialized_message_benchmark.cc',
+        'test/xwalk_extensions_benchmark.cc',
+        'test/xwalk_extensions_test_base.cc',
+        'test/xwalk_extensions_test_base.h',
+      ],
+    },
   ],
 }
@@ -0,0 +1,62 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef XWALK_EXTENSIONS_PUBLIC_XW_EXTENSION_BINARYMESSAGE_H_
+#define XWALK_EXTENSIONS_PUBLIC_XW_EXTENSION_BINARYMESSAGE_H_
+
+#ifndef XWALK_EXTENSIONS_PUBLIC_XW_EXTENSION_H_
+#error "You should include XW_Extension.h before this file"
+#endif
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// XW_BINARY_MESSAGING_INTERFACE: Exchange asynchronous messages made of
+// arbitrary bytes with JavaScript code provided by extension. Unlike
+// XW_MESSAGING_INTERFACE, the contents are not required to be a NUL
+// terminated UTF-8 string and are not converted along the way, so this is
+// the interface to use for media frames and other large payloads.
+//
+// In JavaScript, binary messages are exchanged using the functions
+// extension.postBinaryMessage(), which takes an ArrayBuffer or an
+// ArrayBufferView, and extension.setBinaryMessageListener(), whose callback
+// receives an ArrayBuffer.
+//
+
+#define XW_BINARY_MESSAGING_INTERFACE_1 "XW_BinaryMessagingInterface_1"
+#define XW_BINARY_MESSAGING_INTERFACE XW_BINARY_MESSAGING_INTERFACE_1
+
+typedef void (*XW_HandleBinaryMessageCallback)(XW_Instance instance,
+                                               const char* message,
+                                               size_t size);
+
+struct XW_BinaryMessagingInterface_1 {
+  // Register a callback to be called when the JavaScript code associated
+  // with the extension posts a binary message. The memory pointed by
+  // 'message' is owned by Crosswalk and is only valid during the execution
+  // of the callback.
+  void (*Register)(XW_Extension extension,
+                   XW_HandleBinaryMessageCallback handle_message);
+
+  // Post 'size' bytes starting at 'message' to the web content associated
+  // with the instance. The contents are copied before this function returns.
+  // To receive this message the extension's JavaScript code should set a
+  // listener using extension.setBinaryMessageListener() function.
+  //
+  // This function is thread-safe and can be called until the instance is
+  // destroyed.
+  void (*PostMessage)(XW_Instance instance, const char* message, size_t size);
+};
+
+typedef struct XW_BinaryMessagingInterface_1 XW_BinaryMessagingInterface;
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // XWALK_EXTENSIONS_PUBLIC_XW_EXTENSION_BINARYMESSAGE_H_
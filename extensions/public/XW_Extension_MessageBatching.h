@@ -0,0 +1,47 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef XWALK_EXTENSIONS_PUBLIC_XW_EXTENSION_MESSAGEBATCHING_H_
+#define XWALK_EXTENSIONS_PUBLIC_XW_EXTENSION_MESSAGEBATCHING_H_
+
+// NOTE: This file and interfaces marked as internal are not considered stable
+// and can be modified in incompatible ways between Crosswalk versions.
+
+#ifndef XWALK_EXTENSIONS_PUBLIC_XW_EXTENSION_H_
+#error "You should include XW_Extension.h before this file"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define XW_INTERNAL_MESSAGE_BATCHING_INTERFACE_1 \
+  "XW_Internal_MessageBatchingInterface_1"
+#define XW_INTERNAL_MESSAGE_BATCHING_INTERFACE \
+  XW_INTERNAL_MESSAGE_BATCHING_INTERFACE_1
+
+//
+// XW_INTERNAL_MESSAGE_BATCHING_INTERFACE: allow extensions that post many
+// small messages (e.g. sensor readings or socket data) to have them coalesced
+// into fewer IPC messages. Messages are still delivered one by one and in the
+// same order to the listeners, but may be delayed until the end of the
+// current message loop turn.
+//
+
+struct XW_Internal_MessageBatchingInterface_1 {
+  // Enable batching of the messages exchanged between this extension and its
+  // JavaScript code, in both directions.
+  //
+  // This function should be called only during XW_Initialize().
+  void (*EnableMessageBatching)(XW_Extension extension);
+};
+
+typedef struct XW_Internal_MessageBatchingInterface_1
+    XW_Internal_MessageBatchingInterface;
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // XWALK_EXTENSIONS_PUBLIC_XW_EXTENSION_MESSAGEBATCHING_H_
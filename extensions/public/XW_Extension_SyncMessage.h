@@ -23,11 +23,18 @@ extern "C" {
 // function, that can be done from outside the context of the SyncMessage
 // handler.
 //
+// The same handler also serves extension.internal.sendRequest(), which
+// doesn't block the JavaScript code: the reply resolves a promise instead.
+// Messages of both kinds are handed to the extension one at a time, the next
+// one only after SetSyncReply was called for the previous.
+//
 
 #define XW_INTERNAL_SYNC_MESSAGING_INTERFACE_1 \
   "XW_InternalSyncMessagingInterface_1"
+#define XW_INTERNAL_SYNC_MESSAGING_INTERFACE_2 \
+  "XW_InternalSyncMessagingInterface_2"
 #define XW_INTERNAL_SYNC_MESSAGING_INTERFACE \
-  XW_INTERNAL_SYNC_MESSAGING_INTERFACE_1
+  XW_INTERNAL_SYNC_MESSAGING_INTERFACE_2
 
 typedef void (*XW_HandleSyncMessageCallback)(XW_Instance instance,
                                              const char* message);
@@ -38,7 +45,22 @@ struct XW_Internal_SyncMessagingInterface_1 {
   void (*SetSyncReply)(XW_Instance instance, const char* reply);
 };
 
-typedef struct XW_Internal_SyncMessagingInterface_1
+struct XW_Internal_SyncMessagingInterface_2 {
+  void (*Register)(XW_Extension extension,
+                   XW_HandleSyncMessageCallback handle_sync_message);
+  void (*SetSyncReply)(XW_Instance instance, const char* reply);
+
+  // Maximum time, in milliseconds, the JavaScript code waits for the reply
+  // of a synchronous message. When it expires sendSyncMessage() throws an
+  // exception, and the reply that arrives later is dropped. Zero, the
+  // default, means no limit.
+  //
+  // This function should be called only during XW_Initialize().
+  void (*SetSyncMessageTimeout)(XW_Extension extension,
+                                unsigned int timeout_ms);
+};
+
+typedef struct XW_Internal_SyncMessagingInterface_2
     XW_Internal_SyncMessagingInterface;
 
 #ifdef __cplusplus
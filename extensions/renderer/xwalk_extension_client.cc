@@ -4,25 +4,65 @@
 
 #include "xwalk/extensions/renderer/xwalk_extension_client.h"
 
+#include "base/bind.h"
+#include "base/debug/trace_event.h"
+#include "base/message_loop/message_loop.h"
+#include "base/metrics/histogram.h"
 #include "base/values.h"
 #include "base/stl_util.h"
-#include "ipc/ipc_sender.h"
+#include "ipc/ipc_sync_channel.h"
+#include "xwalk/extensions/common/xwalk_extension_binary_message.h"
 #include "xwalk/extensions/common/xwalk_extension_messages.h"
 
 namespace xwalk {
 namespace extensions {
 
+namespace {
+
+void AddStallToHistogram(const std::string& name, base::TimeDelta stall) {
+  // Same parameters as UMA_HISTOGRAM_TIMES, but the name is only known at
+  // runtime, so the macro can't be used.
+  base::HistogramBase* histogram = base::Histogram::FactoryTimeGet(
+      name, base::TimeDelta::FromMilliseconds(1),
+      base::TimeDelta::FromSeconds(10), 50,
+      base::HistogramBase::kUmaTargetedHistogramFlag);
+  histogram->AddTime(stall);
+}
+
+}  // namespace
+
 XWalkExtensionClient::XWalkExtensionClient()
     : sender_(0),
-      next_instance_id_(1) {  // Zero is never used for a valid instance.
+      pending_bytes_(0),
+      flush_scheduled_(false),
+      next_instance_id_(1),  // Zero is never used for a valid instance.
+      next_request_id_(1),  // Zero means the request wasn't sent.
+      weak_factory_(this) {
 }
 
 XWalkExtensionClient::~XWalkExtensionClient() {
   STLDeleteValues(&extension_apis_);
+  STLDeleteValues(&pending_messages_);
+  LogBatchingStats("to native", batching_stats_);
+
+  SyncMessageStatsMap::const_iterator it = sync_message_stats_.begin();
+  for (; it != sync_message_stats_.end(); ++it) {
+    const SyncMessageStats& stats = it->second;
+    UMA_HISTOGRAM_TIMES("XWalk.Extensions.SyncMessageLongestStall",
+                        stats.longest_stall);
+    VLOG(1) << "Extension " << it->first << " blocked for "
+            << stats.total_stall.InMilliseconds() << "ms in "
+            << stats.messages << " sync messages, " << stats.timeouts
+            << " timed out, longest stall was "
+            << stats.longest_stall.InMilliseconds() << "ms.";
+  }
 }
 
 bool XWalkExtensionClient::Send(IPC::Message* msg) {
   DCHECK(sender_);
+  TRACE_EVENT_INSTANT2("xwalk", "XWalkExtensionClient::Send",
+                       TRACE_EVENT_SCOPE_THREAD,
+                       "type", msg->type(), "bytes", msg->payload_size());
 
   return sender_->Send(msg);
 }
@@ -31,19 +71,44 @@ int64_t XWalkExtensionClient::CreateInstance(
     const std::string& extension_name,
     InstanceHandler* handler) {
   CHECK(handler);
+  if (!sender_ && !sender_needed_callback_.is_null())
+    sender_needed_callback_.Run();
+  if (!sender_) {
+    LOG(WARNING) << "Can't create an instance of extension " << extension_name
+                 << " without a connection to its server.";
+    return 0;
+  }
+
   if (!Send(new XWalkExtensionServerMsg_CreateInstance(next_instance_id_,
                                                        extension_name))) {
     return 0;
   }
   handlers_[next_instance_id_] = handler;
+  instance_names_[next_instance_id_] = extension_name;
+
+  ExtensionAPIMap::const_iterator it = extension_apis_.find(extension_name);
+  if (it != extension_apis_.end() && it->second->message_batching_enabled)
+    batched_instances_[next_instance_id_] = extension_name;
+
   return next_instance_id_++;
 }
 
 bool XWalkExtensionClient::OnMessageReceived(const IPC::Message& message) {
+  TRACE_EVENT2("xwalk", "XWalkExtensionClient::OnMessageReceived",
+               "type", message.type(),
+               "bytes", message.payload_size());
   bool handled = true;
   IPC_BEGIN_MESSAGE_MAP(XWalkExtensionClient, message)
     IPC_MESSAGE_HANDLER(XWalkExtensionClientMsg_PostMessageToJS,
         OnPostMessageToJS)
+    IPC_MESSAGE_HANDLER(XWalkExtensionClientMsg_PostMessagesToJS,
+        OnPostMessagesToJS)
+    IPC_MESSAGE_HANDLER(XWalkExtensionClientMsg_PostBinaryMessageToJS,
+        OnPostBinaryMessageToJS)
+    IPC_MESSAGE_HANDLER(XWalkExtensionClientMsg_PostSharedBinaryMessageToJS,
+        OnPostSharedBinaryMessageToJS)
+    IPC_MESSAGE_HANDLER(XWalkExtensionClientMsg_RequestReplyToJS,
+        OnRequestReplyToJS)
     IPC_MESSAGE_HANDLER(XWalkExtensionClientMsg_InstanceDestroyed,
         OnInstanceDestroyed)
     IPC_MESSAGE_UNHANDLED(handled = false)
@@ -52,28 +117,83 @@ bool XWalkExtensionClient::OnMessageReceived(const IPC::Message& message) {
   return handled;
 }
 
-XWalkExtensionClient::ExtensionCodePoints::ExtensionCodePoints() {
+XWalkExtensionClient::ExtensionCodePoints::ExtensionCodePoints()
+    : message_batching_enabled(false) {
 }
 
 XWalkExtensionClient::ExtensionCodePoints::~ExtensionCodePoints() {
 }
 
-void XWalkExtensionClient::OnPostMessageToJS(int64_t instance_id,
-                                             const base::ListValue& msg) {
+XWalkExtensionClient::InstanceHandler*
+XWalkExtensionClient::GetHandlerForMessage(int64_t instance_id) {
   HandlerMap::const_iterator it = handlers_.find(instance_id);
   if (it == handlers_.end()) {
     LOG(WARNING) << "Can't PostMessage to invalid Extension instance id: "
                  << instance_id;
-    return;
+    return NULL;
   }
 
   // See comment in DestroyInstance() about two step destruction.
-  if (!it->second)
+  return it->second;
+}
+
+void XWalkExtensionClient::OnPostMessageToJS(int64_t instance_id,
+                                             const base::ListValue& msg) {
+  InstanceHandler* handler = GetHandlerForMessage(instance_id);
+  if (!handler)
     return;
 
   const base::Value* value;
   msg.Get(0, &value);
-  it->second->HandleMessageFromNative(*value);
+  handler->HandleMessageFromNative(*value);
+}
+
+void XWalkExtensionClient::OnPostMessagesToJS(int64_t instance_id,
+                                              const base::ListValue& msgs) {
+  base::ListValue::const_iterator it = msgs.begin();
+  for (; it != msgs.end(); ++it) {
+    // The handler is looked up for every message since the instance might be
+    // destroyed by the listener of a previous message in the batch.
+    InstanceHandler* handler = GetHandlerForMessage(instance_id);
+    if (!handler)
+      return;
+    handler->HandleMessageFromNative(**it);
+  }
+}
+
+void XWalkExtensionClient::OnPostBinaryMessageToJS(int64_t instance_id,
+                                                   const std::string& msg) {
+  InstanceHandler* handler = GetHandlerForMessage(instance_id);
+  if (!handler)
+    return;
+
+  handler->HandleBinaryMessageFromNative(msg.data(), msg.size());
+}
+
+void XWalkExtensionClient::OnPostSharedBinaryMessageToJS(
+    int64_t instance_id, base::SharedMemoryHandle handle, uint32_t size) {
+  // Map before looking for the handler so the handle is always released.
+  scoped_ptr<base::SharedMemory> shared_memory =
+      MapBinaryMessageSharedMemory(handle, size);
+
+  InstanceHandler* handler = GetHandlerForMessage(instance_id);
+  if (!handler || !shared_memory)
+    return;
+
+  handler->HandleBinaryMessageFromNative(
+      static_cast<const char*>(shared_memory->memory()), size);
+}
+
+void XWalkExtensionClient::OnRequestReplyToJS(int64_t instance_id,
+                                              int request_id,
+                                              const base::ListValue& reply) {
+  InstanceHandler* handler = GetHandlerForMessage(instance_id);
+  if (!handler)
+    return;
+
+  const base::Value* value = NULL;
+  reply.Get(0, &value);
+  handler->HandleRequestReplyFromNative(request_id, value);
 }
 
 void XWalkExtensionClient::DestroyInstance(int64_t instance_id) {
@@ -82,6 +202,8 @@ void XWalkExtensionClient::DestroyInstance(int64_t instance_id) {
     LOG(WARNING) << "Can't Destroy invalid instance id: " << instance_id;
     return;
   }
+  FlushPendingMessagesForInstance(instance_id);
+  batched_instances_.erase(instance_id);
   Send(new XWalkExtensionServerMsg_DestroyInstance(instance_id));
 
   // Destruction happens in two steps, first we nullify the handler in our map,
@@ -104,6 +226,7 @@ void XWalkExtensionClient::OnInstanceDestroyed(int64_t instance_id) {
   // instances.
   DCHECK(!it->second);
   handlers_.erase(it);
+  instance_names_.erase(instance_id);
 }
 
 namespace {
@@ -126,38 +249,217 @@ scoped_ptr<base::ListValue> WrapValueInList(scoped_ptr<base::Value> value) {
 
 void XWalkExtensionClient::PostMessageToNative(int64_t instance_id,
     scoped_ptr<base::Value> msg) {
-  scoped_ptr<base::ListValue> list_msg = WrapValueInList(msg.Pass());
-  Send(new XWalkExtensionServerMsg_PostMessageToNative(instance_id, *list_msg));
+  BatchedInstanceMap::const_iterator it = batched_instances_.find(instance_id);
+  if (it == batched_instances_.end() || !msg) {
+    scoped_ptr<base::ListValue> list_msg = WrapValueInList(msg.Pass());
+    Send(new XWalkExtensionServerMsg_PostMessageToNative(instance_id,
+                                                         *list_msg));
+    return;
+  }
+
+  base::ListValue*& pending = pending_messages_[instance_id];
+  if (!pending)
+    pending = new base::ListValue;
+
+  pending_bytes_ += EstimateMessageSize(*msg);
+  pending->Append(msg.release());
+  batching_stats_[it->second].messages++;
+
+  if (pending_bytes_ >= kMaxMessageBatchBytes ||
+      !base::MessageLoop::current()) {
+    FlushPendingMessages();
+    return;
+  }
+
+  if (flush_scheduled_)
+    return;
+
+  flush_scheduled_ = true;
+  base::MessageLoop::current()->PostTask(FROM_HERE,
+      base::Bind(&XWalkExtensionClient::FlushPendingMessages,
+                 weak_factory_.GetWeakPtr()));
+}
+
+void XWalkExtensionClient::PostSerializedMessageToNative(
+    scoped_ptr<IPC::Message> msg) {
+  Send(msg.release());
+}
+
+bool XWalkExtensionClient::IsBatchingMessages(int64_t instance_id) const {
+  return batched_instances_.find(instance_id) != batched_instances_.end();
+}
+
+void XWalkExtensionClient::SendPendingMessages(int64_t instance_id,
+                                               base::ListValue* msgs) {
+  if (msgs->empty())
+    return;
+
+  BatchedInstanceMap::const_iterator it = batched_instances_.find(instance_id);
+  if (it != batched_instances_.end())
+    batching_stats_[it->second].batches++;
+
+  // A batch with a single message is sent as a regular message.
+  if (msgs->GetSize() == 1)
+    Send(new XWalkExtensionServerMsg_PostMessageToNative(instance_id, *msgs));
+  else
+    Send(new XWalkExtensionServerMsg_PostMessagesToNative(instance_id, *msgs));
+  msgs->Clear();
+}
+
+void XWalkExtensionClient::FlushPendingMessages() {
+  flush_scheduled_ = false;
+  PendingMessagesMap::iterator it = pending_messages_.begin();
+  for (; it != pending_messages_.end(); ++it)
+    SendPendingMessages(it->first, it->second);
+  STLDeleteValues(&pending_messages_);
+  pending_bytes_ = 0;
+}
+
+void XWalkExtensionClient::FlushPendingMessagesForInstance(
+    int64_t instance_id) {
+  PendingMessagesMap::iterator it = pending_messages_.find(instance_id);
+  if (it == pending_messages_.end())
+    return;
+
+  SendPendingMessages(it->first, it->second);
+  delete it->second;
+  pending_messages_.erase(it);
+}
+
+scoped_ptr<base::SharedMemory> XWalkExtensionClient::AllocateSharedMemory(
+    size_t size) {
+  scoped_ptr<base::SharedMemory> shared_memory;
+  if (!shared_memory_allocator_.is_null()) {
+    shared_memory = shared_memory_allocator_.Run(size);
+  } else {
+    shared_memory.reset(new base::SharedMemory);
+    if (!shared_memory->CreateAnonymous(size))
+      return scoped_ptr<base::SharedMemory>();
+  }
+
+  if (!shared_memory || (!shared_memory->memory() && !shared_memory->Map(size)))
+    return scoped_ptr<base::SharedMemory>();
+
+  return shared_memory.Pass();
+}
+
+void XWalkExtensionClient::PostBinaryMessageToNative(int64_t instance_id,
+    const char* data, size_t size) {
+  FlushPendingMessagesForInstance(instance_id);
+
+  if (ShouldUseSharedMemoryForBinaryMessage(size)) {
+    scoped_ptr<base::SharedMemory> shared_memory = AllocateSharedMemory(size);
+    base::SharedMemoryHandle handle;
+    if (shared_memory && CopyBinaryMessageToSharedMemory(
+            shared_memory.get(), data, size, &handle)) {
+      Send(new XWalkExtensionServerMsg_PostSharedBinaryMessageToNative(
+          instance_id, handle, size));
+      return;
+    }
+    LOG(WARNING) << "Couldn't allocate shared memory for binary message of "
+                 << "size " << size << ", sending it inline.";
+  }
+
+  Send(new XWalkExtensionServerMsg_PostBinaryMessageToNative(
+      instance_id, std::string(data, size)));
 }
 
 scoped_ptr<base::Value> XWalkExtensionClient::SendSyncMessageToNative(
-    int64_t instance_id, scoped_ptr<base::Value> msg) {
+    int64_t instance_id, scoped_ptr<base::Value> msg, bool* timed_out) {
+  *timed_out = false;
+
+  // Messages posted before must arrive first.
+  FlushPendingMessagesForInstance(instance_id);
+
+  std::string extension_name;
+  base::TimeDelta timeout;
+  InstanceNameMap::const_iterator name_it = instance_names_.find(instance_id);
+  if (name_it != instance_names_.end()) {
+    extension_name = name_it->second;
+    ExtensionAPIMap::const_iterator it = extension_apis_.find(extension_name);
+    if (it != extension_apis_.end())
+      timeout = it->second->sync_message_timeout;
+  }
+
+  TRACE_EVENT2("xwalk", "XWalkExtensionClient::SendSyncMessageToNative",
+               "extension", TRACE_STR_COPY(extension_name.c_str()),
+               "timeout_ms", timeout.InMilliseconds());
+
   scoped_ptr<base::ListValue> wrapped_msg = WrapValueInList(msg.Pass());
-  base::ListValue* wrapped_reply = new base::ListValue;
-  Send(new XWalkExtensionServerMsg_SendSyncMessageToNative(instance_id,
-      *wrapped_msg, wrapped_reply));
+  base::ListValue wrapped_reply;
+  IPC::Message* sync_msg = new XWalkExtensionServerMsg_SendSyncMessageToNative(
+      instance_id, *wrapped_msg, &wrapped_reply);
+
+  DCHECK(sender_);
+  base::TimeTicks start = base::TimeTicks::Now();
+  bool sent = timeout > base::TimeDelta() ?
+      sender_->SendWithTimeout(sync_msg, timeout.InMilliseconds()) :
+      sender_->Send(sync_msg);
+  base::TimeDelta stall = base::TimeTicks::Now() - start;
+
+  // SendWithTimeout() doesn't tell a timeout from other errors.
+  *timed_out = !sent && timeout > base::TimeDelta() && stall >= timeout;
+  RecordSyncMessageStall(extension_name, stall, *timed_out);
 
   scoped_ptr<base::Value> reply;
-  wrapped_reply->Remove(0, &reply);
+  if (sent)
+    wrapped_reply.Remove(0, &reply);
   return reply.Pass();
 }
 
-void XWalkExtensionClient::Initialize(IPC::Sender* sender) {
+int XWalkExtensionClient::SendRequestToNative(int64_t instance_id,
+    scoped_ptr<base::Value> msg) {
+  if (!msg)
+    return 0;
+  FlushPendingMessagesForInstance(instance_id);
+
+  scoped_ptr<base::ListValue> wrapped_msg = WrapValueInList(msg.Pass());
+  if (!Send(new XWalkExtensionServerMsg_SendRequestToNative(
+          instance_id, next_request_id_, *wrapped_msg)))
+    return 0;
+  return next_request_id_++;
+}
+
+void XWalkExtensionClient::RecordSyncMessageStall(
+    const std::string& extension_name, base::TimeDelta stall,
+    bool timed_out) {
+  UMA_HISTOGRAM_TIMES("XWalk.Extensions.SyncMessageStall", stall);
+  if (extension_name.empty())
+    return;
+
+  AddStallToHistogram("XWalk.Extensions.SyncMessageStall." + extension_name,
+                      stall);
+
+  SyncMessageStats& stats = sync_message_stats_[extension_name];
+  stats.messages++;
+  if (timed_out)
+    stats.timeouts++;
+  stats.total_stall += stall;
+  if (stall > stats.longest_stall)
+    stats.longest_stall = stall;
+}
+
+void XWalkExtensionClient::Initialize(IPC::SyncChannel* sender) {
   sender_ = sender;
 
   std::vector<XWalkExtensionServerMsg_ExtensionRegisterParams> extensions;
   Send(new XWalkExtensionServerMsg_GetExtensions(&extensions));
+  SetExtensions(extensions);
+}
 
-  if (extensions.empty())
-    return;
-
-  std::vector<XWalkExtensionServerMsg_ExtensionRegisterParams>::iterator it =
-      extensions.begin();
+void XWalkExtensionClient::SetExtensions(
+    const std::vector<XWalkExtensionServerMsg_ExtensionRegisterParams>&
+        extensions) {
+  std::vector<XWalkExtensionServerMsg_ExtensionRegisterParams>::const_iterator
+      it = extensions.begin();
   for (; it != extensions.end(); ++it) {
     ExtensionCodePoints* codepoint = new ExtensionCodePoints;
     codepoint->api = (*it).js_api;
 
     codepoint->entry_points = (*it).entry_points;
+    codepoint->message_batching_enabled = (*it).message_batching_enabled;
+    codepoint->sync_message_timeout =
+        base::TimeDelta::FromMilliseconds((*it).sync_message_timeout_ms);
 
     std::string name = (*it).name;
     extension_apis_[name] = codepoint;
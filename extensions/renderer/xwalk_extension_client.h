@@ -7,19 +7,28 @@
 
 #include <stdint.h>
 #include <map>
+#include <set>
 #include <string>
 #include <vector>
 
+#include "base/callback.h"
 #include "base/memory/scoped_ptr.h"
+#include "base/memory/shared_memory.h"
+#include "base/memory/weak_ptr.h"
+#include "base/time/time.h"
 #include "base/values.h"
 #include "ipc/ipc_listener.h"
+#include "xwalk/extensions/common/xwalk_extension_message_batch.h"
+
+struct XWalkExtensionServerMsg_ExtensionRegisterParams;
 
 namespace base {
 class Value;
 }
 
 namespace IPC {
-class Sender;
+class Message;
+class SyncChannel;
 }
 
 namespace xwalk {
@@ -36,6 +45,12 @@ class XWalkExtensionClient : public IPC::Listener {
  public:
   struct InstanceHandler {
     virtual void HandleMessageFromNative(const base::Value& msg) = 0;
+    // The |data| is only valid during the call.
+    virtual void HandleBinaryMessageFromNative(const char* data,
+                                               size_t size) = 0;
+    // |reply| is NULL if the request couldn't be handled.
+    virtual void HandleRequestReplyFromNative(int request_id,
+                                              const base::Value* reply) = 0;
    protected:
     ~InstanceHandler() {}
   };
@@ -48,10 +63,55 @@ class XWalkExtensionClient : public IPC::Listener {
   void DestroyInstance(int64_t instance_id);
 
   void PostMessageToNative(int64_t instance_id, scoped_ptr<base::Value> msg);
-  scoped_ptr<base::Value> SendSyncMessageToNative(int64_t instance_id,
-      scoped_ptr<base::Value> msg);
 
-  void Initialize(IPC::Sender* sender);
+  // Posts an XWalkExtensionServerMsg_PostSerializedMessageToNative, with the
+  // contents already written by SerializeV8Value(). Instances of extensions
+  // that enabled message batching queue their messages as base::Values, so
+  // they keep using PostMessageToNative().
+  void PostSerializedMessageToNative(scoped_ptr<IPC::Message> msg);
+  bool IsBatchingMessages(int64_t instance_id) const;
+
+  // Blocks until the instance replies, or until the sync message timeout of
+  // its extension expires, in which case |timed_out| is set. Returns NULL if
+  // there's no reply.
+  scoped_ptr<base::Value> SendSyncMessageToNative(int64_t instance_id,
+      scoped_ptr<base::Value> msg, bool* timed_out);
+
+  // Same as above but without blocking, the reply is given to
+  // InstanceHandler::HandleRequestReplyFromNative() with the returned request
+  // id. Returns zero if the request couldn't be sent.
+  int SendRequestToNative(int64_t instance_id, scoped_ptr<base::Value> msg);
+
+  // Posts |size| bytes starting at |data| without converting them to a
+  // base::Value. Big payloads are copied to shared memory obtained from the
+  // allocator below. The caller keeps ownership of |data|.
+  void PostBinaryMessageToNative(int64_t instance_id,
+                                 const char* data, size_t size);
+
+  // Sandboxed processes can't create shared memory by themselves, so the
+  // embedder can provide a different way to get it (e.g. asking the browser
+  // process). The returned memory doesn't need to be mapped.
+  typedef base::Callback<scoped_ptr<base::SharedMemory>(size_t size)>
+      SharedMemoryAllocator;
+  void set_shared_memory_allocator(const SharedMemoryAllocator& allocator) {
+    shared_memory_allocator_ = allocator;
+  }
+
+  // Sets the sender and asks the server for its extensions. A SyncChannel is
+  // needed to give up on sync messages after their timeout.
+  void Initialize(IPC::SyncChannel* sender);
+
+  // When the extensions are known in advance, the sender can be set later.
+  // Until then, creating an instance runs the callback below, that is
+  // expected to set the sender, even if it needs to block.
+  void SetExtensions(
+      const std::vector<XWalkExtensionServerMsg_ExtensionRegisterParams>&
+          extensions);
+  void set_sender(IPC::SyncChannel* sender) { sender_ = sender; }
+  bool has_sender() const { return sender_ != NULL; }
+  void set_sender_needed_callback(const base::Closure& callback) {
+    sender_needed_callback_ = callback;
+  }
 
   // IPC::Listener Implementation.
   virtual bool OnMessageReceived(const IPC::Message& message) OVERRIDE;
@@ -61,26 +121,92 @@ class XWalkExtensionClient : public IPC::Listener {
     ~ExtensionCodePoints();
     std::string api;
     std::vector<std::string> entry_points;
+    bool message_batching_enabled;
+    base::TimeDelta sync_message_timeout;
   };
 
   typedef std::map<std::string, ExtensionCodePoints*> ExtensionAPIMap;
 
   const ExtensionAPIMap& extension_apis() const { return extension_apis_; }
 
+  // Counters for the messages posted to native by instances of extensions
+  // that enabled message batching, keyed by extension name.
+  const XWalkExtensionBatchingStatsMap& batching_stats() const {
+    return batching_stats_;
+  }
+
+  // Time the calling thread spent blocked in sync messages, keyed by
+  // extension name.
+  struct SyncMessageStats {
+    SyncMessageStats() : messages(0), timeouts(0) {}
+    uint64_t messages;
+    uint64_t timeouts;
+    base::TimeDelta total_stall;
+    base::TimeDelta longest_stall;
+  };
+
+  typedef std::map<std::string, SyncMessageStats> SyncMessageStatsMap;
+
+  const SyncMessageStatsMap& sync_message_stats() const {
+    return sync_message_stats_;
+  }
+
  private:
   bool Send(IPC::Message* msg);
 
   // Message Handlers.
   void OnInstanceDestroyed(int64_t instance_id);
   void OnPostMessageToJS(int64_t instance_id, const base::ListValue& msg);
-
-  IPC::Sender* sender_;
+  void OnPostMessagesToJS(int64_t instance_id, const base::ListValue& msgs);
+  void OnPostBinaryMessageToJS(int64_t instance_id, const std::string& msg);
+  void OnPostSharedBinaryMessageToJS(int64_t instance_id,
+                                     base::SharedMemoryHandle handle,
+                                     uint32_t size);
+  void OnRequestReplyToJS(int64_t instance_id, int request_id,
+                          const base::ListValue& reply);
+
+  // Records in the stats and histograms that a sync message to an instance of
+  // |extension_name| blocked for |stall|.
+  void RecordSyncMessageStall(const std::string& extension_name,
+                              base::TimeDelta stall, bool timed_out);
+
+  InstanceHandler* GetHandlerForMessage(int64_t instance_id);
+  scoped_ptr<base::SharedMemory> AllocateSharedMemory(size_t size);
+
+  // Messages from instances of extensions that enabled batching are queued
+  // and sent together at the end of the current message loop turn.
+  void FlushPendingMessages();
+  void FlushPendingMessagesForInstance(int64_t instance_id);
+  void SendPendingMessages(int64_t instance_id, base::ListValue* msgs);
+
+  IPC::SyncChannel* sender_;
+  base::Closure sender_needed_callback_;
   ExtensionAPIMap extension_apis_;
 
   typedef std::map<int64_t, InstanceHandler*> HandlerMap;
   HandlerMap handlers_;
 
+  typedef std::map<int64_t, std::string> InstanceNameMap;
+  InstanceNameMap instance_names_;
+
+  SharedMemoryAllocator shared_memory_allocator_;
+
+  // Maps the instances that batch messages to their extension names.
+  typedef std::map<int64_t, std::string> BatchedInstanceMap;
+  BatchedInstanceMap batched_instances_;
+
+  typedef std::map<int64_t, base::ListValue*> PendingMessagesMap;
+  PendingMessagesMap pending_messages_;
+  size_t pending_bytes_;
+  bool flush_scheduled_;
+  XWalkExtensionBatchingStatsMap batching_stats_;
+
+  SyncMessageStatsMap sync_message_stats_;
+
   int64_t next_instance_id_;
+  int next_request_id_;
+
+  base::WeakPtrFactory<XWalkExtensionClient> weak_factory_;
 };
 
 }  // namespace extensions
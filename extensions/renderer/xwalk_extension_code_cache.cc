@@ -0,0 +1,118 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/extensions/renderer/xwalk_extension_code_cache.h"
+
+#include "base/hash.h"
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/stl_util.h"
+#include "base/strings/stringprintf.h"
+
+namespace xwalk {
+namespace extensions {
+
+namespace {
+
+base::LazyInstance<XWalkExtensionCodeCache>::Leaky g_code_cache =
+    LAZY_INSTANCE_INITIALIZER;
+
+std::string GetKey(const std::string& name, const std::string& source) {
+  return base::StringPrintf("%s-%08x", name.c_str(), base::Hash(source));
+}
+
+}  // namespace
+
+XWalkExtensionCodeCache::Stats::Stats()
+    : memory_hits(0),
+      persistent_hits(0),
+      misses(0) {
+}
+
+// static
+XWalkExtensionCodeCache* XWalkExtensionCodeCache::GetInstance() {
+  return g_code_cache.Pointer();
+}
+
+XWalkExtensionCodeCache::XWalkExtensionCodeCache() {
+}
+
+XWalkExtensionCodeCache::~XWalkExtensionCodeCache() {
+  for (ScriptMap::iterator it = scripts_.begin(); it != scripts_.end(); ++it)
+    it->second->Reset();
+  STLDeleteValues(&scripts_);
+}
+
+void XWalkExtensionCodeCache::AddPersistentData(
+    const std::map<std::string, std::string>& entries) {
+  persistent_data_.insert(entries.begin(), entries.end());
+}
+
+v8::Handle<v8::Script> XWalkExtensionCodeCache::GetScript(
+    const std::string& name, const std::string& source) {
+  v8::Isolate* isolate = v8::Isolate::GetCurrent();
+  v8::EscapableHandleScope handle_scope(isolate);
+
+  const std::string key = GetKey(name, source);
+  ScriptMap::const_iterator it = scripts_.find(key);
+  if (it != scripts_.end()) {
+    stats_.memory_hits++;
+    return handle_scope.Escape(v8::Local<v8::Script>::New(isolate,
+                                                          *it->second));
+  }
+
+  base::TimeTicks start_time = base::TimeTicks::Now();
+  v8::Handle<v8::String> v8_source(
+      v8::String::NewFromUtf8(isolate, source.c_str()));
+
+  scoped_ptr<v8::ScriptData> pre_data;
+  PersistentDataMap::const_iterator data_it = persistent_data_.find(key);
+  if (data_it != persistent_data_.end()) {
+    pre_data.reset(v8::ScriptData::New(data_it->second.data(),
+                                       data_it->second.size()));
+    if (pre_data->HasError())
+      pre_data.reset();
+  }
+
+  const bool persistent_hit = pre_data.get() != NULL;
+  if (!persistent_hit) {
+    pre_data.reset(v8::ScriptData::PreCompile(v8_source));
+    // On syntax errors let the compilation below report the exception.
+    if (pre_data->HasError()) {
+      pre_data.reset();
+    } else if (!store_callback_.is_null()) {
+      std::string data(pre_data->Data(), pre_data->Length());
+      persistent_data_[key] = data;
+      store_callback_.Run(key, data);
+    }
+  }
+
+  v8::ScriptOrigin origin(v8::String::Empty(isolate));
+  v8::Local<v8::Script> script =
+      v8::Script::New(v8_source, &origin, pre_data.get());
+
+  base::TimeDelta compile_time = base::TimeTicks::Now() - start_time;
+  stats_.compile_time += compile_time;
+  if (persistent_hit)
+    stats_.persistent_hits++;
+  else
+    stats_.misses++;
+
+  VLOG(1) << "Compiled JS code for '" << name << "' in "
+          << compile_time.InMillisecondsF() << "ms ("
+          << (persistent_hit ? "preparse data hit" : "miss") << "). "
+          << "Cache totals: " << stats_.memory_hits << " memory hits, "
+          << stats_.persistent_hits << " preparse data hits, "
+          << stats_.misses << " misses, "
+          << stats_.compile_time.InMillisecondsF() << "ms compiling.";
+
+  if (script.IsEmpty())
+    return handle_scope.Escape(script);
+
+  scripts_[key] = new v8::Persistent<v8::Script>(isolate, script);
+  return handle_scope.Escape(script);
+}
+
+}  // namespace extensions
+}  // namespace xwalk
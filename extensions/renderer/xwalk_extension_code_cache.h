@@ -0,0 +1,82 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef XWALK_EXTENSIONS_RENDERER_XWALK_EXTENSION_CODE_CACHE_H_
+#define XWALK_EXTENSIONS_RENDERER_XWALK_EXTENSION_CODE_CACHE_H_
+
+#include <map>
+#include <string>
+#include "base/callback.h"
+#include "base/lazy_instance.h"
+#include "base/time/time.h"
+#include "v8/include/v8.h"
+
+namespace xwalk {
+namespace extensions {
+
+// Keeps the compiled JS API code of extensions and of internal JS modules, so
+// it is parsed and compiled only once per render process, no matter how many
+// frames use it. The scripts are compiled context independent and bound to
+// a context only when they run.
+//
+// The first compilation in each process can still be sped up by V8 preparse
+// data, produced here and persisted by the browser process across runs (see
+// XWalkExtensionCodeCacheStore). Entries are keyed by extension name and a
+// hash of the source code.
+class XWalkExtensionCodeCache {
+ public:
+  struct Stats {
+    Stats();
+    // Script found already compiled in this process.
+    int memory_hits;
+    // Script compiled using preparse data from a previous run.
+    int persistent_hits;
+    // Script compiled from scratch.
+    int misses;
+    base::TimeDelta compile_time;
+  };
+
+  typedef base::Callback<void(const std::string& key,
+                              const std::string& data)> StoreCallback;
+
+  static XWalkExtensionCodeCache* GetInstance();
+
+  // Called with the preparse data produced for scripts that were not found
+  // in the cache, so they can be persisted.
+  void set_store_callback(const StoreCallback& callback) {
+    store_callback_ = callback;
+  }
+
+  void AddPersistentData(const std::map<std::string, std::string>& entries);
+
+  // Returns the compiled script for |source|, compiling it if it isn't in the
+  // cache. Should be called inside a v8::TryCatch, since on compilation
+  // errors an empty handle is returned and the exception is kept.
+  v8::Handle<v8::Script> GetScript(const std::string& name,
+                                   const std::string& source);
+
+  const Stats& stats() const { return stats_; }
+
+ private:
+  friend struct base::DefaultLazyInstanceTraits<XWalkExtensionCodeCache>;
+
+  XWalkExtensionCodeCache();
+  ~XWalkExtensionCodeCache();
+
+  typedef std::map<std::string, v8::Persistent<v8::Script>*> ScriptMap;
+  ScriptMap scripts_;
+
+  typedef std::map<std::string, std::string> PersistentDataMap;
+  PersistentDataMap persistent_data_;
+
+  StoreCallback store_callback_;
+  Stats stats_;
+
+  DISALLOW_COPY_AND_ASSIGN(XWalkExtensionCodeCache);
+};
+
+}  // namespace extensions
+}  // namespace xwalk
+
+#endif  // XWALK_EXTENSIONS_RENDERER_XWALK_EXTENSION_CODE_CACHE_H_
@@ -9,10 +9,15 @@
 #include "base/strings/stringprintf.h"
 #include "base/values.h"
 #include "content/public/renderer/v8_value_converter.h"
+#include "third_party/WebKit/public/web/WebArrayBuffer.h"
+#include "third_party/WebKit/public/web/WebArrayBufferView.h"
 #include "third_party/WebKit/public/web/WebFrame.h"
 #include "third_party/WebKit/public/web/WebScopedMicrotaskSuppression.h"
+#include "xwalk/extensions/common/xwalk_extension_messages.h"
+#include "xwalk/extensions/renderer/xwalk_extension_code_cache.h"
 #include "xwalk/extensions/renderer/xwalk_module_system.h"
 #include "xwalk/extensions/renderer/xwalk_v8_utils.h"
+#include "xwalk/extensions/renderer/xwalk_v8_value_serializer.h"
 
 namespace xwalk {
 namespace extensions {
@@ -35,27 +40,6 @@ XWalkExtensionModule::XWalkExtensionModule(XWalkExtensionClient* client,
       client_(client),
       module_system_(module_system),
       instance_id_(0) {
-  v8::Isolate* isolate = v8::Isolate::GetCurrent();
-  v8::HandleScope handle_scope(isolate);
-  v8::Handle<v8::Object> function_data = v8::Object::New();
-  function_data->Set(v8::String::NewFromUtf8(isolate, kXWalkExtensionModule),
-                     v8::External::New(this));
-
-  v8::Handle<v8::ObjectTemplate> object_template = v8::ObjectTemplate::New();
-  // TODO(cmarcelo): Use Template::Set() function that takes isolate, once we
-  // update the Chromium (and V8) version.
-  object_template->Set(
-      v8::String::NewFromUtf8(isolate, "postMessage"),
-      v8::FunctionTemplate::New(PostMessageCallback, function_data));
-  object_template->Set(
-      v8::String::NewFromUtf8(isolate, "sendSyncMessage"),
-      v8::FunctionTemplate::New(SendSyncMessageCallback, function_data));
-  object_template->Set(
-      v8::String::NewFromUtf8(isolate, "setMessageListener"),
-      v8::FunctionTemplate::New(SetMessageListenerCallback, function_data));
-
-  function_data_.Reset(isolate, function_data);
-  object_template_.Reset(isolate, object_template);
 }
 
 XWalkExtensionModule::~XWalkExtensionModule() {
@@ -66,13 +50,21 @@ XWalkExtensionModule::~XWalkExtensionModule() {
   // this because it might be the case that the JS objects we created outlive
   // this object (getting references from inside an iframe and then destroying
   // the iframe), even if we destroy the references we have.
-  v8::Handle<v8::Object> function_data =
-      v8::Handle<v8::Object>::New(isolate, function_data_);
-  function_data->Delete(v8::String::New(kXWalkExtensionModule));
+  if (!function_data_.IsEmpty()) {
+    v8::Handle<v8::Object> function_data =
+        v8::Handle<v8::Object>::New(isolate, function_data_);
+    function_data->Delete(v8::String::New(kXWalkExtensionModule));
+  }
 
-  object_template_.Reset();
   function_data_.Reset();
   message_listener_.Reset();
+  binary_message_listener_.Reset();
+
+  RequestCallbackMap::iterator it = request_callbacks_.begin();
+  for (; it != request_callbacks_.end(); ++it) {
+    it->second->Reset();
+    delete it->second;
+  }
 
   if (instance_id_)
     client_->DestroyInstance(instance_id_);
@@ -106,6 +98,17 @@ std::string WrapAPICode(const std::string& extension_code,
       "extension.internal = {};"
       "extension.internal.sendSyncMessage = extension.sendSyncMessage;"
       "delete extension.sendSyncMessage;"
+      "extension.internal.sendRequest = (function(sendRequest) {"
+      "  return function(msg) {"
+      "    return new Promise(function(resolve, reject) {"
+      "      var sent = sendRequest(msg, function(reply, error) {"
+      "        if (error) reject(new Error(error)); else resolve(reply);"
+      "      });"
+      "      if (!sent) reject(new Error('Could not send the request.'));"
+      "    });"
+      "  };"
+      "})(extension.sendRequest);"
+      "delete extension.sendRequest;"
       "var exports = {}; (function() {'use strict'; %s\n})();"
       "%s = exports; });",
       CodeToEnsureNamespace(extension_name).c_str(),
@@ -113,18 +116,18 @@ std::string WrapAPICode(const std::string& extension_code,
       extension_name.c_str());
 }
 
-v8::Handle<v8::Value> RunString(const std::string& code,
+v8::Handle<v8::Value> RunString(const std::string& name,
+                                const std::string& code,
                                 std::string* exception) {
   v8::Isolate* isolate = v8::Isolate::GetCurrent();
   v8::EscapableHandleScope handle_scope(isolate);
-  v8::Handle<v8::String> v8_code(
-      v8::String::NewFromUtf8(isolate, code.c_str()));
 
   WebKit::WebScopedMicrotaskSuppression suppression;
   v8::TryCatch try_catch;
   try_catch.SetVerbose(true);
 
-  v8::Handle<v8::Script> script(v8::Script::New(v8_code, v8::String::Empty()));
+  v8::Handle<v8::Script> script(
+      XWalkExtensionCodeCache::GetInstance()->GetScript(name, code));
   if (try_catch.HasCaught()) {
     *exception = ExceptionToString(try_catch);
     return handle_scope.Escape(
@@ -148,10 +151,13 @@ void XWalkExtensionModule::LoadExtensionCode(
   CHECK(!instance_id_);
   instance_id_ = client_->CreateInstance(extension_name_, this);
 
+  v8::Handle<v8::ObjectTemplate> object_template =
+      CreateExtensionObjectTemplate(context->GetIsolate());
+
   std::string exception;
   std::string wrapped_api_code = WrapAPICode(extension_code_, extension_name_);
   v8::Handle<v8::Value> result =
-      RunString(wrapped_api_code, &exception);
+      RunString(extension_name_, wrapped_api_code, &exception);
   if (!result->IsFunction()) {
     LOG(WARNING) << "Couldn't load JS API code for " << extension_name_
       << ": " << exception;
@@ -159,9 +165,6 @@ void XWalkExtensionModule::LoadExtensionCode(
   }
   v8::Handle<v8::Function> callable_api_code =
       v8::Handle<v8::Function>::Cast(result);
-  v8::Handle<v8::ObjectTemplate> object_template =
-      v8::Handle<v8::ObjectTemplate>::New(context->GetIsolate(),
-                                          object_template_);
 
   const int argc = 2;
   v8::Handle<v8::Value> argv[argc] = {
@@ -179,6 +182,42 @@ void XWalkExtensionModule::LoadExtensionCode(
   }
 }
 
+// The 'extension' object and its callbacks are only needed once the JS API
+// code runs, so they are not created for modules that are never used.
+v8::Handle<v8::ObjectTemplate>
+XWalkExtensionModule::CreateExtensionObjectTemplate(v8::Isolate* isolate) {
+  v8::EscapableHandleScope handle_scope(isolate);
+  v8::Handle<v8::Object> function_data = v8::Object::New();
+  function_data->Set(v8::String::NewFromUtf8(isolate, kXWalkExtensionModule),
+                     v8::External::New(this));
+
+  v8::Local<v8::ObjectTemplate> object_template = v8::ObjectTemplate::New();
+  // TODO(cmarcelo): Use Template::Set() function that takes isolate, once we
+  // update the Chromium (and V8) version.
+  object_template->Set(
+      v8::String::NewFromUtf8(isolate, "postMessage"),
+      v8::FunctionTemplate::New(PostMessageCallback, function_data));
+  object_template->Set(
+      v8::String::NewFromUtf8(isolate, "sendSyncMessage"),
+      v8::FunctionTemplate::New(SendSyncMessageCallback, function_data));
+  object_template->Set(
+      v8::String::NewFromUtf8(isolate, "sendRequest"),
+      v8::FunctionTemplate::New(SendRequestCallback, function_data));
+  object_template->Set(
+      v8::String::NewFromUtf8(isolate, "setMessageListener"),
+      v8::FunctionTemplate::New(SetMessageListenerCallback, function_data));
+  object_template->Set(
+      v8::String::NewFromUtf8(isolate, "postBinaryMessage"),
+      v8::FunctionTemplate::New(PostBinaryMessageCallback, function_data));
+  object_template->Set(
+      v8::String::NewFromUtf8(isolate, "setBinaryMessageListener"),
+      v8::FunctionTemplate::New(SetBinaryMessageListenerCallback,
+                                function_data));
+
+  function_data_.Reset(isolate, function_data);
+  return handle_scope.Escape(object_template);
+}
+
 void XWalkExtensionModule::HandleMessageFromNative(const base::Value& msg) {
   if (message_listener_.IsEmpty())
     return;
@@ -200,6 +239,70 @@ void XWalkExtensionModule::HandleMessageFromNative(const base::Value& msg) {
         << ExceptionToString(try_catch);
 }
 
+void XWalkExtensionModule::HandleBinaryMessageFromNative(const char* data,
+                                                         size_t size) {
+  if (binary_message_listener_.IsEmpty())
+    return;
+
+  v8::Isolate* isolate = v8::Isolate::GetCurrent();
+  v8::HandleScope handle_scope(isolate);
+  v8::Handle<v8::Context> context = module_system_->GetV8Context();
+  v8::Context::Scope context_scope(context);
+
+  // This is the only copy in the renderer side, from the IPC message (or
+  // shared memory) straight to the ArrayBuffer backing store.
+  WebKit::WebArrayBuffer buffer = WebKit::WebArrayBuffer::create(size, 1);
+  memcpy(buffer.data(), data, size);
+  v8::Handle<v8::Value> v8_value(buffer.toV8Value());
+  v8::Handle<v8::Function> binary_message_listener =
+      v8::Handle<v8::Function>::New(isolate, binary_message_listener_);
+
+  WebKit::WebScopedMicrotaskSuppression suppression;
+  v8::TryCatch try_catch;
+  binary_message_listener->Call(context->Global(), 1, &v8_value);
+  if (try_catch.HasCaught())
+    LOG(WARNING) << "Exception when running binary message listener: "
+        << ExceptionToString(try_catch);
+}
+
+void XWalkExtensionModule::HandleRequestReplyFromNative(
+    int request_id, const base::Value* reply) {
+  RequestCallbackMap::iterator it = request_callbacks_.find(request_id);
+  if (it == request_callbacks_.end()) {
+    LOG(WARNING) << "Got reply for unknown request id: " << request_id;
+    return;
+  }
+
+  v8::Isolate* isolate = v8::Isolate::GetCurrent();
+  v8::HandleScope handle_scope(isolate);
+  v8::Handle<v8::Context> context = module_system_->GetV8Context();
+  v8::Context::Scope context_scope(context);
+
+  v8::Handle<v8::Function> callback =
+      v8::Handle<v8::Function>::New(isolate, *it->second);
+  it->second->Reset();
+  delete it->second;
+  request_callbacks_.erase(it);
+
+  const int argc = 2;
+  v8::Handle<v8::Value> argv[argc];
+  if (reply) {
+    argv[0] = converter_->ToV8Value(reply, context);
+    argv[1] = v8::Undefined(isolate);
+  } else {
+    argv[0] = v8::Undefined(isolate);
+    argv[1] = v8::String::NewFromUtf8(isolate,
+                                      "Extension instance is not available.");
+  }
+
+  WebKit::WebScopedMicrotaskSuppression suppression;
+  v8::TryCatch try_catch;
+  callback->Call(context->Global(), argc, argv);
+  if (try_catch.HasCaught())
+    LOG(WARNING) << "Exception when running request callback: "
+        << ExceptionToString(try_catch);
+}
+
 // static
 void XWalkExtensionModule::PostMessageCallback(
     const v8::FunctionCallbackInfo<v8::Value>& info) {
@@ -210,11 +313,25 @@ void XWalkExtensionModule::PostMessageCallback(
     return;
   }
 
+  CHECK(module->instance_id_);
+
+  // Write the message directly in the IPC message when possible, instead of
+  // converting it to a base::Value first.
+  if (!module->client_->IsBatchingMessages(module->instance_id_)) {
+    scoped_ptr<IPC::Message> msg(
+        new XWalkExtensionServerMsg_PostSerializedMessageToNative(
+            module->instance_id_));
+    if (SerializeV8Value(info[0], msg.get())) {
+      module->client_->PostSerializedMessageToNative(msg.Pass());
+      result.Set(true);
+      return;
+    }
+  }
+
   v8::Handle<v8::Context> context = info.GetIsolate()->GetCurrentContext();
   scoped_ptr<base::Value> value(
       module->converter_->FromV8Value(info[0], context));
 
-  CHECK(module->instance_id_);
   module->client_->PostMessageToNative(module->instance_id_, value.Pass());
   result.Set(true);
 }
@@ -234,9 +351,19 @@ void XWalkExtensionModule::SendSyncMessageCallback(
       module->converter_->FromV8Value(info[0], context));
 
   CHECK(module->instance_id_);
+  bool timed_out;
   scoped_ptr<base::Value> reply(
       module->client_->SendSyncMessageToNative(module->instance_id_,
-                                               value.Pass()));
+                                               value.Pass(), &timed_out));
+
+  if (timed_out) {
+    std::string error = base::StringPrintf(
+        "Sync message to extension %s timed out.",
+        module->extension_name_.c_str());
+    v8::ThrowException(v8::Exception::Error(
+        v8::String::NewFromUtf8(info.GetIsolate(), error.c_str())));
+    return;
+  }
 
   // If we tried to send a message to an instance that became invalid,
   // then reply will be NULL.
@@ -244,6 +371,33 @@ void XWalkExtensionModule::SendSyncMessageCallback(
     result.Set(module->converter_->ToV8Value(reply.get(), context));
 }
 
+// static
+void XWalkExtensionModule::SendRequestCallback(
+    const v8::FunctionCallbackInfo<v8::Value>& info) {
+  v8::ReturnValue<v8::Value> result(info.GetReturnValue());
+  XWalkExtensionModule* module = GetExtensionModule(info);
+  if (!module || info.Length() != 2 || !info[1]->IsFunction()) {
+    result.Set(false);
+    return;
+  }
+
+  v8::Handle<v8::Context> context = info.GetIsolate()->GetCurrentContext();
+  scoped_ptr<base::Value> value(
+      module->converter_->FromV8Value(info[0], context));
+
+  CHECK(module->instance_id_);
+  int request_id =
+      module->client_->SendRequestToNative(module->instance_id_, value.Pass());
+  if (!request_id) {
+    result.Set(false);
+    return;
+  }
+
+  module->request_callbacks_[request_id] = new v8::Persistent<v8::Function>(
+      info.GetIsolate(), info[1].As<v8::Function>());
+  result.Set(true);
+}
+
 // static
 void XWalkExtensionModule::SetMessageListenerCallback(
     const v8::FunctionCallbackInfo<v8::Value>& info) {
@@ -269,6 +423,73 @@ void XWalkExtensionModule::SetMessageListenerCallback(
   result.Set(true);
 }
 
+// static
+void XWalkExtensionModule::PostBinaryMessageCallback(
+    const v8::FunctionCallbackInfo<v8::Value>& info) {
+  v8::ReturnValue<v8::Value> result(info.GetReturnValue());
+  XWalkExtensionModule* module = GetExtensionModule(info);
+  if (!module || info.Length() != 1) {
+    result.Set(false);
+    return;
+  }
+
+  // Read the bytes directly from the ArrayBuffer backing store, no
+  // base::Value is created for binary messages.
+  const char* data = NULL;
+  size_t size = 0;
+  scoped_ptr<WebKit::WebArrayBuffer> buffer;
+  scoped_ptr<WebKit::WebArrayBufferView> view;
+  if (info[0]->IsArrayBuffer()) {
+    buffer.reset(WebKit::WebArrayBuffer::createFromV8Value(info[0]));
+    if (buffer) {
+      data = static_cast<const char*>(buffer->data());
+      size = buffer->byteLength();
+    }
+  } else if (info[0]->IsArrayBufferView()) {
+    view.reset(WebKit::WebArrayBufferView::createFromV8Value(info[0]));
+    if (view) {
+      data = static_cast<const char*>(view->baseAddress()) + view->byteOffset();
+      size = view->byteLength();
+    }
+  }
+
+  if (!buffer && !view) {
+    LOG(WARNING) << "Trying to post binary message with invalid value.";
+    result.Set(false);
+    return;
+  }
+
+  CHECK(module->instance_id_);
+  module->client_->PostBinaryMessageToNative(module->instance_id_, data, size);
+  result.Set(true);
+}
+
+// static
+void XWalkExtensionModule::SetBinaryMessageListenerCallback(
+    const v8::FunctionCallbackInfo<v8::Value>& info) {
+  v8::ReturnValue<v8::Value> result(info.GetReturnValue());
+  XWalkExtensionModule* module = GetExtensionModule(info);
+  if (!module || info.Length() != 1) {
+    result.Set(false);
+    return;
+  }
+
+  if (!info[0]->IsFunction() && !info[0]->IsUndefined()) {
+    LOG(WARNING) << "Trying to set binary message listener with invalid value.";
+    result.Set(false);
+    return;
+  }
+
+  v8::Isolate* isolate = info.GetIsolate();
+  if (info[0]->IsUndefined())
+    module->binary_message_listener_.Reset();
+  else
+    module->binary_message_listener_.Reset(isolate,
+                                           info[0].As<v8::Function>());
+
+  result.Set(true);
+}
+
 // static
 XWalkExtensionModule* XWalkExtensionModule::GetExtensionModule(
     const v8::FunctionCallbackInfo<v8::Value>& info) {
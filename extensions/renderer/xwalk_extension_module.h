@@ -5,6 +5,7 @@
 #ifndef XWALK_EXTENSIONS_RENDERER_XWALK_EXTENSION_MODULE_H_
 #define XWALK_EXTENSIONS_RENDERER_XWALK_EXTENSION_MODULE_H_
 
+#include <map>
 #include <string>
 #include "xwalk/extensions/renderer/xwalk_extension_client.h"
 #include "xwalk/extensions/renderer/xwalk_module_system.h"
@@ -44,24 +45,38 @@ class XWalkExtensionModule : public XWalkExtensionClient::InstanceHandler {
 
   std::string extension_name() const { return extension_name_; }
 
+  // Whether LoadExtensionCode() was called, i.e. the extension instance was
+  // created and its JS API code evaluated.
+  bool is_loaded() const { return instance_id_ != 0; }
+
  private:
   // XWalkExtensionClient::InstanceHandler implementation.
   virtual void HandleMessageFromNative(const base::Value& msg) OVERRIDE;
+  virtual void HandleBinaryMessageFromNative(const char* data,
+                                             size_t size) OVERRIDE;
+  virtual void HandleRequestReplyFromNative(int request_id,
+                                            const base::Value* reply) OVERRIDE;
 
   // Callbacks for JS functions available in 'extension' object.
   static void PostMessageCallback(
       const v8::FunctionCallbackInfo<v8::Value>& info);
   static void SendSyncMessageCallback(
       const v8::FunctionCallbackInfo<v8::Value>& info);
+  static void SendRequestCallback(
+      const v8::FunctionCallbackInfo<v8::Value>& info);
   static void SetMessageListenerCallback(
       const v8::FunctionCallbackInfo<v8::Value>& info);
+  static void PostBinaryMessageCallback(
+      const v8::FunctionCallbackInfo<v8::Value>& info);
+  static void SetBinaryMessageListenerCallback(
+      const v8::FunctionCallbackInfo<v8::Value>& info);
+
+  v8::Handle<v8::ObjectTemplate> CreateExtensionObjectTemplate(
+      v8::Isolate* isolate);
 
   static XWalkExtensionModule* GetExtensionModule(
       const v8::FunctionCallbackInfo<v8::Value>& info);
 
-  // Template for the 'extension' object exposed to the extension JS code.
-  v8::Persistent<v8::ObjectTemplate> object_template_;
-
   // This JS object contains a pointer back to the XWalkExtensionModule, it is
   // set as data for the function callbacks.
   v8::Persistent<v8::Object> function_data_;
@@ -70,6 +85,15 @@ class XWalkExtensionModule : public XWalkExtensionClient::InstanceHandler {
   // This value is registered by using 'extension.setMessageListener()'.
   v8::Persistent<v8::Function> message_listener_;
 
+  // Same as above, but for binary messages. This value is registered by using
+  // 'extension.setBinaryMessageListener()'.
+  v8::Persistent<v8::Function> binary_message_listener_;
+
+  // Callbacks waiting for the reply of 'extension.sendRequest()', which
+  // settle the promises returned by 'extension.internal.sendRequest()'.
+  typedef std::map<int, v8::Persistent<v8::Function>*> RequestCallbackMap;
+  RequestCallbackMap request_callbacks_;
+
   std::string extension_name_;
   std::string extension_code_;
 
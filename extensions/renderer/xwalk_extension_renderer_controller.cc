@@ -4,13 +4,17 @@
 
 #include "xwalk/extensions/renderer/xwalk_extension_renderer_controller.h"
 
+#include "base/bind.h"
 #include "base/command_line.h"
+#include "base/logging.h"
+#include "base/time/time.h"
 #include "base/values.h"
 #include "content/public/renderer/render_thread.h"
 #include "content/public/renderer/v8_value_converter.h"
 #include "grit/xwalk_extensions_resources.h"
 #include "ipc/ipc_channel_handle.h"
 #include "ipc/ipc_listener.h"
+#include "ipc/ipc_message_macros.h"
 #include "ipc/ipc_sync_channel.h"
 #include "third_party/WebKit/public/web/WebDocument.h"
 #include "third_party/WebKit/public/web/WebFrame.h"
@@ -19,6 +23,7 @@
 #include "xwalk/extensions/common/xwalk_extension_messages.h"
 #include "xwalk/extensions/common/xwalk_extension_switches.h"
 #include "xwalk/extensions/renderer/xwalk_extension_client.h"
+#include "xwalk/extensions/renderer/xwalk_extension_code_cache.h"
 #include "xwalk/extensions/renderer/xwalk_extension_module.h"
 #include "xwalk/extensions/renderer/xwalk_js_module.h"
 #include "xwalk/extensions/renderer/xwalk_module_system.h"
@@ -29,21 +34,34 @@ namespace extensions {
 
 const GURL kAboutBlankURL = GURL("about:blank");
 
+namespace {
+
+// The renderer is sandboxed, so the browser process persists the code cache.
+void StoreCodeCacheInBrowser(const std::string& key, const std::string& data) {
+  content::RenderThread::Get()->Send(
+      new XWalkExtensionHostMsg_StoreCodeCache(key, data));
+}
+
+}  // namespace
+
 XWalkExtensionRendererController::XWalkExtensionRendererController(
     Delegate* delegate)
-    : shutdown_event_(false, false),
+    : has_external_extensions_(false),
+      shutdown_event_(false, false),
       delegate_(delegate) {
   content::RenderThread* thread = content::RenderThread::Get();
   thread->AddObserver(this);
 
-  IPC::SyncChannel* browser_channel = thread->GetChannel();
-  SetupBrowserProcessClient(browser_channel);
+  XWalkExtensionCodeCache::GetInstance()->set_store_callback(
+      base::Bind(&StoreCodeCacheInBrowser));
+
+  SetupBrowserProcessClient(thread->GetChannel());
 
   CommandLine* cmd_line = CommandLine::ForCurrentProcess();
   if (cmd_line->HasSwitch(switches::kXWalkDisableExtensionProcess))
     LOG(INFO) << "EXTENSION PROCESS DISABLED.";
   else
-    SetupExtensionProcessClient(browser_channel);
+    SetupExtensionProcessClient();
 }
 
 XWalkExtensionRendererController::~XWalkExtensionRendererController() {
@@ -71,6 +89,14 @@ void CreateExtensionModules(XWalkExtensionClient* client,
   }
 }
 
+// The renderer is sandboxed, so shared memory used by binary messages has to
+// be allocated by the browser process.
+XWalkExtensionClient::SharedMemoryAllocator GetSharedMemoryAllocator() {
+  return base::Bind(
+      &content::RenderThread::HostAllocateSharedMemoryBuffer,
+      base::Unretained(content::RenderThread::Get()));
+}
+
 }  // namespace
 
 void XWalkExtensionRendererController::DidCreateScriptContext(
@@ -91,8 +117,15 @@ void XWalkExtensionRendererController::DidCreateScriptContext(
                          module_system);
 
   if (external_extensions_client_) {
-    CreateExtensionModules(external_extensions_client_.get(),
-                           module_system);
+    // Usually the external extensions arrive before the first script context
+    // is created. Otherwise their trampolines are installed when they arrive,
+    // page loading doesn't wait for the extension process.
+    if (has_external_extensions_) {
+      CreateExtensionModules(external_extensions_client_.get(),
+                             module_system);
+    } else {
+      pending_module_systems_.insert(module_system);
+    }
   }
 
   module_system->Initialize();
@@ -101,14 +134,50 @@ void XWalkExtensionRendererController::DidCreateScriptContext(
 void XWalkExtensionRendererController::WillReleaseScriptContext(
     WebKit::WebFrame* frame, v8::Handle<v8::Context> context) {
   v8::Context::Scope contextScope(context);
+  pending_module_systems_.erase(
+      XWalkModuleSystem::GetModuleSystemFromContext(context));
   XWalkModuleSystem::ResetModuleSystemFromContext(context);
 }
 
 bool XWalkExtensionRendererController::OnControlMessageReceived(
     const IPC::Message& message) {
+  bool handled = true;
+  IPC_BEGIN_MESSAGE_MAP(XWalkExtensionRendererController, message)
+    IPC_MESSAGE_HANDLER(XWalkExtensionMsg_CodeCacheData, OnCodeCacheData)
+    IPC_MESSAGE_HANDLER(XWalkExtensionMsg_ExternalExtensions,
+                        OnExternalExtensions)
+    IPC_MESSAGE_HANDLER(XWalkExtensionMsg_ExtensionProcessChannelCreated,
+                        OnExtensionProcessChannelCreated)
+    IPC_MESSAGE_UNHANDLED(handled = false)
+  IPC_END_MESSAGE_MAP()
+
+  if (handled)
+    return true;
   return in_browser_process_extensions_client_->OnMessageReceived(message);
 }
 
+void XWalkExtensionRendererController::OnCodeCacheData(
+    const std::map<std::string, std::string>& entries) {
+  XWalkExtensionCodeCache::GetInstance()->AddPersistentData(entries);
+}
+
+void XWalkExtensionRendererController::OnExternalExtensions(
+    const std::vector<XWalkExtensionServerMsg_ExtensionRegisterParams>&
+        extensions) {
+  if (!external_extensions_client_ || has_external_extensions_)
+    return;
+  external_extensions_client_->SetExtensions(extensions);
+  has_external_extensions_ = true;
+  InstallPendingExtensionModules();
+}
+
+void XWalkExtensionRendererController::OnExtensionProcessChannelCreated(
+    const IPC::ChannelHandle& handle) {
+  if (!external_extensions_client_)
+    return;
+  ConnectToExtensionProcess(handle);
+}
+
 void XWalkExtensionRendererController::OnRenderProcessShutdown() {
   shutdown_event_.Signal();
 }
@@ -116,25 +185,81 @@ void XWalkExtensionRendererController::OnRenderProcessShutdown() {
 void XWalkExtensionRendererController::SetupBrowserProcessClient(
     IPC::SyncChannel* browser_channel) {
   in_browser_process_extensions_client_.reset(new XWalkExtensionClient);
+  in_browser_process_extensions_client_->set_shared_memory_allocator(
+      GetSharedMemoryAllocator());
   in_browser_process_extensions_client_->Initialize(browser_channel);
 }
 
-void XWalkExtensionRendererController::SetupExtensionProcessClient(
-    IPC::SyncChannel* browser_channel) {
-  IPC::ChannelHandle handle;
-  browser_channel->Send(
-      new XWalkExtensionProcessHostMsg_GetExtensionProcessChannel(&handle));
-  // FIXME(cmarcelo): Need to account for failure in creating the channel.
-
+void XWalkExtensionRendererController::SetupExtensionProcessClient() {
   external_extensions_client_.reset(new XWalkExtensionClient);
+  external_extensions_client_->set_shared_memory_allocator(
+      GetSharedMemoryAllocator());
+  // Instances are created when JS code touches an extension namespace, only
+  // then the render process has to wait for the extension process.
+  external_extensions_client_->set_sender_needed_callback(
+      base::Bind(&XWalkExtensionRendererController::
+                     WaitForExtensionProcessChannel,
+                 base::Unretained(this)));
+}
+
+void XWalkExtensionRendererController::ConnectToExtensionProcess(
+    const IPC::ChannelHandle& handle) {
+  if (extension_process_channel_) {
+    LOG(WARNING) << "Ignoring extra extension process channel.";
+    return;
+  }
+
   extension_process_channel_.reset(new IPC::SyncChannel(handle,
       IPC::Channel::MODE_CLIENT, external_extensions_client_.get(),
       content::RenderThread::Get()->GetIOMessageLoopProxy(), true,
       &shutdown_event_));
 
+  if (has_external_extensions_) {
+    external_extensions_client_->set_sender(extension_process_channel_.get());
+    return;
+  }
+
+  // The browser sends the extensions before the channel, but ask the
+  // extension process directly in case they didn't arrive.
   external_extensions_client_->Initialize(extension_process_channel_.get());
+  has_external_extensions_ = true;
+  InstallPendingExtensionModules();
+}
+
+void XWalkExtensionRendererController::InstallPendingExtensionModules() {
+  std::set<XWalkModuleSystem*> module_systems;
+  module_systems.swap(pending_module_systems_);
+
+  std::set<XWalkModuleSystem*>::iterator it = module_systems.begin();
+  for (; it != module_systems.end(); ++it) {
+    CreateExtensionModules(external_extensions_client_.get(), *it);
+    (*it)->InstallLateExtensionModules();
+  }
 }
 
+void XWalkExtensionRendererController::WaitForExtensionProcessChannel() {
+  if (extension_process_channel_)
+    return;
+
+  const base::TimeTicks start_time = base::TimeTicks::Now();
+  IPC::ChannelHandle handle;
+  content::RenderThread::Get()->Send(
+      new XWalkExtensionProcessHostMsg_GetExtensionProcessChannel(&handle));
+
+  // The messages with the extensions and the channel are dispatched while
+  // waiting for the reply, so the channel may be already connected.
+  if (!extension_process_channel_) {
+    if (handle.name.empty()) {
+      LOG(WARNING) << "Couldn't get the extension process channel.";
+      return;
+    }
+    ConnectToExtensionProcess(handle);
+  }
+
+  VLOG(1) << "Waited "
+          << (base::TimeTicks::Now() - start_time).InMillisecondsF()
+          << "ms for the extension process channel.";
+}
 
 }  // namespace extensions
 }  // namespace xwalk
@@ -6,6 +6,7 @@
 #define XWALK_EXTENSIONS_RENDERER_XWALK_EXTENSION_RENDERER_CONTROLLER_H_
 
 #include <map>
+#include <set>
 #include <string>
 #include <vector>
 #include "base/compiler_specific.h"
@@ -14,6 +15,8 @@
 #include "content/public/renderer/render_process_observer.h"
 #include "v8/include/v8.h"
 
+struct XWalkExtensionServerMsg_ExtensionRegisterParams;
+
 namespace content {
 class RenderView;
 }
@@ -61,14 +64,36 @@ class XWalkExtensionRendererController : public content::RenderProcessObserver {
   virtual void OnRenderProcessShutdown() OVERRIDE;
 
  private:
+  void OnCodeCacheData(const std::map<std::string, std::string>& entries);
+  void OnExternalExtensions(
+      const std::vector<XWalkExtensionServerMsg_ExtensionRegisterParams>&
+          extensions);
+  void OnExtensionProcessChannelCreated(const IPC::ChannelHandle& handle);
+
   void SetupBrowserProcessClient(IPC::SyncChannel* browser_channel);
 
-  // We use the browser_channel to ask for the handle to setup the extension
-  // channel and plug the external_extensions_client_ into it.
-  void SetupExtensionProcessClient(IPC::SyncChannel* browser_channel);
+  // The browser process sends the external extensions and the handle to
+  // setup the extension channel when they are available, so page loading
+  // doesn't wait for the extension process.
+  void SetupExtensionProcessClient();
+  void ConnectToExtensionProcess(const IPC::ChannelHandle& handle);
+
+  // Installs the external extensions in the script contexts created before
+  // they arrived.
+  void InstallPendingExtensionModules();
+
+  // Blocks asking the browser process for the extension channel. Only used
+  // when the first instance of an external extension is created before the
+  // channel arrived.
+  void WaitForExtensionProcessChannel();
 
   scoped_ptr<XWalkExtensionClient> in_browser_process_extensions_client_;
   scoped_ptr<XWalkExtensionClient> external_extensions_client_;
+  bool has_external_extensions_;
+
+  // Module systems of the script contexts created before the external
+  // extensions arrived. Not owned.
+  std::set<XWalkModuleSystem*> pending_module_systems_;
 
   base::WaitableEvent shutdown_event_;
   scoped_ptr<IPC::SyncChannel> extension_process_channel_;
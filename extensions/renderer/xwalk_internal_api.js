@@ -48,6 +48,12 @@ exports.postMessage = function(function_name, args, callback) {
   return id;
 };
 
+// Binary messages have no function name nor callback, the receiver is
+// expected to know what to do with them from a previous message.
+exports.postBinaryMessage = function(buffer) {
+  extension_object.postBinaryMessage(buffer);
+};
+
 exports.removeCallback = function(id) {
   if (!id in callback_listeners)
     return;
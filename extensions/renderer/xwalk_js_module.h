@@ -20,7 +20,8 @@ scoped_ptr<XWalkNativeModule> CreateJSModuleFromResource(int resource_id);
 // should be filled with functions and properties that the module will export.
 class XWalkJSModule : public XWalkNativeModule {
  public:
-  explicit XWalkJSModule(const std::string& js_code);
+  // The |name| is used to identify the compiled code in the code cache.
+  XWalkJSModule(const std::string& name, const std::string& js_code);
   virtual ~XWalkJSModule();
 
  private:
@@ -29,6 +30,7 @@ class XWalkJSModule : public XWalkNativeModule {
 
   bool Compile(v8::Isolate* isolate, std::string* error);
 
+  std::string name_;
   std::string js_code_;
   v8::Persistent<v8::Script> compiled_script_;
 };
@@ -5,6 +5,7 @@
 #include "xwalk/extensions/renderer/xwalk_module_system.h"
 
 #include <algorithm>
+#include <iterator>
 #include "base/command_line.h"
 #include "base/logging.h"
 #include "base/stl_util.h"
@@ -67,7 +68,8 @@ void RequireNativeCallback(const v8::FunctionCallbackInfo<v8::Value>& info) {
 
 }  // namespace
 
-XWalkModuleSystem::XWalkModuleSystem(v8::Handle<v8::Context> context) {
+XWalkModuleSystem::XWalkModuleSystem(v8::Handle<v8::Context> context)
+    : installed_extension_modules_count_(0) {
   v8::Isolate* isolate = context->GetIsolate();
   v8_context_.Reset(isolate, context);
 
@@ -83,6 +85,10 @@ XWalkModuleSystem::XWalkModuleSystem(v8::Handle<v8::Context> context) {
 }
 
 XWalkModuleSystem::~XWalkModuleSystem() {
+  VLOG(1) << "Extension modules instantiated in context: "
+          << loaded_extension_modules_count() << " of "
+          << extension_modules_count() << ".";
+
   DeleteExtensionModules();
   STLDeleteValues(&native_modules_);
 
@@ -267,10 +273,9 @@ bool XWalkModuleSystem::DeleteAccessorForEntryPoint(
 
 bool XWalkModuleSystem::InstallTrampoline(v8::Handle<v8::Context> context,
                                           ExtensionModuleEntry* entry) {
-  v8::Local<v8::External> entry_ptr = v8::External::New(entry);
   bool ret;
 
-  ret = SetTrampolineAccessorForEntryPoint(context, entry->name, entry_ptr);
+  ret = InstallOrDeferTrampoline(context, entry->name, entry);
   if (!ret) {
     LOG(WARNING) << "Error installing trampoline for '"
                  << entry->name << "'.";
@@ -279,7 +284,7 @@ bool XWalkModuleSystem::InstallTrampoline(v8::Handle<v8::Context> context,
 
   std::vector<std::string>::const_iterator it = entry->entry_points.begin();
   for (; it != entry->entry_points.end(); ++it) {
-    ret = SetTrampolineAccessorForEntryPoint(context, *it, entry_ptr);
+    ret = InstallOrDeferTrampoline(context, *it, entry);
     if (!ret) {
       // TODO(vcgomes): Remove already added trampolines when it fails.
       LOG(WARNING) << "Error installing trampoline for '"
@@ -291,6 +296,78 @@ bool XWalkModuleSystem::InstallTrampoline(v8::Handle<v8::Context> context,
   return true;
 }
 
+// Installing a trampoline inside the namespace of an extension that wasn't
+// loaded yet would require walking through that namespace, triggering its
+// own trampoline. So we wait until the owner of the namespace is loaded.
+bool XWalkModuleSystem::InstallOrDeferTrampoline(
+    v8::Handle<v8::Context> context,
+    const std::string& entry_point,
+    ExtensionModuleEntry* entry) {
+  if (IsInsideUnloadedNamespace(entry_point, entry)) {
+    deferred_trampolines_.push_back(std::make_pair(entry_point, entry));
+    return true;
+  }
+  return SetTrampolineAccessorForEntryPoint(context, entry_point,
+                                            v8::External::New(entry));
+}
+
+void XWalkModuleSystem::InstallDeferredTrampolines(
+    v8::Handle<v8::Context> context) {
+  DeferredTrampolines deferred;
+  deferred.swap(deferred_trampolines_);
+
+  DeferredTrampolines::iterator it = deferred.begin();
+  for (; it != deferred.end(); ++it) {
+    if (it->second->loaded)
+      continue;
+    if (!InstallOrDeferTrampoline(context, it->first, it->second)) {
+      LOG(WARNING) << "Error installing trampoline for '"
+                   << it->second->name << "'.";
+    }
+  }
+}
+
+bool XWalkModuleSystem::IsInsideUnloadedNamespace(
+    const std::string& entry_point,
+    const ExtensionModuleEntry* entry) const {
+  ExtensionModules::const_iterator it = extension_modules_.begin();
+  for (; it != extension_modules_.end(); ++it) {
+    if (&*it == entry || it->loaded)
+      continue;
+    const std::string& ns = it->name;
+    if (entry_point.size() > ns.size() && entry_point[ns.size()] == '.'
+        && entry_point.compare(0, ns.size(), ns) == 0)
+      return true;
+  }
+  return false;
+}
+
+void XWalkModuleSystem::LoadExtensionModule(v8::Handle<v8::Context> context,
+                                            ExtensionModuleEntry* entry) {
+  if (entry->loaded)
+    return;
+  entry->loaded = true;
+
+  DeleteAccessorForEntryPoint(context, entry->name);
+
+  std::vector<std::string>::const_iterator it = entry->entry_points.begin();
+  for (; it != entry->entry_points.end(); ++it) {
+    DeleteAccessorForEntryPoint(context, *it);
+  }
+
+  v8::Handle<v8::FunctionTemplate> require_native_template =
+      v8::Handle<v8::FunctionTemplate>::New(context->GetIsolate(),
+                                            require_native_template_);
+
+  entry->module->LoadExtensionCode(context,
+                                   require_native_template->GetFunction());
+  EnsureExtensionNamespaceIsReadOnly(context, entry->name);
+
+  // Now that the namespace object exists, the trampolines for the nested
+  // extensions can be installed on it.
+  InstallDeferredTrampolines(context);
+}
+
 v8::Handle<v8::Object> XWalkModuleSystem::RequireNative(
     const std::string& name) {
   NativeModuleMap::iterator it = native_modules_.find(name);
@@ -304,26 +381,62 @@ void XWalkModuleSystem::Initialize() {
   v8::HandleScope handle_scope(isolate);
 
   v8::Handle<v8::Context> context = GetV8Context();
-  v8::Handle<v8::FunctionTemplate> require_native_template =
-      v8::Handle<v8::FunctionTemplate>::New(isolate, require_native_template_);
-  v8::Handle<v8::Function> require_native =
-      require_native_template->GetFunction();
 
-  MarkModulesWithTrampoline();
+  // Keep a deterministic order, outer namespaces before the nested ones.
+  extension_modules_.sort();
+  InstallExtensionModules(context, extension_modules_.begin());
+}
 
-  ExtensionModules::iterator it = extension_modules_.begin();
+void XWalkModuleSystem::InstallLateExtensionModules() {
+  v8::Isolate* isolate = v8::Isolate::GetCurrent();
+  v8::HandleScope handle_scope(isolate);
+
+  v8::Handle<v8::Context> context = GetV8Context();
+  v8::Context::Scope context_scope(context);
+
+  // Trampolines of nested namespaces are deferred whatever the order, until
+  // the outer namespace is loaded.
+  ExtensionModules::iterator first = extension_modules_.begin();
+  std::advance(first, installed_extension_modules_count_);
+  InstallExtensionModules(context, first);
+}
+
+void XWalkModuleSystem::InstallExtensionModules(
+    v8::Handle<v8::Context> context, ExtensionModules::iterator first) {
+  // No extension instance is created nor JS API code is evaluated at this
+  // point, only when the script first touches one of the entry points.
+  ExtensionModules::iterator it = first;
   for (; it != extension_modules_.end(); ++it) {
-    if (it->use_trampoline && InstallTrampoline(context, &*it))
-      continue;
-    it->module->LoadExtensionCode(context, require_native);
-    EnsureExtensionNamespaceIsReadOnly(context, it->name);
+    if (!InstallTrampoline(context, &*it))
+      LoadExtensionModule(context, &*it);
   }
+  installed_extension_modules_count_ = extension_modules_.size();
+
+  CommandLine* cmd_line = CommandLine::ForCurrentProcess();
+  if (!cmd_line->HasSwitch(switches::kXWalkDisableLazyExtensionLoading))
+    return;
+
+  // Load everything upfront, mostly useful to compare with the lazy
+  // behavior. Trampolines are still in place so extensions depending on
+  // each other will be loaded in the right order.
+  for (it = first; it != extension_modules_.end(); ++it)
+    LoadExtensionModule(context, &*it);
 }
 
 v8::Handle<v8::Context> XWalkModuleSystem::GetV8Context() {
   return v8::Handle<v8::Context>::New(v8::Isolate::GetCurrent(), v8_context_);
 }
 
+size_t XWalkModuleSystem::loaded_extension_modules_count() const {
+  size_t count = 0;
+  ExtensionModules::const_iterator it = extension_modules_.begin();
+  for (; it != extension_modules_.end(); ++it) {
+    if (it->loaded)
+      count++;
+  }
+  return count;
+}
+
 bool XWalkModuleSystem::ContainsEntryPoint(
     const std::string& entry) {
   ExtensionModules::iterator it = extension_modules_.begin();
@@ -361,25 +474,8 @@ void XWalkModuleSystem::LoadExtensionForTrampoline(
     return;
 
   v8::Handle<v8::Context> context = isolate->GetCurrentContext();
-
-  DeleteAccessorForEntryPoint(context, entry->name);
-
-  std::vector<std::string>::const_iterator it = entry->entry_points.begin();
-  for (; it != entry->entry_points.end(); ++it) {
-    DeleteAccessorForEntryPoint(context, *it);
-  }
-
   XWalkModuleSystem* module_system = GetModuleSystemFromContext(context);
-  v8::Handle<v8::FunctionTemplate> require_native_template =
-        v8::Handle<v8::FunctionTemplate>::New(
-            isolate,
-            module_system->require_native_template_);
-
-  XWalkExtensionModule* module = entry->module;
-  module->LoadExtensionCode(module_system->GetV8Context(),
-                            require_native_template->GetFunction());
-
-  module_system->EnsureExtensionNamespaceIsReadOnly(context, entry->name);
+  module_system->LoadExtensionModule(context, entry);
 }
 
 // static
@@ -427,46 +523,13 @@ XWalkModuleSystem::ExtensionModuleEntry::ExtensionModuleEntry(
   const std::string& name,
   XWalkExtensionModule* module,
   const std::vector<std::string>& entry_points) :
-    name(name), module(module), use_trampoline(true),
+    name(name), module(module), loaded(false),
     entry_points(entry_points) {
 }
 
 XWalkModuleSystem::ExtensionModuleEntry::~ExtensionModuleEntry() {
 }
 
-// Returns whether the name of first is prefix of the second, considering "."
-// character as a separator. So "a" is prefix of "a.b" but not of "ab".
-bool XWalkModuleSystem::ExtensionModuleEntry::IsPrefix(
-    const ExtensionModuleEntry& first,
-    const ExtensionModuleEntry& second) {
-  const std::string& p = first.name;
-  const std::string& s = second.name;
-  return s.size() > p.size() && s[p.size()] == '.'
-      && std::mismatch(p.begin(), p.end(), s.begin()).first == p.end();
-}
-
-// Mark the extension modules that we want to setup "trampolines"
-// instead of loading the code directly. The current algorithm is very
-// simple: we only create trampolines for extensions that are leaves
-// in the namespace tree.
-//
-// For example, if there are two extensions "tizen" and "tizen.time",
-// the first one won't be marked with trampoline, but the second one
-// will. So we'll only load code for "tizen" extension.
-void XWalkModuleSystem::MarkModulesWithTrampoline() {
-  std::sort(extension_modules_.begin(), extension_modules_.end());
-
-  ExtensionModules::iterator it = extension_modules_.begin();
-  while (it != extension_modules_.end()) {
-    it = std::adjacent_find(it, extension_modules_.end(),
-                            &ExtensionModuleEntry::IsPrefix);
-    if (it == extension_modules_.end())
-      break;
-    it->use_trampoline = false;
-    ++it;
-  }
-}
-
 void XWalkModuleSystem::EnsureExtensionNamespaceIsReadOnly(
     v8::Handle<v8::Context> context,
     const std::string& extension_name) {
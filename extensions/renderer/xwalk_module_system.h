@@ -5,7 +5,9 @@
 #ifndef XWALK_EXTENSIONS_RENDERER_XWALK_MODULE_SYSTEM_H_
 #define XWALK_EXTENSIONS_RENDERER_XWALK_MODULE_SYSTEM_H_
 
+#include <list>
 #include <map>
+#include <utility>
 #include <vector>
 #include <string>
 #include "base/values.h"
@@ -55,8 +57,17 @@ class XWalkModuleSystem {
 
   void Initialize();
 
+  // Installs the trampolines of the extension modules registered after
+  // Initialize(), for extensions that were not known yet.
+  void InstallLateExtensionModules();
+
   v8::Handle<v8::Context> GetV8Context();
 
+  // Number of extension modules registered in this context, and how many of
+  // them actually had their instance created and JS API code evaluated.
+  size_t extension_modules_count() const { return extension_modules_.size(); }
+  size_t loaded_extension_modules_count() const;
+
  private:
   struct ExtensionModuleEntry {
     ExtensionModuleEntry(const std::string& name, XWalkExtensionModule* module,
@@ -64,14 +75,11 @@ class XWalkModuleSystem {
     ~ExtensionModuleEntry();
     std::string name;
     XWalkExtensionModule* module;
-    bool use_trampoline;
+    bool loaded;
     std::vector<std::string> entry_points;
     bool operator<(const ExtensionModuleEntry& other) const {
       return name < other.name;
     }
-
-    static bool IsPrefix(const ExtensionModuleEntry& first,
-                         const ExtensionModuleEntry& second);
   };
 
   bool SetTrampolineAccessorForEntryPoint(
@@ -82,8 +90,21 @@ class XWalkModuleSystem {
   static bool DeleteAccessorForEntryPoint(v8::Handle<v8::Context> context,
                                           const std::string& entry_point);
 
+  typedef std::list<ExtensionModuleEntry> ExtensionModules;
+
+  void InstallExtensionModules(v8::Handle<v8::Context> context,
+                               ExtensionModules::iterator first);
   bool InstallTrampoline(v8::Handle<v8::Context> context,
                          ExtensionModuleEntry* entry);
+  bool InstallOrDeferTrampoline(v8::Handle<v8::Context> context,
+                                const std::string& entry_point,
+                                ExtensionModuleEntry* entry);
+  void InstallDeferredTrampolines(v8::Handle<v8::Context> context);
+  bool IsInsideUnloadedNamespace(const std::string& entry_point,
+                                 const ExtensionModuleEntry* entry) const;
+
+  void LoadExtensionModule(v8::Handle<v8::Context> context,
+                           ExtensionModuleEntry* entry);
 
   static void TrampolineCallback(
       v8::Local<v8::String> property,
@@ -100,14 +121,21 @@ class XWalkModuleSystem {
     v8::Local<v8::Value> data);
 
   bool ContainsEntryPoint(const std::string& entry_point);
-  void MarkModulesWithTrampoline();
   void DeleteExtensionModules();
 
   void EnsureExtensionNamespaceIsReadOnly(v8::Handle<v8::Context> context,
                                           const std::string& extension_name);
 
-  typedef std::vector<ExtensionModuleEntry> ExtensionModules;
+  // A list, so the entries pointed to by the trampolines don't move when
+  // more are registered.
   ExtensionModules extension_modules_;
+  size_t installed_extension_modules_count_;
+
+  // Trampolines that can only be installed after the extension owning the
+  // namespace they live in is loaded, e.g. "tizen.time" waits for "tizen".
+  typedef std::vector<std::pair<std::string, ExtensionModuleEntry*> >
+      DeferredTrampolines;
+  DeferredTrampolines deferred_trampolines_;
 
   typedef std::map<std::string, XWalkNativeModule*> NativeModuleMap;
   NativeModuleMap native_modules_;
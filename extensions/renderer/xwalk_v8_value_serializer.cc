@@ -0,0 +1,190 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/extensions/renderer/xwalk_v8_value_serializer.h"
+
+#include <map>
+#include "base/basictypes.h"
+#include "base/float_util.h"
+#include "base/logging.h"
+#include "base/pickle.h"
+#include "base/strings/string_piece.h"
+#include "xwalk/extensions/common/xwalk_serialized_value.h"
+
+namespace xwalk {
+namespace extensions {
+
+namespace {
+
+// Deeper values are rejected by XWalkSerializedValue::Read().
+const int kMaxRecursionDepth = 100;
+
+base::StringPiece ToStringPiece(const v8::String::Utf8Value& utf8) {
+  return base::StringPiece(*utf8, utf8.length());
+}
+
+class V8ValueSerializer {
+ public:
+  explicit V8ValueSerializer(Pickle* pickle) : pickle_(pickle) {}
+
+  // Returns false if |value| can't be serialized, see SerializeV8Value().
+  bool Serialize(v8::Handle<v8::Value> value, int depth);
+
+ private:
+  // Values that V8ValueConverter doesn't convert, they are skipped in objects
+  // and replaced by null in arrays.
+  bool ShouldSkip(v8::Handle<v8::Value> value);
+
+  bool SerializeArray(v8::Handle<v8::Array> array, int depth);
+  bool SerializeObject(v8::Handle<v8::Object> object, int depth);
+
+  bool WasSerialized(v8::Handle<v8::Object> object);
+
+  Pickle* pickle_;
+
+  // Identity hashes are not unique, so the handles are compared too.
+  typedef std::multimap<int, v8::Handle<v8::Object> > ObjectMap;
+  ObjectMap serialized_objects_;
+
+  DISALLOW_COPY_AND_ASSIGN(V8ValueSerializer);
+};
+
+bool V8ValueSerializer::ShouldSkip(v8::Handle<v8::Value> value) {
+  if (value->IsUndefined() || value->IsFunction())
+    return true;
+  if (value->IsNumber() && !base::IsFinite(value->NumberValue()))
+    return true;
+  return value->IsObject() && WasSerialized(value.As<v8::Object>());
+}
+
+bool V8ValueSerializer::WasSerialized(v8::Handle<v8::Object> object) {
+  std::pair<ObjectMap::iterator, ObjectMap::iterator> range =
+      serialized_objects_.equal_range(object->GetIdentityHash());
+  for (ObjectMap::iterator it = range.first; it != range.second; ++it) {
+    if (it->second == object)
+      return true;
+  }
+  return false;
+}
+
+bool V8ValueSerializer::Serialize(v8::Handle<v8::Value> value, int depth) {
+  if (depth > kMaxRecursionDepth)
+    return false;
+
+  if (value->IsNull()) {
+    XWalkSerializedValue::WriteNull(pickle_);
+    return true;
+  }
+
+  if (value->IsBoolean()) {
+    XWalkSerializedValue::WriteBoolean(value->BooleanValue(), pickle_);
+    return true;
+  }
+
+  if (value->IsInt32()) {
+    XWalkSerializedValue::WriteInteger(value->Int32Value(), pickle_);
+    return true;
+  }
+
+  if (value->IsNumber()) {
+    // Inside containers these were skipped already, see ShouldSkip().
+    const double number = value->NumberValue();
+    if (!base::IsFinite(number))
+      return false;
+    XWalkSerializedValue::WriteDouble(number, pickle_);
+    return true;
+  }
+
+  if (value->IsString()) {
+    v8::String::Utf8Value utf8(value);
+    XWalkSerializedValue::WriteString(ToStringPiece(utf8), pickle_);
+    return true;
+  }
+
+  // These have special handling in the converter, leave them to it.
+  if (value->IsUndefined() || value->IsFunction() || value->IsDate() ||
+      value->IsRegExp() || value->IsArrayBuffer() ||
+      value->IsArrayBufferView())
+    return false;
+
+  if (value->IsArray())
+    return SerializeArray(value.As<v8::Array>(), depth);
+
+  if (value->IsObject())
+    return SerializeObject(value.As<v8::Object>(), depth);
+
+  return false;
+}
+
+bool V8ValueSerializer::SerializeArray(v8::Handle<v8::Array> array,
+                                       int depth) {
+  serialized_objects_.insert(std::make_pair(array->GetIdentityHash(), array));
+
+  XWalkSerializedValue::BeginList(pickle_);
+  const uint32_t length = array->Length();
+  for (uint32_t i = 0; i < length; ++i) {
+    v8::TryCatch try_catch;
+    v8::Handle<v8::Value> child = array->Get(i);
+    if (try_catch.HasCaught()) {
+      LOG(WARNING) << "Getter for index " << i << " threw an exception.";
+      child = v8::Null();
+    }
+
+    // Holes are skipped, like the converter does.
+    if (!array->HasRealIndexedProperty(i))
+      continue;
+
+    if (ShouldSkip(child)) {
+      XWalkSerializedValue::WriteNull(pickle_);
+      continue;
+    }
+    if (!Serialize(child, depth + 1))
+      return false;
+  }
+  XWalkSerializedValue::EndContainer(pickle_);
+  return true;
+}
+
+bool V8ValueSerializer::SerializeObject(v8::Handle<v8::Object> object,
+                                        int depth) {
+  serialized_objects_.insert(
+      std::make_pair(object->GetIdentityHash(), object));
+
+  XWalkSerializedValue::BeginDictionary(pickle_);
+  v8::Handle<v8::Array> names = object->GetOwnPropertyNames();
+  const uint32_t length = names->Length();
+  for (uint32_t i = 0; i < length; ++i) {
+    v8::Handle<v8::Value> key = names->Get(i);
+    if (!key->IsString() && !key->IsNumber())
+      continue;
+
+    v8::String::Utf8Value name(key->ToString());
+    v8::TryCatch try_catch;
+    v8::Handle<v8::Value> child = object->Get(key);
+    if (try_catch.HasCaught()) {
+      LOG(WARNING) << "Getter for property " << *name
+                   << " threw an exception.";
+      child = v8::Null();
+    }
+
+    if (ShouldSkip(child))
+      continue;
+
+    XWalkSerializedValue::WriteKey(ToStringPiece(name), pickle_);
+    if (!Serialize(child, depth + 1))
+      return false;
+  }
+  XWalkSerializedValue::EndContainer(pickle_);
+  return true;
+}
+
+}  // namespace
+
+bool SerializeV8Value(v8::Handle<v8::Value> value, Pickle* pickle) {
+  V8ValueSerializer serializer(pickle);
+  return serializer.Serialize(value, 0);
+}
+
+}  // namespace extensions
+}  // namespace xwalk
@@ -0,0 +1,29 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef XWALK_EXTENSIONS_RENDERER_XWALK_V8_VALUE_SERIALIZER_H_
+#define XWALK_EXTENSIONS_RENDERER_XWALK_V8_VALUE_SERIALIZER_H_
+
+#include "v8/include/v8.h"
+
+class Pickle;
+
+namespace xwalk {
+namespace extensions {
+
+// Writes |value| into |pickle| in the format read by XWalkSerializedValue,
+// without creating a base::Value. The result is the same that
+// content::V8ValueConverter would produce: functions, undefined, NaN and the
+// infinities become null inside arrays and are dropped from objects, and so
+// are objects that appear more than once.
+//
+// Returns false for values that this serializer doesn't handle, like
+// ArrayBuffers, Dates, or undefined and NaN at the top level. The contents
+// written to |pickle| should then be discarded and the converter used instead.
+bool SerializeV8Value(v8::Handle<v8::Value> value, Pickle* pickle);
+
+}  // namespace extensions
+}  // namespace xwalk
+
+#endif  // XWALK_EXTENSIONS_RENDERER_XWALK_V8_VALUE_SERIALIZER_H_
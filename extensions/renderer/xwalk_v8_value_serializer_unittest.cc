@@ -0,0 +1,175 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/extensions/renderer/xwalk_v8_value_serializer.h"
+
+#include <string>
+#include "base/memory/scoped_ptr.h"
+#include "base/pickle.h"
+#include "base/values.h"
+#include "content/public/renderer/v8_value_converter.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "xwalk/extensions/common/xwalk_serialized_value.h"
+
+using xwalk::extensions::SerializeV8Value;
+using xwalk::extensions::XWalkSerializedValue;
+
+// The serializer is used instead of content::V8ValueConverter when posting
+// messages, so the extensions must get the same base::Value either way.
+class XWalkV8ValueSerializerTest : public testing::Test {
+ protected:
+  XWalkV8ValueSerializerTest()
+      : isolate_(v8::Isolate::GetCurrent()),
+        converter_(content::V8ValueConverter::create()) {}
+
+  virtual void SetUp() OVERRIDE {
+    v8::HandleScope handle_scope(isolate_);
+    context_.Reset(isolate_, v8::Context::New(isolate_));
+  }
+
+  virtual void TearDown() OVERRIDE {
+    context_.Reset();
+  }
+
+  // Runs |script| and checks that its result, serialized and read back, is
+  // the same value that the converter creates.
+  void ExpectSameAsConverter(const std::string& script) {
+    v8::HandleScope handle_scope(isolate_);
+    v8::Local<v8::Context> context =
+        v8::Local<v8::Context>::New(isolate_, context_);
+    v8::Context::Scope context_scope(context);
+
+    v8::Handle<v8::Value> value = Run(script);
+    ASSERT_FALSE(value.IsEmpty()) << script;
+    scoped_ptr<base::Value> expected(converter_->FromV8Value(value, context));
+    ASSERT_TRUE(expected) << script;
+
+    Pickle pickle;
+    ASSERT_TRUE(SerializeV8Value(value, &pickle)) << script;
+    PickleIterator iter(pickle);
+    XWalkSerializedValue serialized;
+    ASSERT_TRUE(XWalkSerializedValue::Read(&iter, &serialized)) << script;
+    scoped_ptr<base::Value> actual(serialized.ToValue());
+    ASSERT_TRUE(actual) << script;
+    EXPECT_TRUE(expected->Equals(actual.get())) << script;
+  }
+
+  // Whether the result of |script| is serialized instead of being left to the
+  // converter.
+  bool CanSerialize(const std::string& script) {
+    v8::HandleScope handle_scope(isolate_);
+    v8::Local<v8::Context> context =
+        v8::Local<v8::Context>::New(isolate_, context_);
+    v8::Context::Scope context_scope(context);
+
+    Pickle pickle;
+    return SerializeV8Value(Run(script), &pickle);
+  }
+
+ private:
+  v8::Handle<v8::Value> Run(const std::string& script) {
+    return v8::Script::Compile(
+        v8::String::NewFromUtf8(isolate_, script.c_str()))->Run();
+  }
+
+  v8::Isolate* isolate_;
+  v8::Persistent<v8::Context> context_;
+  scoped_ptr<content::V8ValueConverter> converter_;
+};
+
+TEST_F(XWalkV8ValueSerializerTest, Primitives) {
+  ExpectSameAsConverter("null");
+  ExpectSameAsConverter("true");
+  ExpectSameAsConverter("false");
+  ExpectSameAsConverter("''");
+  ExpectSameAsConverter("'crosswalk'");
+  ExpectSameAsConverter("'\\u00e7\\u4e2d\\ud83d\\ude00'");
+  ExpectSameAsConverter("'embedded\\u0000null'");
+}
+
+TEST_F(XWalkV8ValueSerializerTest, Numbers) {
+  ExpectSameAsConverter("0");
+  ExpectSameAsConverter("-0");
+  ExpectSameAsConverter("1");
+  ExpectSameAsConverter("-1");
+  ExpectSameAsConverter("1.0");
+  ExpectSameAsConverter("1.5");
+  ExpectSameAsConverter("2147483647");
+  ExpectSameAsConverter("-2147483648");
+  ExpectSameAsConverter("2147483648");
+  ExpectSameAsConverter("-2147483649");
+  ExpectSameAsConverter("Math.pow(2, 53)");
+  ExpectSameAsConverter("Number.MIN_VALUE");
+  ExpectSameAsConverter("[1, 1.5, 2147483648, -0, 1e300]");
+  ExpectSameAsConverter("[NaN, Infinity, -Infinity]");
+  ExpectSameAsConverter("({nan: NaN, inf: Infinity, one: 1})");
+}
+
+TEST_F(XWalkV8ValueSerializerTest, Arrays) {
+  ExpectSameAsConverter("[]");
+  ExpectSameAsConverter("[null, true, 'a', 1, 2.5]");
+  ExpectSameAsConverter("[[], [[]], [[1], [2, [3]]]]");
+  ExpectSameAsConverter("[undefined, function() {}, 1]");
+  ExpectSameAsConverter("[1, , 3]");
+  ExpectSameAsConverter("var a = [1, 2]; a[5] = 6; a");
+  ExpectSameAsConverter("var a = [1]; a.extra = 2; a");
+  ExpectSameAsConverter("new Array(3)");
+}
+
+TEST_F(XWalkV8ValueSerializerTest, NestedObjects) {
+  ExpectSameAsConverter("({})");
+  ExpectSameAsConverter("({a: null, b: true, c: 'c', d: 1, e: 1.5})");
+  ExpectSameAsConverter("({a: {b: {c: {d: [1, {e: 'f'}]}}}})");
+  ExpectSameAsConverter("({undef: undefined, fn: function() {}, x: 1})");
+  ExpectSameAsConverter("({'with.dot': 1, '': 2, 'a.b.c': {'.': 3}})");
+  ExpectSameAsConverter("['f', '42', [{name: 'Person', age: 30}]]");
+
+  // Only own properties are converted.
+  ExpectSameAsConverter(
+      "function P() { this.own = 1; }"
+      "P.prototype.inherited = 2;"
+      "new P()");
+}
+
+TEST_F(XWalkV8ValueSerializerTest, NonStringKeys) {
+  ExpectSameAsConverter("({1: 'one', 2.5: 'two and a half', '-1': 'x'})");
+  ExpectSameAsConverter("({4294967295: 'a', 4294967296: 'b'})");
+  ExpectSameAsConverter("var o = {}; o[true] = 1; o[null] = 2; o");
+  ExpectSameAsConverter("var o = {}; o[{}] = 1; o");
+}
+
+TEST_F(XWalkV8ValueSerializerTest, RepeatedObjects) {
+  ExpectSameAsConverter("var o = {a: 1}; [o, o]");
+  ExpectSameAsConverter("var o = {a: 1}; ({x: o, y: o})");
+  ExpectSameAsConverter("var a = [1]; ({x: a, y: [a, a]})");
+}
+
+TEST_F(XWalkV8ValueSerializerTest, Cycles) {
+  ExpectSameAsConverter("var o = {a: 1}; o.self = o; o");
+  ExpectSameAsConverter("var a = [1]; a.push(a); a");
+  ExpectSameAsConverter("var o = {}; var a = [o]; o.list = a; a");
+  ExpectSameAsConverter(
+      "var parent = {children: []};"
+      "parent.children.push({parent: parent, name: 'child'});"
+      "parent");
+}
+
+TEST_F(XWalkV8ValueSerializerTest, LeftToTheConverter) {
+  EXPECT_FALSE(CanSerialize("undefined"));
+  EXPECT_FALSE(CanSerialize("NaN"));
+  EXPECT_FALSE(CanSerialize("Infinity"));
+  EXPECT_FALSE(CanSerialize("(function() {})"));
+  EXPECT_FALSE(CanSerialize("new Date(0)"));
+  EXPECT_FALSE(CanSerialize("/regexp/"));
+  EXPECT_FALSE(CanSerialize("new ArrayBuffer(4)"));
+  EXPECT_FALSE(CanSerialize("new Uint8Array(4)"));
+  EXPECT_FALSE(CanSerialize("({date: new Date(0)})"));
+  EXPECT_FALSE(CanSerialize("[new ArrayBuffer(4)]"));
+
+  // Deeper than XWalkSerializedValue::Read() accepts.
+  EXPECT_FALSE(CanSerialize(
+      "var deep = []; for (var i = 0; i < 200; ++i) deep = [deep]; deep"));
+  EXPECT_TRUE(CanSerialize(
+      "var deep = []; for (var i = 0; i < 50; ++i) deep = [deep]; deep"));
+}
@@ -4,7 +4,11 @@
 
 #include "xwalk/extensions/renderer/xwalk_v8tools_module.h"
 
+#include <vector>
+#include "base/bind.h"
 #include "base/logging.h"
+#include "base/memory/ref_counted.h"
+#include "base/message_loop/message_loop.h"
 #include "content/public/renderer/render_view.h"
 #include "ipc/ipc_message.h"
 #include "third_party/WebKit/public/web/WebFrame.h"
@@ -69,6 +73,152 @@ void LifecycleTracker(const v8::FunctionCallbackInfo<v8::Value>& info) {
   info.GetReturnValue().Set(tracker);
 }
 
+// Gathers the integer IDs of the objects tracked with notifier.track(object,
+// id) as they get collected and passes them all at once to the callback of the
+// notifier, from a task posted by the first of them. The weak callbacks run in
+// the middle of the garbage collection, when no JavaScript can be called, so
+// unlike LifecycleTracker this needs neither a context nor a call per object.
+class CollectionNotifier : public base::RefCounted<CollectionNotifier> {
+ public:
+  CollectionNotifier(v8::Isolate* isolate, v8::Handle<v8::Object> wrapper,
+                     v8::Handle<v8::Function> callback);
+
+  void Track(v8::Handle<v8::Object> object, int id);
+
+  static void TrackCallback(const v8::FunctionCallbackInfo<v8::Value>& info);
+
+ private:
+  friend class base::RefCounted<CollectionNotifier>;
+
+  struct TrackedObject {
+    v8::Persistent<v8::Object> object;
+    int id;
+    scoped_refptr<CollectionNotifier> notifier;
+  };
+
+  ~CollectionNotifier();
+
+  static void OnObjectCollected(v8::Isolate* isolate,
+                                v8::Persistent<v8::Object>* object,
+                                TrackedObject* tracked);
+  static void OnWrapperCollected(v8::Isolate* isolate,
+                                 v8::Persistent<v8::Object>* wrapper,
+                                 CollectionNotifier* notifier);
+  static void OnCallbackCollected(v8::Isolate* isolate,
+                                  v8::Persistent<v8::Function>* callback,
+                                  CollectionNotifier* notifier);
+
+  void Flush();
+
+  v8::Isolate* isolate_;
+
+  // Both are weak, the notifier is kept alive by the objects it tracks and
+  // by its JS wrapper.
+  v8::Persistent<v8::Object> wrapper_;
+  v8::Persistent<v8::Function> callback_;
+
+  std::vector<int> collected_ids_;
+};
+
+CollectionNotifier::CollectionNotifier(v8::Isolate* isolate,
+                                       v8::Handle<v8::Object> wrapper,
+                                       v8::Handle<v8::Function> callback)
+    : isolate_(isolate) {
+  // Released by OnWrapperCollected().
+  AddRef();
+  wrapper->SetAlignedPointerInInternalField(0, this);
+  wrapper_.Reset(isolate, wrapper);
+  wrapper_.MakeWeak<CollectionNotifier>(this, &OnWrapperCollected);
+  callback_.Reset(isolate, callback);
+  callback_.MakeWeak<CollectionNotifier>(this, &OnCallbackCollected);
+}
+
+CollectionNotifier::~CollectionNotifier() {
+  wrapper_.Reset();
+  callback_.Reset();
+}
+
+void CollectionNotifier::Track(v8::Handle<v8::Object> object, int id) {
+  TrackedObject* tracked = new TrackedObject;
+  tracked->object.Reset(isolate_, object);
+  tracked->object.MakeWeak<TrackedObject>(tracked, &OnObjectCollected);
+  tracked->id = id;
+  tracked->notifier = this;
+}
+
+// static
+void CollectionNotifier::TrackCallback(
+    const v8::FunctionCallbackInfo<v8::Value>& info) {
+  info.GetReturnValue().SetUndefined();
+
+  if (info.Length() != 2 || !info[0]->IsObject() || !info[1]->IsInt32())
+    return;
+
+  CollectionNotifier* notifier = static_cast<CollectionNotifier*>(
+      info.Holder()->GetAlignedPointerFromInternalField(0));
+  if (!notifier)
+    return;
+
+  notifier->Track(info[0].As<v8::Object>(), info[1]->Int32Value());
+}
+
+// static
+void CollectionNotifier::OnObjectCollected(v8::Isolate* isolate,
+                                           v8::Persistent<v8::Object>* object,
+                                           TrackedObject* tracked) {
+  CollectionNotifier* notifier = tracked->notifier.get();
+  if (notifier->collected_ids_.empty()) {
+    base::MessageLoop::current()->PostTask(
+        FROM_HERE, base::Bind(&CollectionNotifier::Flush, notifier));
+  }
+  notifier->collected_ids_.push_back(tracked->id);
+
+  tracked->object.Reset();
+  delete tracked;
+}
+
+// static
+void CollectionNotifier::OnWrapperCollected(
+    v8::Isolate* isolate, v8::Persistent<v8::Object>* wrapper,
+    CollectionNotifier* notifier) {
+  notifier->wrapper_.Reset();
+  notifier->Release();
+}
+
+// static
+void CollectionNotifier::OnCallbackCollected(
+    v8::Isolate* isolate, v8::Persistent<v8::Function>* callback,
+    CollectionNotifier* notifier) {
+  notifier->callback_.Reset();
+}
+
+void CollectionNotifier::Flush() {
+  std::vector<int> ids;
+  ids.swap(collected_ids_);
+
+  // Without callback the context is gone, and so is whoever should know.
+  if (callback_.IsEmpty())
+    return;
+
+  v8::HandleScope handle_scope(isolate_);
+  v8::Handle<v8::Function> callback =
+      v8::Local<v8::Function>::New(isolate_, callback_);
+  v8::Handle<v8::Context> context = callback->CreationContext();
+  v8::Context::Scope context_scope(context);
+
+  v8::Handle<v8::Array> array = v8::Array::New(ids.size());
+  for (size_t i = 0; i < ids.size(); ++i)
+    array->Set(i, v8::Integer::New(ids[i]));
+
+  WebKit::WebScopedMicrotaskSuppression suppression;
+  v8::TryCatch try_catch;
+  v8::Handle<v8::Value> argv[] = { array };
+  callback->Call(context->Global(), 1, argv);
+  if (try_catch.HasCaught())
+    LOG(WARNING) << "Exception when notifying collected objects: "
+        << ExceptionToString(try_catch);
+}
+
 RenderView* GetCurrentRenderView() {
   WebFrame* frame = WebFrame::frameForCurrentContext();
   DCHECK(frame) << "There should be an active frame here";
@@ -126,14 +276,53 @@ XWalkV8ToolsModule::XWalkV8ToolsModule() {
   object_template->Set(v8::String::NewFromUtf8(isolate, "lifecycleTracker"),
                        v8::FunctionTemplate::New(LifecycleTracker));
 
+  object_template->Set(
+      v8::String::NewFromUtf8(isolate, "collectionNotifier"),
+      v8::FunctionTemplate::New(CreateCollectionNotifier,
+                                v8::External::New(this)));
+
   object_template->Set(v8::String::NewFromUtf8(isolate, "getWindowObject"),
                        v8::FunctionTemplate::New(GetWindowObject));
 
   object_template_.Reset(isolate, object_template);
+
+  v8::Handle<v8::ObjectTemplate> notifier_template = v8::ObjectTemplate::New();
+  notifier_template->SetInternalFieldCount(1);
+  notifier_template->Set(
+      v8::String::NewFromUtf8(isolate, "track"),
+      v8::FunctionTemplate::New(CollectionNotifier::TrackCallback));
+  notifier_template_.Reset(isolate, notifier_template);
 }
 
 XWalkV8ToolsModule::~XWalkV8ToolsModule() {
   object_template_.Reset();
+  notifier_template_.Reset();
+}
+
+// v8tools.collectionNotifier(callback) returns a notifier whose track(object,
+// id) calls |callback| with an array of the integer IDs of the tracked objects
+// that were collected, once per garbage collection.
+// static
+void XWalkV8ToolsModule::CreateCollectionNotifier(
+    const v8::FunctionCallbackInfo<v8::Value>& info) {
+  info.GetReturnValue().SetUndefined();
+
+  if (info.Length() != 1 || !info[0]->IsFunction())
+    return;
+
+  v8::Isolate* isolate = info.GetIsolate();
+  v8::HandleScope handle_scope(isolate);
+
+  XWalkV8ToolsModule* module = static_cast<XWalkV8ToolsModule*>(
+      info.Data().As<v8::External>()->Value());
+  v8::Handle<v8::ObjectTemplate> notifier_template =
+      v8::Local<v8::ObjectTemplate>::New(isolate, module->notifier_template_);
+  v8::Handle<v8::Object> wrapper = notifier_template->NewInstance();
+
+  // Owned by |wrapper| and the objects it tracks.
+  new CollectionNotifier(isolate, wrapper, info[0].As<v8::Function>());
+
+  info.GetReturnValue().Set(wrapper);
 }
 
 v8::Handle<v8::Object> XWalkV8ToolsModule::NewInstance() {
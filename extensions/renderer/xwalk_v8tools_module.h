@@ -20,7 +20,11 @@ class XWalkV8ToolsModule : public XWalkNativeModule {
  private:
   virtual v8::Handle<v8::Object> NewInstance() OVERRIDE;
 
+  static void CreateCollectionNotifier(
+      const v8::FunctionCallbackInfo<v8::Value>& info);
+
   v8::Persistent<v8::ObjectTemplate> object_template_;
+  v8::Persistent<v8::ObjectTemplate> notifier_template_;
 };
 
 }  // namespace extensions
@@ -0,0 +1,100 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#if defined(__cplusplus)
+#error "This file is written in C to make sure the C API works as intended."
+#endif
+
+// External variant of the echo extension used by xwalk_extensions_benchmark,
+// see xwalk_extensions_benchmark.cc for the message format. It must behave
+// the same as BenchmarkInstance there.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "xwalk/extensions/public/XW_Extension.h"
+#include "xwalk/extensions/public/XW_Extension_SyncMessage.h"
+
+XW_Extension g_extension = 0;
+const XW_CoreInterface* g_core = NULL;
+const XW_MessagingInterface* g_messaging = NULL;
+const XW_Internal_SyncMessagingInterface* g_sync_messaging = NULL;
+
+int g_instances_created = 0;
+int g_instances_destroyed = 0;
+int g_messages_dropped = 0;
+
+void instance_created(XW_Instance instance) {
+  g_instances_created++;
+}
+
+void instance_destroyed(XW_Instance instance) {
+  g_instances_destroyed++;
+}
+
+void handle_message(XW_Instance instance, const char* message) {
+  char reply[64];
+
+  switch (message[0]) {
+    case 'd':
+      g_messages_dropped++;
+      break;
+    case 'f':
+      snprintf(reply, sizeof(reply), "f%d", g_messages_dropped);
+      g_messages_dropped = 0;
+      g_messaging->PostMessage(instance, reply);
+      break;
+    default:
+      g_messaging->PostMessage(instance, message);
+      break;
+  }
+}
+
+void handle_sync_message(XW_Instance instance, const char* message) {
+  char reply[64];
+
+  if (message[0] == 'i') {
+    snprintf(reply, sizeof(reply), "i%d,%d",
+             g_instances_created, g_instances_destroyed);
+    g_sync_messaging->SetSyncReply(instance, reply);
+    return;
+  }
+  g_sync_messaging->SetSyncReply(instance, message);
+}
+
+int32_t XW_Initialize(XW_Extension extension, XW_GetInterface get_interface) {
+  static const char* kAPI =
+      "var listener = null;"
+      "extension.setMessageListener(function(msg) {"
+      "  if (listener instanceof Function) {"
+      "    listener(msg);"
+      "  };"
+      "});"
+      "exports.setListener = function(callback) {"
+      "  listener = callback;"
+      "};"
+      "exports.post = function(msg) {"
+      "  extension.postMessage(msg);"
+      "};"
+      "exports.sync = function(msg) {"
+      "  return extension.internal.sendSyncMessage(msg);"
+      "};"
+      "exports.request = function(msg) {"
+      "  return extension.internal.sendRequest(msg);"
+      "};";
+
+  g_extension = extension;
+  g_core = get_interface(XW_CORE_INTERFACE);
+  g_core->SetExtensionName(extension, "benchmark_external");
+  g_core->SetJavaScriptAPI(extension, kAPI);
+  g_core->RegisterInstanceCallbacks(
+      extension, instance_created, instance_destroyed);
+
+  g_messaging = get_interface(XW_MESSAGING_INTERFACE);
+  g_messaging->Register(extension, handle_message);
+
+  g_sync_messaging = get_interface(XW_INTERNAL_SYNC_MESSAGING_INTERFACE);
+  g_sync_messaging->Register(extension, handle_sync_message);
+
+  return XW_OK;
+}
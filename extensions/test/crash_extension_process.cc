@@ -40,3 +40,30 @@ IN_PROC_BROWSER_TEST_F(CrashExtensionTest, CrashExtensionProcessKeepBPAlive) {
 
   EXPECT_EQ(kPassString, title_watcher.WaitAndGetTitle());
 }
+
+class SharedCrashExtensionTest : public CrashExtensionTest {
+ public:
+  virtual void SetUpCommandLine(CommandLine* command_line) OVERRIDE {
+    CrashExtensionTest::SetUpCommandLine(command_line);
+    command_line->AppendSwitch(switches::kXWalkSharedExtensionProcess);
+  }
+};
+
+IN_PROC_BROWSER_TEST_F(SharedCrashExtensionTest,
+                       CrashSharedExtensionProcessKeepBPAlive) {
+  CommandLine* cmd_line = CommandLine::ForCurrentProcess();
+  if (cmd_line->HasSwitch(switches::kXWalkDisableExtensionProcess)) {
+    LOG(INFO) << "--disable-extension-process not supported by " \
+                 "CrashSharedExtensionProcessKeepBPAlive. Skipping test.";
+    return;
+  }
+
+  GURL url = GetExtensionsTestURL(base::FilePath(),
+                                  base::FilePath().AppendASCII("crash.html"));
+  content::TitleWatcher title_watcher(runtime()->web_contents(), kPassString);
+
+  xwalk_test_utils::NavigateToURL(runtime(), url);
+  WaitForLoadStop(runtime()->web_contents());
+
+  EXPECT_EQ(kPassString, title_watcher.WaitAndGetTitle());
+}
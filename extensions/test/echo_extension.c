@@ -9,12 +9,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "xwalk/extensions/public/XW_Extension.h"
+#include "xwalk/extensions/public/XW_Extension_BinaryMessage.h"
 #include "xwalk/extensions/public/XW_Extension_SyncMessage.h"
 
 XW_Extension g_extension = 0;
 const XW_CoreInterface* g_core = NULL;
 const XW_MessagingInterface* g_messaging = NULL;
 const XW_Internal_SyncMessagingInterface* g_sync_messaging = NULL;
+const XW_BinaryMessagingInterface* g_binary_messaging = NULL;
 
 void instance_created(XW_Instance instance) {
   printf("Instance %d created!\n", instance);
@@ -28,6 +30,11 @@ void handle_message(XW_Instance instance, const char* message) {
   g_messaging->PostMessage(instance, message);
 }
 
+void handle_binary_message(XW_Instance instance, const char* message,
+                           size_t size) {
+  g_binary_messaging->PostMessage(instance, message, size);
+}
+
 void handle_sync_message(XW_Instance instance, const char* message) {
   g_sync_messaging->SetSyncReply(instance, message);
 }
@@ -50,6 +57,16 @@ int32_t XW_Initialize(XW_Extension extension, XW_GetInterface get_interface) {
       "};"
       "exports.syncEcho = function(msg) {"
       "  return extension.internal.sendSyncMessage(msg);"
+      "};"
+      "var binaryEchoListener = null;"
+      "extension.setBinaryMessageListener(function(buffer) {"
+      "  if (binaryEchoListener instanceof Function) {"
+      "    binaryEchoListener(buffer);"
+      "  };"
+      "});"
+      "exports.binaryEcho = function(buffer, callback) {"
+      "  binaryEchoListener = callback;"
+      "  extension.postBinaryMessage(buffer);"
       "};";
 
   g_extension = extension;
@@ -63,6 +80,9 @@ int32_t XW_Initialize(XW_Extension extension, XW_GetInterface get_interface) {
   g_messaging = get_interface(XW_MESSAGING_INTERFACE);
   g_messaging->Register(extension, handle_message);
 
+  g_binary_messaging = get_interface(XW_BINARY_MESSAGING_INTERFACE);
+  g_binary_messaging->Register(extension, handle_binary_message);
+
   g_sync_messaging = get_interface(XW_INTERNAL_SYNC_MESSAGING_INTERFACE);
   g_sync_messaging->Register(extension, handle_sync_message);
 
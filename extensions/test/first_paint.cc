@@ -0,0 +1,61 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/logging.h"
+#include "xwalk/extensions/browser/xwalk_extension_service.h"
+#include "xwalk/extensions/test/xwalk_extensions_test_base.h"
+#include "xwalk/runtime/browser/runtime.h"
+#include "xwalk/test/base/xwalk_test_utils.h"
+#include "content/public/test/browser_test_utils.h"
+#include "content/public/test/test_utils.h"
+
+using xwalk::extensions::XWalkExtensionService;
+
+// Render processes don't wait for the extension process before loading a
+// page, so the time to the first frame of a page that doesn't use extensions
+// should be about the same with and without external extensions. The times
+// are logged to be compared, they vary too much between runs to be checked.
+class FirstPaintTest : public XWalkExtensionsTestBase {
+ protected:
+  int MeasureFirstPaintTime() {
+    GURL url = GetExtensionsTestURL(
+        base::FilePath(), base::FilePath().AppendASCII("first_paint.html"));
+    content::TitleWatcher title_watcher(runtime()->web_contents(),
+                                        kPassString);
+    title_watcher.AlsoWaitForTitle(kFailString);
+    xwalk_test_utils::NavigateToURL(runtime(), url);
+    EXPECT_EQ(kPassString, title_watcher.WaitAndGetTitle());
+
+    int first_paint_time = -1;
+    EXPECT_TRUE(content::ExecuteScriptAndExtractInt(
+        runtime()->web_contents(),
+        "window.domAutomationController.send(firstPaintTime);",
+        &first_paint_time));
+    return first_paint_time;
+  }
+};
+
+class FirstPaintWithExternalExtensionTest : public FirstPaintTest {
+ public:
+  virtual void SetUp() OVERRIDE {
+    XWalkExtensionService::SetExternalExtensionsPathForTesting(
+        GetExternalExtensionTestPath(FILE_PATH_LITERAL("echo_extension")));
+    FirstPaintTest::SetUp();
+  }
+};
+
+IN_PROC_BROWSER_TEST_F(FirstPaintTest, WithoutExternalExtensions) {
+  content::RunAllPendingInMessageLoop();
+  const int first_paint_time = MeasureFirstPaintTime();
+  LOG(INFO) << "First paint without external extensions: "
+            << first_paint_time << "ms.";
+}
+
+IN_PROC_BROWSER_TEST_F(FirstPaintWithExternalExtensionTest,
+                       WithExternalExtensions) {
+  content::RunAllPendingInMessageLoop();
+  const int first_paint_time = MeasureFirstPaintTime();
+  LOG(INFO) << "First paint with external extensions: "
+            << first_paint_time << "ms.";
+}
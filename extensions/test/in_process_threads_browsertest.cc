@@ -14,6 +14,8 @@ using namespace xwalk::extensions;  // NOLINT
 
 const char kInProcessExtensionThread[] = "in_process_extension_thread";
 const char kInProcessUIThread[] = "in_process_ui_thread";
+const char kInProcessUIAffinity[] = "in_process_ui_affinity";
+const char kInProcessAnyAffinity[] = "in_process_any_affinity";
 
 class InProcessExtension;
 
@@ -42,8 +44,11 @@ class InProcessExtensionInstance : public XWalkExtensionInstance {
 
 class InProcessExtension : public XWalkExtension {
  public:
-  explicit InProcessExtension(const char* name) {
+  explicit InProcessExtension(
+      const char* name,
+      ThreadAffinity affinity = THREAD_AFFINITY_IO) {
     set_name(name);
+    set_thread_affinity(affinity);
     set_javascript_api(
       "var listener = null;"
       "extension.setMessageListener(function(msg) {"
@@ -73,6 +78,10 @@ class InProcessThreadsTest : public XWalkExtensionsTestBase {
   virtual void CreateExtensionsForExtensionThread(
       XWalkExtensionVector* extensions) OVERRIDE {
     extensions->push_back(new InProcessExtension(kInProcessExtensionThread));
+    extensions->push_back(new InProcessExtension(
+        kInProcessUIAffinity, XWalkExtension::THREAD_AFFINITY_UI));
+    extensions->push_back(new InProcessExtension(
+        kInProcessAnyAffinity, XWalkExtension::THREAD_AFFINITY_ANY));
   }
 };
 
@@ -4,9 +4,11 @@
 
 #include "xwalk/extensions/test/xwalk_extensions_test_base.h"
 
+#include "base/command_line.h"
 #include "content/public/test/browser_test_utils.h"
 #include "content/public/test/test_utils.h"
 #include "xwalk/extensions/common/xwalk_extension.h"
+#include "xwalk/extensions/common/xwalk_extension_switches.h"
 #include "xwalk/runtime/browser/runtime.h"
 #include "xwalk/test/base/xwalk_test_utils.h"
 
@@ -105,6 +107,14 @@ class XWalkExtensionsTrampolinesForNested : public XWalkExtensionsTestBase {
   }
 };
 
+class XWalkExtensionsEagerLoadingTest
+    : public XWalkExtensionsNestedNamespaceTest {
+ public:
+  virtual void SetUpCommandLine(CommandLine* command_line) OVERRIDE {
+    command_line->AppendSwitch(switches::kXWalkDisableLazyExtensionLoading);
+  }
+};
+
 IN_PROC_BROWSER_TEST_F(XWalkExtensionsNestedNamespaceTest,
                        InstanceCreatedForInnerExtension) {
   content::RunAllPendingInMessageLoop();
@@ -150,3 +160,33 @@ IN_PROC_BROWSER_TEST_F(XWalkExtensionsTrampolinesForNested,
   EXPECT_TRUE(g_inner_extension_loaded);
   EXPECT_TRUE(g_outer_extension_loaded);
 }
+
+IN_PROC_BROWSER_TEST_F(XWalkExtensionsNestedNamespaceTest,
+                       InstanceNotCreatedForUnusedExtensions) {
+  content::RunAllPendingInMessageLoop();
+  GURL url = GetExtensionsTestURL(base::FilePath(),
+      base::FilePath().AppendASCII("untouched_namespace.html"));
+
+  content::TitleWatcher title_watcher(runtime()->web_contents(), kPassString);
+  title_watcher.AlsoWaitForTitle(kFailString);
+  xwalk_test_utils::NavigateToURL(runtime(), url);
+  EXPECT_EQ(kPassString, title_watcher.WaitAndGetTitle());
+
+  EXPECT_FALSE(g_outer_extension_loaded);
+  EXPECT_FALSE(g_inner_extension_loaded);
+}
+
+IN_PROC_BROWSER_TEST_F(XWalkExtensionsEagerLoadingTest,
+                       InstancesCreatedForUnusedExtensions) {
+  content::RunAllPendingInMessageLoop();
+  GURL url = GetExtensionsTestURL(base::FilePath(),
+      base::FilePath().AppendASCII("untouched_namespace.html"));
+
+  content::TitleWatcher title_watcher(runtime()->web_contents(), kPassString);
+  title_watcher.AlsoWaitForTitle(kFailString);
+  xwalk_test_utils::NavigateToURL(runtime(), url);
+  EXPECT_EQ(kPassString, title_watcher.WaitAndGetTitle());
+
+  EXPECT_TRUE(g_outer_extension_loaded);
+  EXPECT_TRUE(g_inner_extension_loaded);
+}
@@ -0,0 +1,128 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/time/time.h"
+#include "base/values.h"
+#include "content/public/renderer/v8_value_converter.h"
+#include "ipc/ipc_message.h"
+#include "ipc/ipc_message_utils.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "xwalk/extensions/common/xwalk_serialized_value.h"
+#include "xwalk/extensions/renderer/xwalk_v8_value_serializer.h"
+
+using xwalk::extensions::SerializeV8Value;
+using xwalk::extensions::XWalkSerializedValue;
+
+namespace {
+
+const int kIterations = 20;
+
+// Same shape as the messages sent through XWalkExtensionFunctionHandler:
+// function name, callback id and the arguments.
+const char kCreateMessage[] =
+    "var persons = [];"
+    "for (var i = 0; i < 5000; ++i) {"
+    "  persons.push({name: 'Person ' + i, age: i % 100,"
+    "                height: 1.5 + i / 1000, active: i % 2 == 0});"
+    "}"
+    "['addPersons', '42', persons]";
+
+}  // namespace
+
+// Compares the cost of postMessage() with the message converted to a
+// base::ListValue, which is sent when the serializer can't be used, and with
+// the message written directly in the IPC message. On the renderer side the
+// message is encoded from V8, on the extension side it is decoded when only
+// the function name is needed (e.g. the function isn't registered) and when
+// the whole value is needed. The times are logged to be compared.
+class SerializedMessageBenchmark : public testing::Test {
+ protected:
+  SerializedMessageBenchmark()
+      : isolate_(v8::Isolate::GetCurrent()),
+        converter_(content::V8ValueConverter::create()) {}
+
+  virtual void SetUp() OVERRIDE {
+    v8::HandleScope handle_scope(isolate_);
+    context_.Reset(isolate_, v8::Context::New(isolate_));
+  }
+
+  virtual void TearDown() OVERRIDE {
+    context_.Reset();
+  }
+
+  v8::Isolate* isolate_;
+  v8::Persistent<v8::Context> context_;
+  scoped_ptr<content::V8ValueConverter> converter_;
+};
+
+TEST_F(SerializedMessageBenchmark, EncodeAndDecode) {
+  v8::HandleScope handle_scope(isolate_);
+  v8::Local<v8::Context> context =
+      v8::Local<v8::Context>::New(isolate_, context_);
+  v8::Context::Scope context_scope(context);
+  v8::Handle<v8::Value> msg = v8::Script::Compile(
+      v8::String::NewFromUtf8(isolate_, kCreateMessage))->Run();
+  ASSERT_FALSE(msg.IsEmpty());
+
+  IPC::Message list_message;
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kIterations; ++i) {
+    list_message = IPC::Message();
+    base::ListValue wrapper;
+    wrapper.Append(converter_->FromV8Value(msg, context));
+    IPC::WriteParam(&list_message, wrapper);
+  }
+  const base::TimeDelta list_encode_time = base::TimeTicks::Now() - start;
+
+  IPC::Message serialized_message;
+  start = base::TimeTicks::Now();
+  for (int i = 0; i < kIterations; ++i) {
+    serialized_message = IPC::Message();
+    ASSERT_TRUE(SerializeV8Value(msg, &serialized_message));
+  }
+  const base::TimeDelta serialized_encode_time =
+      base::TimeTicks::Now() - start;
+
+  start = base::TimeTicks::Now();
+  for (int i = 0; i < kIterations; ++i) {
+    PickleIterator iter(list_message);
+    base::ListValue value;
+    ASSERT_TRUE(IPC::ReadParam(&list_message, &iter, &value));
+  }
+  const base::TimeDelta list_decode_time = base::TimeTicks::Now() - start;
+
+  start = base::TimeTicks::Now();
+  for (int i = 0; i < kIterations; ++i) {
+    PickleIterator iter(serialized_message);
+    XWalkSerializedValue value;
+    ASSERT_TRUE(XWalkSerializedValue::Read(&iter, &value));
+    XWalkSerializedValue name;
+    ASSERT_TRUE(value.Get(0, &name));
+  }
+  const base::TimeDelta view_decode_time = base::TimeTicks::Now() - start;
+
+  start = base::TimeTicks::Now();
+  for (int i = 0; i < kIterations; ++i) {
+    PickleIterator iter(serialized_message);
+    XWalkSerializedValue value;
+    ASSERT_TRUE(XWalkSerializedValue::Read(&iter, &value));
+    EXPECT_TRUE(value.ToValue());
+  }
+  const base::TimeDelta to_value_decode_time = base::TimeTicks::Now() - start;
+
+  LOG(INFO) << kIterations << " messages of " << list_message.size()
+            << " bytes as base::ListValue and " << serialized_message.size()
+            << " bytes serialized.";
+  LOG(INFO) << "Encoding: base::ListValue "
+            << list_encode_time.InMillisecondsF() << "ms, serialized "
+            << serialized_encode_time.InMillisecondsF() << "ms.";
+  LOG(INFO) << "Decoding: base::ListValue "
+            << list_decode_time.InMillisecondsF() << "ms, serialized view "
+            << view_decode_time.InMillisecondsF()
+            << "ms, serialized to base::Value "
+            << to_value_decode_time.InMillisecondsF() << "ms.";
+}
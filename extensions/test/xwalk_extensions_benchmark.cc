@@ -0,0 +1,218 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Measures the cost of the extension messaging paths, so changes to them can
+// be compared over time. The same echo extension is registered on the UI
+// thread, on the extension thread and as an external extension in the
+// Extension Process, and benchmark.html measures each of them:
+//
+//   - round-trip latency percentiles of postMessage, sync messages and
+//     requests;
+//   - one-way throughput with small, medium and large payloads;
+//   - how fast instances are created and destroyed, using iframes.
+//
+// The results are written as JSON to the file given by --benchmark-output,
+// or logged if the switch is not present, e.g.:
+//
+//   xwalk_extensions_benchmark --benchmark-output=/tmp/results.json
+//
+// Messages are strings, the first character selects what the instance does:
+// 'd' drops the message, 'f' replies with the number of dropped messages
+// since the last 'f', 'i' (sync only) replies with the number of instances
+// created and destroyed so far. Everything else is echoed back.
+
+#include <string>
+#include "base/command_line.h"
+#include "base/file_util.h"
+#include "base/json/json_reader.h"
+#include "base/json/json_writer.h"
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/stringprintf.h"
+#include "base/values.h"
+#include "xwalk/extensions/browser/xwalk_extension_service.h"
+#include "xwalk/extensions/common/xwalk_extension.h"
+#include "xwalk/extensions/test/xwalk_extensions_test_base.h"
+#include "xwalk/runtime/browser/runtime.h"
+#include "xwalk/test/base/xwalk_test_utils.h"
+#include "content/public/test/browser_test_utils.h"
+#include "content/public/test/test_utils.h"
+
+using namespace xwalk::extensions;  // NOLINT
+
+namespace {
+
+const char kBenchmarkOutput[] = "benchmark-output";
+
+// Same as the API of benchmark_extension.c.
+const char kBenchmarkAPI[] =
+    "var listener = null;"
+    "extension.setMessageListener(function(msg) {"
+    "  if (listener instanceof Function) {"
+    "    listener(msg);"
+    "  };"
+    "});"
+    "exports.setListener = function(callback) {"
+    "  listener = callback;"
+    "};"
+    "exports.post = function(msg) {"
+    "  extension.postMessage(msg);"
+    "};"
+    "exports.sync = function(msg) {"
+    "  return extension.internal.sendSyncMessage(msg);"
+    "};"
+    "exports.request = function(msg) {"
+    "  return extension.internal.sendRequest(msg);"
+    "};";
+
+class BenchmarkExtension;
+
+class BenchmarkInstance : public XWalkExtensionInstance {
+ public:
+  explicit BenchmarkInstance(BenchmarkExtension* extension);
+  virtual ~BenchmarkInstance();
+
+  virtual void HandleMessage(scoped_ptr<base::Value> msg) OVERRIDE;
+  virtual void HandleSyncMessage(scoped_ptr<base::Value> msg) OVERRIDE;
+
+ private:
+  BenchmarkExtension* extension_;
+};
+
+// Instances are created and destroyed on the thread of the extension, so the
+// counters don't need a lock.
+class BenchmarkExtension : public XWalkExtension {
+ public:
+  explicit BenchmarkExtension(const std::string& name)
+      : instances_created_(0),
+        instances_destroyed_(0),
+        messages_dropped_(0) {
+    set_name(name);
+    set_javascript_api(kBenchmarkAPI);
+  }
+
+  virtual XWalkExtensionInstance* CreateInstance() OVERRIDE {
+    instances_created_++;
+    return new BenchmarkInstance(this);
+  }
+
+  void OnInstanceDestroyed() { instances_destroyed_++; }
+  void OnMessageDropped() { messages_dropped_++; }
+
+  int TakeMessagesDropped() {
+    int dropped = messages_dropped_;
+    messages_dropped_ = 0;
+    return dropped;
+  }
+
+  std::string GetInstanceCounts() const {
+    return base::StringPrintf("i%d,%d", instances_created_,
+                              instances_destroyed_);
+  }
+
+ private:
+  int instances_created_;
+  int instances_destroyed_;
+  int messages_dropped_;
+};
+
+BenchmarkInstance::BenchmarkInstance(BenchmarkExtension* extension)
+    : extension_(extension) {}
+
+BenchmarkInstance::~BenchmarkInstance() {
+  extension_->OnInstanceDestroyed();
+}
+
+void BenchmarkInstance::HandleMessage(scoped_ptr<base::Value> msg) {
+  std::string str;
+  if (!msg->GetAsString(&str) || str.empty()) {
+    PostMessageToJS(msg.Pass());
+    return;
+  }
+
+  switch (str[0]) {
+    case 'd':
+      extension_->OnMessageDropped();
+      break;
+    case 'f':
+      PostMessageToJS(scoped_ptr<base::Value>(base::Value::CreateStringValue(
+          "f" + base::IntToString(extension_->TakeMessagesDropped()))));
+      break;
+    default:
+      PostMessageToJS(msg.Pass());
+      break;
+  }
+}
+
+void BenchmarkInstance::HandleSyncMessage(scoped_ptr<base::Value> msg) {
+  std::string str;
+  if (msg->GetAsString(&str) && str == "i") {
+    SendSyncReplyToJS(scoped_ptr<base::Value>(
+        base::Value::CreateStringValue(extension_->GetInstanceCounts())));
+    return;
+  }
+  SendSyncReplyToJS(msg.Pass());
+}
+
+}  // namespace
+
+class XWalkExtensionsBenchmark : public XWalkExtensionsTestBase {
+ public:
+  virtual void SetUp() OVERRIDE {
+    XWalkExtensionService::SetExternalExtensionsPathForTesting(
+        GetExternalExtensionTestPath(FILE_PATH_LITERAL("benchmark_extension")));
+    XWalkExtensionsTestBase::SetUp();
+  }
+
+  virtual void CreateExtensionsForUIThread(
+      XWalkExtensionVector* extensions) OVERRIDE {
+    extensions->push_back(new BenchmarkExtension("benchmark_ui"));
+  }
+
+  virtual void CreateExtensionsForExtensionThread(
+      XWalkExtensionVector* extensions) OVERRIDE {
+    extensions->push_back(
+        new BenchmarkExtension("benchmark_extension_thread"));
+  }
+
+ protected:
+  void WriteResults(const std::string& json) {
+    scoped_ptr<base::Value> results(base::JSONReader::Read(json));
+    ASSERT_TRUE(results);
+    ASSERT_TRUE(results->IsType(base::Value::TYPE_DICTIONARY));
+
+    std::string output;
+    base::JSONWriter::WriteWithOptions(
+        results.get(), base::JSONWriter::OPTIONS_PRETTY_PRINT, &output);
+
+    CommandLine* cmd_line = CommandLine::ForCurrentProcess();
+    if (!cmd_line->HasSwitch(kBenchmarkOutput)) {
+      LOG(INFO) << "Extension messaging benchmark:\n" << output;
+      return;
+    }
+
+    base::FilePath path = cmd_line->GetSwitchValuePath(kBenchmarkOutput);
+    EXPECT_EQ(static_cast<int>(output.size()),
+              file_util::WriteFile(path, output.data(), output.size()));
+  }
+};
+
+IN_PROC_BROWSER_TEST_F(XWalkExtensionsBenchmark, ExtensionMessaging) {
+  content::RunAllPendingInMessageLoop();
+  GURL url = GetExtensionsTestURL(base::FilePath(),
+                                  base::FilePath().AppendASCII(
+                                      "benchmark.html"));
+  content::TitleWatcher title_watcher(runtime()->web_contents(), kPassString);
+  title_watcher.AlsoWaitForTitle(kFailString);
+  xwalk_test_utils::NavigateToURL(runtime(), url);
+  ASSERT_EQ(kPassString, title_watcher.WaitAndGetTitle());
+
+  std::string json;
+  ASSERT_TRUE(content::ExecuteScriptAndExtractString(
+      runtime()->web_contents(),
+      "window.domAutomationController.send("
+      "    JSON.stringify(benchmarkResults));",
+      &json));
+  WriteResults(json);
+}
@@ -30,6 +30,9 @@ const char* kEchoAPI =
     "};"
     "exports.syncEcho = function(msg) {"
     "  return extension.internal.sendSyncMessage(msg);"
+    "};"
+    "exports.requestEcho = function(msg) {"
+    "  return extension.internal.sendRequest(msg);"
     "};";
 
 class EchoContext : public XWalkExtensionInstance {
@@ -92,6 +95,20 @@ class DelayedEchoExtension : public XWalkExtension {
   }
 };
 
+// Gives up on sync replies long before DelayedEchoContext sends them.
+class TimeoutEchoExtension : public XWalkExtension {
+ public:
+  TimeoutEchoExtension() : XWalkExtension() {
+    set_name("echo");
+    set_javascript_api(kEchoAPI);
+    set_sync_message_timeout(base::TimeDelta::FromMilliseconds(100));
+  }
+
+  virtual XWalkExtensionInstance* CreateInstance() OVERRIDE {
+    return new DelayedEchoContext();
+  }
+};
+
 class ExtensionWithInvalidName : public XWalkExtension {
  public:
   ExtensionWithInvalidName() : XWalkExtension() {
@@ -127,6 +144,14 @@ class XWalkExtensionsDelayedTest : public XWalkExtensionsTestBase {
   }
 };
 
+class XWalkExtensionsTimeoutTest : public XWalkExtensionsTestBase {
+ public:
+  virtual void CreateExtensionsForUIThread(
+      XWalkExtensionVector* extensions) OVERRIDE {
+    extensions->push_back(new TimeoutEchoExtension);
+  }
+};
+
 IN_PROC_BROWSER_TEST_F(XWalkExtensionsTest, EchoExtension) {
   content::RunAllPendingInMessageLoop();
   GURL url = GetExtensionsTestURL(base::FilePath(),
@@ -171,3 +196,25 @@ IN_PROC_BROWSER_TEST_F(XWalkExtensionsDelayedTest, EchoExtensionSync) {
   xwalk_test_utils::NavigateToURL(runtime(), url);
   EXPECT_EQ(kPassString, title_watcher.WaitAndGetTitle());
 }
+
+IN_PROC_BROWSER_TEST_F(XWalkExtensionsTimeoutTest, EchoExtensionSyncTimeout) {
+  content::RunAllPendingInMessageLoop();
+  GURL url = GetExtensionsTestURL(base::FilePath(),
+                                  base::FilePath().AppendASCII(
+                                      "sync_echo_timeout.html"));
+  content::TitleWatcher title_watcher(runtime()->web_contents(), kPassString);
+  title_watcher.AlsoWaitForTitle(kFailString);
+  xwalk_test_utils::NavigateToURL(runtime(), url);
+  EXPECT_EQ(kPassString, title_watcher.WaitAndGetTitle());
+}
+
+IN_PROC_BROWSER_TEST_F(XWalkExtensionsDelayedTest, EchoExtensionRequest) {
+  content::RunAllPendingInMessageLoop();
+  GURL url = GetExtensionsTestURL(base::FilePath(),
+                                  base::FilePath().AppendASCII(
+                                      "request_echo.html"));
+  content::TitleWatcher title_watcher(runtime()->web_contents(), kPassString);
+  title_watcher.AlsoWaitForTitle(kFailString);
+  xwalk_test_utils::NavigateToURL(runtime(), url);
+  EXPECT_EQ(kPassString, title_watcher.WaitAndGetTitle());
+}
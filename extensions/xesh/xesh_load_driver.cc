@@ -0,0 +1,538 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/extensions/xesh/xesh_load_driver.h"
+
+#include <stdio.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include <vector>
+#include "base/bind.h"
+#include "base/file_util.h"
+#include "base/files/file_path.h"
+#include "base/json/json_reader.h"
+#include "base/logging.h"
+#include "base/message_loop/message_loop.h"
+#include "base/stl_util.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_split.h"
+#include "base/values.h"
+#include "xwalk/extensions/common/xwalk_extension_server.h"
+#include "xwalk/extensions/renderer/xwalk_module_system.h"
+#include "xwalk/extensions/xesh/xesh_v8_runner.h"
+
+using xwalk::extensions::XWalkModuleSystem;
+
+namespace {
+
+// How long a replay waits for the replies of the last requests.
+const int kReplayGracePeriodInSeconds = 5;
+
+base::TimeDelta TimeValToTimeDelta(const struct timeval& tv) {
+  return base::TimeDelta::FromSeconds(tv.tv_sec) +
+         base::TimeDelta::FromMicroseconds(tv.tv_usec);
+}
+
+base::DictionaryValue* LatencyToValue(std::vector<base::TimeDelta>* samples) {
+  base::DictionaryValue* value = new base::DictionaryValue;
+  value->SetInteger("count", samples->size());
+  if (samples->empty())
+    return value;
+
+  std::sort(samples->begin(), samples->end());
+  const size_t size = samples->size();
+  value->SetDouble("p50_ms", (*samples)[size / 2].InMillisecondsF());
+  value->SetDouble("p90_ms",
+                   (*samples)[std::min(size - 1, size * 9 / 10)]
+                       .InMillisecondsF());
+  value->SetDouble("p99_ms",
+                   (*samples)[std::min(size - 1, size * 99 / 100)]
+                       .InMillisecondsF());
+  value->SetDouble("max_ms", samples->back().InMillisecondsF());
+  return value;
+}
+
+}  // namespace
+
+// Receives what the extensions send to a replayed instance.
+class XEShLoadDriver::ReplayInstance
+    : public XWalkExtensionClient::InstanceHandler {
+ public:
+  ReplayInstance(XEShLoadDriver* driver, const std::string& extension_name)
+      : driver_(driver),
+        extension_name_(extension_name),
+        instance_id_(0) {}
+  virtual ~ReplayInstance() {}
+
+  const std::string& extension_name() const { return extension_name_; }
+  int64_t instance_id() const { return instance_id_; }
+  void set_instance_id(int64_t instance_id) { instance_id_ = instance_id; }
+
+  // XWalkExtensionClient::InstanceHandler implementation.
+  virtual void HandleMessageFromNative(const base::Value& msg) OVERRIDE {
+    driver_->OnMessageFromNative(extension_name_);
+  }
+  virtual void HandleBinaryMessageFromNative(const char* data,
+                                             size_t size) OVERRIDE {
+    driver_->OnMessageFromNative(extension_name_);
+  }
+  virtual void HandleRequestReplyFromNative(int request_id,
+                                            const base::Value* reply) OVERRIDE {
+    driver_->OnRequestReply(request_id);
+  }
+
+ private:
+  XEShLoadDriver* driver_;
+  std::string extension_name_;
+  int64_t instance_id_;
+};
+
+XEShLoadDriver::WorkloadContext::WorkloadContext(XEShLoadDriver* driver,
+                                                 int index)
+    : driver(driver),
+      index(index),
+      done(false) {}
+
+XEShLoadDriver::WorkloadContext::~WorkloadContext() {
+  context.Reset();
+}
+
+XEShLoadDriver::ReplayEvent::ReplayEvent()
+    : time(0),
+      size(0) {}
+
+XEShLoadDriver::ReplayEvent::~ReplayEvent() {}
+
+XEShLoadDriver::ExtensionLatencies::ExtensionLatencies()
+    : dropped_requests(0),
+      messages_from_native(0) {}
+
+XEShLoadDriver::ExtensionLatencies::~ExtensionLatencies() {}
+
+XEShLoadDriver::XEShLoadDriver(XEShV8Runner* v8_runner,
+                               XWalkExtensionServer* server)
+    : v8_runner_(v8_runner),
+      server_(server),
+      client_(v8_runner->client()),
+      workload_instances_(0),
+      pending_workload_contexts_(0),
+      next_timer_id_(1),
+      next_replay_event_(0),
+      speed_(1),
+      replay_events_sent_(false),
+      finished_(false),
+      weak_factory_(this) {}
+
+XEShLoadDriver::~XEShLoadDriver() {
+  DestroyWorkloadContexts();
+  STLDeleteValues(&replay_instances_);
+}
+
+void XEShLoadDriver::RunWorkload(const std::string& source, int instances,
+                                 const base::Closure& finished_callback) {
+  mode_ = "workload";
+  finished_callback_ = finished_callback;
+  start_time_ = base::TimeTicks::Now();
+  workload_instances_ = instances;
+  pending_workload_contexts_ = instances;
+  for (int i = 0; i < instances; ++i)
+    CreateWorkloadContext(source, i);
+}
+
+void XEShLoadDriver::CreateWorkloadContext(const std::string& source,
+                                           int index) {
+  v8::Isolate* isolate = v8::Isolate::GetCurrent();
+  v8::HandleScope handle_scope(isolate);
+  v8::Handle<v8::Context> context = v8::Context::New(isolate);
+  v8::Context::Scope context_scope(context);
+
+  WorkloadContext* workload_context = new WorkloadContext(this, index);
+  workload_context->context.Reset(isolate, context);
+  workload_contexts_.push_back(workload_context);
+
+  v8_runner_->SetUpContext(context);
+
+  v8::Handle<v8::Object> global = context->Global();
+  global->Set(v8::String::NewFromUtf8(isolate, "instanceIndex"),
+              v8::Integer::New(index));
+  global->Set(v8::String::NewFromUtf8(isolate, "done"),
+              v8::FunctionTemplate::New(
+                  DoneCallback,
+                  v8::External::New(workload_context))->GetFunction());
+  global->Set(v8::String::NewFromUtf8(isolate, "setTimeout"),
+              v8::FunctionTemplate::New(
+                  SetTimeoutCallback,
+                  v8::External::New(this))->GetFunction());
+
+  v8::TryCatch try_catch;
+  v8::Handle<v8::Script> script = v8::Script::Compile(
+      v8::String::NewFromUtf8(isolate, source.c_str()),
+      v8::String::NewFromUtf8(isolate, "(workload)"));
+  if (script.IsEmpty() || script->Run().IsEmpty()) {
+    // A broken workload won't call done().
+    fprintf(stderr, "Workload instance %d failed: %s", index,
+            XEShV8Runner::ReportException(&try_catch).c_str());
+    OnWorkloadContextDone(workload_context);
+  }
+}
+
+void XEShLoadDriver::OnWorkloadContextDone(WorkloadContext* workload_context) {
+  if (workload_context->done)
+    return;
+  workload_context->done = true;
+  if (--pending_workload_contexts_ > 0)
+    return;
+
+  // done() is called from JS, so the contexts can't go away right now.
+  base::MessageLoop::current()->PostTask(
+      FROM_HERE, base::Bind(&XEShLoadDriver::Finish,
+                            weak_factory_.GetWeakPtr()));
+}
+
+void XEShLoadDriver::DestroyWorkloadContexts() {
+  v8::Isolate* isolate = v8::Isolate::GetCurrent();
+  v8::HandleScope handle_scope(isolate);
+
+  // Destroys the instances of the extensions, as a closing frame does.
+  for (size_t i = 0; i < workload_contexts_.size(); ++i) {
+    v8::Handle<v8::Context> context = v8::Handle<v8::Context>::New(
+        isolate, workload_contexts_[i]->context);
+    XWalkModuleSystem::ResetModuleSystemFromContext(context);
+  }
+  workload_contexts_.clear();
+
+  for (TimerMap::iterator it = timers_.begin(); it != timers_.end(); ++it) {
+    it->second->Reset();
+    delete it->second;
+  }
+  timers_.clear();
+}
+
+// static
+void XEShLoadDriver::DoneCallback(
+    const v8::FunctionCallbackInfo<v8::Value>& info) {
+  WorkloadContext* workload_context = static_cast<WorkloadContext*>(
+      info.Data().As<v8::External>()->Value());
+  workload_context->driver->OnWorkloadContextDone(workload_context);
+}
+
+// static
+void XEShLoadDriver::SetTimeoutCallback(
+    const v8::FunctionCallbackInfo<v8::Value>& info) {
+  XEShLoadDriver* driver = static_cast<XEShLoadDriver*>(
+      info.Data().As<v8::External>()->Value());
+  if (info.Length() < 1 || !info[0]->IsFunction()) {
+    info.GetReturnValue().Set(v8::Integer::New(0));
+    return;
+  }
+
+  int delay = info.Length() > 1 ? info[1]->Int32Value() : 0;
+  int timer_id = driver->next_timer_id_++;
+  driver->timers_[timer_id] = new v8::Persistent<v8::Function>(
+      info.GetIsolate(), info[0].As<v8::Function>());
+  base::MessageLoop::current()->PostDelayedTask(
+      FROM_HERE, base::Bind(&XEShLoadDriver::RunTimer,
+                            driver->weak_factory_.GetWeakPtr(), timer_id),
+      base::TimeDelta::FromMilliseconds(std::max(delay, 0)));
+  info.GetReturnValue().Set(v8::Integer::New(timer_id));
+}
+
+void XEShLoadDriver::RunTimer(int timer_id) {
+  TimerMap::iterator it = timers_.find(timer_id);
+  if (it == timers_.end())
+    return;
+
+  v8::Isolate* isolate = v8::Isolate::GetCurrent();
+  v8::HandleScope handle_scope(isolate);
+  v8::Handle<v8::Function> function =
+      v8::Local<v8::Function>::New(isolate, *it->second);
+  it->second->Reset();
+  delete it->second;
+  timers_.erase(it);
+
+  v8::Handle<v8::Context> context = function->CreationContext();
+  v8::Context::Scope context_scope(context);
+  v8::TryCatch try_catch;
+  function->Call(context->Global(), 0, NULL);
+  if (try_catch.HasCaught()) {
+    fprintf(stderr, "%s",
+            XEShV8Runner::ReportException(&try_catch).c_str());
+  }
+}
+
+void XEShLoadDriver::Replay(const base::FilePath& trace_path, double speed,
+                            const base::Closure& finished_callback) {
+  mode_ = "replay";
+  finished_callback_ = finished_callback;
+  speed_ = speed > 0 ? speed : 1;
+  if (!ReadTrace(trace_path)) {
+    fprintf(stderr, "Can't read trace %s.\n",
+            trace_path.AsUTF8Unsafe().c_str());
+    Finish();
+    return;
+  }
+
+  fprintf(stderr, "Replaying %u messages.\n",
+          static_cast<unsigned>(replay_events_.size()));
+  start_time_ = base::TimeTicks::Now();
+  if (replay_events_.empty()) {
+    Finish();
+    return;
+  }
+  ReplayNextEvents();
+}
+
+// static
+bool XEShLoadDriver::CompareReplayEvents(const ReplayEvent* a,
+                                         const ReplayEvent* b) {
+  return a->time < b->time;
+}
+
+bool XEShLoadDriver::ReadTrace(const base::FilePath& trace_path) {
+  std::string contents;
+  if (!file_util::ReadFileToString(trace_path, &contents))
+    return false;
+
+  std::vector<std::string> lines;
+  base::SplitString(contents, '\n', &lines);
+  for (size_t i = 0; i < lines.size(); ++i) {
+    if (lines[i].empty())
+      continue;
+
+    scoped_ptr<base::Value> value(base::JSONReader::Read(lines[i]));
+    base::DictionaryValue* record;
+    if (!value || !value->GetAsDictionary(&record)) {
+      LOG(WARNING) << "Ignoring invalid line " << i + 1 << " of the trace.";
+      continue;
+    }
+
+    scoped_ptr<ReplayEvent> event(new ReplayEvent);
+    std::string source;
+    double instance;
+    if (!record->GetDouble("time", &event->time) ||
+        !record->GetString("source", &source) ||
+        !record->GetDouble("instance", &instance) ||
+        !record->GetString("extension", &event->extension_name) ||
+        !record->GetString("type", &event->type)) {
+      LOG(WARNING) << "Ignoring incomplete line " << i + 1 << " of the trace.";
+      continue;
+    }
+    event->instance_key = source + ":" + base::Int64ToString(
+        static_cast<int64_t>(instance));
+    record->GetInteger("size", &event->size);
+    scoped_ptr<base::Value> message;
+    if (record->Remove("message", &message))
+      event->message = message.Pass();
+    replay_events_.push_back(event.release());
+  }
+
+  // Processes append to the trace concurrently, so the lines may be slightly
+  // out of order.
+  std::stable_sort(replay_events_.begin(), replay_events_.end(),
+                   CompareReplayEvents);
+  return true;
+}
+
+void XEShLoadDriver::ReplayNextEvents() {
+  if (finished_)
+    return;
+
+  const double first_time = replay_events_[0]->time;
+  while (next_replay_event_ < replay_events_.size()) {
+    ReplayEvent* event = replay_events_[next_replay_event_];
+    base::TimeTicks due_time = start_time_ +
+        base::TimeDelta::FromMicroseconds(static_cast<int64_t>(
+            (event->time - first_time) * 1000 / speed_));
+    base::TimeTicks now = base::TimeTicks::Now();
+    if (due_time > now) {
+      base::MessageLoop::current()->PostDelayedTask(
+          FROM_HERE, base::Bind(&XEShLoadDriver::ReplayNextEvents,
+                                weak_factory_.GetWeakPtr()),
+          due_time - now);
+      return;
+    }
+    DispatchEvent(event);
+    next_replay_event_++;
+  }
+
+  replay_events_sent_ = true;
+  base::MessageLoop::current()->PostDelayedTask(
+      FROM_HERE, base::Bind(&XEShLoadDriver::Finish,
+                            weak_factory_.GetWeakPtr()),
+      base::TimeDelta::FromSeconds(kReplayGracePeriodInSeconds));
+  MaybeFinishReplay();
+}
+
+XEShLoadDriver::ReplayInstance* XEShLoadDriver::GetReplayInstance(
+    const ReplayEvent& event) {
+  ReplayInstance*& instance = replay_instances_[event.instance_key];
+  if (instance)
+    return instance;
+
+  // Traces may start after the instance was created.
+  instance = new ReplayInstance(this, event.extension_name);
+  instance->set_instance_id(
+      client_->CreateInstance(event.extension_name, instance));
+  if (!instance->instance_id()) {
+    LOG(WARNING) << "Can't create instance of " << event.extension_name
+                 << ", is the extension loaded?";
+  }
+  return instance;
+}
+
+void XEShLoadDriver::DispatchEvent(ReplayEvent* event) {
+  ReplayInstance* instance = GetReplayInstance(*event);
+  const int64_t instance_id = instance->instance_id();
+  if (!instance_id || event->type == "create")
+    return;
+
+  ExtensionLatencies& latencies = latencies_[event->extension_name];
+  if (event->type == "destroy") {
+    client_->DestroyInstance(instance_id);
+    PendingRequestMap::iterator it = pending_requests_.begin();
+    while (it != pending_requests_.end()) {
+      if (it->second.instance_id == instance_id) {
+        latencies.dropped_requests++;
+        pending_requests_.erase(it++);
+      } else {
+        ++it;
+      }
+    }
+    replay_instances_.erase(event->instance_key);
+    delete instance;
+    return;
+  }
+
+  if (event->type == "binary") {
+    std::string data(event->size, '\0');
+    client_->PostBinaryMessageToNative(instance_id, data.data(), data.size());
+    return;
+  }
+
+  if (!event->message)
+    event->message.reset(base::Value::CreateNullValue());
+
+  if (event->type == "post") {
+    client_->PostMessageToNative(instance_id, event->message.Pass());
+  } else if (event->type == "sync") {
+    base::TimeTicks start = base::TimeTicks::Now();
+    bool timed_out = false;
+    client_->SendSyncMessageToNative(instance_id, event->message.Pass(),
+                                     &timed_out);
+    latencies.sync.push_back(base::TimeTicks::Now() - start);
+  } else if (event->type == "request") {
+    PendingRequest request;
+    request.instance_id = instance_id;
+    request.extension_name = event->extension_name;
+    request.start_time = base::TimeTicks::Now();
+    int request_id =
+        client_->SendRequestToNative(instance_id, event->message.Pass());
+    if (request_id)
+      pending_requests_[request_id] = request;
+    else
+      latencies.dropped_requests++;
+  } else {
+    LOG(WARNING) << "Ignoring message of unknown type " << event->type;
+  }
+}
+
+void XEShLoadDriver::OnRequestReply(int request_id) {
+  PendingRequestMap::iterator it = pending_requests_.find(request_id);
+  if (it == pending_requests_.end())
+    return;
+
+  latencies_[it->second.extension_name].request.push_back(
+      base::TimeTicks::Now() - it->second.start_time);
+  pending_requests_.erase(it);
+  MaybeFinishReplay();
+}
+
+void XEShLoadDriver::OnMessageFromNative(const std::string& extension_name) {
+  latencies_[extension_name].messages_from_native++;
+}
+
+void XEShLoadDriver::MaybeFinishReplay() {
+  if (replay_events_sent_ && pending_requests_.empty())
+    Finish();
+}
+
+void XEShLoadDriver::Finish() {
+  if (finished_)
+    return;
+  finished_ = true;
+  elapsed_time_ = base::TimeTicks::Now() - start_time_;
+
+  DestroyWorkloadContexts();
+  for (ReplayInstanceMap::iterator it = replay_instances_.begin();
+       it != replay_instances_.end(); ++it) {
+    if (it->second->instance_id())
+      client_->DestroyInstance(it->second->instance_id());
+  }
+  STLDeleteValues(&replay_instances_);
+
+  for (PendingRequestMap::iterator it = pending_requests_.begin();
+       it != pending_requests_.end(); ++it)
+    latencies_[it->second.extension_name].dropped_requests++;
+  pending_requests_.clear();
+
+  finished_callback_.Run();
+}
+
+scoped_ptr<base::DictionaryValue> XEShLoadDriver::GetReport() {
+  scoped_ptr<base::DictionaryValue> report(new base::DictionaryValue);
+  report->SetString("mode", mode_);
+  report->SetInteger("instances", workload_instances_);
+  report->SetDouble("wall_time_ms", elapsed_time_.InMillisecondsF());
+
+  // The extensions run in this process, on the main thread.
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+    report->SetDouble("user_cpu_ms",
+                      TimeValToTimeDelta(usage.ru_utime).InMillisecondsF());
+    report->SetDouble("system_cpu_ms",
+                      TimeValToTimeDelta(usage.ru_stime).InMillisecondsF());
+  }
+
+  // Latency and CPU time as seen by the server, plus the time the JS side
+  // was blocked in sync messages and what the replay measured.
+  scoped_ptr<base::DictionaryValue> extensions = server_->GetMessagingStats();
+  const XWalkExtensionClient::SyncMessageStatsMap& sync_stats =
+      client_->sync_message_stats();
+  for (base::DictionaryValue::Iterator it(*extensions); !it.IsAtEnd();
+       it.Advance()) {
+    base::DictionaryValue* extension;
+    if (!extensions->GetDictionaryWithoutPathExpansion(it.key(), &extension))
+      continue;
+    extension->Remove("instances", NULL);
+
+    XWalkExtensionClient::SyncMessageStatsMap::const_iterator sync_it =
+        sync_stats.find(it.key());
+    if (sync_it != sync_stats.end()) {
+      base::DictionaryValue* stall = new base::DictionaryValue;
+      stall->SetDouble("count", static_cast<double>(sync_it->second.messages));
+      stall->SetDouble("timeouts",
+                       static_cast<double>(sync_it->second.timeouts));
+      stall->SetDouble("total_ms",
+                       sync_it->second.total_stall.InMillisecondsF());
+      stall->SetDouble("max_ms",
+                       sync_it->second.longest_stall.InMillisecondsF());
+      extension->Set("sync_stall", stall);
+    }
+
+    LatencyMap::iterator latency_it = latencies_.find(it.key());
+    if (latency_it != latencies_.end()) {
+      ExtensionLatencies& latencies = latency_it->second;
+      base::DictionaryValue* replay = new base::DictionaryValue;
+      replay->Set("sync_latency", LatencyToValue(&latencies.sync));
+      replay->Set("request_latency", LatencyToValue(&latencies.request));
+      replay->SetDouble("dropped_requests",
+                        static_cast<double>(latencies.dropped_requests));
+      replay->SetDouble("messages_from_native",
+                        static_cast<double>(latencies.messages_from_native));
+      extension->Set("replay", replay);
+    }
+  }
+  report->Set("extensions", extensions.release());
+  return report.Pass();
+}
@@ -0,0 +1,163 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef XWALK_EXTENSIONS_XESH_XESH_LOAD_DRIVER_H_
+#define XWALK_EXTENSIONS_XESH_XESH_LOAD_DRIVER_H_
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "base/callback.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+#include "base/memory/weak_ptr.h"
+#include "base/time/time.h"
+#include "v8/include/v8.h"
+#include "xwalk/extensions/renderer/xwalk_extension_client.h"
+
+class XEShV8Runner;
+
+namespace base {
+class DictionaryValue;
+class FilePath;
+class Value;
+}
+
+namespace xwalk {
+namespace extensions {
+class XWalkExtensionServer;
+}
+}
+
+using xwalk::extensions::XWalkExtensionServer;
+
+// Drives load on the extensions without the interactive shell, in one of two
+// ways:
+//
+//   - RunWorkload() runs a JS file in several contexts at once, each one with
+//     its own instances of the extensions, like iframes of a page would do;
+//   - Replay() sends again the messages recorded by the Browser with
+//     --record-extension-messages, keeping their timing.
+//
+// Afterwards GetReport() tells the latency and the CPU time spent by each
+// extension. Like XEShV8Runner, this class lives on the v8 thread.
+class XEShLoadDriver {
+ public:
+  XEShLoadDriver(XEShV8Runner* v8_runner, XWalkExtensionServer* server);
+  ~XEShLoadDriver();
+
+  // Runs |source| in |instances| contexts. Besides the extensions and the
+  // functions of the shell, the workload has |instanceIndex|, setTimeout()
+  // and done(), that must be called by every context once its work is
+  // finished. |finished_callback| runs after that.
+  void RunWorkload(const std::string& source, int instances,
+                   const base::Closure& finished_callback);
+
+  // Replays the trace at |trace_path|, waiting between messages the recorded
+  // time divided by |speed|. |finished_callback| runs once all the messages
+  // were sent and the requests replied.
+  void Replay(const base::FilePath& trace_path, double speed,
+              const base::Closure& finished_callback);
+
+  scoped_ptr<base::DictionaryValue> GetReport();
+
+ private:
+  struct WorkloadContext {
+    WorkloadContext(XEShLoadDriver* driver, int index);
+    ~WorkloadContext();
+    XEShLoadDriver* driver;
+    int index;
+    bool done;
+    v8::Persistent<v8::Context> context;
+  };
+
+  struct ReplayEvent {
+    ReplayEvent();
+    ~ReplayEvent();
+    double time;
+    std::string instance_key;
+    std::string extension_name;
+    std::string type;
+    scoped_ptr<base::Value> message;
+    int size;
+  };
+
+  class ReplayInstance;
+
+  struct PendingRequest {
+    int64_t instance_id;
+    std::string extension_name;
+    base::TimeTicks start_time;
+  };
+
+  // Latencies seen by the driver, keyed by extension name.
+  struct ExtensionLatencies {
+    ExtensionLatencies();
+    ~ExtensionLatencies();
+    std::vector<base::TimeDelta> sync;
+    std::vector<base::TimeDelta> request;
+    uint64_t dropped_requests;
+    uint64_t messages_from_native;
+  };
+
+  void CreateWorkloadContext(const std::string& source, int index);
+  void OnWorkloadContextDone(WorkloadContext* workload_context);
+  void DestroyWorkloadContexts();
+
+  void RunTimer(int timer_id);
+
+  static bool CompareReplayEvents(const ReplayEvent* a, const ReplayEvent* b);
+  bool ReadTrace(const base::FilePath& trace_path);
+  void ReplayNextEvents();
+  void DispatchEvent(ReplayEvent* event);
+  ReplayInstance* GetReplayInstance(const ReplayEvent& event);
+  void OnRequestReply(int request_id);
+  void OnMessageFromNative(const std::string& extension_name);
+  void MaybeFinishReplay();
+
+  void Finish();
+
+  static void DoneCallback(const v8::FunctionCallbackInfo<v8::Value>& info);
+  static void SetTimeoutCallback(
+      const v8::FunctionCallbackInfo<v8::Value>& info);
+
+  XEShV8Runner* v8_runner_;
+  XWalkExtensionServer* server_;
+  XWalkExtensionClient* client_;
+  base::Closure finished_callback_;
+  std::string mode_;
+  base::TimeTicks start_time_;
+  base::TimeDelta elapsed_time_;
+
+  ScopedVector<WorkloadContext> workload_contexts_;
+  int workload_instances_;
+  int pending_workload_contexts_;
+
+  typedef std::map<int, v8::Persistent<v8::Function>*> TimerMap;
+  TimerMap timers_;
+  int next_timer_id_;
+
+  ScopedVector<ReplayEvent> replay_events_;
+  size_t next_replay_event_;
+  double speed_;
+  bool replay_events_sent_;
+
+  typedef std::map<std::string, ReplayInstance*> ReplayInstanceMap;
+  ReplayInstanceMap replay_instances_;
+
+  typedef std::map<int, PendingRequest> PendingRequestMap;
+  PendingRequestMap pending_requests_;
+
+  typedef std::map<std::string, ExtensionLatencies> LatencyMap;
+  LatencyMap latencies_;
+
+  bool finished_;
+
+  base::WeakPtrFactory<XEShLoadDriver> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(XEShLoadDriver);
+};
+
+#endif  // XWALK_EXTENSIONS_XESH_XESH_LOAD_DRIVER_H_
@@ -10,6 +10,19 @@
 // It is a single process application which runs with three threads (main, IO
 // and v8).
 // The overall implementation started upon v8/samples/shell.cc .
+//
+// With --workload or --replay it doesn't read stdin, and instead puts load on
+// the extensions and reports how they handled it, see XEShLoadDriver. For
+// example, to run a workload in 10 contexts at once:
+//
+//   xesh --external-extensions-path=<dir> --workload=load.js --instances=10
+//
+// or to replay messages recorded with --record-extension-messages at twice
+// their original speed:
+//
+//   xesh --external-extensions-path=<dir> --replay=trace --replay-speed=2
+//
+// The report is JSON, written to stdout or to the file given by --report.
 
 #include <unistd.h>
 #include <string>
@@ -20,13 +33,16 @@
 #include "base/memory/scoped_ptr.h"
 #include "base/message_loop/message_loop.h"
 #include "base/message_loop/message_pump_libevent.h"
+#include "base/json/json_writer.h"
 #include "base/run_loop.h"
+#include "base/strings/string_number_conversions.h"
 #include "base/synchronization/waitable_event.h"
 #include "base/task_runner_util.h"
 #include "base/threading/thread.h"
 #include "ipc/ipc_sync_channel.h"
 #include "xwalk/extensions/common/xwalk_extension_server.h"
 #include "xwalk/extensions/common/xwalk_extension_switches.h"
+#include "xwalk/extensions/xesh/xesh_load_driver.h"
 #include "xwalk/extensions/xesh/xesh_v8_runner.h"
 
 
@@ -35,6 +51,18 @@ using xwalk::extensions::XWalkExtensionServer;
 // Specifies which file XESh will use as input.
 const char kInputFilePath[] = "input-file";
 
+// JS file run by XEShLoadDriver in --instances contexts.
+const char kWorkload[] = "workload";
+const char kInstances[] = "instances";
+
+// Trace recorded with --record-extension-messages, replayed by
+// XEShLoadDriver --replay-speed times faster than recorded.
+const char kReplay[] = "replay";
+const char kReplaySpeed[] = "replay-speed";
+
+// Where the report of --workload and --replay is written, stdout by default.
+const char kReport[] = "report";
+
 namespace {
 
 inline void PrintInitialInfo() {
@@ -176,12 +204,64 @@ class ExtensionManager {
 
   const IPC::ChannelHandle& ipc_channel_handle() { return handle_; }
 
+  XWalkExtensionServer* server() { return &server_; }
+
  private:
   IPC::ChannelHandle handle_;
   base::WaitableEvent shutdown_event_;
   XWalkExtensionServer server_;
   scoped_ptr<IPC::SyncChannel> server_channel_;
 };
+
+// Runs on the v8 thread once XEShLoadDriver is finished.
+void OnLoadFinished(XEShLoadDriver* driver,
+                    scoped_refptr<base::MessageLoopProxy> main_loop,
+                    const base::Closure& quit_closure) {
+  std::string report;
+  base::JSONWriter::WriteWithOptions(driver->GetReport().get(),
+      base::JSONWriter::OPTIONS_PRETTY_PRINT, &report);
+
+  CommandLine* cmd_line = CommandLine::ForCurrentProcess();
+  if (cmd_line->HasSwitch(kReport)) {
+    base::FilePath path = cmd_line->GetSwitchValuePath(kReport);
+    if (file_util::WriteFile(path, report.data(), report.size()) !=
+        static_cast<int>(report.size()))
+      fprintf(stderr, "Can't write report to %s.\n",
+              path.AsUTF8Unsafe().c_str());
+  } else {
+    printf("%s", report.c_str());
+    fflush(stdout);
+  }
+
+  main_loop->PostTask(FROM_HERE, quit_closure);
+}
+
+void StartLoadDriver(XEShLoadDriver* driver, const base::Closure& done) {
+  CommandLine* cmd_line = CommandLine::ForCurrentProcess();
+  if (cmd_line->HasSwitch(kReplay)) {
+    double speed = 1;
+    if (cmd_line->HasSwitch(kReplaySpeed) &&
+        !base::StringToDouble(cmd_line->GetSwitchValueASCII(kReplaySpeed),
+                              &speed))
+      speed = 1;
+    driver->Replay(cmd_line->GetSwitchValuePath(kReplay), speed, done);
+    return;
+  }
+
+  std::string source;
+  if (!ReadFileToString(cmd_line->GetSwitchValuePath(kWorkload), &source)) {
+    fprintf(stderr, "Can't read workload file.\n");
+    exit(1);
+  }
+
+  int instances = 1;
+  if (cmd_line->HasSwitch(kInstances) &&
+      (!base::StringToInt(cmd_line->GetSwitchValueASCII(kInstances),
+                          &instances) || instances < 1))
+    instances = 1;
+  driver->RunWorkload(source, instances, done);
+}
+
 }  // namespace
 
 int main(int argc, char* argv[]) {
@@ -211,16 +291,36 @@ int main(int argc, char* argv[]) {
       base::Unretained(&v8_runner), argc, argv, io_thread.message_loop_proxy(),
       extension_manager.ipc_channel_handle()));
 
+  CommandLine* cmd_line = CommandLine::ForCurrentProcess();
+  const bool run_load_driver =
+      cmd_line->HasSwitch(kWorkload) || cmd_line->HasSwitch(kReplay);
+
   InputWatcher input_watcher(&v8_runner, v8_thread.message_loop());
+  scoped_ptr<XEShLoadDriver> load_driver;
+  base::RunLoop run_loop;
 
-  static_cast<base::MessageLoopForIO*>(io_thread.message_loop())->PostTask(
-      FROM_HERE, base::Bind(&InputWatcher::StartWatching,
-      base::Unretained(&input_watcher)));
+  if (run_load_driver) {
+    load_driver.reset(
+        new XEShLoadDriver(&v8_runner, extension_manager.server()));
+    base::Closure done = base::Bind(&OnLoadFinished,
+        base::Unretained(load_driver.get()),
+        main_message_loop.message_loop_proxy(), run_loop.QuitClosure());
+    v8_thread.message_loop()->PostTask(
+        FROM_HERE, base::Bind(&StartLoadDriver,
+        base::Unretained(load_driver.get()), done));
+  } else {
+    static_cast<base::MessageLoopForIO*>(io_thread.message_loop())->PostTask(
+        FROM_HERE, base::Bind(&InputWatcher::StartWatching,
+        base::Unretained(&input_watcher)));
+    PrintPromptLine();
+  }
 
-  PrintPromptLine();
-  base::RunLoop run_loop;
   run_loop.Run();
 
+  // The driver holds v8 handles, it must go away on the v8 thread.
+  if (load_driver)
+    v8_thread.message_loop()->DeleteSoon(FROM_HERE, load_driver.release());
+
   static_cast<base::MessageLoopForIO*>(v8_thread.message_loop())->PostTask(
       FROM_HERE, base::Bind(&XEShV8Runner::Shutdown,
       base::Unretained(&v8_runner)));
@@ -27,7 +27,24 @@ rm temp_test.js
 rm test_stdout
 rm test_stderr
 
-if [ "$RESULT" = "$EXPECTED" ]; then
+if [ "$RESULT" != "$EXPECTED" ]; then
+   echo -e "XESh Test: FAIL."
+   exit 1
+fi
+
+# Same extension driven by a workload in 3 contexts, each one with its own
+# instance.
+echo "echo.echo(\"\" + instanceIndex, function() { done(); });" > temp_workload.js
+
+$BUILD_DIR/xesh --external-extensions-path=$BUILD_DIR/tests/extension/echo_extension --workload=temp_workload.js --instances=3 --report=test_report 1> /dev/null 2> /dev/null
+
+INSTANCES=`grep -c '"instances": 3' test_report`
+MESSAGES=`grep -c '"messages_to_native": 3.0' test_report`
+
+rm temp_workload.js
+rm test_report
+
+if [ "$INSTANCES" = "1" ] && [ "$MESSAGES" = "1" ]; then
    echo -e "XESh Test: PASS."
    exit 0
 else
@@ -67,8 +67,12 @@ void XEShV8Runner::Initialize(int argc, char** argv,
   v8::Local<v8::Context> context = GetV8Context();
   context->Enter();
 
-  CreateModuleSystem();
-  RegisterAccessors();
+  SetUpContext(context);
+}
+
+void XEShV8Runner::SetUpContext(v8::Handle<v8::Context> context) {
+  CreateModuleSystem(context);
+  RegisterAccessors(context);
 }
 
 std::string XEShV8Runner::ExecuteString(std::string statement) {
@@ -101,6 +105,7 @@ std::string XEShV8Runner::ExecuteString(std::string statement) {
   return std::string();
 }
 
+// static
 std::string XEShV8Runner::ReportException(v8::TryCatch* try_catch) {
   v8::HandleScope handle_scope(v8::Isolate::GetCurrent());
   v8::String::Utf8Value exception(try_catch->Exception());
@@ -143,12 +148,10 @@ std::string XEShV8Runner::ReportException(v8::TryCatch* try_catch) {
   return result;
 }
 
-void XEShV8Runner::RegisterAccessors() {
+void XEShV8Runner::RegisterAccessors(v8::Handle<v8::Context> context) {
   v8::Isolate* isolate = v8::Isolate::GetCurrent();
   v8::HandleScope handle_scope(isolate);
 
-  v8::Local<v8::Context> context = GetV8Context();
-
   context->Global()->Set(
       v8::String::NewFromUtf8(isolate, "print"),
       v8::FunctionTemplate::New(PrintCallback)->GetFunction());
@@ -185,10 +188,9 @@ void XEShV8Runner::QuitCallback(v8::Local<v8::String> property,
   exit(0);
 }
 
-void XEShV8Runner::CreateModuleSystem() {
+void XEShV8Runner::CreateModuleSystem(v8::Handle<v8::Context> context) {
   v8::Isolate* isolate = v8::Isolate::GetCurrent();
   v8::HandleScope handle_scope(isolate);
-  v8::Local<v8::Context> context = GetV8Context();
 
   XWalkModuleSystem* module_system = new XWalkModuleSystem(context);
   XWalkModuleSystem::SetModuleSystemInContext(
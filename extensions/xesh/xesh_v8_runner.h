@@ -43,6 +43,15 @@ class XEShV8Runner {
   // Executes a string within the current v8 context.
   std::string ExecuteString(std::string statement);
 
+  // Installs the module system, the extensions and the shell functions in
+  // |context|. Done for the context of the shell in Initialize(), and used by
+  // XEShLoadDriver for the contexts of the workload instances.
+  void SetUpContext(v8::Handle<v8::Context> context);
+
+  XWalkExtensionClient* client() { return &client_; }
+
+  static std::string ReportException(v8::TryCatch* try_catch);
+
   static const char* GetV8Version() {
     return v8::V8::GetVersion();
   }
@@ -52,10 +61,9 @@ class XEShV8Runner {
     return v8::Handle<v8::Context>::New(v8::Isolate::GetCurrent(), v8_context_);
   }
 
-  void CreateModuleSystem();
+  void CreateModuleSystem(v8::Handle<v8::Context> context);
   void CreateExtensionModules(XWalkModuleSystem* module_system);
-  void RegisterAccessors();
-  std::string ReportException(v8::TryCatch* try_catch);
+  void RegisterAccessors(v8::Handle<v8::Context> context);
 
   static void PrintCallback(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void QuitCallback(v8::Local<v8::String> property,
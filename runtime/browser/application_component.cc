@@ -27,4 +27,10 @@ void ApplicationComponent::CreateExtensionThreadExtensions(
     content::RenderProcessHost* host,
     extensions::XWalkExtensionVector* extensions) {}
 
+void ApplicationComponent::GetExternalExtensionsFilter(
+    content::RenderProcessHost* host,
+    extensions::XWalkExternalExtensionsFilter* filter) {
+  app_system_->GetExternalExtensionsFilter(host, filter);
+}
+
 }  // namespace xwalk
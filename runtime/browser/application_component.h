@@ -37,6 +37,9 @@ class ApplicationComponent : public XWalkComponent {
   virtual void CreateExtensionThreadExtensions(
       content::RenderProcessHost* host,
       extensions::XWalkExtensionVector* extensions) OVERRIDE;
+  virtual void GetExternalExtensionsFilter(
+      content::RenderProcessHost* host,
+      extensions::XWalkExternalExtensionsFilter* filter) OVERRIDE;
 
   scoped_ptr<application::ApplicationSystem> app_system_;
   bool extensions_enabled_;
@@ -13,6 +13,10 @@ class RenderProcessHost;
 
 namespace xwalk {
 
+namespace extensions {
+struct XWalkExternalExtensionsFilter;
+}
+
 // Base class for subsystems of Crosswalk to hook into important
 // events of "Browser Process" execution. The concrete implementations
 // are instantiated by XWalkRunner before the message loop starts and
@@ -30,6 +34,11 @@ class XWalkComponent {
       content::RenderProcessHost* host,
       extensions::XWalkExtensionVector* extensions) {}
 
+  // Restricts the external extensions available to |host|.
+  virtual void GetExternalExtensionsFilter(
+      content::RenderProcessHost* host,
+      extensions::XWalkExternalExtensionsFilter* filter) {}
+
  protected:
   XWalkComponent() {}
 };
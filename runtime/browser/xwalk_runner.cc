@@ -119,6 +119,7 @@ void XWalkRunner::OnRenderProcessHostCreated(content::RenderProcessHost* host) {
 
   std::vector<extensions::XWalkExtension*> ui_thread_extensions;
   std::vector<extensions::XWalkExtension*> extension_thread_extensions;
+  extensions::XWalkExternalExtensionsFilter filter;
 
   ScopedVector<XWalkComponent>::iterator it = components_.begin();
   for (; it != components_.end(); ++it) {
@@ -126,6 +127,7 @@ void XWalkRunner::OnRenderProcessHostCreated(content::RenderProcessHost* host) {
     component->CreateUIThreadExtensions(host, &ui_thread_extensions);
     component->CreateExtensionThreadExtensions(
         host, &extension_thread_extensions);
+    component->GetExternalExtensionsFilter(host, &filter);
   }
 
   // TODO(cmarcelo): Once functionality is moved to components, remove
@@ -137,7 +139,7 @@ void XWalkRunner::OnRenderProcessHostCreated(content::RenderProcessHost* host) {
       host, &extension_thread_extensions);
 
   extension_service_->OnRenderProcessHostCreated(
-      host, &ui_thread_extensions, &extension_thread_extensions);
+      host, filter, &ui_thread_extensions, &extension_thread_extensions);
 }
 
 void XWalkRunner::OnRenderProcessHostGone(content::RenderProcessHost* host) {
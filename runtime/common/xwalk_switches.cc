@@ -22,6 +22,15 @@ const char kListApplications[] = "list-apps";
 // Specifies install an application.
 const char kInstall[] = "install";
 
+// With --install, keeps the package as it is instead of extracting it, the
+// resources of the application being served from it.
+const char kInstallAsArchive[] = "install-as-archive";
+
+// With --install, also keeps gzip compressed copies of the text resources of
+// the application, that are served instead of them to read less from the
+// disk.
+const char kInstallCompressedAssets[] = "install-compressed-assets";
+
 // Specifies uninstall an application from runtime.
 const char kUninstall[] = "uninstall";
 
@@ -16,6 +16,10 @@ extern const char kFullscreen[];
 
 extern const char kInstall[];
 
+extern const char kInstallAsArchive[];
+
+extern const char kInstallCompressedAssets[];
+
 extern const char kListApplications[];
 
 extern const char kUninstall[];
@@ -5,6 +5,7 @@
 #ifndef XWALK_SYSAPPS_COMMON_BINDING_OBJECT_H_
 #define XWALK_SYSAPPS_COMMON_BINDING_OBJECT_H_
 
+#include <string>
 #include "xwalk/extensions/browser/xwalk_extension_function_handler.h"
 
 namespace xwalk {
@@ -29,6 +30,13 @@ class BindingObject {
     return handler_.HandleFunction(info.Pass());
   }
 
+  // Receives the data sent by _postBinaryMessage(name, buffer, args) from
+  // the JavaScript object, see BindingObjectStore. The |data| is only valid
+  // during the call.
+  virtual void HandleBinaryMessage(const std::string& name,
+                                   const base::ListValue& args,
+                                   const char* data, size_t size) {}
+
  protected:
   XWalkExtensionFunctionHandler handler_;
 };
@@ -4,7 +4,7 @@
 
 #include "xwalk/sysapps/common/binding_object_store.h"
 
-#include "base/stl_util.h"
+#include "base/logging.h"
 #include "xwalk/sysapps/common/common.h"
 
 using namespace xwalk::jsapi::common; // NOLINT
@@ -12,30 +12,113 @@ using namespace xwalk::jsapi::common; // NOLINT
 namespace xwalk {
 namespace sysapps {
 
+namespace {
+
+// Must match the constants of common_api.js.
+const int kIndexBits = 20;
+const int kIndexMask = (1 << kIndexBits) - 1;
+const int kGenerationMask = (1 << 10) - 1;
+const int kNativeHandleBit = 1 << 30;
+
+int GetIndex(BindingObjectStore::Handle handle) {
+  return handle & kIndexMask;
+}
+
+// Generations go from 1 to kGenerationMask, so no handle is 0.
+int GetNextGeneration(BindingObjectStore::Handle handle) {
+  return ((handle >> kIndexBits) & kGenerationMask) % kGenerationMask + 1;
+}
+
+}  // namespace
+
 BindingObjectStore::BindingObjectStore(XWalkExtensionFunctionHandler* handler)
-    : objects_deleter_(&objects_) {
+    : binary_message_handle_(0) {
   handler->Register("JSObjectCollected",
       base::Bind(&BindingObjectStore::OnJSObjectCollected,
                  base::Unretained(this)));
+  handler->Register("JSObjectsCollected",
+      base::Bind(&BindingObjectStore::OnJSObjectsCollected,
+                 base::Unretained(this)));
   handler->Register("postMessageToObject",
       base::Bind(&BindingObjectStore::OnPostMessageToObject,
                  base::Unretained(this)));
+  handler->Register("postBinaryMessageToObject",
+      base::Bind(&BindingObjectStore::OnPostBinaryMessageToObject,
+                 base::Unretained(this)));
 }
 
-BindingObjectStore::~BindingObjectStore() {}
+BindingObjectStore::~BindingObjectStore() {
+  for (size_t i = 0; i < slots_.size(); ++i)
+    delete slots_[i].object;
+  for (size_t i = 0; i < native_slots_.size(); ++i)
+    delete native_slots_[i].object;
+}
 
-void BindingObjectStore::AddBindingObject(const std::string& id,
+void BindingObjectStore::AddBindingObject(Handle handle,
                                           scoped_ptr<BindingObject> obj) {
-  if (ContainsKey(objects_, id)) {
-    LOG(WARNING) << "The object with the ID " << id << " already exists.";
+  if (handle <= 0 || (handle & kNativeHandleBit)) {
+    LOG(WARNING) << "Invalid object handle " << handle << ".";
+    return;
+  }
+
+  size_t index = GetIndex(handle);
+  if (index >= slots_.size())
+    slots_.resize(index + 1);
+
+  Slot& slot = slots_[index];
+  if (slot.object) {
+    LOG(WARNING) << "The object with the ID " << handle << " already exists.";
     return;
   }
 
-  objects_[id] = obj.release();
+  slot.handle = handle;
+  slot.object = obj.release();
+}
+
+BindingObjectStore::Handle BindingObjectStore::AddNativeBindingObject(
+    scoped_ptr<BindingObject> obj) {
+  size_t index;
+  if (!free_native_slots_.empty()) {
+    index = free_native_slots_.back();
+    free_native_slots_.pop_back();
+  } else {
+    index = native_slots_.size();
+    native_slots_.push_back(Slot());
+  }
+  DCHECK_LE(index, static_cast<size_t>(kIndexMask));
+
+  Slot& slot = native_slots_[index];
+  slot.handle = kNativeHandleBit |
+      (GetNextGeneration(slot.handle) << kIndexBits) | index;
+  slot.object = obj.release();
+  return slot.handle;
+}
+
+bool BindingObjectStore::HasObjectForTesting(Handle handle) const {
+  return GetSlot(handle) != NULL;
 }
 
-bool BindingObjectStore::HasObjectForTesting(const std::string& id) const {
-  return ContainsKey(objects_, id);
+BindingObjectStore::Slot* BindingObjectStore::GetSlot(Handle handle) {
+  return const_cast<Slot*>(
+      static_cast<const BindingObjectStore*>(this)->GetSlot(handle));
+}
+
+const BindingObjectStore::Slot* BindingObjectStore::GetSlot(
+    Handle handle) const {
+  if (handle <= 0)
+    return NULL;
+
+  const std::vector<Slot>& slots =
+      (handle & kNativeHandleBit) ? native_slots_ : slots_;
+  size_t index = GetIndex(handle);
+  if (index >= slots.size())
+    return NULL;
+
+  const Slot& slot = slots[index];
+  if (!slot.object || slot.handle != handle)
+    return NULL;
+
+  return &slot;
 }
 
 void BindingObjectStore::OnJSObjectCollected(
@@ -48,52 +131,108 @@ void BindingObjectStore::OnJSObjectCollected(
     return;
   }
 
-  BindingObjectMap::iterator it = objects_.find(params->object_id);
-  if (it == objects_.end()) {
+  DestroyBindingObject(params->object_id);
+}
+
+void BindingObjectStore::OnJSObjectsCollected(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  scoped_ptr<DestroyObjects::Params>
+      params(DestroyObjects::Params::Create(*info->arguments()));
+
+  if (!params) {
+    LOG(WARNING) << "Malformed parameters passed to " << info->name();
+    return;
+  }
+
+  for (size_t i = 0; i < params->object_ids.size(); ++i)
+    DestroyBindingObject(params->object_ids[i]);
+}
+
+void BindingObjectStore::DestroyBindingObject(Handle handle) {
+  Slot* slot = GetSlot(handle);
+  if (!slot) {
     LOG(WARNING) << "Attempt to destroy inexistent object with the ID "
-        << params->object_id;
+        << handle;
     return;
   }
 
-  delete it->second;
-  objects_.erase(it);
+  delete slot->object;
+  slot->object = NULL;
+
+  if (handle & kNativeHandleBit)
+    free_native_slots_.push_back(GetIndex(handle));
 }
 
+// This is the path of every call on a binding object, so the arguments are
+// read in place instead of copied by PostMessageToObject::Params::Create().
 void BindingObjectStore::OnPostMessageToObject(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
-  scoped_ptr<PostMessageToObject::Params>
-      params(PostMessageToObject::Params::Create(*info->arguments()));
-
-  if (!params) {
+  Handle handle;
+  std::string name;
+  scoped_ptr<base::Value> arguments;
+  if (!info->arguments()->GetInteger(0, &handle) ||
+      !info->arguments()->GetString(1, &name) ||
+      !info->arguments()->Remove(2, &arguments)) {
     LOG(WARNING) << "Malformed parameters passed to " << info->name();
     return;
   }
 
-  BindingObjectMap::iterator it = objects_.find(params->object_id);
-  if (it == objects_.end())
+  Slot* slot = GetSlot(handle);
+  if (!slot)
     return;
 
-  if (!params->arguments->IsType(base::Value::TYPE_LIST)) {
+  if (!arguments->IsType(base::Value::TYPE_LIST)) {
     LOG(WARNING) << "Malformed message sent to the object with the ID "
-        << params->object_id << ".";
+        << handle << ".";
     return;
   }
 
   scoped_ptr<base::ListValue> new_args(
-      static_cast<base::ListValue*>(params->arguments.release()));
+      static_cast<base::ListValue*>(arguments.release()));
 
   scoped_ptr<XWalkExtensionFunctionInfo> new_info(
       new XWalkExtensionFunctionInfo(
-          params->name,
+          name,
           new_args.Pass(),
           info->post_result_cb()));
 
-  if (!it->second->HandleFunction(new_info.Pass())) {
-    LOG(WARNING) << "The object with the ID " << params->object_id << " has no "
-        "handler for the function " << params->name << ".";
+  if (!slot->object->HandleFunction(new_info.Pass())) {
+    LOG(WARNING) << "The object with the ID " << handle << " has no "
+        "handler for the function " << name << ".";
     return;
   }
 }
 
+void BindingObjectStore::OnPostBinaryMessageToObject(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  binary_message_handle_ = 0;
+  scoped_ptr<base::Value> arguments;
+  if (!info->arguments()->GetInteger(0, &binary_message_handle_) ||
+      !info->arguments()->GetString(1, &binary_message_name_) ||
+      !info->arguments()->Remove(2, &arguments) ||
+      !arguments->IsType(base::Value::TYPE_LIST)) {
+    LOG(WARNING) << "Malformed parameters passed to " << info->name();
+    binary_message_handle_ = 0;
+    return;
+  }
+
+  binary_message_args_.reset(
+      static_cast<base::ListValue*>(arguments.release()));
+}
+
+void BindingObjectStore::HandleBinaryMessage(const char* data, size_t size) {
+  Handle handle = binary_message_handle_;
+  binary_message_handle_ = 0;
+
+  Slot* slot = GetSlot(handle);
+  if (!slot) {
+    LOG(WARNING) << "Binary message sent without a valid destination object.";
+    return;
+  }
+
+  slot->object->HandleBinaryMessage(binary_message_name_,
+                                    *binary_message_args_, data, size);
+}
+
 }  // namespace sysapps
 }  // namespace xwalk
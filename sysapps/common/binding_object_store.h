@@ -5,10 +5,9 @@
 #ifndef XWALK_SYSAPPS_COMMON_BINDING_OBJECT_STORE_H_
 #define XWALK_SYSAPPS_COMMON_BINDING_OBJECT_STORE_H_
 
-#include <map>
 #include <string>
+#include <vector>
 #include "base/memory/scoped_ptr.h"
-#include "base/stl_util.h"
 #include "xwalk/extensions/browser/xwalk_extension_function_handler.h"
 #include "xwalk/extensions/common/xwalk_extension.h"
 #include "xwalk/sysapps/common/binding_object.h"
@@ -24,23 +23,61 @@ using extensions::XWalkExtensionFunctionInfo;
 // the JavaScript context. It handles the dispatching of messages to the
 // destination object based on a unique identifier associated to every
 // BindingObject. This class owns the BindingObjects it is managing.
+//
+// The identifiers are integer handles made of the index of the slot of the
+// object in the store and of the generation of the slot, that changes every
+// time the slot is freed, so finding an object takes no lookup and a stale
+// handle never reaches the object that reused its slot.
+//
+// Handles of objects created from JavaScript are allocated by common_api.js,
+// that reuses a slot only after sending JSObjectsCollected for its previous
+// object. Handles of objects created on the native side, like the sockets
+// accepted by a TCPServerSocket, are allocated by AddNativeBindingObject()
+// and freed here when the JavaScript object is collected.
 class BindingObjectStore {
  public:
+  typedef int Handle;
+
   explicit BindingObjectStore(XWalkExtensionFunctionHandler* handler);
   virtual ~BindingObjectStore();
 
-  void AddBindingObject(const std::string& id, scoped_ptr<BindingObject> obj);
-  bool HasObjectForTesting(const std::string& id) const;
+  void AddBindingObject(Handle handle, scoped_ptr<BindingObject> obj);
+  Handle AddNativeBindingObject(scoped_ptr<BindingObject> obj);
+  bool HasObjectForTesting(Handle handle) const;
+
+  // Delivers a binary message to the object named by the last
+  // postBinaryMessageToObject message, that always comes right before it.
+  void HandleBinaryMessage(const char* data, size_t size);
 
  private:
+  struct Slot {
+    Slot() : handle(0), object(NULL) {}
+    Handle handle;
+    BindingObject* object;
+  };
+
+  // Returns NULL if |handle| is not a valid handle.
+  Slot* GetSlot(Handle handle);
+  const Slot* GetSlot(Handle handle) const;
+
   // This method is invoked every time a JavaScript Binding object is collected
   // by the garbage collector, so we can also destroy the native counterpart.
   void OnJSObjectCollected(scoped_ptr<XWalkExtensionFunctionInfo> info);
+  // Same, for all the objects collected by a garbage collection at once.
+  void OnJSObjectsCollected(scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void DestroyBindingObject(Handle handle);
   void OnPostMessageToObject(scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void OnPostBinaryMessageToObject(
+      scoped_ptr<XWalkExtensionFunctionInfo> info);
+
+  std::vector<Slot> slots_;
+  std::vector<Slot> native_slots_;
+  std::vector<size_t> free_native_slots_;
 
-  typedef std::map<std::string, BindingObject*> BindingObjectMap;
-  BindingObjectMap objects_;
-  STLValueDeleter<BindingObjectMap> objects_deleter_;
+  // Target of the next binary message.
+  Handle binary_message_handle_;
+  std::string binary_message_name_;
+  scoped_ptr<base::ListValue> binary_message_args_;
 };
 
 }  // namespace sysapps
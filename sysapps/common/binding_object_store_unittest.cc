@@ -18,10 +18,16 @@ const char kTestString[] = "crosswalk1234567890";
 
 void DummyCallback(scoped_ptr<base::ListValue> result) {}
 
+// The handle JavaScript gives to the first object of the slot |index|, see
+// BindingObjectStore.
+int JSHandle(int index) {
+  return (1 << 20) | index;
+}
+
 scoped_ptr<XWalkExtensionFunctionInfo> CreateFunctionInfo(
-    const std::string& name, const std::string& str_argument) {
+    const std::string& name, int int_argument) {
   scoped_ptr<base::ListValue> arguments(new base::ListValue);
-  arguments->AppendString(str_argument);
+  arguments->AppendInteger(int_argument);
 
   return make_scoped_ptr(new XWalkExtensionFunctionInfo(
       name,
@@ -78,20 +84,20 @@ TEST(XWalkSysAppsBindingObjectStoreTest, AddBindingObject) {
       new XWalkExtensionFunctionHandler(NULL));
   scoped_ptr<BindingObjectStore> store(new BindingObjectStore(handler.get()));
 
-  EXPECT_FALSE(store->HasObjectForTesting("foobar1"));
-  EXPECT_FALSE(store->HasObjectForTesting("foobar2"));
-  EXPECT_FALSE(store->HasObjectForTesting("foobar3"));
-  EXPECT_FALSE(store->HasObjectForTesting("foobar4"));
+  EXPECT_FALSE(store->HasObjectForTesting(JSHandle(1)));
+  EXPECT_FALSE(store->HasObjectForTesting(JSHandle(2)));
+  EXPECT_FALSE(store->HasObjectForTesting(JSHandle(3)));
+  EXPECT_FALSE(store->HasObjectForTesting(JSHandle(4)));
 
-  store->AddBindingObject("foobar1", BindingObjectTest::Create());
-  store->AddBindingObject("foobar2", BindingObjectTest::Create());
-  store->AddBindingObject("foobar3", BindingObjectTest::Create());
-  store->AddBindingObject("foobar4", BindingObjectTest::Create());
+  store->AddBindingObject(JSHandle(1), BindingObjectTest::Create());
+  store->AddBindingObject(JSHandle(2), BindingObjectTest::Create());
+  store->AddBindingObject(JSHandle(3), BindingObjectTest::Create());
+  store->AddBindingObject(JSHandle(4), BindingObjectTest::Create());
 
-  EXPECT_TRUE(store->HasObjectForTesting("foobar1"));
-  EXPECT_TRUE(store->HasObjectForTesting("foobar2"));
-  EXPECT_TRUE(store->HasObjectForTesting("foobar3"));
-  EXPECT_TRUE(store->HasObjectForTesting("foobar4"));
+  EXPECT_TRUE(store->HasObjectForTesting(JSHandle(1)));
+  EXPECT_TRUE(store->HasObjectForTesting(JSHandle(2)));
+  EXPECT_TRUE(store->HasObjectForTesting(JSHandle(3)));
+  EXPECT_TRUE(store->HasObjectForTesting(JSHandle(4)));
 
   EXPECT_EQ(BindingObjectTest::instance_count(), 4);
 
@@ -102,10 +108,10 @@ TEST(XWalkSysAppsBindingObjectStoreTest, AddBindingObject) {
   // Same ID, should discard the object. If this is happening in
   // real life, there is something wrong with the code (and that is
   // why we print a warning).
-  store->AddBindingObject("foobar1", BindingObjectTest::Create());
-  store->AddBindingObject("foobar1", BindingObjectTest::Create());
-  store->AddBindingObject("foobar1", BindingObjectTest::Create());
-  store->AddBindingObject("foobar1", BindingObjectTest::Create());
+  store->AddBindingObject(JSHandle(1), BindingObjectTest::Create());
+  store->AddBindingObject(JSHandle(1), BindingObjectTest::Create());
+  store->AddBindingObject(JSHandle(1), BindingObjectTest::Create());
+  store->AddBindingObject(JSHandle(1), BindingObjectTest::Create());
   EXPECT_EQ(BindingObjectTest::instance_count(), 1);
 
   store.reset();
@@ -116,25 +122,59 @@ TEST(XWalkSysAppsBindingObjectStoreTest, OnJSObjectCollected) {
   XWalkExtensionFunctionHandler handler(NULL);
   scoped_ptr<BindingObjectStore> store(new BindingObjectStore(&handler));
 
-  store->AddBindingObject("foobar1", BindingObjectTest::Create());
-  store->AddBindingObject("foobar2", BindingObjectTest::Create());
-  store->AddBindingObject("foobar3", BindingObjectTest::Create());
-  store->AddBindingObject("foobar4", BindingObjectTest::Create());
+  store->AddBindingObject(JSHandle(1), BindingObjectTest::Create());
+  store->AddBindingObject(JSHandle(2), BindingObjectTest::Create());
+  store->AddBindingObject(JSHandle(3), BindingObjectTest::Create());
+  store->AddBindingObject(JSHandle(4), BindingObjectTest::Create());
   EXPECT_EQ(BindingObjectTest::instance_count(), 4);
 
   EXPECT_TRUE(handler.HandleFunction(
-          CreateFunctionInfo("JSObjectCollected", "foobar1")));
+          CreateFunctionInfo("JSObjectCollected", JSHandle(1))));
   EXPECT_EQ(BindingObjectTest::instance_count(), 3);
 
   EXPECT_TRUE(handler.HandleFunction(
-          CreateFunctionInfo("JSObjectCollected", "foobar2")));
+          CreateFunctionInfo("JSObjectCollected", JSHandle(2))));
   EXPECT_EQ(BindingObjectTest::instance_count(), 2);
 
   // Attempt to destroy an object that doesn't exist
   // on the store.
   EXPECT_TRUE(handler.HandleFunction(
-          CreateFunctionInfo("JSObjectCollected", "foobar2")));
+          CreateFunctionInfo("JSObjectCollected", JSHandle(2))));
+  EXPECT_EQ(BindingObjectTest::instance_count(), 2);
+
+  store.reset();
+  EXPECT_EQ(BindingObjectTest::instance_count(), 0);
+}
+
+TEST(XWalkSysAppsBindingObjectStoreTest, OnJSObjectsCollected) {
+  XWalkExtensionFunctionHandler handler(NULL);
+  scoped_ptr<BindingObjectStore> store(new BindingObjectStore(&handler));
+
+  store->AddBindingObject(JSHandle(1), BindingObjectTest::Create());
+  store->AddBindingObject(JSHandle(2), BindingObjectTest::Create());
+  store->AddBindingObject(JSHandle(3), BindingObjectTest::Create());
+  store->AddBindingObject(JSHandle(4), BindingObjectTest::Create());
+  EXPECT_EQ(BindingObjectTest::instance_count(), 4);
+
+  // JSHandle(5) doesn't exist on the store and should not stop the others
+  // from being destroyed.
+  scoped_ptr<base::ListValue> object_ids(new base::ListValue);
+  object_ids->AppendInteger(JSHandle(1));
+  object_ids->AppendInteger(JSHandle(5));
+  object_ids->AppendInteger(JSHandle(3));
+
+  scoped_ptr<base::ListValue> arguments(new base::ListValue);
+  arguments->Append(object_ids.release());
+
+  EXPECT_TRUE(handler.HandleFunction(make_scoped_ptr(
+      new XWalkExtensionFunctionInfo("JSObjectsCollected",
+                                     arguments.Pass(),
+                                     base::Bind(&DummyCallback)))));
   EXPECT_EQ(BindingObjectTest::instance_count(), 2);
+  EXPECT_FALSE(store->HasObjectForTesting(JSHandle(1)));
+  EXPECT_TRUE(store->HasObjectForTesting(JSHandle(2)));
+  EXPECT_FALSE(store->HasObjectForTesting(JSHandle(3)));
+  EXPECT_TRUE(store->HasObjectForTesting(JSHandle(4)));
 
   store.reset();
   EXPECT_EQ(BindingObjectTest::instance_count(), 0);
@@ -149,15 +189,15 @@ TEST(XWalkSysAppsBindingObjectStoreTest, OnPostMessageToObject) {
   scoped_ptr<BindingObject> binding_object_ptr1(binding_object1);
   scoped_ptr<BindingObject> binding_object_ptr2(binding_object2);
 
-  store->AddBindingObject("foobar1", binding_object_ptr1.Pass());
-  store->AddBindingObject("foobar2", binding_object_ptr2.Pass());
+  store->AddBindingObject(JSHandle(1), binding_object_ptr1.Pass());
+  store->AddBindingObject(JSHandle(2), binding_object_ptr2.Pass());
   EXPECT_EQ(BindingObjectTest::instance_count(), 2);
 
   for (unsigned i = 0; i < 1000; ++i) {
     scoped_ptr<base::ListValue> arguments(new base::ListValue);
 
     // Object ID.
-    arguments->AppendString("foobar1");
+    arguments->AppendInteger(JSHandle(1));
 
     // Function name on the target object.
     arguments->AppendString("test");
@@ -182,3 +222,48 @@ TEST(XWalkSysAppsBindingObjectStoreTest, OnPostMessageToObject) {
   store.reset();
   EXPECT_EQ(BindingObjectTest::instance_count(), 0);
 }
+
+TEST(XWalkSysAppsBindingObjectStoreTest, Handles) {
+  XWalkExtensionFunctionHandler handler(NULL);
+  scoped_ptr<BindingObjectStore> store(new BindingObjectStore(&handler));
+
+  // 0 is never a valid handle.
+  store->AddBindingObject(0, BindingObjectTest::Create());
+  EXPECT_EQ(BindingObjectTest::instance_count(), 0);
+
+  // A handle from an older generation of the slot doesn't reach the object.
+  int stale_handle = JSHandle(1);
+  int handle = (2 << 20) | 1;
+  store->AddBindingObject(handle, BindingObjectTest::Create());
+  EXPECT_FALSE(store->HasObjectForTesting(stale_handle));
+  EXPECT_TRUE(handler.HandleFunction(
+          CreateFunctionInfo("JSObjectCollected", stale_handle)));
+  EXPECT_EQ(BindingObjectTest::instance_count(), 1);
+
+  EXPECT_TRUE(handler.HandleFunction(
+          CreateFunctionInfo("JSObjectCollected", handle)));
+  EXPECT_EQ(BindingObjectTest::instance_count(), 0);
+
+  // Handles of native objects don't clash with the ones from JavaScript and
+  // get a new generation when their slot is reused.
+  store->AddBindingObject(JSHandle(0), BindingObjectTest::Create());
+  int native_handle1 =
+      store->AddNativeBindingObject(BindingObjectTest::Create());
+  EXPECT_NE(native_handle1, JSHandle(0));
+  EXPECT_TRUE(store->HasObjectForTesting(native_handle1));
+  EXPECT_TRUE(store->HasObjectForTesting(JSHandle(0)));
+
+  EXPECT_TRUE(handler.HandleFunction(
+          CreateFunctionInfo("JSObjectCollected", native_handle1)));
+  EXPECT_FALSE(store->HasObjectForTesting(native_handle1));
+  EXPECT_EQ(BindingObjectTest::instance_count(), 1);
+
+  int native_handle2 =
+      store->AddNativeBindingObject(BindingObjectTest::Create());
+  EXPECT_NE(native_handle1, native_handle2);
+  EXPECT_FALSE(store->HasObjectForTesting(native_handle1));
+  EXPECT_TRUE(store->HasObjectForTesting(native_handle2));
+
+  store.reset();
+  EXPECT_EQ(BindingObjectTest::instance_count(), 0);
+}
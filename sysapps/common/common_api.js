@@ -6,11 +6,41 @@
 // for more details.
 var internal;
 var v8tools;
+var collectionNotifier;
 
-var unique_id = 0;
+// Binding objects are identified by integer handles made of the index of a
+// slot and of its generation, see BindingObjectStore. The slots of the objects
+// created from JavaScript are allocated here and freed once the object is
+// collected. The constants must match binding_object_store.cc.
+var kIndexBits = 20;
+var kIndexMask = (1 << kIndexBits) - 1;
+var kGenerationMask = (1 << 10) - 1;
+var kNativeHandleBit = 1 << 30;
+
+var slot_generations = [];
+var free_slots = [];
 
 function getUniqueId() {
-  return (unique_id++).toString();
+  var index;
+  if (free_slots.length > 0) {
+    index = free_slots.pop();
+  } else {
+    index = slot_generations.length;
+    slot_generations.push(1);
+  }
+
+  return (slot_generations[index] << kIndexBits) | index;
+}
+
+function freeObjectHandles(object_ids) {
+  for (var i = 0; i < object_ids.length; ++i) {
+    if (object_ids[i] & kNativeHandleBit)
+      continue;
+
+    var index = object_ids[i] & kIndexMask;
+    slot_generations[index] = slot_generations[index] % kGenerationMask + 1;
+    free_slots.push(index);
+  }
 }
 
 function wrapPromiseAsCallback(promise) {
@@ -42,6 +72,12 @@ function wrapPromiseAsCallback(promise) {
 //     |postMessage| but wraps the unique identifier as the first argument
 //     automatically.
 //
+// _postBinaryMessage(name, buffer, args):
+//     Sends the contents of |buffer|, an ArrayBuffer or ArrayBufferView, to
+//     BindingObject::HandleBinaryMessage() of the native counterpart without
+//     converting them to a base::Value, along with the optional array |args|.
+//     There is no reply.
+//
 // _addMethod(name, has_callback):
 //     Convenience function for adding methods to an object that have a
 //     correspondent on the native side. Methods names that start with "_" are
@@ -61,6 +97,12 @@ var BindingObjectPrototype = function() {
         [this._id, name, args], callback);
   };
 
+  function postBinaryMessage(name, buffer, args) {
+    internal.postMessage("postBinaryMessageToObject",
+        [this._id, name, args || []]);
+    internal.postBinaryMessage(buffer);
+  };
+
   function isEnumerable(method_name) {
     return name.indexOf("_") != 0;
   };
@@ -93,20 +135,16 @@ var BindingObjectPrototype = function() {
   };
 
   function registerLifecycleTracker() {
-    Object.defineProperty(this, "_tracker", {
-      value: v8tools.lifecycleTracker(),
-    });
-
-    var object_id = this._id;
-    this._tracker.destructor = function() {
-      internal.postMessage("JSObjectCollected", [object_id]);
-    };
+    collectionNotifier.track(this, this._id);
   }
 
   Object.defineProperties(this, {
     "_postMessage" : {
       value: postMessage,
     },
+    "_postBinaryMessage" : {
+      value: postBinaryMessage,
+    },
     "_addMethod" : {
       value: addMethod,
     },
@@ -211,9 +249,26 @@ var EventTargetPrototype = function() {
   // We need a reference to the calling object because
   // this function is called by the renderer process with
   // "this" equals to the global object.
+  //
+  // Events with a delivery policy other than the default on the native side
+  // (see EventTarget::DeliveryPolicy) come with |delivery| set, and the next
+  // message of the type is only sent once this one is acknowledged. With
+  // "batch", |data| is an array with the data of several events. The
+  // acknowledgement carries back |generation|, that tells the listeners
+  // apart across removal and addition.
   function makeCallbackListener(obj, type) {
-    return function(data) {
-      obj._dispatchEventFromExtension(type, data);
+    return function(data, delivery, generation) {
+      try {
+        if (delivery == "batch") {
+          for (var i = 0; i < data.length; ++i)
+            obj._dispatchEventFromExtension(type, data[i]);
+        } else {
+          obj._dispatchEventFromExtension(type, data);
+        }
+      } finally {
+        if (delivery)
+          obj._postMessage("ackEvent", [type, generation]);
+      }
       return true;
     };
   };
@@ -313,6 +368,14 @@ exports.setupSysAppsCommon = function(internalObj, v8toolsObj) {
   internal = internalObj;
   v8tools = v8toolsObj;
 
+  // The objects collected by the same garbage collection are destroyed on
+  // the native side with a single message. Their slots can be reused right
+  // away, the constructors of the next objects are sent after it.
+  collectionNotifier = v8tools.collectionNotifier(function(object_ids) {
+    internal.postMessage("JSObjectsCollected", [object_ids]);
+    freeObjectHandles(object_ids);
+  });
+
   EventTargetPrototype.prototype = new BindingObjectPrototype();
 
   exports.getUniqueId = getUniqueId;
@@ -4,6 +4,7 @@
 
 #include "xwalk/sysapps/common/event_target.h"
 
+#include "base/debug/trace_event.h"
 #include "xwalk/sysapps/common/common.h"
 
 using namespace xwalk::jsapi::common; // NOLINT
@@ -11,30 +12,200 @@ using namespace xwalk::jsapi::common; // NOLINT
 namespace xwalk {
 namespace sysapps {
 
-EventTarget::EventTarget() {
+namespace {
+
+// Tells the JavaScript side how to handle the message and that it must be
+// acknowledged, see makeCallbackListener() in common_api.js.
+const char kDeliveryAck[] = "ack";
+const char kDeliveryBatch[] = "batch";
+
+}  // namespace
+
+EventTarget::Event::Event()
+    : policy(DELIVER_IMMEDIATELY),
+      max_pending(0),
+      waiting_ack(false),
+      generation(0) {}
+
+EventTarget::Event::~Event() {}
+
+EventTarget::EventTarget()
+    : pending_event_count_(0),
+      dropped_event_count_(0) {
   handler_.Register("addEventListener",
       base::Bind(&EventTarget::OnAddEventListener, base::Unretained(this)));
   handler_.Register("removeEventListener",
       base::Bind(&EventTarget::OnRemoveEventListener, base::Unretained(this)));
+  handler_.Register("ackEvent",
+      base::Bind(&EventTarget::OnAckEvent, base::Unretained(this)));
 }
 
 EventTarget::~EventTarget() {}
 
+EventTarget::EventType EventTarget::RegisterEvent(const std::string& type) {
+  EventType event_type = FindEvent(type);
+  if (event_type == events_.size()) {
+    events_.push_back(new Event);
+    events_.back()->type = type;
+  }
+  return event_type;
+}
+
 void EventTarget::DispatchEvent(const std::string& type) {
   DispatchEvent(type, make_scoped_ptr(new base::ListValue));
 }
 
 void EventTarget::DispatchEvent(const std::string& type,
                                 scoped_ptr<base::ListValue> data) {
-  EventMap::iterator it = events_.find(type);
-  if (it == events_.end())
+  EventType event_type = FindEvent(type);
+  if (event_type == events_.size())
+    return;
+
+  DispatchEvent(event_type, data.Pass());
+}
+
+void EventTarget::DispatchEvent(EventType type) {
+  DispatchEvent(type, make_scoped_ptr(new base::ListValue));
+}
+
+void EventTarget::DispatchEvent(EventType type,
+                                scoped_ptr<base::ListValue> data) {
+  DCHECK_LT(type, events_.size());
+  Event* event = events_[type];
+  if (event->callback.is_null())
     return;
 
-  it->second.Run(data.Pass());
+  if (event->policy == DELIVER_IMMEDIATELY) {
+    event->callback.Run(data.Pass());
+    return;
+  }
+
+  scoped_ptr<base::Value> value;
+  if (!data->Remove(0, &value))
+    value.reset(base::Value::CreateNullValue());
+
+  QueueEvent(event, value.Pass());
+  if (!event->waiting_ack)
+    SendPendingEvents(event);
+
+  TracePendingEvents();
+}
+
+void EventTarget::DispatchEvents(EventType type,
+                                 scoped_ptr<base::ListValue> events) {
+  DCHECK_LT(type, events_.size());
+  Event* event = events_[type];
+  if (event->callback.is_null() || events->empty())
+    return;
+
+  scoped_ptr<base::Value> value;
+  if (event->policy == DELIVER_IMMEDIATELY) {
+    while (events->Remove(0, &value)) {
+      scoped_ptr<base::ListValue> data(new base::ListValue);
+      data->Append(value.release());
+      event->callback.Run(data.Pass());
+    }
+    return;
+  }
+
+  while (events->Remove(0, &value))
+    QueueEvent(event, value.Pass());
+  if (!event->waiting_ack)
+    SendPendingEvents(event);
+
+  TracePendingEvents();
 }
 
 bool EventTarget::IsEventActive(const std::string& type) const {
-  return events_.find(type) != events_.end();
+  EventType event_type = FindEvent(type);
+  return event_type != events_.size() &&
+      !events_[event_type]->callback.is_null();
+}
+
+void EventTarget::SetEventDeliveryPolicy(EventType type,
+                                         DeliveryPolicy policy,
+                                         size_t max_pending) {
+  DCHECK_LT(type, events_.size());
+  DCHECK(policy == DELIVER_IMMEDIATELY || policy == DELIVER_LATEST ||
+         max_pending > 0);
+  Event* event = events_[type];
+  ClearPendingEvents(type);
+  event->policy = policy;
+  event->max_pending = max_pending;
+}
+
+bool EventTarget::CanDispatchEvent(EventType type) const {
+  DCHECK_LT(type, events_.size());
+  const Event* event = events_[type];
+  if (event->policy == DELIVER_IMMEDIATELY || event->policy == DELIVER_LATEST)
+    return true;
+  return event->pending.GetSize() < event->max_pending;
+}
+
+void EventTarget::QueueEvent(Event* event, scoped_ptr<base::Value> value) {
+  if (event->policy == DELIVER_LATEST) {
+    dropped_event_count_ += event->pending.GetSize();
+    pending_event_count_ -= event->pending.GetSize();
+    event->pending.Clear();
+  } else if (event->pending.GetSize() >= event->max_pending) {
+    event->pending.Remove(0, NULL);
+    pending_event_count_--;
+    dropped_event_count_++;
+  }
+
+  event->pending.Append(value.release());
+  pending_event_count_++;
+}
+
+EventTarget::EventType EventTarget::FindEvent(const std::string& type) const {
+  EventType event_type = 0;
+  while (event_type < events_.size() && events_[event_type]->type != type)
+    event_type++;
+  return event_type;
+}
+
+void EventTarget::SendPendingEvents(Event* event) {
+  if (event->pending.empty())
+    return;
+
+  scoped_ptr<base::ListValue> data(new base::ListValue);
+  if (event->policy == DELIVER_BATCHED) {
+    pending_event_count_ -= event->pending.GetSize();
+    base::ListValue* batch = new base::ListValue;
+    batch->Swap(&event->pending);
+    data->Append(batch);
+    data->AppendString(kDeliveryBatch);
+  } else {
+    scoped_ptr<base::Value> value;
+    event->pending.Remove(0, &value);
+    pending_event_count_--;
+    data->Append(value.release());
+    data->AppendString(kDeliveryAck);
+  }
+  data->AppendInteger(event->generation);
+
+  event->waiting_ack = true;
+  event->callback.Run(data.Pass());
+}
+
+void EventTarget::ClearPendingEvents(EventType type) {
+  Event* event = events_[type];
+  bool was_waiting_ack = event->waiting_ack;
+  pending_event_count_ -= event->pending.GetSize();
+  event->pending.Clear();
+  event->waiting_ack = false;
+  TracePendingEvents();
+
+  // The message on the way will not be acknowledged, producers waiting for
+  // it can resume.
+  if (was_waiting_ack)
+    OnEventAcknowledged(type);
+}
+
+void EventTarget::TracePendingEvents() {
+  TRACE_COUNTER_ID2("xwalk", "EventTarget::PendingEvents", this,
+                    "pending", pending_event_count_,
+                    "dropped", dropped_event_count_);
 }
 
 void EventTarget::OnAddEventListener(
@@ -47,14 +218,16 @@ void EventTarget::OnAddEventListener(
     return;
   }
 
-  if (events_.find(params->type) != events_.end()) {
+  Event* event = events_[RegisterEvent(params->type)];
+  if (!event->callback.is_null()) {
     LOG(WARNING) << "Trying to re-add the event '" << params->type << "'. "
         "This should be optized in the JavaScript side so this message is sent "
         "only once.";
     return;
   }
 
-  events_[params->type] = info->post_result_cb();
+  event->callback = info->post_result_cb();
+  event->generation++;
   StartEvent(params->type);
 }
 
@@ -68,16 +241,44 @@ void EventTarget::OnRemoveEventListener(
     return;
   }
 
-  EventMap::iterator it = events_.find(params->type);
-  if (it == events_.end()) {
+  EventType event_type = FindEvent(params->type);
+  if (event_type == events_.size() ||
+      events_[event_type]->callback.is_null()) {
     LOG(WARNING) << "Attempt to remove the event '" << params->type << "' but "
         "this event was not previously added.";
     return;
   }
 
-  events_.erase(it);
+  events_[event_type]->callback.Reset();
+  ClearPendingEvents(event_type);
   StopEvent(params->type);
 }
 
+void EventTarget::OnAckEvent(scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  scoped_ptr<AckEvent::Params>
+      params(AckEvent::Params::Create(*info->arguments()));
+
+  if (!params) {
+    LOG(WARNING) << "Malformed parameters passed to " << info->name();
+    return;
+  }
+
+  // Acknowledgements of messages sent before the last listener was removed
+  // can still arrive, even after a new one was added, they are ignored.
+  EventType event_type = FindEvent(params->type);
+  if (event_type == events_.size())
+    return;
+
+  Event* event = events_[event_type];
+  if (!event->waiting_ack || params->generation != event->generation)
+    return;
+
+  event->waiting_ack = false;
+  SendPendingEvents(event);
+  TracePendingEvents();
+
+  OnEventAcknowledged(event_type);
+}
+
 }  // namespace sysapps
 }  // namespace xwalk
@@ -5,8 +5,8 @@
 #ifndef XWALK_SYSAPPS_COMMON_EVENT_TARGET_H_
 #define XWALK_SYSAPPS_COMMON_EVENT_TARGET_H_
 
-#include <map>
 #include <string>
+#include "base/memory/scoped_vector.h"
 #include "xwalk/sysapps/common/binding_object.h"
 
 namespace xwalk {
@@ -19,6 +19,23 @@ using extensions::XWalkExtensionFunctionInfo;
 // It has convenience methods and signals to make dispatching of events simple.
 class EventTarget : public BindingObject {
  public:
+  // Index of an event in the events of this object, see RegisterEvent().
+  typedef size_t EventType;
+
+  // How the events of a type are delivered while JavaScript did not
+  // acknowledge the previous message of the type yet. Only one message per
+  // type is on the way at a time, except for DELIVER_IMMEDIATELY.
+  enum DeliveryPolicy {
+    // Every event is sent right away and never acknowledged. The default.
+    DELIVER_IMMEDIATELY,
+    // Only the latest event is kept, for values like sensor readings.
+    DELIVER_LATEST,
+    // The events kept are sent together in a single message.
+    DELIVER_BATCHED,
+    // The events kept are sent one by one.
+    DELIVER_QUEUED
+  };
+
   EventTarget();
   virtual ~EventTarget();
 
@@ -30,23 +47,81 @@ class EventTarget : public BindingObject {
   virtual void StartEvent(const std::string& type) {}
   virtual void StopEvent(const std::string& type) {}
 
+  // Returns the EventType of |type|, that can be given to DispatchEvent()
+  // instead of the name to skip looking it up, for events fired often. Events
+  // are also registered when the first listener is added.
+  EventType RegisterEvent(const std::string& type);
+
   // DispatchEvent will send an event to the JavaScript counterpart of this
   // object and invoke its listeners. The message is only sent if there is at
   // least one listener, so it is safe to call this method without concerning
   // about performance issues.
   void DispatchEvent(const std::string& type);
   void DispatchEvent(const std::string& type, scoped_ptr<base::ListValue> data);
+  void DispatchEvent(EventType type);
+  void DispatchEvent(EventType type, scoped_ptr<base::ListValue> data);
+
+  // Dispatches an event of |type| for each item of |events|, that are the
+  // first argument of each one. With DELIVER_BATCHED they are sent in a
+  // single message if no acknowledgement is pending.
+  void DispatchEvents(EventType type, scoped_ptr<base::ListValue> events);
 
   bool IsEventActive(const std::string& type) const;
 
+  // Up to |max_pending| events of |type| are kept while waiting for the
+  // acknowledgement of the previous message, with DELIVER_BATCHED and
+  // DELIVER_QUEUED. Beyond that the oldest ones are dropped, so producers
+  // that can wait, like sockets, should stop while CanDispatchEvent() is
+  // false and resume on OnEventAcknowledged(), that is also called when the
+  // message on the way is given up because the last listener was removed.
+  void SetEventDeliveryPolicy(EventType type, DeliveryPolicy policy,
+                              size_t max_pending);
+  bool CanDispatchEvent(EventType type) const;
+  virtual void OnEventAcknowledged(EventType type) {}
+
+  // Events waiting for an acknowledgement, and dropped ones, in all types.
+  size_t pending_event_count() const { return pending_event_count_; }
+  size_t dropped_event_count() const { return dropped_event_count_; }
+
  private:
+  struct Event {
+    Event();
+    ~Event();
+
+    std::string type;
+    // Null while there are no listeners.
+    XWalkExtensionFunctionInfo::PostResultCallback callback;
+
+    DeliveryPolicy policy;
+    size_t max_pending;
+    bool waiting_ack;
+    // Incremented when the first listener is added and sent with the messages
+    // to acknowledge, not to take an old acknowledgement for a new message.
+    int generation;
+    // The first argument of the events, the rest is not sent.
+    base::ListValue pending;
+  };
+
+  // Returns events_.size() if |type| was not registered.
+  EventType FindEvent(const std::string& type) const;
+
+  // Adds |value| to the pending events of |event|, dropping the oldest one
+  // if it is full.
+  void QueueEvent(Event* event, scoped_ptr<base::Value> value);
+  // Sends the pending events of |event| that the policy allows.
+  void SendPendingEvents(Event* event);
+  void ClearPendingEvents(EventType type);
+  void TracePendingEvents();
+
   void OnAddEventListener(scoped_ptr<XWalkExtensionFunctionInfo> info);
   void OnRemoveEventListener(scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void OnAckEvent(scoped_ptr<XWalkExtensionFunctionInfo> info);
 
-  typedef std::map<std::string,
-      XWalkExtensionFunctionInfo::PostResultCallback> EventMap;
+  // An object has a handful of events, the vector is faster than a map.
+  ScopedVector<Event> events_;
 
-  EventMap events_;
+  size_t pending_event_count_;
+  size_t dropped_event_count_;
 };
 
 }  // namespace sysapps
@@ -4,6 +4,7 @@
 
 #include "xwalk/sysapps/common/event_target.h"
 
+#include "base/memory/scoped_vector.h"
 #include "testing/gtest/include/gtest/gtest.h"
 #include "xwalk/extensions/browser/xwalk_extension_function_handler.h"
 
@@ -36,11 +37,35 @@ void DispatchResult(int* message_count, scoped_ptr<base::ListValue> result) {
   (*message_count)++;
 }
 
+void StoreResult(ScopedVector<base::ListValue>* results,
+                 scoped_ptr<base::ListValue> result) {
+  results->push_back(result.release());
+}
+
+int GetIntegerResult(const base::ListValue* result) {
+  int value = -1;
+  result->GetInteger(0, &value);
+  return value;
+}
+
+std::string GetDelivery(const base::ListValue* result) {
+  std::string delivery;
+  result->GetString(1, &delivery);
+  return delivery;
+}
+
+int GetGeneration(const base::ListValue* result) {
+  int generation = -1;
+  result->GetInteger(2, &generation);
+  return generation;
+}
+
 class EventTargetTest : public EventTarget {
  public:
   EventTargetTest()
       : event1_count_(0),
-        event2_count_(0) {}
+        event2_count_(0),
+        event2_type_(RegisterEvent("event2")) {}
 
   void InjectEvent(const std::string& type) {
     scoped_ptr<base::ListValue> data(new base::ListValue());
@@ -49,6 +74,13 @@ class EventTargetTest : public EventTarget {
     DispatchEvent(type, data.Pass());
   }
 
+  void InjectEvent2() {
+    scoped_ptr<base::ListValue> data(new base::ListValue());
+    data->AppendString(kTestString);
+
+    DispatchEvent(event2_type_, data.Pass());
+  }
+
   bool is_event1_active() const {
     return event1_count_ == 1;
   }
@@ -84,6 +116,86 @@ class EventTargetTest : public EventTarget {
 
   int event1_count_;
   int event2_count_;
+  EventType event2_type_;
+};
+
+// Fires the event "test" with integers as data. Like sockets, Produce()
+// pauses while the events can not be dispatched.
+class DeliveryTest : public EventTarget {
+ public:
+  DeliveryTest(DeliveryPolicy policy, size_t max_pending)
+      : type_(RegisterEvent("test")),
+        ack_count_(0),
+        results_(NULL),
+        is_paused_(false) {
+    SetEventDeliveryPolicy(type_, policy, max_pending);
+  }
+
+  void AddListener(ScopedVector<base::ListValue>* results) {
+    results_ = results;
+    scoped_ptr<base::ListValue> arguments(new base::ListValue);
+    arguments->AppendString("test");
+    EXPECT_TRUE(HandleFunction(make_scoped_ptr(new XWalkExtensionFunctionInfo(
+        "addEventListener", arguments.Pass(),
+        base::Bind(&StoreResult, results)))));
+  }
+
+  // Acknowledges the last message received, as the JavaScript side does.
+  void Ack() {
+    ASSERT_FALSE(results_->empty());
+    Ack(GetGeneration(results_->back()));
+  }
+
+  void Ack(int generation) {
+    scoped_ptr<base::ListValue> arguments(new base::ListValue);
+    arguments->AppendString("test");
+    arguments->AppendInteger(generation);
+    EXPECT_TRUE(HandleFunction(make_scoped_ptr(new XWalkExtensionFunctionInfo(
+        "ackEvent", arguments.Pass(), base::Bind(&DummyCallback)))));
+  }
+
+  bool Produce(int value) {
+    if (is_paused_)
+      return false;
+
+    InjectEvent(value);
+    is_paused_ = !can_dispatch();
+    return true;
+  }
+
+  void InjectEvent(int value) {
+    scoped_ptr<base::ListValue> data(new base::ListValue());
+    data->AppendInteger(value);
+
+    DispatchEvent(type_, data.Pass());
+  }
+
+  void InjectEvents(int first, int last) {
+    scoped_ptr<base::ListValue> events(new base::ListValue());
+    for (int value = first; value <= last; ++value)
+      events->AppendInteger(value);
+
+    DispatchEvents(type_, events.Pass());
+  }
+
+  bool can_dispatch() const { return CanDispatchEvent(type_); }
+  size_t pending() const { return pending_event_count(); }
+  size_t dropped() const { return dropped_event_count(); }
+  int ack_count() const { return ack_count_; }
+  bool is_paused() const { return is_paused_; }
+
+ private:
+  virtual void OnEventAcknowledged(EventType type) OVERRIDE {
+    EXPECT_EQ(type_, type);
+    ack_count_++;
+    if (can_dispatch())
+      is_paused_ = false;
+  }
+
+  EventType type_;
+  int ack_count_;
+  ScopedVector<base::ListValue>* results_;
+  bool is_paused_;
 };
 
 }  // namespace
@@ -162,3 +274,184 @@ TEST(XWalkSysAppsEventTargetTest, DispatchEvent) {
     EXPECT_EQ(message_count, i + 1);
   }
 }
+
+TEST(XWalkSysAppsEventTargetTest, DispatchRegisteredEvent) {
+  scoped_ptr<EventTargetTest> target(new EventTargetTest());
+
+  int message_count = 0;
+  target->InjectEvent2();
+
+  scoped_ptr<base::ListValue> argumentsList(new base::ListValue);
+  argumentsList->AppendString("event2");
+
+  scoped_ptr<XWalkExtensionFunctionInfo> eventInfo(
+      new XWalkExtensionFunctionInfo(
+          "addEventListener",
+          argumentsList.Pass(),
+          base::Bind(&DispatchResult, &message_count)));
+
+  // The listener takes the event registered by the constructor.
+  EXPECT_TRUE(target->HandleFunction(eventInfo.Pass()));
+  EXPECT_TRUE(target->is_event2_active());
+
+  for (int i = 0; i < 1000; ++i) {
+    target->InjectEvent2();
+    EXPECT_EQ(message_count, i + 1);
+  }
+
+  EXPECT_TRUE(target->HandleFunction(
+          CreateFunctionInfo("removeEventListener", "event2")));
+  target->InjectEvent2();
+  EXPECT_EQ(message_count, 1000);
+}
+
+TEST(XWalkSysAppsEventTargetTest, DeliverLatest) {
+  ScopedVector<base::ListValue> results;
+  DeliveryTest target(EventTarget::DELIVER_LATEST, 0);
+
+  // Nothing is kept without listeners.
+  target.InjectEvent(0);
+  EXPECT_EQ(target.pending(), 0u);
+
+  target.AddListener(&results);
+  target.InjectEvent(1);
+  target.InjectEvent(2);
+  target.InjectEvent(3);
+  ASSERT_EQ(results.size(), 1u);
+  EXPECT_EQ(GetIntegerResult(results[0]), 1);
+  EXPECT_EQ(GetDelivery(results[0]), "ack");
+  EXPECT_EQ(target.pending(), 1u);
+  EXPECT_EQ(target.dropped(), 1u);
+
+  target.Ack();
+  ASSERT_EQ(results.size(), 2u);
+  EXPECT_EQ(GetIntegerResult(results[1]), 3);
+  EXPECT_EQ(target.pending(), 0u);
+
+  target.Ack();
+  EXPECT_EQ(results.size(), 2u);
+  EXPECT_EQ(target.ack_count(), 2);
+
+  // Nothing on the way, sent right away.
+  target.InjectEvent(4);
+  ASSERT_EQ(results.size(), 3u);
+  EXPECT_EQ(GetIntegerResult(results[2]), 4);
+}
+
+TEST(XWalkSysAppsEventTargetTest, DeliverBatched) {
+  ScopedVector<base::ListValue> results;
+  DeliveryTest target(EventTarget::DELIVER_BATCHED, 3);
+  target.AddListener(&results);
+
+  for (int i = 1; i <= 5; ++i)
+    target.InjectEvent(i);
+
+  // The first event goes alone, then 2 is dropped to make room for 5.
+  ASSERT_EQ(results.size(), 1u);
+  EXPECT_EQ(target.pending(), 3u);
+  EXPECT_EQ(target.dropped(), 1u);
+  EXPECT_FALSE(target.can_dispatch());
+
+  target.Ack();
+  ASSERT_EQ(results.size(), 2u);
+  EXPECT_EQ(GetDelivery(results[1]), "batch");
+  base::ListValue* batch;
+  ASSERT_TRUE(results[1]->GetList(0, &batch));
+  ASSERT_EQ(batch->GetSize(), 3u);
+  EXPECT_EQ(GetIntegerResult(batch), 3);
+  EXPECT_EQ(target.pending(), 0u);
+  EXPECT_TRUE(target.can_dispatch());
+}
+
+TEST(XWalkSysAppsEventTargetTest, DispatchEventsBatched) {
+  ScopedVector<base::ListValue> results;
+  DeliveryTest target(EventTarget::DELIVER_BATCHED, 4);
+  target.AddListener(&results);
+
+  // Events dispatched together go in a single message.
+  target.InjectEvents(1, 3);
+  ASSERT_EQ(results.size(), 1u);
+  EXPECT_EQ(GetDelivery(results[0]), "batch");
+  base::ListValue* batch;
+  ASSERT_TRUE(results[0]->GetList(0, &batch));
+  ASSERT_EQ(batch->GetSize(), 3u);
+  EXPECT_EQ(GetIntegerResult(batch), 1);
+
+  // While waiting for the acknowledgement they are kept, up to 4.
+  target.InjectEvents(4, 8);
+  ASSERT_EQ(results.size(), 1u);
+  EXPECT_EQ(target.pending(), 4u);
+  EXPECT_EQ(target.dropped(), 1u);
+
+  target.Ack();
+  ASSERT_EQ(results.size(), 2u);
+  ASSERT_TRUE(results[1]->GetList(0, &batch));
+  ASSERT_EQ(batch->GetSize(), 4u);
+  EXPECT_EQ(GetIntegerResult(batch), 5);
+}
+
+TEST(XWalkSysAppsEventTargetTest, DeliverQueued) {
+  ScopedVector<base::ListValue> results;
+  DeliveryTest target(EventTarget::DELIVER_QUEUED, 2);
+  target.AddListener(&results);
+
+  target.InjectEvent(1);
+  target.InjectEvent(2);
+  EXPECT_TRUE(target.can_dispatch());
+  target.InjectEvent(3);
+  EXPECT_FALSE(target.can_dispatch());
+  ASSERT_EQ(results.size(), 1u);
+
+  target.Ack();
+  ASSERT_EQ(results.size(), 2u);
+  EXPECT_EQ(GetIntegerResult(results[1]), 2);
+  EXPECT_EQ(GetDelivery(results[1]), "ack");
+  EXPECT_TRUE(target.can_dispatch());
+  EXPECT_EQ(target.ack_count(), 1);
+
+  // Removing the listener drops what was kept.
+  EXPECT_TRUE(target.HandleFunction(
+      CreateFunctionInfo("removeEventListener", "test")));
+  EXPECT_EQ(target.pending(), 0u);
+  EXPECT_EQ(target.dropped(), 0u);
+
+  target.Ack();
+  EXPECT_EQ(results.size(), 2u);
+}
+
+TEST(XWalkSysAppsEventTargetTest, RemoveListenerWhilePaused) {
+  ScopedVector<base::ListValue> results;
+  DeliveryTest target(EventTarget::DELIVER_QUEUED, 1);
+  target.AddListener(&results);
+
+  EXPECT_TRUE(target.Produce(1));
+  EXPECT_TRUE(target.Produce(2));
+  EXPECT_TRUE(target.is_paused());
+  EXPECT_FALSE(target.Produce(3));
+  ASSERT_EQ(results.size(), 1u);
+  int old_generation = GetGeneration(results[0]);
+
+  // The message on the way will never be acknowledged, the producer resumes.
+  EXPECT_TRUE(target.HandleFunction(
+      CreateFunctionInfo("removeEventListener", "test")));
+  EXPECT_FALSE(target.is_paused());
+  EXPECT_EQ(target.pending(), 0u);
+
+  target.AddListener(&results);
+  EXPECT_TRUE(target.Produce(4));
+  EXPECT_TRUE(target.Produce(5));
+  ASSERT_EQ(results.size(), 2u);
+  EXPECT_EQ(GetIntegerResult(results[1]), 4);
+  EXPECT_NE(GetGeneration(results[1]), old_generation);
+
+  // The acknowledgement of the first message arrives late, it does not count
+  // for the new one.
+  target.Ack(old_generation);
+  EXPECT_EQ(results.size(), 2u);
+  EXPECT_TRUE(target.is_paused());
+
+  target.Ack();
+  ASSERT_EQ(results.size(), 3u);
+  EXPECT_EQ(GetIntegerResult(results[2]), 5);
+  EXPECT_FALSE(target.is_paused());
+}
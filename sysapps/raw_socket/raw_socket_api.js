@@ -18,7 +18,11 @@ common.setupSysAppsCommon(internal, v8tools);
 // cannot subscribe to its own events otherwise it will
 // leak (because it creates a circular reference).
 //
-var ReadyStateObserver = function(object_id, initial_state) {
+// With |track_written| it also keeps the number of bytes
+// written to the socket from the |written| event, for the
+// bufferedAmount of TCPSocket.
+//
+var ReadyStateObserver = function(object_id, initial_state, track_written) {
   common.BindingObject.call(this, object_id);
   common.EventTarget.call(this);
 
@@ -30,19 +34,67 @@ var ReadyStateObserver = function(object_id, initial_state) {
     that.readyState = event.data;
   };
 
+  this.bytesWritten = 0;
+  if (track_written) {
+    this._addEvent("written");
+    this.onwritten = function(event) {
+      that.bytesWritten = event.data;
+    };
+  }
+
   this.destructor = function() {
     this.onreadystate = null;
+    if (track_written)
+      this.onwritten = null;
   };
 };
 
+// Number of bytes of the UTF-8 encoding of |str|, as sent by
+// the native side.
+function utf8Length(str) {
+  var length = str.length;
+  for (var i = 0; i < str.length; ++i) {
+    var code = str.charCodeAt(i);
+    if (code >= 0xd800 && code < 0xdc00)
+      length += 2;  // Surrogate pair, 4 bytes for 2 code units.
+    else if (code >= 0x800 && (code < 0xdc00 || code >= 0xe000))
+      length += 2;
+    else if (code >= 0x80 && code < 0x800)
+      length += 1;
+  }
+  return length;
+}
+
+// Sends |data| to the native side of |obj| with the extra
+// arguments |args|, and returns its size in bytes. Binary
+// data goes in a binary message, everything else as string.
+function postSendData(obj, data, args) {
+  if (data instanceof ArrayBuffer) {
+    obj._postBinaryMessage("sendArrayBuffer", data, args);
+    return data.byteLength;
+  }
+
+  if (data && data.buffer instanceof ArrayBuffer) {
+    obj._postBinaryMessage("sendArrayBufferView", data, args);
+    return data.byteLength;
+  }
+
+  data = String(data);
+  obj._sendString.apply(obj, [data].concat(args));
+  return utf8Length(data);
+}
+
 ReadyStateObserver.prototype = new common.EventTargetPrototype();
 
 // TCPSocket interface.
 //
 // TODO(tmpsantos): We are currently not throwing any exceptions
-// neither validating the input parameters.
+// neither validating the input parameters, except for send()
+// after halfclose().
 //
-// TODO(tmpsantos): TCPOptions argument is being ignored by now.
+// TODO(tmpsantos): TCPOptions argument is being ignored by now, except
+// for |highWaterMark|: send() returns false once bufferedAmount reaches it,
+// and a "drain" event is fired when all the data has been written.
 //
 var TCPSocket = function(remoteAddress, remotePort, options, object_id) {
   common.BindingObject.call(this, object_id ? object_id : common.getUniqueId());
@@ -64,11 +116,14 @@ var TCPSocket = function(remoteAddress, remotePort, options, object_id) {
   if (!options.useSecureTransport)
     options.useSecureTransport = false;
 
+  var highWaterMark = options.highWaterMark || 65536;
+
   this._addMethod("_close");
-  this._addMethod("halfclose");
+  this._addMethod("_halfclose");
   this._addMethod("suspend");
   this._addMethod("resume");
   this._addMethod("_sendString");
+  this._addMethod("_requestDrain");
 
   this._addEvent("drain");
   this._addEvent("open");
@@ -77,15 +132,24 @@ var TCPSocket = function(remoteAddress, remotePort, options, object_id) {
   this._addEvent("error");
   this._addEvent("data");
 
+  // The native side queues everything it gets, send() only tells
+  // whether the caller should wait for "drain" before sending more.
+  // The bytes written come back asynchronously, so bufferedAmount
+  // can be a bit higher than the real amount, never lower.
+  //
+  // The native side drops what is sent after halfclose(), it would
+  // never be written, so send() throws instead of counting it.
   function sendWrapper(data) {
-    this._sendString(data);
-
-    // FIXME(tmpsantos): The spec says that send() should always
-    // return if you can keep sending data. This can only be
-    // verified in the native implementation, which makes this
-    // call sync. We are returning always true here to keep the
-    // implementation async.
-    return true;
+    if (this._isHalfClosed)
+      throw new Error("InvalidStateError: The socket is half closed.");
+
+    this._bytesSent += postSendData(this, data, []);
+
+    if (this.bufferedAmount < highWaterMark)
+      return true;
+
+    this._requestDrain();
+    return false;
   };
 
   function closeWrapper(data) {
@@ -96,10 +160,27 @@ var TCPSocket = function(remoteAddress, remotePort, options, object_id) {
     this._close();
   };
 
+  // The "halfclosed" readyState comes back asynchronously, send()
+  // can't wait for it. The native side ignores halfclose() until the
+  // socket is connected, so does send().
+  function halfcloseWrapper() {
+    if (this._readyStateObserver.readyState == "open")
+      this._isHalfClosed = true;
+    this._halfclose();
+  };
+
   Object.defineProperties(this, {
     "_readyStateObserver": {
       value: new ReadyStateObserver(
-          this._id, object_id ? "open" : "connecting"),
+          this._id, object_id ? "open" : "connecting", true),
+    },
+    "_bytesSent": {
+      value: 0,
+      writable: true,
+    },
+    "_isHalfClosed": {
+      value: false,
+      writable: true,
     },
     "_readyStateObserverDeleter": {
       value: v8tools.lifecycleTracker(),
@@ -112,6 +193,10 @@ var TCPSocket = function(remoteAddress, remotePort, options, object_id) {
       value: closeWrapper,
       enumerable: true,
     },
+    "halfclose": {
+      value: halfcloseWrapper,
+      enumerable: true,
+    },
     "remoteAddress": {
       value: remoteAddress,
       enumerable: true,
@@ -128,8 +213,10 @@ var TCPSocket = function(remoteAddress, remotePort, options, object_id) {
       value: 0,
       enumerable: true,
     },
-    "bufferAmount": {
-      value: 0,
+    "bufferedAmount": {
+      get: function() {
+        return this._bytesSent - this._readyStateObserver.bytesWritten;
+      },
       enumerable: true,
     },
     "readyState": {
@@ -251,6 +338,144 @@ var TCPServerSocket = function(options) {
 TCPServerSocket.prototype = new common.EventTargetPrototype();
 TCPServerSocket.prototype.constructor = TCPServerSocket;
 
+// UDPSocket interface.
+//
+// The datagrams received by the native side on each wakeup
+// of the socket come in a single message, and are dispatched
+// here one by one as "message" events.
+//
+var UDPMessageEvent = function(type, data) {
+  this.type = type;
+  this.data = data.data;
+  this.remoteAddress = data.remoteAddress;
+  this.remotePort = data.remotePort;
+};
+
+var UDPSocket = function(options) {
+  common.BindingObject.call(this, common.getUniqueId());
+  common.EventTarget.call(this);
+
+  internal.postMessage("UDPSocketConstructor", [this._id]);
+
+  options = options || {};
+
+  if (!options.localAddress)
+    options.localAddress = "0.0.0.0";
+  if (!options.localPort)
+    options.localPort = 0;
+  if (options.addressReuse == undefined)
+    options.addressReuse = true;
+  if (options.loopback == undefined)
+    options.loopback = false;
+
+  var highWaterMark = options.highWaterMark || 65536;
+
+  this._addMethod("_close");
+  this._addMethod("suspend");
+  this._addMethod("resume");
+  this._addMethod("joinMulticastGroup");
+  this._addMethod("leaveMulticastGroup");
+  this._addMethod("_sendString");
+  this._addMethod("_requestDrain");
+
+  this._addEvent("open");
+  this._addEvent("drain");
+  this._addEvent("error");
+  this._addEvent("message", UDPMessageEvent);
+
+  // Without |remoteAddress| and |remotePort| the datagram goes
+  // to the ones of the options.
+  function sendWrapper(data, remoteAddress, remotePort) {
+    var args = [remoteAddress || null, remotePort || null];
+    this._bytesSent += postSendData(this, data, args);
+
+    if (this.bufferedAmount < highWaterMark)
+      return true;
+
+    this._requestDrain();
+    return false;
+  };
+
+  function closeWrapper() {
+    if (this._readyStateObserver.readyState == "closed")
+      return;
+
+    this._readyStateObserver.readyState = "closing";
+    this._close();
+  };
+
+  Object.defineProperties(this, {
+    "_readyStateObserver": {
+      value: new ReadyStateObserver(this._id, "opening", true),
+    },
+    "_readyStateObserverDeleter": {
+      value: v8tools.lifecycleTracker(),
+    },
+    "_bytesSent": {
+      value: 0,
+      writable: true,
+    },
+    "send": {
+      value: sendWrapper,
+      enumerable: true,
+    },
+    "close": {
+      value: closeWrapper,
+      enumerable: true,
+    },
+    "localAddress": {
+      value: options.localAddress,
+      enumerable: true,
+    },
+    "localPort": {
+      value: options.localPort,
+      enumerable: true,
+    },
+    "remoteAddress": {
+      value: options.remoteAddress || null,
+      enumerable: true,
+    },
+    "remotePort": {
+      value: options.remotePort || null,
+      enumerable: true,
+    },
+    "addressReuse": {
+      value: options.addressReuse,
+      enumerable: true,
+    },
+    "loopback": {
+      value: options.loopback,
+      enumerable: true,
+    },
+    "bufferedAmount": {
+      get: function() {
+        return this._bytesSent - this._readyStateObserver.bytesWritten;
+      },
+      enumerable: true,
+    },
+    "readyState": {
+      get: function() { return this._readyStateObserver.readyState; },
+      enumerable: true,
+    },
+  });
+
+  var watcher = this._readyStateObserver;
+  this._readyStateObserverDeleter.destructor = function() {
+    watcher.destructor();
+  };
+
+  function delayedInitialization(obj) {
+    obj._postMessage("init", [options]);
+  };
+
+  this._registerLifecycleTracker();
+  setTimeout(delayedInitialization, 0, this);
+};
+
+UDPSocket.prototype = new common.EventTargetPrototype();
+UDPSocket.prototype.constructor = UDPSocket;
+
 // Exported API.
 exports.TCPSocket = TCPSocket;
 exports.TCPServerSocket = TCPServerSocket;
+exports.UDPSocket = UDPSocket;
@@ -9,6 +9,7 @@
 #include "xwalk/sysapps/raw_socket/raw_socket.h"
 #include "xwalk/sysapps/raw_socket/tcp_server_socket_object.h"
 #include "xwalk/sysapps/raw_socket/tcp_socket_object.h"
+#include "xwalk/sysapps/raw_socket/udp_socket_object.h"
 
 using namespace xwalk::jsapi::raw_socket; // NOLINT
 
@@ -36,15 +37,21 @@ RawSocketInstance::RawSocketInstance()
   handler_.Register("TCPSocketConstructor",
       base::Bind(&RawSocketInstance::OnTCPSocketConstructor,
                  base::Unretained(this)));
+  handler_.Register("UDPSocketConstructor",
+      base::Bind(&RawSocketInstance::OnUDPSocketConstructor,
+                 base::Unretained(this)));
 }
 
 void RawSocketInstance::HandleMessage(scoped_ptr<base::Value> msg) {
   handler_.HandleMessage(msg.Pass());
 }
 
-void RawSocketInstance::AddBindingObject(const std::string& object_id,
-                                         scoped_ptr<BindingObject> obj) {
-  store_.AddBindingObject(object_id, obj.Pass());
+void RawSocketInstance::HandleBinaryMessage(const char* data, size_t size) {
+  store_.HandleBinaryMessage(data, size);
+}
+
+int RawSocketInstance::AddNativeBindingObject(scoped_ptr<BindingObject> obj) {
+  return store_.AddNativeBindingObject(obj.Pass());
 }
 
 void RawSocketInstance::OnTCPServerSocketConstructor(
@@ -75,5 +82,19 @@ void RawSocketInstance::OnTCPSocketConstructor(
   store_.AddBindingObject(params->object_id, obj.Pass());
 }
 
+void RawSocketInstance::OnUDPSocketConstructor(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  scoped_ptr<UDPSocketConstructor::Params>
+      params(UDPSocketConstructor::Params::Create(*info->arguments()));
+
+  if (!params) {
+    LOG(WARNING) << "Malformed parameters passed to " << info->name();
+    return;
+  }
+
+  scoped_ptr<BindingObject> obj(new UDPSocketObject);
+  store_.AddBindingObject(params->object_id, obj.Pass());
+}
+
 }  // namespace sysapps
 }  // namespace xwalk
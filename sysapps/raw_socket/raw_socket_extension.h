@@ -5,7 +5,6 @@
 #ifndef XWALK_SYSAPPS_RAW_SOCKET_RAW_SOCKET_EXTENSION_H_
 #define XWALK_SYSAPPS_RAW_SOCKET_RAW_SOCKET_EXTENSION_H_
 
-#include <string>
 #include "base/values.h"
 #include "xwalk/sysapps/common/binding_object_store.h"
 
@@ -32,14 +31,16 @@ class RawSocketInstance : public XWalkExtensionInstance {
 
   // XWalkExtensionInstance implementation.
   virtual void HandleMessage(scoped_ptr<base::Value> msg) OVERRIDE;
+  virtual void HandleBinaryMessage(const char* data, size_t size) OVERRIDE;
 
-  void AddBindingObject(const std::string& object_id,
-                        scoped_ptr<BindingObject> obj);
+  // Returns the handle of |obj|, see BindingObjectStore.
+  int AddNativeBindingObject(scoped_ptr<BindingObject> obj);
 
  private:
   void OnTCPServerSocketConstructor(
       scoped_ptr<XWalkExtensionFunctionInfo> info);
   void OnTCPSocketConstructor(scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void OnUDPSocketConstructor(scoped_ptr<XWalkExtensionFunctionInfo> info);
 
   XWalkExtensionFunctionHandler handler_;
   BindingObjectStore store_;
@@ -10,7 +10,8 @@
 namespace xwalk {
 namespace sysapps {
 
-RawSocketObject::RawSocketObject() {}
+RawSocketObject::RawSocketObject()
+    : readystate_event_(RegisterEvent("readystate")) {}
 
 RawSocketObject::~RawSocketObject() {}
 
@@ -18,7 +19,7 @@ void RawSocketObject::setReadyState(ReadyState state) {
   scoped_ptr<base::ListValue> eventData(new base::ListValue);
   eventData->AppendString(ToString(state));
 
-  DispatchEvent("readystate", eventData.Pass());
+  DispatchEvent(readystate_event_, eventData.Pass());
 }
 
 }  // namespace sysapps
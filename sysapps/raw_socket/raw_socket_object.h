@@ -22,6 +22,9 @@ class RawSocketObject : public EventTarget {
   RawSocketObject();
 
   void setReadyState(ReadyState state);
+
+ private:
+  EventType readystate_event_;
 };
 
 }  // namespace sysapps
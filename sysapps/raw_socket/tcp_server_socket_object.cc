@@ -5,7 +5,6 @@
 #include "xwalk/sysapps/raw_socket/tcp_server_socket_object.h"
 
 #include <string.h>
-#include "base/guid.h"
 #include "base/logging.h"
 #include "net/base/ip_endpoint.h"
 #include "net/base/net_errors.h"
@@ -119,12 +118,11 @@ void TCPServerSocketObject::OnAccept(int status) {
     options.no_delay = true;
     options.use_secure_transport = false;
 
-    std::string object_id = base::GenerateGUID();
     scoped_ptr<BindingObject> obj(new TCPSocketObject(accepted_socket_.Pass()));
-    instance_->AddBindingObject(object_id, obj.Pass());
+    int object_id = instance_->AddNativeBindingObject(obj.Pass());
 
     scoped_ptr<base::ListValue> dataList(new base::ListValue);
-    dataList->AppendString(object_id);
+    dataList->AppendInteger(object_id);
     dataList->Append(options.ToValue().release());
 
     scoped_ptr<base::ListValue> eventData(new base::ListValue);
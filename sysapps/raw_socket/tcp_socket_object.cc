@@ -17,6 +17,14 @@ namespace {
 
 const unsigned kBufferSize = 4096;
 
+// Reads kept while waiting for JavaScript to handle the previous ones.
+const size_t kMaxPendingReads = 16;
+
+// Queued writes smaller than this are copied together into a single write of
+// up to kMaxGatheredWriteSize bytes. Bigger ones are written in place.
+const int kSmallWriteSize = 4096;
+const int kMaxGatheredWriteSize = 65536;
+
 }  // namespace
 
 namespace xwalk {
@@ -26,8 +34,10 @@ TCPSocketObject::TCPSocketObject()
     : has_write_pending_(false),
       is_suspended_(false),
       is_half_closed_(false),
+      is_read_paused_(false),
       read_buffer_(new net::IOBuffer(kBufferSize)),
-      write_buffer_(new net::IOBuffer(kBufferSize)),
+      bytes_written_(0),
+      needs_drain_(false),
       resolver_(net::HostResolver::CreateDefaultResolver(NULL)),
       single_resolver_(new net::SingleRequestHostResolver(resolver_.get())) {
   RegisterHandlers();
@@ -37,8 +47,10 @@ TCPSocketObject::TCPSocketObject(scoped_ptr<net::StreamSocket> socket)
     : has_write_pending_(false),
       is_suspended_(false),
       is_half_closed_(false),
+      is_read_paused_(false),
       read_buffer_(new net::IOBuffer(kBufferSize)),
-      write_buffer_(new net::IOBuffer(kBufferSize)),
+      bytes_written_(0),
+      needs_drain_(false),
       socket_(socket.release()) {
   RegisterHandlers();
 }
@@ -46,11 +58,17 @@ TCPSocketObject::TCPSocketObject(scoped_ptr<net::StreamSocket> socket)
 TCPSocketObject::~TCPSocketObject() {}
 
 void TCPSocketObject::RegisterHandlers() {
+  data_event_ = RegisterEvent("data");
+  drain_event_ = RegisterEvent("drain");
+  written_event_ = RegisterEvent("written");
+  SetEventDeliveryPolicy(data_event_, DELIVER_QUEUED, kMaxPendingReads);
+  SetEventDeliveryPolicy(written_event_, DELIVER_LATEST, 1);
+
   handler_.Register("init",
       base::Bind(&TCPSocketObject::OnInit, base::Unretained(this)));
   handler_.Register("_close",
       base::Bind(&TCPSocketObject::OnClose, base::Unretained(this)));
-  handler_.Register("halfclose",
+  handler_.Register("_halfclose",
       base::Bind(&TCPSocketObject::OnHalfClose, base::Unretained(this)));
   handler_.Register("suspend",
       base::Bind(&TCPSocketObject::OnSuspend, base::Unretained(this)));
@@ -58,6 +76,8 @@ void TCPSocketObject::RegisterHandlers() {
       base::Bind(&TCPSocketObject::OnResume, base::Unretained(this)));
   handler_.Register("_sendString",
       base::Bind(&TCPSocketObject::OnSendString, base::Unretained(this)));
+  handler_.Register("_requestDrain",
+      base::Bind(&TCPSocketObject::OnRequestDrain, base::Unretained(this)));
 }
 
 void TCPSocketObject::DoRead() {
@@ -73,6 +93,112 @@ void TCPSocketObject::DoRead() {
     OnRead(ret);
 }
 
+void TCPSocketObject::QueueWrite(net::IOBuffer* buffer, int size) {
+  // JavaScript doesn't send anything after halfclose(), see send().
+  if (is_half_closed_ || size <= 0)
+    return;
+
+  write_queue_.push_back(new net::DrainableIOBuffer(buffer, size));
+
+  // Data sent before the connection is established waits in the queue,
+  // OnConnect() writes it.
+  if (!has_write_pending_ && socket_ && socket_->IsConnected())
+    DoWrite();
+}
+
+void TCPSocketObject::GatherSmallWrites() {
+  if (write_queue_.size() < 2 ||
+      write_queue_.front()->BytesRemaining() >= kSmallWriteSize)
+    return;
+
+  size_t count = 0;
+  int size = 0;
+  while (count < write_queue_.size()) {
+    int remaining = write_queue_[count]->BytesRemaining();
+    if (remaining >= kSmallWriteSize ||
+        size + remaining > kMaxGatheredWriteSize)
+      break;
+    size += remaining;
+    ++count;
+  }
+
+  if (count < 2)
+    return;
+
+  scoped_refptr<net::IOBuffer> gathered(new net::IOBuffer(size));
+  int offset = 0;
+  for (size_t i = 0; i < count; ++i) {
+    net::DrainableIOBuffer* buffer = write_queue_.front().get();
+    memcpy(gathered->data() + offset, buffer->data(),
+           buffer->BytesRemaining());
+    offset += buffer->BytesRemaining();
+    write_queue_.pop_front();
+  }
+
+  write_queue_.push_front(new net::DrainableIOBuffer(gathered.get(), size));
+}
+
+void TCPSocketObject::DoWrite() {
+  while (!write_queue_.empty()) {
+    GatherSmallWrites();
+
+    net::DrainableIOBuffer* buffer = write_queue_.front().get();
+    int ret = socket_->Write(buffer,
+                             buffer->BytesRemaining(),
+                             base::Bind(&TCPSocketObject::OnWrite,
+                                        base::Unretained(this)));
+
+    if (ret == net::ERR_IO_PENDING) {
+      has_write_pending_ = true;
+      return;
+    }
+
+    if (!DidWrite(ret))
+      return;
+  }
+}
+
+bool TCPSocketObject::DidWrite(int result) {
+  if (result < 0) {
+    write_queue_.clear();
+    socket_->Disconnect();
+    setReadyState(READY_STATE_CLOSED);
+    DispatchEvent("error");
+    return false;
+  }
+
+  net::DrainableIOBuffer* buffer = write_queue_.front().get();
+  buffer->DidConsume(result);
+  if (!buffer->BytesRemaining())
+    write_queue_.pop_front();
+
+  bytes_written_ += result;
+  scoped_ptr<base::ListValue> eventData(new base::ListValue);
+  eventData->AppendDouble(bytes_written_);
+  DispatchEvent(written_event_, eventData.Pass());
+
+  if (write_queue_.empty() && needs_drain_) {
+    needs_drain_ = false;
+    DispatchEvent(drain_event_);
+  }
+
+  return true;
+}
+
+void TCPSocketObject::HandleBinaryMessage(const std::string& name,
+                                          const base::ListValue& args,
+                                          const char* data, size_t size) {
+  if (name != "sendArrayBuffer" && name != "sendArrayBufferView") {
+    LOG(WARNING) << "Unknown binary message " << name << ".";
+    return;
+  }
+
+  // The data only lives during this call, it is copied once to be queued.
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(size));
+  memcpy(buffer->data(), data, size);
+  QueueWrite(buffer.get(), size);
+}
+
 void TCPSocketObject::OnInit(scoped_ptr<XWalkExtensionFunctionInfo> info) {
   if (socket_) {
     DoRead();
@@ -124,40 +250,29 @@ void TCPSocketObject::OnResume(scoped_ptr<XWalkExtensionFunctionInfo> info) {
   is_suspended_ = false;
 }
 
+// The string is read in place rather than through SendDOMString::Params and
+// the buffer queued owns it, so it is copied once whatever its size.
 void TCPSocketObject::OnSendString(
     scoped_ptr<XWalkExtensionFunctionInfo> info) {
-  if (is_half_closed_ || has_write_pending_)
-    return;
-
-  if (!socket_ || !socket_->IsConnected())
-    return;
-
-  scoped_ptr<SendDOMString::Params>
-      params(SendDOMString::Params::Create(*info->arguments()));
-
-  if (!params) {
+  scoped_ptr<std::string> data(new std::string);
+  if (!info->arguments()->GetString(0, data.get())) {
     LOG(WARNING) << "Malformed parameters passed to " << info->name();
     return;
   }
 
-  if (params->data.size() > kBufferSize) {
-    LOG(WARNING) << "Write data bigger than the write buffer.";
+  int size = data->size();
+  scoped_refptr<net::IOBuffer> buffer(new net::StringIOBuffer(data.Pass()));
+  QueueWrite(buffer.get(), size);
+}
+
+void TCPSocketObject::OnRequestDrain(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  if (write_queue_.empty()) {
+    DispatchEvent(drain_event_);
     return;
   }
 
-  memcpy(write_buffer_->data(), params->data.data(), params->data.size());
-
-  int ret = socket_->Write(write_buffer_,
-                           params->data.size(),
-                           base::Bind(&TCPSocketObject::OnWrite,
-                                      base::Unretained(this)));
-
-  if (ret == net::ERR_IO_PENDING)
-    has_write_pending_ = true;
-  else if (ret == static_cast<int>(params->data.size()))
-    return;
-  else
-    socket_->Disconnect();
+  needs_drain_ = true;
 }
 
 void TCPSocketObject::OnConnect(int status) {
@@ -169,6 +284,7 @@ void TCPSocketObject::OnConnect(int status) {
 
     DispatchEvent("open");
     DoRead();
+    DoWrite();
   } else {
     setReadyState(READY_STATE_CLOSED);
     DispatchEvent("error");
@@ -192,14 +308,28 @@ void TCPSocketObject::OnRead(int status) {
   eventData->Append(data.release());
 
   if (!is_suspended_)
-    DispatchEvent("data", eventData.Pass());
+    DispatchEvent(data_event_, eventData.Pass());
+
+  if (!CanDispatchEvent(data_event_)) {
+    is_read_paused_ = true;
+    return;
+  }
+
+  DoRead();
+}
+
+void TCPSocketObject::OnEventAcknowledged(EventType type) {
+  if (type != data_event_ || !is_read_paused_ || !CanDispatchEvent(type))
+    return;
 
+  is_read_paused_ = false;
   DoRead();
 }
 
 void TCPSocketObject::OnWrite(int status) {
   has_write_pending_ = false;
-  DispatchEvent("drain");
+  if (DidWrite(status))
+    DoWrite();
 }
 
 void TCPSocketObject::OnResolved(int status) {
@@ -5,6 +5,7 @@
 #ifndef XWALK_SYSAPPS_RAW_SOCKET_TCP_SOCKET_OBJECT_H_
 #define XWALK_SYSAPPS_RAW_SOCKET_TCP_SOCKET_OBJECT_H_
 
+#include <deque>
 #include <string>
 #include "net/dns/single_request_host_resolver.h"
 #include "net/base/io_buffer.h"
@@ -24,6 +25,22 @@ class TCPSocketObject : public RawSocketObject {
   void RegisterHandlers();
   void DoRead();
 
+  // Writes the queued data until the socket blocks. Small buffers at the
+  // front of the queue are gathered into a single write first.
+  void DoWrite();
+  void GatherSmallWrites();
+  void QueueWrite(net::IOBuffer* buffer, int size);
+  // Returns false if the socket failed.
+  bool DidWrite(int result);
+
+  // BindingObject implementation.
+  virtual void HandleBinaryMessage(const std::string& name,
+                                   const base::ListValue& args,
+                                   const char* data, size_t size) OVERRIDE;
+
+  // EventTarget implementation.
+  virtual void OnEventAcknowledged(EventType type) OVERRIDE;
+
   // JavaScript function handlers.
   void OnInit(scoped_ptr<XWalkExtensionFunctionInfo> info);
   void OnClose(scoped_ptr<XWalkExtensionFunctionInfo> info);
@@ -31,6 +48,7 @@ class TCPSocketObject : public RawSocketObject {
   void OnSuspend(scoped_ptr<XWalkExtensionFunctionInfo> info);
   void OnResume(scoped_ptr<XWalkExtensionFunctionInfo> info);
   void OnSendString(scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void OnRequestDrain(scoped_ptr<XWalkExtensionFunctionInfo> info);
 
   // net::TCPClientSocket callbacks.
   void OnConnect(int status);
@@ -43,14 +61,27 @@ class TCPSocketObject : public RawSocketObject {
   bool has_write_pending_;
   bool is_suspended_;
   bool is_half_closed_;
+  // Reading stops while JavaScript is behind on the data events.
+  bool is_read_paused_;
 
   scoped_refptr<net::IOBuffer> read_buffer_;
-  scoped_refptr<net::IOBuffer> write_buffer_;
   scoped_ptr<net::StreamSocket> socket_;
 
+  // Data sent by JavaScript and not written yet. JavaScript keeps the count
+  // of bytes sent, |bytes_written_| tells it the bufferedAmount.
+  std::deque<scoped_refptr<net::DrainableIOBuffer> > write_queue_;
+  double bytes_written_;
+  // Set when send() returned false, so JavaScript expects a drain event once
+  // the queue is empty.
+  bool needs_drain_;
+
   scoped_ptr<net::HostResolver> resolver_;
   scoped_ptr<net::SingleRequestHostResolver> single_resolver_;
   net::AddressList addresses_;
+
+  EventType data_event_;
+  EventType drain_event_;
+  EventType written_event_;
 };
 
 }  // namespace sysapps
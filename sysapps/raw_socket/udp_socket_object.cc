@@ -0,0 +1,402 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/sysapps/raw_socket/udp_socket_object.h"
+
+#include <string.h>
+#include "base/logging.h"
+#include "base/message_loop/message_loop.h"
+#include "net/base/net_errors.h"
+#include "net/base/net_util.h"
+#include "net/base/rand_callback.h"
+#include "xwalk/sysapps/raw_socket/udp_socket.h"
+
+using namespace xwalk::jsapi::udp_socket; // NOLINT
+using namespace xwalk::jsapi::raw_socket; // NOLINT
+
+namespace {
+
+// Biggest payload of an UDP datagram.
+const int kMaxDatagramSize = 65536;
+
+// Datagrams read on a wakeup of the socket before letting other tasks run.
+const size_t kMaxDatagramsPerWakeup = 64;
+
+// Datagrams kept while waiting for JavaScript to handle the previous ones.
+const size_t kMaxPendingDatagrams = 256;
+
+bool ParseEndPoint(const std::string& host, int port,
+                   net::IPEndPoint* address) {
+  net::IPAddressNumber ip_number;
+  if (!net::ParseIPLiteralToNumber(host, &ip_number) ||
+      port < 0 || port > 65535)
+    return false;
+
+  *address = net::IPEndPoint(ip_number, port);
+  return true;
+}
+
+}  // namespace
+
+namespace xwalk {
+namespace sysapps {
+
+UDPSocketObject::PendingSend::PendingSend() : size(0) {}
+
+UDPSocketObject::PendingSend::~PendingSend() {}
+
+UDPSocketObject::UDPSocketObject()
+    : is_suspended_(false),
+      is_recv_paused_(false),
+      has_send_pending_(false),
+      recv_buffer_(new net::IOBuffer(kMaxDatagramSize)),
+      has_remote_address_(false),
+      bytes_sent_(0),
+      needs_drain_(false),
+      weak_factory_(this) {
+  message_event_ = RegisterEvent("message");
+  drain_event_ = RegisterEvent("drain");
+  written_event_ = RegisterEvent("written");
+  SetEventDeliveryPolicy(message_event_, DELIVER_BATCHED, kMaxPendingDatagrams);
+  SetEventDeliveryPolicy(written_event_, DELIVER_LATEST, 1);
+
+  handler_.Register("init",
+      base::Bind(&UDPSocketObject::OnInit, base::Unretained(this)));
+  handler_.Register("_close",
+      base::Bind(&UDPSocketObject::OnClose, base::Unretained(this)));
+  handler_.Register("suspend",
+      base::Bind(&UDPSocketObject::OnSuspend, base::Unretained(this)));
+  handler_.Register("resume",
+      base::Bind(&UDPSocketObject::OnResume, base::Unretained(this)));
+  handler_.Register("joinMulticastGroup",
+      base::Bind(&UDPSocketObject::OnJoinMulticastGroup,
+                 base::Unretained(this)));
+  handler_.Register("leaveMulticastGroup",
+      base::Bind(&UDPSocketObject::OnLeaveMulticastGroup,
+                 base::Unretained(this)));
+  handler_.Register("_sendString",
+      base::Bind(&UDPSocketObject::OnSendString, base::Unretained(this)));
+  handler_.Register("_requestDrain",
+      base::Bind(&UDPSocketObject::OnRequestDrain, base::Unretained(this)));
+}
+
+UDPSocketObject::~UDPSocketObject() {}
+
+void UDPSocketObject::StartRecv() {
+  if (!socket_)
+    return;
+
+  DoRecv(make_scoped_ptr(new base::ListValue));
+}
+
+void UDPSocketObject::DoRecv(scoped_ptr<base::ListValue> datagrams) {
+  int result = net::OK;
+  while (datagrams->GetSize() < kMaxDatagramsPerWakeup &&
+         CanDispatchEvent(message_event_)) {
+    result = socket_->RecvFrom(recv_buffer_.get(),
+                               kMaxDatagramSize,
+                               &recv_address_,
+                               base::Bind(&UDPSocketObject::OnRecvFrom,
+                                          base::Unretained(this)));
+    if (result >= 0)
+      AppendDatagram(result, datagrams.get());
+    else if (result == net::ERR_MSG_TOO_BIG)
+      result = net::OK;  // The datagram is dropped.
+    else
+      break;
+  }
+
+  if (!is_suspended_)
+    DispatchEvents(message_event_, datagrams.Pass());
+
+  if (result == net::ERR_IO_PENDING)
+    return;
+
+  if (result < 0) {
+    OnRecvError(result);
+    return;
+  }
+
+  if (!CanDispatchEvent(message_event_)) {
+    is_recv_paused_ = true;
+    return;
+  }
+
+  // More datagrams might be waiting, they are read after the other tasks.
+  base::MessageLoop::current()->PostTask(FROM_HERE,
+      base::Bind(&UDPSocketObject::StartRecv, weak_factory_.GetWeakPtr()));
+}
+
+void UDPSocketObject::AppendDatagram(int size, base::ListValue* datagrams) {
+  base::DictionaryValue* datagram = new base::DictionaryValue;
+  datagram->Set("data", base::BinaryValue::CreateWithCopiedBuffer(
+      recv_buffer_->data(), size));
+  datagram->SetString("remoteAddress", recv_address_.ToStringWithoutPort());
+  datagram->SetInteger("remotePort", recv_address_.port());
+  datagrams->Append(datagram);
+}
+
+void UDPSocketObject::OnRecvError(int result) {
+  LOG(WARNING) << "Failed to receive from the UDP socket: "
+      << net::ErrorToString(result);
+  socket_.reset();
+  send_queue_.clear();
+  has_send_pending_ = false;
+  setReadyState(READY_STATE_CLOSED);
+  DispatchEvent("error");
+}
+
+bool UDPSocketObject::GetRemoteEndPoint(const base::ListValue& args,
+                                        size_t index,
+                                        net::IPEndPoint* address) const {
+  std::string host;
+  int port;
+  if (args.GetString(index, &host) && args.GetInteger(index + 1, &port))
+    return ParseEndPoint(host, port, address);
+
+  if (!has_remote_address_)
+    return false;
+
+  *address = remote_address_;
+  return true;
+}
+
+void UDPSocketObject::QueueSend(net::IOBuffer* buffer, int size,
+                                const base::ListValue& args,
+                                size_t address_index) {
+  PendingSend send;
+  if (!GetRemoteEndPoint(args, address_index, &send.address)) {
+    LOG(WARNING) << "Invalid destination for the datagram.";
+    // JavaScript counted the datagram as sent.
+    DidSend(size);
+    return;
+  }
+
+  send.buffer = buffer;
+  send.size = size;
+  send_queue_.push_back(send);
+
+  // Datagrams sent before the socket is bound wait in the queue.
+  if (!has_send_pending_ && socket_)
+    DoSend();
+}
+
+void UDPSocketObject::DoSend() {
+  while (!send_queue_.empty()) {
+    const PendingSend& send = send_queue_.front();
+    int result = socket_->SendTo(send.buffer.get(),
+                                 send.size,
+                                 send.address,
+                                 base::Bind(&UDPSocketObject::OnSendTo,
+                                            base::Unretained(this)));
+    if (result == net::ERR_IO_PENDING) {
+      has_send_pending_ = true;
+      return;
+    }
+
+    // Failing to send a datagram doesn't make the socket unusable.
+    if (result < 0) {
+      LOG(WARNING) << "Failed to send a datagram: "
+          << net::ErrorToString(result);
+    }
+
+    int size = send.size;
+    send_queue_.pop_front();
+    DidSend(size);
+  }
+}
+
+void UDPSocketObject::DidSend(int size) {
+  bytes_sent_ += size;
+  scoped_ptr<base::ListValue> eventData(new base::ListValue);
+  eventData->AppendDouble(bytes_sent_);
+  DispatchEvent(written_event_, eventData.Pass());
+
+  if (send_queue_.empty() && needs_drain_) {
+    needs_drain_ = false;
+    DispatchEvent(drain_event_);
+  }
+}
+
+void UDPSocketObject::HandleBinaryMessage(const std::string& name,
+                                          const base::ListValue& args,
+                                          const char* data, size_t size) {
+  if (name != "sendArrayBuffer" && name != "sendArrayBufferView") {
+    LOG(WARNING) << "Unknown binary message " << name << ".";
+    return;
+  }
+
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(size));
+  memcpy(buffer->data(), data, size);
+  QueueSend(buffer.get(), size, args, 0);
+}
+
+void UDPSocketObject::OnEventAcknowledged(EventType type) {
+  if (type != message_event_ || !is_recv_paused_ || !CanDispatchEvent(type))
+    return;
+
+  is_recv_paused_ = false;
+  StartRecv();
+}
+
+void UDPSocketObject::OnInit(scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  scoped_ptr<Init::Params> params(Init::Params::Create(*info->arguments()));
+  if (!params) {
+    LOG(WARNING) << "Malformed parameters passed to " << info->name();
+    setReadyState(READY_STATE_CLOSED);
+    DispatchEvent("error");
+    return;
+  }
+
+  const UDPOptions& options = params->options;
+  net::IPEndPoint local_address;
+  if (!ParseEndPoint(options.local_address, options.local_port,
+                     &local_address)) {
+    LOG(WARNING) << "Invalid IP address " << options.local_address;
+    setReadyState(READY_STATE_CLOSED);
+    DispatchEvent("error");
+    return;
+  }
+
+  if (options.remote_address && options.remote_port) {
+    if (!ParseEndPoint(*options.remote_address, *options.remote_port,
+                       &remote_address_)) {
+      LOG(WARNING) << "Invalid IP address " << *options.remote_address;
+      setReadyState(READY_STATE_CLOSED);
+      DispatchEvent("error");
+      return;
+    }
+    has_remote_address_ = true;
+  }
+
+  socket_.reset(new net::UDPSocket(net::DatagramSocket::DEFAULT_BIND,
+                                   net::RandIntCallback(),
+                                   NULL,
+                                   net::NetLog::Source()));
+
+  // These must be set before binding.
+  if (options.address_reuse)
+    socket_->AllowAddressReuse();
+  socket_->AllowBroadcast();
+  socket_->SetMulticastLoopbackMode(options.loopback);
+
+  if (socket_->Bind(local_address) != net::OK) {
+    LOG(WARNING) << "Failed to bind to " << options.local_address
+        << " port " << options.local_port;
+    socket_.reset();
+    setReadyState(READY_STATE_CLOSED);
+    DispatchEvent("error");
+    return;
+  }
+
+  setReadyState(READY_STATE_OPEN);
+  DispatchEvent("open");
+  StartRecv();
+  DoSend();
+}
+
+void UDPSocketObject::OnClose(scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  socket_.reset();
+  send_queue_.clear();
+  has_send_pending_ = false;
+
+  setReadyState(READY_STATE_CLOSED);
+  DispatchEvent("close");
+}
+
+void UDPSocketObject::OnSuspend(scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  is_suspended_ = true;
+}
+
+void UDPSocketObject::OnResume(scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  is_suspended_ = false;
+}
+
+void UDPSocketObject::OnJoinMulticastGroup(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  scoped_ptr<JoinMulticastGroup::Params>
+      params(JoinMulticastGroup::Params::Create(*info->arguments()));
+
+  if (!params) {
+    LOG(WARNING) << "Malformed parameters passed to " << info->name();
+    return;
+  }
+
+  net::IPAddressNumber group;
+  if (!socket_ ||
+      !net::ParseIPLiteralToNumber(params->multicast_group_address, &group) ||
+      socket_->JoinGroup(group) != net::OK) {
+    LOG(WARNING) << "Failed to join the multicast group "
+        << params->multicast_group_address;
+    DispatchEvent("error");
+  }
+}
+
+void UDPSocketObject::OnLeaveMulticastGroup(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  scoped_ptr<LeaveMulticastGroup::Params>
+      params(LeaveMulticastGroup::Params::Create(*info->arguments()));
+
+  if (!params) {
+    LOG(WARNING) << "Malformed parameters passed to " << info->name();
+    return;
+  }
+
+  net::IPAddressNumber group;
+  if (!socket_ ||
+      !net::ParseIPLiteralToNumber(params->multicast_group_address, &group) ||
+      socket_->LeaveGroup(group) != net::OK) {
+    LOG(WARNING) << "Failed to leave the multicast group "
+        << params->multicast_group_address;
+  }
+}
+
+void UDPSocketObject::OnSendString(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  scoped_ptr<std::string> data(new std::string);
+  if (!info->arguments()->GetString(0, data.get())) {
+    LOG(WARNING) << "Malformed parameters passed to " << info->name();
+    return;
+  }
+
+  int size = data->size();
+  scoped_refptr<net::IOBuffer> buffer(new net::StringIOBuffer(data.Pass()));
+  QueueSend(buffer.get(), size, *info->arguments(), 1);
+}
+
+void UDPSocketObject::OnRequestDrain(
+    scoped_ptr<XWalkExtensionFunctionInfo> info) {
+  if (send_queue_.empty()) {
+    DispatchEvent(drain_event_);
+    return;
+  }
+
+  needs_drain_ = true;
+}
+
+void UDPSocketObject::OnRecvFrom(int result) {
+  scoped_ptr<base::ListValue> datagrams(new base::ListValue);
+  if (result >= 0) {
+    AppendDatagram(result, datagrams.get());
+  } else if (result != net::ERR_MSG_TOO_BIG) {
+    OnRecvError(result);
+    return;
+  }
+
+  DoRecv(datagrams.Pass());
+}
+
+void UDPSocketObject::OnSendTo(int result) {
+  has_send_pending_ = false;
+  if (result < 0)
+    LOG(WARNING) << "Failed to send a datagram: " << net::ErrorToString(result);
+
+  int size = send_queue_.front().size;
+  send_queue_.pop_front();
+  DidSend(size);
+  DoSend();
+}
+
+}  // namespace sysapps
+}  // namespace xwalk
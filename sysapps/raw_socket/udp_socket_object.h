@@ -0,0 +1,100 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef XWALK_SYSAPPS_RAW_SOCKET_UDP_SOCKET_OBJECT_H_
+#define XWALK_SYSAPPS_RAW_SOCKET_UDP_SOCKET_OBJECT_H_
+
+#include <deque>
+#include <string>
+#include "base/memory/weak_ptr.h"
+#include "net/base/io_buffer.h"
+#include "net/base/ip_endpoint.h"
+#include "net/udp/udp_socket.h"
+#include "xwalk/sysapps/raw_socket/raw_socket_object.h"
+
+namespace xwalk {
+namespace sysapps {
+
+// Receives the datagrams available on each wakeup of the socket in a loop,
+// and sends them to JavaScript as a single batch of "message" events, see
+// EventTarget::DispatchEvents(). Reading stops while JavaScript is behind.
+class UDPSocketObject : public RawSocketObject {
+ public:
+  UDPSocketObject();
+  virtual ~UDPSocketObject();
+
+ private:
+  struct PendingSend {
+    PendingSend();
+    ~PendingSend();
+
+    scoped_refptr<net::IOBuffer> buffer;
+    int size;
+    net::IPEndPoint address;
+  };
+
+  void StartRecv();
+  void DoRecv(scoped_ptr<base::ListValue> datagrams);
+  void AppendDatagram(int size, base::ListValue* datagrams);
+  void OnRecvError(int result);
+
+  // Reads the destination from |args| at |index|, the remote address of
+  // the options being the default.
+  bool GetRemoteEndPoint(const base::ListValue& args, size_t index,
+                         net::IPEndPoint* address) const;
+  void QueueSend(net::IOBuffer* buffer, int size, const base::ListValue& args,
+                 size_t address_index);
+  void DoSend();
+  void DidSend(int size);
+
+  // BindingObject implementation.
+  virtual void HandleBinaryMessage(const std::string& name,
+                                   const base::ListValue& args,
+                                   const char* data, size_t size) OVERRIDE;
+
+  // EventTarget implementation.
+  virtual void OnEventAcknowledged(EventType type) OVERRIDE;
+
+  // JavaScript function handlers.
+  void OnInit(scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void OnClose(scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void OnSuspend(scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void OnResume(scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void OnJoinMulticastGroup(scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void OnLeaveMulticastGroup(scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void OnSendString(scoped_ptr<XWalkExtensionFunctionInfo> info);
+  void OnRequestDrain(scoped_ptr<XWalkExtensionFunctionInfo> info);
+
+  // net::UDPSocket callbacks.
+  void OnRecvFrom(int result);
+  void OnSendTo(int result);
+
+  bool is_suspended_;
+  bool is_recv_paused_;
+  bool has_send_pending_;
+
+  scoped_refptr<net::IOBuffer> recv_buffer_;
+  net::IPEndPoint recv_address_;
+  scoped_ptr<net::UDPSocket> socket_;
+
+  bool has_remote_address_;
+  net::IPEndPoint remote_address_;
+
+  // Like in TCPSocketObject, JavaScript gets the bufferedAmount from the
+  // bytes sent.
+  std::deque<PendingSend> send_queue_;
+  double bytes_sent_;
+  bool needs_drain_;
+
+  EventType message_event_;
+  EventType drain_event_;
+  EventType written_event_;
+
+  base::WeakPtrFactory<UDPSocketObject> weak_factory_;
+};
+
+}  // namespace sysapps
+}  // namespace xwalk
+
+#endif  // XWALK_SYSAPPS_RAW_SOCKET_UDP_SOCKET_OBJECT_H_